@@ -0,0 +1,918 @@
+/**
+ * aot.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include "aot.h"
+
+/*
+ * Implementation notes:
+ *
+ * Generated functions keep intermediate values in an array, r. A form
+ * compiled to slot d leaves its value in r[d] and may use the slots above d,
+ * so the operands of a call land in consecutive slots and can be passed as
+ * they are. Every value is checked for NULL as soon as it is made, and NULL
+ * is returned from the function, which is how the interpreter propagates
+ * errors too.
+ *
+ * Forms that the generated code needs, such as quoted data and forms left to
+ * the interpreter, are "constants": the program finds them by walking the
+ * parsed script along a path of cars and cdrs.
+ */
+
+// The builtins compiled inline, under the names they are registered with
+enum inline_kind {
+	INLINE_NONE,
+	INLINE_ARITH,
+	INLINE_FIELD,
+	INLINE_IS_EMPTY,
+	INLINE_QUOTE,
+	INLINE_COND,
+	INLINE_AND,
+	INLINE_OR,
+	INLINE_DEFINE
+};
+
+static const struct {
+	char *name;
+	enum inline_kind kind;
+	// the C operator or field
+	char *operation;
+} inlines[] = {
+	{"+", INLINE_ARITH, "+"},
+	{"-", INLINE_ARITH, "-"},
+	{"*", INLINE_ARITH, "*"},
+	{"<", INLINE_ARITH, "<"},
+	{">", INLINE_ARITH, ">"},
+	{"=", INLINE_ARITH, "=="},
+	{"<=", INLINE_ARITH, "<="},
+	{">=", INLINE_ARITH, ">="},
+	{"car", INLINE_FIELD, "first"},
+	{"cdr", INLINE_FIELD, "rest"},
+	{"null?", INLINE_IS_EMPTY, NULL},
+	{"empty?", INLINE_IS_EMPTY, NULL},
+	{"not", INLINE_IS_EMPTY, NULL},
+	{"quote", INLINE_QUOTE, NULL},
+	{"cond", INLINE_COND, NULL},
+	{"and", INLINE_AND, NULL},
+	{"or", INLINE_OR, NULL},
+	{"define", INLINE_DEFINE, NULL}
+};
+
+struct constant {
+	struct s_expr *expr;
+	int form;
+	char *steps;
+};
+
+struct pending_lambda {
+	struct s_expr *body;
+	int constant;
+	char *name;
+};
+
+/**
+ * compiler - The state of aot_compile()
+ * @code - the text of the function being compiled
+ * @indent - the nesting of the code being written, in tabs
+ * @slots - the number of slots the function uses so far
+ * @labels - the number of labels the function uses so far
+ * @loops - whether the function has jumped back to its start
+ * @body - the body being compiled, or NULL for a top-level form
+ * @can_loop - whether self tail calls from `body` can jump back
+ * @form - the top-level form being compiled
+ * @path - the path from `form` to the form being compiled
+ * @path_length
+ * @path_capacity
+ * @constants
+ * @constant_count
+ * @constant_capacity
+ * @constant_table - indices + 1 into `constants`, by address
+ * @table_capacity
+ * @builtins - the names of builtins guarded on
+ * @builtin_count
+ * @builtin_capacity
+ * @lambdas - the bodies to compile
+ * @lambda_count
+ * @lambda_capacity
+ */
+struct compiler {
+	FILE *code;
+	int indent;
+	int slots;
+	int labels;
+	int loops;
+	struct s_expr *body;
+	int can_loop;
+	int form;
+	char *path;
+	int path_length;
+	int path_capacity;
+	struct constant *constants;
+	int constant_count;
+	int constant_capacity;
+	int *constant_table;
+	int table_capacity;
+	char **builtins;
+	int builtin_count;
+	int builtin_capacity;
+	struct pending_lambda *lambdas;
+	int lambda_count;
+	int lambda_capacity;
+};
+
+static void *grow(void *array, int *capacity, size_t size)
+{
+	*capacity = *capacity == 0 ? 16 : *capacity * 2;
+	array = realloc(array, *capacity * size);
+	if (array == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	return array;
+}
+
+static void emit(struct compiler *c, char *format, ...)
+{
+	va_list args;
+	int i;
+
+	for (i = 0; i < c->indent; i++)
+		fputc('\t', c->code);
+	va_start(args, format);
+	vfprintf(c->code, format, args);
+	va_end(args);
+	fputc('\n', c->code);
+}
+
+static void write_c_string(FILE *out, char *chars, size_t length)
+{
+	size_t i;
+
+	fputc('"', out);
+	for (i = 0; i < length; i++) {
+		unsigned char ch = chars[i];
+
+		if (ch == '"' || ch == '\\' || ch == '?')
+			fprintf(out, "\\%c", ch);
+		else if (ch == '\n' && i + 1 < length)
+			fputs("\\n\"\n\t\"", out);
+		else if (ch == '\n')
+			fputs("\\n", out);
+		else if (ch < ' ' || ch >= 127)
+			fprintf(out, "\\%03o", ch);
+		else
+			fputc(ch, out);
+	}
+	fputc('"', out);
+}
+
+// Returns `chars` as a C string literal, in a string to free().
+static char *c_string(char *chars)
+{
+	char *literal;
+	size_t length;
+	FILE *out = open_memstream(&literal, &length);
+
+	if (out == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	write_c_string(out, chars, strlen(chars));
+	fclose(out);
+	return literal;
+}
+
+// Moves the path to element `index` of the current form, returning the length
+// to go back to.
+static int descend(struct compiler *c, int index)
+{
+	int length = c->path_length;
+	int i;
+
+	while (c->path_length + index + 2 > c->path_capacity)
+		c->path = (char *) grow(c->path, &c->path_capacity, 1);
+	for (i = 0; i < index; i++)
+		c->path[c->path_length++] = 'd';
+	c->path[c->path_length++] = 'a';
+	c->path[c->path_length] = '\0';
+	return length;
+}
+
+static void ascend(struct compiler *c, int length)
+{
+	c->path_length = length;
+	c->path[length] = '\0';
+}
+
+static unsigned int address_hash(struct s_expr *expr)
+{
+	uintptr_t address = (uintptr_t) expr;
+
+	return (unsigned int) (address >> 4 ^ address >> 16);
+}
+
+static void grow_constant_table(struct compiler *c)
+{
+	int i;
+
+	free(c->constant_table);
+	c->table_capacity = c->table_capacity == 0
+		? 1024 : c->table_capacity * 2;
+	c->constant_table = (int *) calloc(c->table_capacity, sizeof(int));
+	if (c->constant_table == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	for (i = 0; i < c->constant_count; i++) {
+		unsigned int slot = address_hash(c->constants[i].expr)
+			& (c->table_capacity - 1);
+
+		while (c->constant_table[slot] != 0)
+			slot = (slot + 1) & (c->table_capacity - 1);
+		c->constant_table[slot] = i + 1;
+	}
+}
+
+// Returns the index of `expr`, which is at the current path, as a constant.
+static int constant(struct compiler *c, struct s_expr *expr)
+{
+	unsigned int slot;
+
+	if ((c->constant_count + 1) * 2 > c->table_capacity)
+		grow_constant_table(c);
+	slot = address_hash(expr) & (c->table_capacity - 1);
+	while (c->constant_table[slot] != 0) {
+		int index = c->constant_table[slot] - 1;
+
+		if (c->constants[index].expr == expr)
+			return index;
+		slot = (slot + 1) & (c->table_capacity - 1);
+	}
+	if (c->constant_count == c->constant_capacity)
+		c->constants = (struct constant *) grow(c->constants,
+			&c->constant_capacity, sizeof(struct constant));
+	c->constants[c->constant_count].expr = expr;
+	c->constants[c->constant_count].form = c->form;
+	c->constants[c->constant_count].steps = strdup(c->path);
+	c->constant_table[slot] = ++c->constant_count;
+	return c->constant_count - 1;
+}
+
+static int builtin(struct compiler *c, char *name)
+{
+	int i;
+
+	for (i = 0; i < c->builtin_count; i++) {
+		if (!strcmp(c->builtins[i], name))
+			return i;
+	}
+	if (c->builtin_count == c->builtin_capacity)
+		c->builtins = (char **) grow(c->builtins, &c->builtin_capacity,
+			sizeof(char *));
+	c->builtins[c->builtin_count] = name;
+	return c->builtin_count++;
+}
+
+static int is_symbol_named(struct s_expr *expr, char *name)
+{
+	return expr->type == SYMBOL && !strcmp(expr->value->symbol, name);
+}
+
+static struct s_expr *nth(struct s_expr *list, int index)
+{
+	while (index-- > 0)
+		list = list->value->cell->rest;
+	return list->value->cell->first;
+}
+
+static void use_slot(struct compiler *c, int slot)
+{
+	if (slot + 1 > c->slots)
+		c->slots = slot + 1;
+}
+
+static void return_if_null(struct compiler *c, int slot)
+{
+	emit(c, "if (r[%d] == NULL)", slot);
+	emit(c, "\treturn NULL;");
+}
+
+// Leaves the form at the current path to the interpreter.
+static void compile_fallback(struct compiler *c, struct s_expr *expr,
+	int slot)
+{
+	emit(c, "r[%d] = eval_expression(k[%d]);", slot, constant(c, expr));
+	return_if_null(c, slot);
+}
+
+static void compile_expr(struct compiler *c, struct s_expr *expr, int slot,
+	int tail);
+
+static void compile_operand(struct compiler *c, struct s_expr *form,
+	int index, int slot, int tail)
+{
+	int length = descend(c, index + 1);
+
+	compile_expr(c, nth(form, index + 1), slot, tail);
+	ascend(c, length);
+}
+
+static void compile_arith(struct compiler *c, struct s_expr *form, int slot,
+	char *operation, int guard)
+{
+	int k = constant(c, form);
+	int boolean = strcmp(operation, "+") && strcmp(operation, "-")
+		&& strcmp(operation, "*");
+
+	struct s_expr *right = nth(form, 2);
+	char operand[32];
+
+	compile_operand(c, form, 0, slot, 0);
+	emit(c, "if (r[%d]->type != INTEGER) {", slot);
+	emit(c, "\tr[%d] = eval_resume_builtin(b[%d], k[%d], &r[%d], 1);",
+		slot, guard, k, slot);
+	emit(c, "} else {");
+	c->indent++;
+	if (right->type == INTEGER) {
+		snprintf(operand, sizeof(operand), "%d",
+			right->value->integer);
+	} else {
+		snprintf(operand, sizeof(operand), "r[%d]->value->integer",
+			slot + 1);
+		compile_operand(c, form, 1, slot + 1, 0);
+		emit(c, "if (r[%d]->type != INTEGER) {", slot + 1);
+		emit(c, "\tr[%d] = eval_resume_builtin(b[%d], k[%d], &r[%d],"
+			" 2);", slot, guard, k, slot);
+		emit(c, "\tgoto end_%d;", c->labels);
+		emit(c, "}");
+	}
+	// Wrap around like the builtins, without the undefined behavior.
+	if (boolean)
+		emit(c, "r[%d] = s_expr_from_boolean(r[%d]->value->integer"
+			" %s %s);", slot, slot, operation, operand);
+	else
+		emit(c, "r[%d] = s_expr_from_integer((int) ((unsigned int)"
+			" r[%d]->value->integer %s (unsigned int) %s));", slot,
+			slot, operation, operand);
+	if (right->type != INTEGER)
+		emit(c, "end_%d:", c->labels);
+	if (right->type != INTEGER)
+		emit(c, ";");
+	c->labels++;
+	c->indent--;
+	emit(c, "}");
+	return_if_null(c, slot);
+}
+
+static void compile_field(struct compiler *c, struct s_expr *form, int slot,
+	char *field, int guard)
+{
+	compile_operand(c, form, 0, slot, 0);
+	emit(c, "if (r[%d]->type != CELL)", slot);
+	emit(c, "\tr[%d] = eval_resume_builtin(b[%d], k[%d], &r[%d], 1);",
+		slot, guard, constant(c, form), slot);
+	emit(c, "else");
+	emit(c, "\tr[%d] = r[%d]->value->cell->%s;", slot, slot, field);
+	return_if_null(c, slot);
+}
+
+// Only lists of two or more elements, with else last if at all, are inline.
+static int is_simple_cond(struct s_expr *form)
+{
+	struct s_expr *clauses = form->value->cell->rest;
+
+	for (; !is_empty_list(clauses);
+	clauses = clauses->value->cell->rest) {
+		struct s_expr *clause = clauses->value->cell->first;
+
+		if (!is_list(clause) || list_length(clause) < 2)
+			return 0;
+		if (is_symbol_named(clause->value->cell->first, "else")
+		&& !is_empty_list(clauses->value->cell->rest))
+			return 0;
+	}
+	return 1;
+}
+
+static void compile_cond(struct compiler *c, struct s_expr *form, int slot,
+	int tail)
+{
+	int count = list_length(form) - 1;
+	int end = c->labels++;
+	int i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		struct s_expr *clause = nth(form, i + 1);
+		int bodies = list_length(clause) - 1;
+		int length = descend(c, i + 1);
+		int is_else = is_symbol_named(clause->value->cell->first,
+			"else");
+
+		if (!is_else) {
+			int test = descend(c, 0);
+
+			compile_expr(c, clause->value->cell->first, slot, 0);
+			ascend(c, test);
+			emit(c, "if (!is_empty_list(r[%d])) {", slot);
+			c->indent++;
+		}
+		for (j = 0; j < bodies; j++) {
+			int body = descend(c, j + 1);
+
+			compile_expr(c, nth(clause, j + 1), slot,
+				tail && j + 1 == bodies);
+			ascend(c, body);
+		}
+		emit(c, "goto end_%d;", end);
+		if (!is_else) {
+			c->indent--;
+			emit(c, "}");
+		}
+		ascend(c, length);
+		if (is_else)
+			break;
+	}
+	if (i == count)
+		emit(c, "r[%d] = empty_list;", slot);
+	if (count > 0)
+		emit(c, "end_%d:", end);
+	if (count > 0)
+		emit(c, ";");
+}
+
+static void compile_and_or(struct compiler *c, struct s_expr *form, int slot,
+	int is_and)
+{
+	int count = list_length(form) - 1;
+	int end = c->labels++;
+	int i;
+
+	if (is_and)
+		emit(c, "r[%d] = s_expr_from_boolean(1);", slot);
+	for (i = 0; i < count; i++) {
+		compile_operand(c, form, i, slot, 0);
+		if (is_and) {
+			emit(c, "if (is_empty_list(r[%d])) {", slot);
+			emit(c, "\tr[%d] = s_expr_from_boolean(0);", slot);
+			emit(c, "\tgoto end_%d;", end);
+			emit(c, "}");
+		} else {
+			emit(c, "if (!is_empty_list(r[%d]))", slot);
+			emit(c, "\tgoto end_%d;", end);
+		}
+	}
+	if (!is_and)
+		emit(c, "r[%d] = s_expr_from_boolean(0);", slot);
+	if (count > 0)
+		emit(c, "end_%d:", end);
+	if (count > 0)
+		emit(c, ";");
+}
+
+static void compile_define(struct compiler *c, struct s_expr *form, int slot)
+{
+	int length = descend(c, 1);
+	int symbol = constant(c, nth(form, 1));
+
+	ascend(c, length);
+	compile_operand(c, form, 1, slot, 0);
+	emit(c, "set_env(k[%d]->value->symbol, r[%d]);", symbol, slot);
+	emit(c, "r[%d] = k[%d];", slot, symbol);
+}
+
+// Returns how `form`, whose operator names the builtin `name`, is inline.
+static enum inline_kind inline_kind(struct s_expr *form, char *name,
+	char **operation)
+{
+	int count = list_length(form) - 1;
+	enum inline_kind kind = INLINE_NONE;
+	int i;
+
+	for (i = 0; i < (int) (sizeof(inlines) / sizeof(inlines[0])); i++) {
+		if (!strcmp(inlines[i].name, name)) {
+			kind = inlines[i].kind;
+			*operation = inlines[i].operation;
+		}
+	}
+	switch (kind) {
+	case INLINE_ARITH:
+		return count == 2 ? kind : INLINE_NONE;
+	case INLINE_FIELD:
+	case INLINE_IS_EMPTY:
+	case INLINE_QUOTE:
+		return count == 1 ? kind : INLINE_NONE;
+	case INLINE_COND:
+		return is_simple_cond(form) ? kind : INLINE_NONE;
+	case INLINE_DEFINE:
+		return count == 2 && nth(form, 1)->type == SYMBOL
+			? kind : INLINE_NONE;
+	default:
+		return kind;
+	}
+}
+
+static void compile_inline(struct compiler *c, struct s_expr *form, int slot,
+	int tail, enum inline_kind kind, char *operation, int guard)
+{
+	int length;
+
+	switch (kind) {
+	case INLINE_ARITH:
+		compile_arith(c, form, slot, operation, guard);
+		break;
+	case INLINE_FIELD:
+		compile_field(c, form, slot, operation, guard);
+		break;
+	case INLINE_IS_EMPTY:
+		compile_operand(c, form, 0, slot, 0);
+		emit(c, "r[%d] = s_expr_from_boolean(is_empty_list(r[%d]));",
+			slot, slot);
+		break;
+	case INLINE_QUOTE:
+		length = descend(c, 1);
+		emit(c, "r[%d] = k[%d];", slot, constant(c, nth(form, 1)));
+		ascend(c, length);
+		break;
+	case INLINE_COND:
+		compile_cond(c, form, slot, tail);
+		break;
+	case INLINE_AND:
+	case INLINE_OR:
+		compile_and_or(c, form, slot, kind == INLINE_AND);
+		break;
+	case INLINE_DEFINE:
+		compile_define(c, form, slot);
+		break;
+	default:
+		break;
+	}
+}
+
+// Calls the builtin named `name`, which `symbol` is bound to at startup.
+static void compile_builtin_call(struct compiler *c, struct s_expr *form,
+	int slot, int tail, char *symbol, char *name)
+{
+	char *operation = NULL;
+	enum inline_kind kind = inline_kind(form, name, &operation);
+	int guard = builtin(c, symbol);
+	int k = constant(c, form);
+	char *literal = c_string(symbol);
+
+	emit(c, "if (get_env(%s) == b[%d]) {", literal, guard);
+	c->indent++;
+	if (kind == INLINE_NONE) {
+		emit(c, "r[%d] = eval_call_builtin(b[%d], k[%d]);", slot,
+			guard, k);
+		return_if_null(c, slot);
+	} else {
+		compile_inline(c, form, slot, tail, kind, operation, guard);
+	}
+	c->indent--;
+	emit(c, "} else {");
+	c->indent++;
+	compile_fallback(c, form, slot);
+	c->indent--;
+	emit(c, "}");
+	free(literal);
+}
+
+static void compile_lambda_call(struct compiler *c, struct s_expr *form,
+	int slot, int tail)
+{
+	int count = list_length(form) - 1;
+	char *literal = c_string(form->value->cell->first->value->symbol);
+	int i;
+
+	emit(c, "r[%d] = eval_lookup(%s);", slot, literal);
+	return_if_null(c, slot);
+	emit(c, "if (r[%d]->type == LAMBDA) {", slot);
+	c->indent++;
+	use_slot(c, slot + count);
+	for (i = 0; i < count; i++)
+		compile_operand(c, form, i, slot + 1 + i, 0);
+	if (tail && c->can_loop) {
+		// The body was made a constant when it was found.
+		emit(c, "if (eval_tail_call(k[%d], &r[%d], %d))",
+			constant(c, c->body), slot, count + 1);
+		emit(c, "\tgoto top;");
+		c->loops = 1;
+	}
+	emit(c, "r[%d] = eval_apply_lambda(&r[%d], %d);", slot, slot,
+		count + 1);
+	c->indent--;
+	emit(c, "} else {");
+	c->indent++;
+	emit(c, "r[%d] = eval_expression(k[%d]);", slot, constant(c, form));
+	c->indent--;
+	emit(c, "}");
+	return_if_null(c, slot);
+	free(literal);
+}
+
+static void compile_expr(struct compiler *c, struct s_expr *expr, int slot,
+	int tail)
+{
+	struct s_expr *operator;
+	struct s_expr *value;
+
+	use_slot(c, slot);
+	if (expr->type == SYMBOL) {
+		char *literal = c_string(expr->value->symbol);
+
+		emit(c, "r[%d] = eval_lookup(%s);", slot, literal);
+		return_if_null(c, slot);
+		free(literal);
+		return;
+	}
+	if (expr->type == EMPTY_LIST
+	|| (expr->type == CELL && !is_list(expr))) {
+		compile_fallback(c, expr, slot);
+		return;
+	}
+	if (expr->type != CELL) {
+		emit(c, "r[%d] = k[%d];", slot, constant(c, expr));
+		return;
+	}
+	operator = expr->value->cell->first;
+	if (operator->type != SYMBOL) {
+		compile_fallback(c, expr, slot);
+		return;
+	}
+	// What the operator names when the program starts
+	value = get_env(operator->value->symbol);
+	if (value != NULL && value->type == BUILTIN)
+		compile_builtin_call(c, expr, slot, tail,
+			operator->value->symbol, value->value->builtin->name);
+	else
+		compile_lambda_call(c, expr, slot, tail);
+}
+
+static int defines(struct s_expr *expr)
+{
+	if (expr->type == SYMBOL)
+		return is_symbol_named(expr, "define")
+			|| is_symbol_named(expr, "define-memoized");
+	if (expr->type != CELL)
+		return 0;
+	return defines(expr->value->cell->first)
+		|| defines(expr->value->cell->rest);
+}
+
+// Queues the bodies of the lambdas `expr` may make, at any depth.
+static void find_lambdas(struct compiler *c, struct s_expr *expr)
+{
+	struct s_expr *operator;
+	struct s_expr *rest;
+	char *name = NULL;
+	int lambda;
+	int i;
+
+	if (expr->type != CELL || !is_list(expr))
+		return;
+	operator = expr->value->cell->first;
+	if (is_symbol_named(operator, "quote"))
+		return;
+	lambda = list_length(expr) == 3 && (is_symbol_named(operator, "lambda")
+		|| ((is_symbol_named(operator, "define")
+		|| is_symbol_named(operator, "define-memoized"))
+		&& nth(expr, 1)->type == CELL));
+	if (lambda && is_symbol_named(operator, "lambda"))
+		name = "lambda";
+	else if (lambda && nth(expr, 1)->value->cell->first->type == SYMBOL)
+		name = nth(expr, 1)->value->cell->first->value->symbol;
+	else if (lambda)
+		name = "lambda";
+	for (i = 0, rest = expr; !is_empty_list(rest);
+	i++, rest = rest->value->cell->rest) {
+		struct s_expr *element = rest->value->cell->first;
+		int length = descend(c, i);
+
+		if (lambda && i == 2 && element->type == CELL) {
+			if (c->lambda_count == c->lambda_capacity)
+				c->lambdas = (struct pending_lambda *) grow(
+					c->lambdas, &c->lambda_capacity,
+					sizeof(struct pending_lambda));
+			c->lambdas[c->lambda_count].body = element;
+			c->lambdas[c->lambda_count].constant =
+				constant(c, element);
+			c->lambdas[c->lambda_count].name = name;
+			c->lambda_count++;
+		}
+		find_lambdas(c, element);
+		ascend(c, length);
+	}
+}
+
+// Writes a function that evaluates `expr`, found at the current path.
+static void write_function(struct compiler *c, FILE *out, char *name,
+	struct s_expr *expr, char *comment)
+{
+	char *text;
+	size_t length;
+
+	c->code = open_memstream(&text, &length);
+	if (c->code == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	c->indent = 1;
+	c->slots = 0;
+	c->labels = 0;
+	c->loops = 0;
+	c->can_loop = c->body != NULL && !defines(c->body);
+	compile_expr(c, expr, 0, c->body != NULL);
+	emit(c, "return r[0];");
+	fclose(c->code);
+	fprintf(out, "\n// %s\n", comment);
+	fprintf(out, "static struct s_expr *%s(void)\n{\n", name);
+	fprintf(out, "\tstruct s_expr *r[%d];\n\n", c->slots);
+	if (c->loops)
+		fprintf(out, "top:\n");
+	fwrite(text, 1, length, out);
+	fprintf(out, "}\n");
+	free(text);
+}
+
+int aot_compile(struct interpreter *in, char *name, char *source,
+	size_t length, FILE *out)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	struct compiler c;
+	struct list_builder parsed;
+	struct s_expr *forms;
+	struct s_expr *form;
+	int form_count;
+	char *functions;
+	size_t functions_length;
+	FILE *code;
+	int i;
+
+	memset(&c, 0, sizeof(c));
+	c.path = (char *) grow(NULL, &c.path_capacity, 1);
+	c.path[0] = '\0';
+	list_builder_init(&parsed);
+	if (!interpreter_set_buffer(in, source, length)) {
+		interpreter_enter(prev);
+		return 0;
+	}
+	while ((form = interpreter_read(in)) != NULL)
+		list_builder_push(&parsed, form);
+	if (interpreter_read_failed(in)) {
+		interpreter_enter(prev);
+		return 0;
+	}
+	forms = list_builder_finish(&parsed, empty_list);
+	form_count = list_length(forms);
+
+	// The functions come last, once the constants they use are known.
+	code = open_memstream(&functions, &functions_length);
+	if (code == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	for (i = 0, form = forms; i < form_count;
+	i++, form = form->value->cell->rest) {
+		c.form = i;
+		find_lambdas(&c, form->value->cell->first);
+	}
+	for (i = 0; i < c.lambda_count; i++) {
+		char function[32];
+		char *steps = c.constants[c.lambdas[i].constant].steps;
+
+		snprintf(function, sizeof(function), "lambda_%d", i);
+		c.form = c.constants[c.lambdas[i].constant].form;
+		c.path_length = strlen(steps);
+		strcpy(c.path, steps);
+		c.body = c.lambdas[i].body;
+		write_function(&c, code, function, c.body, c.lambdas[i].name);
+	}
+	c.body = NULL;
+	for (i = 0, form = forms; i < form_count;
+	i++, form = form->value->cell->rest) {
+		char function[32];
+		char comment[32];
+
+		snprintf(function, sizeof(function), "form_%d", i);
+		snprintf(comment, sizeof(comment), "top-level form %d", i);
+		c.form = i;
+		ascend(&c, 0);
+		write_function(&c, code, function, form->value->cell->first,
+			comment);
+	}
+	fclose(code);
+
+	fprintf(out, "/*\n * Compiled from %s by scheme --compile.", name);
+	fprintf(out, " See aot.h for how to build it.\n */\n");
+	fprintf(out, "#include \"aot.h\"\n\n");
+	fprintf(out, "static char source[] =\n\t");
+	write_c_string(out, source, length);
+	fprintf(out, ";\n");
+	fprintf(out, "\nstatic const struct aot_path paths[] = {\n");
+	for (i = 0; i < c.constant_count; i++)
+		fprintf(out, "\t{%d, \"%s\"},\n", c.constants[i].form,
+			c.constants[i].steps);
+	fprintf(out, "\t{0, NULL}\n};\n");
+	fprintf(out, "static struct s_expr *k[%d];\n", c.constant_count + 1);
+	fprintf(out, "\nstatic char *const builtin_names[] = {\n");
+	for (i = 0; i < c.builtin_count; i++) {
+		fputc('\t', out);
+		write_c_string(out, c.builtins[i], strlen(c.builtins[i]));
+		fprintf(out, ",\n");
+	}
+	fprintf(out, "\tNULL\n};\n");
+	fprintf(out, "static struct s_expr *b[%d];\n", c.builtin_count + 1);
+	fwrite(functions, 1, functions_length, out);
+	free(functions);
+	fprintf(out, "\nstatic const struct aot_native natives[] = {\n");
+	for (i = 0; i < c.lambda_count; i++)
+		fprintf(out, "\t{%d, lambda_%d},\n", c.lambdas[i].constant, i);
+	fprintf(out, "\t{0, NULL}\n};\n");
+	fprintf(out, "\nstatic struct s_expr *(*const forms[])(void) = {\n");
+	for (i = 0; i < form_count; i++)
+		fprintf(out, "\tform_%d,\n", i);
+	fprintf(out, "\tNULL\n};\n");
+
+	fprintf(out, "\nint main(void)\n{\n");
+	fprintf(out, "\tstruct aot_program program = {\n\t\t");
+	write_c_string(out, name, strlen(name));
+	fprintf(out, ", source, sizeof(source) - 1,\n");
+	fprintf(out, "\t\tpaths, k, %d,\n", c.constant_count);
+	fprintf(out, "\t\tbuiltin_names, b, %d,\n", c.builtin_count);
+	fprintf(out, "\t\tnatives, %d,\n", c.lambda_count);
+	fprintf(out, "\t\tforms, %d\n\t};\n\n", form_count);
+	fprintf(out, "\treturn aot_main(&program);\n}\n");
+
+	for (i = 0; i < c.constant_count; i++)
+		free(c.constants[i].steps);
+	free(c.constants);
+	free(c.constant_table);
+	free(c.builtins);
+	free(c.lambdas);
+	free(c.path);
+	interpreter_enter(prev);
+	return !ferror(out);
+}
+
+static void fail(struct aot_program *program, struct interpreter *in)
+{
+	char error[128];
+
+	interpreter_error(in, error, 128);
+	fprintf(stderr, "%s: %s\n", program->name, error);
+	exit(1);
+}
+
+int aot_main(struct aot_program *program)
+{
+	struct interpreter *in = interpreter_create();
+	struct s_expr **forms = (struct s_expr **) malloc(
+		(program->form_count + 1) * sizeof(struct s_expr *));
+	struct s_expr *form;
+	int count = 0;
+	int i;
+
+	if (forms == NULL) {
+		printf("Out of memory, cannot start %s.\n", program->name);
+		exit(1);
+	}
+	interpreter_set_engine(in, ENGINE_CLOSURE);
+	interpreter_enter(in);
+	if (!interpreter_set_buffer(in, program->source, program->length)) {
+		fprintf(stderr, "Cannot read %s\n", program->name);
+		return 1;
+	}
+	while (count < program->form_count
+	&& (form = interpreter_read(in)) != NULL)
+		forms[count++] = form;
+	if (count != program->form_count) {
+		fprintf(stderr, "%s: parsed differently than when compiled\n",
+			program->name);
+		return 1;
+	}
+	for (i = 0; i < program->builtin_count; i++)
+		program->builtins[i] = get_env(program->builtin_names[i]);
+	for (i = 0; i < program->constant_count; i++) {
+		struct s_expr *expr = forms[program->paths[i].form];
+		char *step;
+
+		for (step = program->paths[i].steps; *step != '\0'; step++)
+			expr = *step == 'a' ? expr->value->cell->first
+				: expr->value->cell->rest;
+		program->constants[i] = expr;
+	}
+	for (i = 0; i < program->native_count; i++)
+		eval_set_native(
+			program->constants[program->natives[i].body],
+			program->natives[i].code);
+	for (i = 0; i < program->form_count; i++) {
+		if (program->forms[i]() == NULL)
+			fail(program, in);
+	}
+	free(forms);
+	return 0;
+}
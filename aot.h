@@ -0,0 +1,120 @@
+/**
+ * aot.h - Compiles a script to C ahead of time
+ *
+ * aot_compile() turns a script into C source that, built against the rest of
+ * the interpreter (libscheme.a), runs the script like `scheme FILE` does. The
+ * source of the script is embedded in the C file and parsed again when the
+ * program starts, so that the compiled code can refer to the same forms the
+ * interpreter would evaluate.
+ *
+ * Each top-level form, and the body of each lambda in the script, becomes a
+ * C function. Variables are looked up when they are used, so definitions made
+ * as the program runs behave as in the interpreter. Calls to lambdas
+ * evaluate their arguments in C. Calls to the builtins below are made inline
+ * as long as their names are still bound to the builtins the program started
+ * with:
+ *
+ *   + - * < > = <= >=  on two integers
+ *   car cdr            on a pair
+ *   null? empty? not
+ *   quote cond and or define
+ *
+ * and any other builtin is called directly. Everything else, including every
+ * case where the inline code would not do what the builtin does, is left to
+ * the interpreter, so errors are reported with the same messages.
+ *
+ * Uses of macros are left to the interpreter too, which expands each one
+ * the first time it is evaluated.
+ *
+ * A call from the end of a lambda's body to a lambda with the same body runs
+ * the body again in the same C frame and environment frame, so that loops
+ * written as self tail calls run in constant space. Bodies that define
+ * anything are left out, since their frames may hold more than parameters.
+ *
+ * Build a compiled program with:
+ *
+ *   cc -I DIR prog.c DIR/libscheme.a -pthread -o prog
+ *
+ * where DIR is where scheme was built.
+ */
+#ifndef AOT_H
+#define AOT_H
+#include <stdio.h>
+#include "parser.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "interpreter.h"
+
+/**
+ * aot_path - Where to find a form in the script
+ * @form - the index of the top-level form it is part of
+ * @steps - 'a' for car and 'd' for cdr, applied from the left
+ */
+struct aot_path {
+	int form;
+	char *steps;
+};
+
+/**
+ * aot_native - The compiled body of a lambda
+ * @body - the index of the body in the program's constants
+ * @code
+ */
+struct aot_native {
+	int body;
+	struct s_expr *(*code)(void);
+};
+
+/**
+ * aot_program - A compiled script, as laid out by aot_compile()
+ * @name - the path the script was compiled from, used in error messages
+ * @source
+ * @length - the number of bytes in `source`
+ * @paths - where each constant is found in the script
+ * @constants - set from `paths` before any form runs
+ * @constant_count
+ * @builtin_names - the names of the builtins the code is guarded by
+ * @builtins - set to the values the names are bound to at startup
+ * @builtin_count
+ * @natives
+ * @native_count
+ * @forms - the code of each top-level form
+ * @form_count
+ */
+struct aot_program {
+	char *name;
+	char *source;
+	size_t length;
+	const struct aot_path *paths;
+	struct s_expr **constants;
+	int constant_count;
+	char *const *builtin_names;
+	struct s_expr **builtins;
+	int builtin_count;
+	const struct aot_native *natives;
+	int native_count;
+	struct s_expr *(*const *forms)(void);
+	int form_count;
+};
+
+/**
+ * aot_compile() - Writes the C source of a compiled script
+ * @in
+ * @name - the path of the script
+ * @source
+ * @length - the number of bytes in `source`
+ * @out
+ * @returns 1 on success and 0 if the script has a syntax error (see
+ * interpreter_read_failed()) or `out` could not be written
+ */
+int aot_compile(struct interpreter *in, char *name, char *source,
+	size_t length, FILE *out);
+
+/**
+ * aot_main() - Runs a compiled script
+ * @program
+ * @returns the exit status: 0, or 1 after printing the first error
+ */
+int aot_main(struct aot_program *program);
+
+#endif
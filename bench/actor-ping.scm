@@ -0,0 +1,17 @@
+; Round trips to an echo actor: message latency, one message in flight.
+(define (reply message)
+  (send (car message) (car (cdr message))))
+
+(define (echo)
+  (cond (else (reply (receive))
+              (echo))))
+
+(define server (spawn echo))
+
+(define (ping n)
+  (cond ((= n 0) 0)
+        (else (send server (list (self) n))
+              (receive)
+              (ping (- n 1)))))
+
+(ping 2000)
@@ -0,0 +1,19 @@
+; Streams messages to a collector actor as fast as they can be sent: mailbox
+; throughput with many messages in flight.
+(define (collect n total)
+  (cond ((= n 0) total)
+        (else (collect (- n 1) (+ total (car (receive)))))))
+
+(define (collector)
+  (send (receive) (collect 1000 0)))
+
+(define sink (spawn collector))
+(send sink (self))
+
+(define (stream n)
+  (cond ((= n 0) 0)
+        (else (send sink (list n n n n))
+              (stream (- n 1)))))
+
+(stream 1000)
+(receive)
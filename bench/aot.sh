@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# aot.sh - Compares compiled benchmarks with the interpreter, one JSON object
+# per line
+#
+# Usage: bench/aot.sh [RUNS] [BENCHMARK.scm ...]
+#
+# Each benchmark is compiled with `scheme --compile`, built against
+# libscheme.a with AOT_CFLAGS (default -O2), and checked to print what the
+# interpreter prints. Both are then run RUNS times (default 5), and the median
+# wall times are reported. Run from the directory scheme was built in.
+
+SCHEME=${SCHEME:-./scheme}
+RUNS=${1:-5}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/*.scm
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+median_ms() {
+	echo $1 | tr ' ' '\n' | sort -n |
+		awk '{ t[NR] = $1 } END {
+			if (NR % 2) m = t[(NR + 1) / 2];
+			else m = (t[NR / 2] + t[NR / 2 + 1]) / 2;
+			printf "%.3f", m / 1000 }'
+}
+
+# Prints the median wall time of running "$@" RUNS times.
+time_runs() {
+	times=""
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		start=$(date +%s%N)
+		if ! "$@" > /dev/null 2> "$dir/stderr"; then
+			echo "$*: benchmark failed" >&2
+			cat "$dir/stderr" >&2
+			exit 1
+		fi
+		end=$(date +%s%N)
+		times="$times $(( (end - start) / 1000 ))"
+		i=$((i + 1))
+	done
+	median_ms "$times"
+}
+
+for file in "$@"; do
+	name=$(basename "$file" .scm)
+	if ! "$SCHEME" --compile "$file" -o "$dir/$name.c" ||
+		! gcc ${AOT_CFLAGS:--O2} -I . -o "$dir/$name" "$dir/$name.c" \
+			libscheme.a -pthread 2> "$dir/stderr"; then
+		echo "$file: cannot compile" >&2
+		cat "$dir/stderr" >&2
+		exit 1
+	fi
+	"$SCHEME" "$file" > "$dir/expected" 2>&1
+	"$dir/$name" > "$dir/actual" 2>&1
+	if ! cmp -s "$dir/expected" "$dir/actual"; then
+		echo "$file: compiled program prints something else" >&2
+		exit 1
+	fi
+
+	interpreted=$(time_runs "$SCHEME" "$file") || exit 1
+	compiled=$(time_runs "$dir/$name") || exit 1
+
+	printf '{"benchmark": "%s", "runs": %d, ' "$name" "$RUNS"
+	printf '"interpreter_ms": %s, "compiled_ms": %s}\n' \
+		"$interpreted" "$compiled"
+done
@@ -0,0 +1,16 @@
+; Repeated lookups in an association list with equal? comparison.
+(define (make-alist n)
+  (cond ((= n 0) (quote ()))
+        (else (cons (list n (* n n)) (make-alist (- n 1))))))
+
+(define table (make-alist 200))
+
+(define (lookup-all n)
+  (cond ((= n 0) 0)
+        (else (+ (car (cdr (assoc n table))) (lookup-all (- n 1))))))
+
+(define (rounds r)
+  (cond ((= r 0) 0)
+        (else (lookup-all 200) (rounds (- r 1)))))
+
+(rounds 10)
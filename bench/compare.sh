@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# compare.sh - Flags benchmarks that got slower between two result files
+#
+# Usage: bench/compare.sh OLD.json NEW.json [THRESHOLD_PERCENT]
+#
+# Both files hold one JSON object per line, as written by `make bench` or
+# `make micro`. Benchmarks are matched by name and compared on "median_ms" or
+# "ns_per_op", whichever is present. Any benchmark more than THRESHOLD_PERCENT
+# (default 10) slower is marked REGRESSION, and the script then exits with
+# status 1.
+
+if [ $# -lt 2 ]; then
+	echo "Usage: $0 OLD.json NEW.json [THRESHOLD_PERCENT]" >&2
+	exit 2
+fi
+
+awk -v threshold="${3:-10}" '
+function field(line, key,	pattern) {
+	pattern = "\"" key "\": *\"?[^,}\"]*"
+	if (!match(line, pattern))
+		return ""
+	line = substr(line, RSTART, RLENGTH)
+	sub("\"" key "\": *\"?", "", line)
+	return line
+}
+
+function time_of(line,	value) {
+	value = field(line, "median_ms")
+	return value != "" ? value : field(line, "ns_per_op")
+}
+
+# Skip anything that is not a result, such as the command echoed by make.
+!/"benchmark"/ {
+	next
+}
+
+FNR == NR {
+	old[field($0, "benchmark")] = time_of($0)
+	next
+}
+
+{
+	name = field($0, "benchmark")
+	if (!(name in old)) {
+		printf "%-24s %12s %12s      new\n", name, "-", time_of($0)
+		next
+	}
+	before = old[name]
+	after = time_of($0)
+	change = before > 0 ? (after - before) * 100 / before : 0
+	flag = change > threshold ? "  REGRESSION" : ""
+	if (flag != "")
+		regressions++
+	printf "%-24s %12s %12s %+7.1f%%%s\n", name, before, after, change, flag
+}
+
+END {
+	if (regressions > 0) {
+		printf "%d regression(s) above %s%%\n", regressions, threshold
+		exit 1
+	}
+}' "$1" "$2"
@@ -0,0 +1,509 @@
+; Calls made with a large global environment: 500 top-level definitions
+; make every environment lookup and lambda call more expensive.
+
+(define d0 0)
+(define d1 1)
+(define d2 2)
+(define d3 3)
+(define d4 4)
+(define d5 5)
+(define d6 6)
+(define d7 7)
+(define d8 8)
+(define d9 9)
+(define d10 10)
+(define d11 11)
+(define d12 12)
+(define d13 13)
+(define d14 14)
+(define d15 15)
+(define d16 16)
+(define d17 17)
+(define d18 18)
+(define d19 19)
+(define d20 20)
+(define d21 21)
+(define d22 22)
+(define d23 23)
+(define d24 24)
+(define d25 25)
+(define d26 26)
+(define d27 27)
+(define d28 28)
+(define d29 29)
+(define d30 30)
+(define d31 31)
+(define d32 32)
+(define d33 33)
+(define d34 34)
+(define d35 35)
+(define d36 36)
+(define d37 37)
+(define d38 38)
+(define d39 39)
+(define d40 40)
+(define d41 41)
+(define d42 42)
+(define d43 43)
+(define d44 44)
+(define d45 45)
+(define d46 46)
+(define d47 47)
+(define d48 48)
+(define d49 49)
+(define d50 50)
+(define d51 51)
+(define d52 52)
+(define d53 53)
+(define d54 54)
+(define d55 55)
+(define d56 56)
+(define d57 57)
+(define d58 58)
+(define d59 59)
+(define d60 60)
+(define d61 61)
+(define d62 62)
+(define d63 63)
+(define d64 64)
+(define d65 65)
+(define d66 66)
+(define d67 67)
+(define d68 68)
+(define d69 69)
+(define d70 70)
+(define d71 71)
+(define d72 72)
+(define d73 73)
+(define d74 74)
+(define d75 75)
+(define d76 76)
+(define d77 77)
+(define d78 78)
+(define d79 79)
+(define d80 80)
+(define d81 81)
+(define d82 82)
+(define d83 83)
+(define d84 84)
+(define d85 85)
+(define d86 86)
+(define d87 87)
+(define d88 88)
+(define d89 89)
+(define d90 90)
+(define d91 91)
+(define d92 92)
+(define d93 93)
+(define d94 94)
+(define d95 95)
+(define d96 96)
+(define d97 97)
+(define d98 98)
+(define d99 99)
+(define d100 100)
+(define d101 101)
+(define d102 102)
+(define d103 103)
+(define d104 104)
+(define d105 105)
+(define d106 106)
+(define d107 107)
+(define d108 108)
+(define d109 109)
+(define d110 110)
+(define d111 111)
+(define d112 112)
+(define d113 113)
+(define d114 114)
+(define d115 115)
+(define d116 116)
+(define d117 117)
+(define d118 118)
+(define d119 119)
+(define d120 120)
+(define d121 121)
+(define d122 122)
+(define d123 123)
+(define d124 124)
+(define d125 125)
+(define d126 126)
+(define d127 127)
+(define d128 128)
+(define d129 129)
+(define d130 130)
+(define d131 131)
+(define d132 132)
+(define d133 133)
+(define d134 134)
+(define d135 135)
+(define d136 136)
+(define d137 137)
+(define d138 138)
+(define d139 139)
+(define d140 140)
+(define d141 141)
+(define d142 142)
+(define d143 143)
+(define d144 144)
+(define d145 145)
+(define d146 146)
+(define d147 147)
+(define d148 148)
+(define d149 149)
+(define d150 150)
+(define d151 151)
+(define d152 152)
+(define d153 153)
+(define d154 154)
+(define d155 155)
+(define d156 156)
+(define d157 157)
+(define d158 158)
+(define d159 159)
+(define d160 160)
+(define d161 161)
+(define d162 162)
+(define d163 163)
+(define d164 164)
+(define d165 165)
+(define d166 166)
+(define d167 167)
+(define d168 168)
+(define d169 169)
+(define d170 170)
+(define d171 171)
+(define d172 172)
+(define d173 173)
+(define d174 174)
+(define d175 175)
+(define d176 176)
+(define d177 177)
+(define d178 178)
+(define d179 179)
+(define d180 180)
+(define d181 181)
+(define d182 182)
+(define d183 183)
+(define d184 184)
+(define d185 185)
+(define d186 186)
+(define d187 187)
+(define d188 188)
+(define d189 189)
+(define d190 190)
+(define d191 191)
+(define d192 192)
+(define d193 193)
+(define d194 194)
+(define d195 195)
+(define d196 196)
+(define d197 197)
+(define d198 198)
+(define d199 199)
+(define d200 200)
+(define d201 201)
+(define d202 202)
+(define d203 203)
+(define d204 204)
+(define d205 205)
+(define d206 206)
+(define d207 207)
+(define d208 208)
+(define d209 209)
+(define d210 210)
+(define d211 211)
+(define d212 212)
+(define d213 213)
+(define d214 214)
+(define d215 215)
+(define d216 216)
+(define d217 217)
+(define d218 218)
+(define d219 219)
+(define d220 220)
+(define d221 221)
+(define d222 222)
+(define d223 223)
+(define d224 224)
+(define d225 225)
+(define d226 226)
+(define d227 227)
+(define d228 228)
+(define d229 229)
+(define d230 230)
+(define d231 231)
+(define d232 232)
+(define d233 233)
+(define d234 234)
+(define d235 235)
+(define d236 236)
+(define d237 237)
+(define d238 238)
+(define d239 239)
+(define d240 240)
+(define d241 241)
+(define d242 242)
+(define d243 243)
+(define d244 244)
+(define d245 245)
+(define d246 246)
+(define d247 247)
+(define d248 248)
+(define d249 249)
+(define d250 250)
+(define d251 251)
+(define d252 252)
+(define d253 253)
+(define d254 254)
+(define d255 255)
+(define d256 256)
+(define d257 257)
+(define d258 258)
+(define d259 259)
+(define d260 260)
+(define d261 261)
+(define d262 262)
+(define d263 263)
+(define d264 264)
+(define d265 265)
+(define d266 266)
+(define d267 267)
+(define d268 268)
+(define d269 269)
+(define d270 270)
+(define d271 271)
+(define d272 272)
+(define d273 273)
+(define d274 274)
+(define d275 275)
+(define d276 276)
+(define d277 277)
+(define d278 278)
+(define d279 279)
+(define d280 280)
+(define d281 281)
+(define d282 282)
+(define d283 283)
+(define d284 284)
+(define d285 285)
+(define d286 286)
+(define d287 287)
+(define d288 288)
+(define d289 289)
+(define d290 290)
+(define d291 291)
+(define d292 292)
+(define d293 293)
+(define d294 294)
+(define d295 295)
+(define d296 296)
+(define d297 297)
+(define d298 298)
+(define d299 299)
+(define d300 300)
+(define d301 301)
+(define d302 302)
+(define d303 303)
+(define d304 304)
+(define d305 305)
+(define d306 306)
+(define d307 307)
+(define d308 308)
+(define d309 309)
+(define d310 310)
+(define d311 311)
+(define d312 312)
+(define d313 313)
+(define d314 314)
+(define d315 315)
+(define d316 316)
+(define d317 317)
+(define d318 318)
+(define d319 319)
+(define d320 320)
+(define d321 321)
+(define d322 322)
+(define d323 323)
+(define d324 324)
+(define d325 325)
+(define d326 326)
+(define d327 327)
+(define d328 328)
+(define d329 329)
+(define d330 330)
+(define d331 331)
+(define d332 332)
+(define d333 333)
+(define d334 334)
+(define d335 335)
+(define d336 336)
+(define d337 337)
+(define d338 338)
+(define d339 339)
+(define d340 340)
+(define d341 341)
+(define d342 342)
+(define d343 343)
+(define d344 344)
+(define d345 345)
+(define d346 346)
+(define d347 347)
+(define d348 348)
+(define d349 349)
+(define d350 350)
+(define d351 351)
+(define d352 352)
+(define d353 353)
+(define d354 354)
+(define d355 355)
+(define d356 356)
+(define d357 357)
+(define d358 358)
+(define d359 359)
+(define d360 360)
+(define d361 361)
+(define d362 362)
+(define d363 363)
+(define d364 364)
+(define d365 365)
+(define d366 366)
+(define d367 367)
+(define d368 368)
+(define d369 369)
+(define d370 370)
+(define d371 371)
+(define d372 372)
+(define d373 373)
+(define d374 374)
+(define d375 375)
+(define d376 376)
+(define d377 377)
+(define d378 378)
+(define d379 379)
+(define d380 380)
+(define d381 381)
+(define d382 382)
+(define d383 383)
+(define d384 384)
+(define d385 385)
+(define d386 386)
+(define d387 387)
+(define d388 388)
+(define d389 389)
+(define d390 390)
+(define d391 391)
+(define d392 392)
+(define d393 393)
+(define d394 394)
+(define d395 395)
+(define d396 396)
+(define d397 397)
+(define d398 398)
+(define d399 399)
+(define d400 400)
+(define d401 401)
+(define d402 402)
+(define d403 403)
+(define d404 404)
+(define d405 405)
+(define d406 406)
+(define d407 407)
+(define d408 408)
+(define d409 409)
+(define d410 410)
+(define d411 411)
+(define d412 412)
+(define d413 413)
+(define d414 414)
+(define d415 415)
+(define d416 416)
+(define d417 417)
+(define d418 418)
+(define d419 419)
+(define d420 420)
+(define d421 421)
+(define d422 422)
+(define d423 423)
+(define d424 424)
+(define d425 425)
+(define d426 426)
+(define d427 427)
+(define d428 428)
+(define d429 429)
+(define d430 430)
+(define d431 431)
+(define d432 432)
+(define d433 433)
+(define d434 434)
+(define d435 435)
+(define d436 436)
+(define d437 437)
+(define d438 438)
+(define d439 439)
+(define d440 440)
+(define d441 441)
+(define d442 442)
+(define d443 443)
+(define d444 444)
+(define d445 445)
+(define d446 446)
+(define d447 447)
+(define d448 448)
+(define d449 449)
+(define d450 450)
+(define d451 451)
+(define d452 452)
+(define d453 453)
+(define d454 454)
+(define d455 455)
+(define d456 456)
+(define d457 457)
+(define d458 458)
+(define d459 459)
+(define d460 460)
+(define d461 461)
+(define d462 462)
+(define d463 463)
+(define d464 464)
+(define d465 465)
+(define d466 466)
+(define d467 467)
+(define d468 468)
+(define d469 469)
+(define d470 470)
+(define d471 471)
+(define d472 472)
+(define d473 473)
+(define d474 474)
+(define d475 475)
+(define d476 476)
+(define d477 477)
+(define d478 478)
+(define d479 479)
+(define d480 480)
+(define d481 481)
+(define d482 482)
+(define d483 483)
+(define d484 484)
+(define d485 485)
+(define d486 486)
+(define d487 487)
+(define d488 488)
+(define d489 489)
+(define d490 490)
+(define d491 491)
+(define d492 492)
+(define d493 493)
+(define d494 494)
+(define d495 495)
+(define d496 496)
+(define d497 497)
+(define d498 498)
+(define d499 499)
+
+(define (sum-to n)
+  (cond ((= n 0) d0)
+        (else (+ d499 (sum-to (- n 1))))))
+
+(sum-to 1000)
@@ -0,0 +1,23 @@
+; Symbolic differentiation (after the Gabriel benchmark): builds lots of
+; short lists and dispatches on symbols.
+(define (deriv a)
+  (cond ((not (list? a))
+         (cond ((eq? a (quote x)) 1) (else 0)))
+        ((eq? (car a) (quote +))
+         (cons (quote +) (map deriv (cdr a))))
+        ((eq? (car a) (quote -))
+         (cons (quote -) (map deriv (cdr a))))
+        ((eq? (car a) (quote *))
+         (list (quote *) a
+               (cons (quote +)
+                     (map (lambda (a) (list (quote /) (deriv a) a))
+                          (cdr a)))))
+        (else (quote error))))
+
+(define expr (quote (+ (* 3 x x) (* a x x) (* b x) 5)))
+
+(define (repeat n)
+  (cond ((= n 0) 0)
+        (else (deriv expr) (repeat (- n 1)))))
+
+(repeat 300)
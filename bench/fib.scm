@@ -0,0 +1,6 @@
+; Doubly recursive Fibonacci: function call overhead and integer arithmetic.
+(define (fib n)
+  (cond ((< n 2) n)
+        (else (+ (fib (- n 1)) (fib (- n 2))))))
+
+(fib 20)
@@ -0,0 +1,18 @@
+; Constant subexpressions, as generated code is full of: with folding, each
+; is computed once, before the program runs, instead of on every call.
+(define (step n acc)
+  (cond ((= n 0) acc)
+        ((and #t (< n 0)) 0)
+        (#f (quote unreachable))
+        (else (step (- n 1)
+                    (+ acc
+                       (* (+ 1 2) (car (quote (4 5))))
+                       ((lambda (a b) (- a b)) 10 3)
+                       (cond ((null? (quote ())) (quotient 9 3))
+                             (else 100)))))))
+
+(define (repeat k total)
+  (cond ((= k 0) total)
+        (else (repeat (- k 1) (+ total (step 400 0))))))
+
+(repeat 8 0)
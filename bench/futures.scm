@@ -0,0 +1,14 @@
+; Parallel Fibonacci with futures: fine-grained, nested task parallelism.
+(define (fib n)
+  (cond ((< n 2) n)
+        (else (+ (fib (- n 1)) (fib (- n 2))))))
+
+; Computes fib m on this thread while the future computes the other half.
+(define (pfib-join f m)
+  (+ (pfib m) (touch f)))
+
+(define (pfib n)
+  (cond ((< n 13) (fib n))
+        (else (pfib-join (future (lambda () (pfib (- n 1)))) (- n 2)))))
+
+(pfib 20)
@@ -0,0 +1,21 @@
+; A parse -> transform -> aggregate pipeline over generators, with no
+; intermediate lists between the stages.
+(define (records n)
+  (cond ((= n 0) (quote ()))
+        (else (cons (list n "item" (* 3 n)) (records (- n 1))))))
+
+(define (parse record) (car (cdr (cdr record))))
+
+(define (weigh x)
+  (cond ((= (remainder x 2) 0) (* x x))
+        (else x)))
+
+(define (add x total) (+ x total))
+
+(define (evens-up-to i n)
+  (cond ((> i n) 0)
+        (else (yield i) (evens-up-to (+ i 2) n))))
+
+(generator-fold add 0
+  (generator-map weigh (generator-map parse (list->generator (records 1500)))))
+(generator-fold add 0 (make-generator (lambda () (evens-up-to 0 1000))))
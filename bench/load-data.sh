@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# load-data.sh - Compares ways of reading large inputs
+#
+# Usage: bench/load-data.sh [RUNS] [RECORDS]
+#
+# Generates a file of RECORDS records (default 300000), then times a script
+# that reads it with load-data, and one that has the same records quoted in
+# its source. Then times a script of one quoted record per form, read one
+# form at a time and with --parallel-read. Prints one JSON object per line,
+# like run.sh, and the load-data line of --stats, which has the throughput
+# in MB/s.
+
+SCHEME=${SCHEME:-./scheme}
+RUNS=${1:-5}
+RECORDS=${2:-300000}
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+awk -v n="$RECORDS" 'BEGIN {
+	for (i = 0; i < n; i++) {
+		printf "(rec%d %d \"name %d\" #t ", i % 1000, i, i
+		printf "(tag%d %d) ())\n", i % 7, i * 3
+	}
+}' > "$dir/records.dat"
+echo "(define records (load-data \"$dir/records.dat\"))" > "$dir/load.scm"
+{
+	echo "(define records (quote ("
+	cat "$dir/records.dat"
+	echo ")))"
+} > "$dir/read.scm"
+sed 's/.*/(quote &)/' "$dir/records.dat" > "$dir/forms.scm"
+
+# time NAME ARGS... - runs the interpreter RUNS times and prints the result
+time_runs() {
+	name=$1
+	shift
+	times=""
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		start=$(date +%s%N)
+		if ! "$SCHEME" --no-cache "$@" > /dev/null; then
+			echo "$name: benchmark failed" >&2
+			exit 1
+		fi
+		end=$(date +%s%N)
+		times="$times $(( (end - start) / 1000 ))"
+		i=$((i + 1))
+	done
+	median=$(echo $times | tr ' ' '\n' | sort -n |
+		awk '{ t[NR] = $1 } END {
+			if (NR % 2) m = t[(NR + 1) / 2];
+			else m = (t[NR / 2] + t[NR / 2 + 1]) / 2;
+			printf "%.3f", m / 1000 }')
+	printf '{"benchmark": "%s/%d", "runs": %d, "median_ms": %s}\n' \
+		"$name" "$RECORDS" "$RUNS" "$median"
+}
+
+time_runs load-reader "$dir/read.scm"
+time_runs load-data "$dir/load.scm"
+time_runs read-forms "$dir/forms.scm"
+time_runs read-forms-parallel --parallel-read "$dir/forms.scm"
+"$SCHEME" --no-cache --stats "$dir/load.scm" 2>&1 | grep "^data loaded"
@@ -0,0 +1,27 @@
+; Loops written with macros: each use is expanded once, however many times
+; the body it is in runs.
+(define-syntax unless
+  (syntax-rules ()
+    ((_ test body) (cond (test #f) (else body)))))
+
+(define-syntax sum-of
+  (syntax-rules ()
+    ((_ e) e)
+    ((_ e rest ...) (+ e (sum-of rest ...)))))
+
+(define-syntax my-or
+  (syntax-rules ()
+    ((_) #f)
+    ((_ e) e)
+    ((_ e rest ...) ((lambda (t) (cond (t t) (else (my-or rest ...)))) e))))
+
+(define (walk n acc)
+  (cond ((my-or (= n 0) (< n 0)) acc)
+        (else (walk (- n 1) (sum-of acc n 1 -1)))))
+
+(define (repeat n)
+  (unless (= n 0)
+    (cond ((= (walk 100 0) 5050) (repeat (- n 1)))
+          (else (quote wrong)))))
+
+(repeat 60)
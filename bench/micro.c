@@ -0,0 +1,358 @@
+/**
+ * micro.c - Microbenchmarks for the lexer, parser, printer, environment,
+ * allocator and coroutines
+ *
+ * Each benchmark repeats an operation until MIN_TIME_NS has passed and prints
+ * one JSON object per line:
+ *
+ *    {"benchmark": "get_env/256", "ops": 1000000, "ns_per_op": 41.250}
+ *
+ * Benchmarks that depend on a size have it after a slash in their name, so
+ * results stay comparable between runs with bench/compare.sh.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../lexer.h"
+#include "../parser.h"
+#include "../heap.h"
+#include "../environment.h"
+#include "../interpreter.h"
+#include "../coroutine.h"
+#include "../printer.h"
+
+// Each benchmark runs for at least this long
+#define MIN_TIME_NS 200000000L
+
+static const int env_sizes[] = { 16, 256, 4096 };
+static const int nesting_depths[] = { 1, 8, 64 };
+
+static long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void report(char *name, int size, long ops, long elapsed)
+{
+	char full_name[64];
+
+	if (size > 0)
+		snprintf(full_name, sizeof(full_name), "%s/%d", name, size);
+	else
+		snprintf(full_name, sizeof(full_name), "%s", name);
+	printf("{\"benchmark\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.3f}\n",
+		full_name, ops, (double) elapsed / ops);
+}
+
+/*
+ * Points the lexer at an in-memory copy of `text`. The stream is closed by the
+ * next call.
+ */
+static void read_from(char *text, size_t length)
+{
+	static FILE *stream;
+
+	if (stream != NULL)
+		fclose(stream);
+	stream = fmemopen(text, length, "r");
+	if (stream == NULL) {
+		perror("fmemopen");
+		exit(1);
+	}
+	set_token_input(stream);
+}
+
+// Appends `count` copies of an expression nested `depth` lists deep.
+static char *generate_source(int depth, int count, size_t *length)
+{
+	size_t size = (size_t) count * (depth * 8 + 16) + 1;
+	char *text = (char *) malloc(size);
+	size_t used = 0;
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < depth; j++)
+			used += sprintf(text + used, "(f %d ", j);
+		used += sprintf(text + used, "x");
+		for (j = 0; j < depth; j++)
+			text[used++] = ')';
+		text[used++] = '\n';
+	}
+	text[used] = '\0';
+	*length = used;
+	return text;
+}
+
+static void bench_get_token(void)
+{
+	size_t length;
+	char *text = generate_source(8, 20000, &length);
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		read_from(text, length);
+		while (get_token() != NULL)
+			ops++;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report("get_token", 0, ops, elapsed);
+	free(text);
+}
+
+/*
+ * Parsed expressions are never freed, so the input is parsed a bounded number
+ * of times rather than for a fixed time.
+ */
+static void bench_get_expression(int depth)
+{
+	size_t length;
+	int count = 40000 / depth;
+	char *text = generate_source(depth, count, &length);
+	long ops = 0;
+	long start = now_ns();
+	int round;
+
+	for (round = 0; round < 10; round++) {
+		read_from(text, length);
+		while (get_expression() != NULL)
+			ops++;
+	}
+	report("get_expression", depth, ops, now_ns() - start);
+	free(text);
+}
+
+/*
+ * Binds `size` distinct ids in a fresh environment state. The first id bound
+ * is the one a lookup finds last.
+ */
+static char **fill_env(int size)
+{
+	char **ids = (char **) malloc(size * sizeof(char *));
+	int i;
+
+	push_env();
+	for (i = 0; i < size; i++) {
+		ids[i] = (char *) malloc(16);
+		sprintf(ids[i], "id%d", i);
+		set_env(ids[i], empty_list);
+	}
+	return ids;
+}
+
+static void empty_env(char **ids, int size)
+{
+	int i;
+
+	pop_env();
+	for (i = 0; i < size; i++)
+		free(ids[i]);
+	free(ids);
+}
+
+static void bench_get_env(int size)
+{
+	char **ids = fill_env(size);
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		int i;
+
+		for (i = 0; i < 1000; i++) {
+			if (get_env(ids[(i * 7) % size]) == NULL)
+				exit(1);
+		}
+		ops += 1000;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report("get_env", size, ops, elapsed);
+	empty_env(ids, size);
+}
+
+static void bench_set_env(int size)
+{
+	char **ids = fill_env(size);
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		int i;
+
+		push_env();
+		for (i = 0; i < 1000; i++)
+			set_env(ids[i % size], empty_list);
+		pop_env();
+		ops += 1000;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	// This includes the push_env, which copies the whole environment.
+	report("set_env", size, ops, elapsed);
+	empty_env(ids, size);
+}
+
+static void bench_push_pop_env(int size)
+{
+	char **ids = fill_env(size);
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		push_env();
+		pop_env();
+		ops++;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report("push_pop_env", size, ops, elapsed);
+	empty_env(ids, size);
+}
+
+static struct s_expr *integer_list(int length)
+{
+	struct list_builder builder;
+	int i;
+
+	list_builder_init(&builder);
+	for (i = 0; i < length; i++)
+		list_builder_push(&builder, s_expr_from_integer(i));
+	return list_builder_finish(&builder, empty_list);
+}
+
+// A binary tree of lists with integer leaves
+static struct s_expr *tree(int depth)
+{
+	struct list_builder builder;
+
+	if (depth == 0)
+		return s_expr_from_integer(depth);
+	list_builder_init(&builder);
+	list_builder_push(&builder, tree(depth - 1));
+	list_builder_push(&builder, tree(depth - 1));
+	return list_builder_finish(&builder, empty_list);
+}
+
+static void bench_equal(char *name, int size, struct s_expr *a,
+	struct s_expr *b)
+{
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		if (!equal(a, b))
+			exit(1);
+		ops++;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report(name, size, ops, elapsed);
+}
+
+// Writes `expr` to /dev/null, or to a string when `fd` is negative.
+static void bench_print(char *name, int size, struct s_expr *expr, int fd)
+{
+	struct printer printer;
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+	size_t length;
+
+	do {
+		if (fd < 0)
+			printer_to_string(&printer);
+		else
+			printer_to_fd(&printer, fd);
+		printer_write(&printer, expr);
+		if (fd < 0)
+			printer_string(&printer, &length);
+		printer_free(&printer);
+		ops++;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report(name, size, ops, elapsed);
+}
+
+static void bench_heap_alloc(void)
+{
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		int i;
+
+		for (i = 0; i < 1000; i++) {
+			void *ptr = heap_alloc(HEAP_CELL, 16);
+
+			heap_free(HEAP_CELL, ptr, 16);
+		}
+		ops += 1000;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report("heap_alloc_free", 0, ops, elapsed);
+}
+
+static void yield_forever(void *data)
+{
+	while (1)
+		coroutine_yield();
+}
+
+// One op is a resume and the yield that comes back from it.
+static void bench_coroutine_switch(void)
+{
+	struct coroutine *co = coroutine_create(yield_forever, NULL, 65536);
+	long ops = 0;
+	long start = now_ns();
+	long elapsed;
+
+	do {
+		int i;
+
+		for (i = 0; i < 1000; i++)
+			coroutine_resume(co);
+		ops += 1000;
+		elapsed = now_ns() - start;
+	} while (elapsed < MIN_TIME_NS);
+	report("coroutine_switch", 0, ops, elapsed);
+	coroutine_free(co);
+}
+
+int main(int argc, char **argv)
+{
+	int null_fd = open("/dev/null", O_WRONLY);
+	int i;
+
+	// Everything below works on this interpreter.
+	interpreter_enter(interpreter_create());
+
+	bench_get_token();
+	for (i = 0; i < sizeof(nesting_depths) / sizeof(int); i++)
+		bench_get_expression(nesting_depths[i]);
+	for (i = 0; i < sizeof(env_sizes) / sizeof(int); i++) {
+		bench_get_env(env_sizes[i]);
+		bench_set_env(env_sizes[i]);
+		bench_push_pop_env(env_sizes[i]);
+	}
+	bench_equal("equal_list", 10000, integer_list(10000),
+		integer_list(10000));
+	bench_equal("equal_tree", 12, tree(12), tree(12));
+	bench_print("print_list_fd", 10000, integer_list(10000), null_fd);
+	bench_print("print_list_string", 10000, integer_list(10000), -1);
+	bench_print("print_tree_fd", 12, tree(12), null_fd);
+	bench_print("print_tree_string", 12, tree(12), -1);
+	close(null_fd);
+	bench_heap_alloc();
+	bench_coroutine_switch();
+	return 0;
+}
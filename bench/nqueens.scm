@@ -0,0 +1,23 @@
+; Counts the solutions to the N queens problem: list walking and branching.
+
+; Whether a queen in `row` of the next column is safe from the queens in
+; `placed`, the first of which is `dist` columns away.
+(define (ok? row dist placed)
+  (cond ((null? placed) #t)
+        ((= (car placed) (+ row dist)) #f)
+        ((= (car placed) (- row dist)) #f)
+        ((= (car placed) row) #f)
+        (else (ok? row (+ dist 1) (cdr placed)))))
+
+; Counts the solutions with a queen in the next column at `row` or below.
+(define (try-rows row n placed)
+  (cond ((= row 0) 0)
+        (else (+ (cond ((ok? row 1 placed) (queens n (cons row placed)))
+                       (else 0))
+                 (try-rows (- row 1) n placed)))))
+
+(define (queens n placed)
+  (cond ((= (length placed) n) 1)
+        (else (try-rows n n placed))))
+
+(queens 7 (quote ()))
@@ -0,0 +1,10 @@
+; Maps an expensive pure function over a list with pmap: data parallelism.
+(define (fib n)
+  (cond ((< n 2) n)
+        (else (+ (fib (- n 1)) (fib (- n 2))))))
+
+(define (repeat x n)
+  (cond ((= n 0) (quote ()))
+        (else (cons x (repeat x (- n 1))))))
+
+(pmap fib (repeat 15 48))
@@ -0,0 +1,38 @@
+; Writes lines and data to a file through a port, then reads them back a
+; line, a character and a datum at a time. Loops recurse, so they are kept
+; short.
+(define path "/tmp/scheme-bench-ports.txt")
+
+(define (write-lines port n)
+  (cond ((= n 0) n)
+        (else (display "line number " port)
+              (display n port)
+              (newline port)
+              (write (list n "record" (quote field)) port)
+              (newline port)
+              (write-lines port (- n 1)))))
+
+(define (count-lines port n)
+  (cond ((eof-object? (read-line port)) n)
+        (else (count-lines port (+ n 1)))))
+
+(define (skip-chars port n)
+  (cond ((= n 0) (read-line port))
+        (else (read-char port)
+              (skip-chars port (- n 1)))))
+
+(define (count-data port n)
+  (cond ((eof-object? (read port)) n)
+        (else (count-data port (+ n 1)))))
+
+(define (with-port port fn)
+  (cond (else (define result (fn port 0))
+              (close-port port)
+              result)))
+
+(define out (open-output-file path))
+(write-lines out 500)
+(close-port out)
+(with-port (open-input-file path) count-lines)
+(skip-chars (open-input-file path) 1000)
+(with-port (open-input-file path) count-data)
@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# run.sh - Runs the Scheme benchmarks and prints one JSON object per line
+#
+# Usage: bench/run.sh [RUNS] [BENCHMARK.scm ...]
+#
+# Each benchmark is run RUNS times (default 5) with `scheme --stats`. The
+# reported wall time is the median over the runs; allocations and peak RSS
+# come from the last run, since they do not vary between runs.
+#
+# If SCHEME_THREADS is set, it is passed on to the interpreter and appended to
+# each benchmark name, as in "pmap/4". If SCHEME_ENGINE is set, it is passed on
+# as --engine; names stay the same, so that bench/compare.sh can compare the
+# results of two engines.
+
+SCHEME=${SCHEME:-./scheme}
+RUNS=${1:-5}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/*.scm
+
+stats=$(mktemp)
+trap 'rm -f "$stats"' EXIT
+
+for file in "$@"; do
+	name=$(basename "$file" .scm)${SCHEME_THREADS:+/$SCHEME_THREADS}
+	times=""
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		start=$(date +%s%N)
+		if ! "$SCHEME" --stats ${SCHEME_ENGINE:+--engine "$SCHEME_ENGINE"} \
+			"$file" > /dev/null 2> "$stats"; then
+			echo "$file: benchmark failed" >&2
+			cat "$stats" >&2
+			exit 1
+		fi
+		end=$(date +%s%N)
+		times="$times $(( (end - start) / 1000 ))"
+		i=$((i + 1))
+	done
+
+	median=$(echo $times | tr ' ' '\n' | sort -n |
+		awk '{ t[NR] = $1 } END {
+			if (NR % 2) m = t[(NR + 1) / 2];
+			else m = (t[NR / 2] + t[NR / 2 + 1]) / 2;
+			printf "%.3f", m / 1000 }')
+	allocations=$(awk '$1 == "total" { print $2 }' "$stats")
+	rss=$(awk '/^peak rss kb:/ { print $4 }' "$stats")
+
+	printf '{"benchmark": "%s", "runs": %d, "median_ms": %s, ' \
+		"$name" "$RUNS" "$median"
+	printf '"allocations": %s, "peak_rss_kb": %s}\n' "$allocations" "$rss"
+done
@@ -0,0 +1,29 @@
+; Merge sort of a pseudo-random list: allocation-heavy list processing.
+(define (random-list n seed)
+  (cond ((= n 0) (quote ()))
+        (else (cons seed
+                    (random-list (- n 1)
+                                 (modulo (+ (* seed 1103) 12345) 65536))))))
+
+(define (merge a b)
+  (cond ((null? a) b)
+        ((null? b) a)
+        ((< (car a) (car b)) (cons (car a) (merge (cdr a) b)))
+        (else (cons (car b) (merge a (cdr b))))))
+
+; Every other element, starting with the first.
+(define (odds ls)
+  (cond ((null? ls) (quote ()))
+        ((null? (cdr ls)) (list (car ls)))
+        (else (cons (car ls) (odds (cdr (cdr ls)))))))
+
+(define (evens ls)
+  (cond ((null? ls) (quote ()))
+        (else (odds (cdr ls)))))
+
+(define (sort ls)
+  (cond ((null? ls) ls)
+        ((null? (cdr ls)) ls)
+        (else (merge (sort (odds ls)) (sort (evens ls))))))
+
+(sort (random-list 400 1))
@@ -0,0 +1,63 @@
+#!/bin/sh
+#
+# startup.sh - Compares starting from source, from cached forms and from an
+# image
+#
+# Usage: bench/startup.sh [RUNS] [DEFINES]
+#
+# Generates a prelude of DEFINES definitions (default 2000), then times a
+# one-line job run after the prelude's source, after the parsed forms of both
+# were cached by an earlier run, and after an image of the prelude made with
+# --dump-image. Prints one JSON object per line, like run.sh.
+
+SCHEME=${SCHEME:-./scheme}
+RUNS=${1:-5}
+DEFINES=${2:-2000}
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+awk -v n="$DEFINES" 'BEGIN {
+	for (i = 0; i < n; i++) {
+		if (i % 2) {
+			printf "(define (f%d x) (cond ((< x 1) %d) ", i, i
+			printf "(else (+ x (f%d (- x 1))))))\n", i
+		} else {
+			printf "(define v%d (list %d \"item\" ", i, i
+			printf "(quote s%d) (list %d %d)))\n", i, i, i + 1
+		}
+	}
+}' > "$dir/prelude.scm"
+echo "(f1 10)" > "$dir/job.scm"
+cat "$dir/prelude.scm" "$dir/job.scm" > "$dir/all.scm"
+"$SCHEME" --no-cache --dump-image "$dir/prelude.img" "$dir/prelude.scm" || exit 1
+
+# time NAME ARGS... - runs the interpreter RUNS times and prints the result
+time_runs() {
+	name=$1
+	shift
+	times=""
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		start=$(date +%s%N)
+		if ! "$SCHEME" "$@" > /dev/null; then
+			echo "$name: benchmark failed" >&2
+			exit 1
+		fi
+		end=$(date +%s%N)
+		times="$times $(( (end - start) / 1000 ))"
+		i=$((i + 1))
+	done
+	median=$(echo $times | tr ' ' '\n' | sort -n |
+		awk '{ t[NR] = $1 } END {
+			if (NR % 2) m = t[(NR + 1) / 2];
+			else m = (t[NR / 2] + t[NR / 2 + 1]) / 2;
+			printf "%.3f", m / 1000 }')
+	printf '{"benchmark": "%s/%d", "runs": %d, "median_ms": %s}\n' \
+		"$name" "$DEFINES" "$RUNS" "$median"
+}
+
+time_runs startup-source --no-cache "$dir/all.scm"
+"$SCHEME" --cache-dir "$dir/cache" "$dir/all.scm" > /dev/null || exit 1
+time_runs startup-cached --cache-dir "$dir/cache" "$dir/all.scm"
+time_runs startup-image --image "$dir/prelude.img" "$dir/job.scm"
@@ -0,0 +1,17 @@
+; Lazy pipelines over an infinite stream, and forcing a long delay-force
+; chain, which must not grow the C stack.
+(define (integers-from n)
+  (cons-stream n (integers-from (+ n 1))))
+
+(define (multiple-of-3 x) (= (remainder x 3) 0))
+(define (square x) (* x x))
+
+(stream->list
+  (stream-map square (stream-filter multiple-of-3 (integers-from 0)))
+  500)
+
+(define (countdown n)
+  (delay-force (cond ((= n 0) (delay n))
+                     (else (countdown (- n 1))))))
+
+(force (countdown 5000))
@@ -0,0 +1,8 @@
+; Takeuchi function: deep non-tail recursion with three arguments.
+(define (tak x y z)
+  (cond ((< y x) (tak (tak (- x 1) y z)
+                      (tak (- y 1) z x)
+                      (tak (- z 1) x y)))
+        (else z)))
+
+(tak 18 12 6)
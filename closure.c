@@ -0,0 +1,439 @@
+/**
+ * closure.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "environment.h"
+#include "profile.h"
+#include "interpreter.h"
+#include "evaluator.h"
+#include "macro.h"
+#include "fold.h"
+#include "closure.h"
+
+// The size the table of compiled forms starts at, a power of two
+#define COMPILED_INITIAL_CAPACITY 1024
+
+/**
+ * compiled_forms - The nodes of an interpreter's list forms, by address
+ * @forms - the keys of an open-addressed table
+ * @nodes - the node of each form in @forms
+ * @capacity - the size of both, a power of two
+ * @count - the number of forms in the table
+ * @last - the most recently compiled node of any kind
+ */
+struct compiled_forms {
+	struct s_expr **forms;
+	struct node **nodes;
+	size_t capacity;
+	size_t count;
+	struct node *last;
+};
+
+static void *compiler_alloc(size_t size)
+{
+	void *ptr;
+
+	if (size == 0)
+		return NULL;
+	ptr = calloc(1, size);
+	if (ptr == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	return ptr;
+}
+
+static size_t form_slot(struct s_expr *form, size_t capacity)
+{
+	unsigned long long hash = (unsigned long long) (size_t) form;
+
+	hash = (hash >> 4) * 0x9e3779b97f4a7c15ULL;
+	return (size_t) (hash >> 32) & (capacity - 1);
+}
+
+struct node *find_node(struct s_expr *form)
+{
+	struct compiled_forms *compiled = interp->compiled;
+	size_t i;
+
+	if (compiled == NULL)
+		return NULL;
+	i = form_slot(form, compiled->capacity);
+	while (compiled->forms[i] != NULL) {
+		if (compiled->forms[i] == form)
+			return compiled->nodes[i];
+		i = (i + 1) & (compiled->capacity - 1);
+	}
+	return NULL;
+}
+
+static void put_node(struct compiled_forms *compiled, struct s_expr *form,
+	struct node *node)
+{
+	size_t i = form_slot(form, compiled->capacity);
+
+	while (compiled->forms[i] != NULL)
+		i = (i + 1) & (compiled->capacity - 1);
+	compiled->forms[i] = form;
+	compiled->nodes[i] = node;
+	compiled->count++;
+}
+
+static void grow_compiled(struct compiled_forms *compiled)
+{
+	struct s_expr **forms = compiled->forms;
+	struct node **nodes = compiled->nodes;
+	size_t capacity = compiled->capacity;
+	size_t i;
+
+	compiled->capacity = capacity * 2;
+	compiled->forms = (struct s_expr **) compiler_alloc(
+		compiled->capacity * sizeof(struct s_expr *));
+	compiled->nodes = (struct node **) compiler_alloc(
+		compiled->capacity * sizeof(struct node *));
+	compiled->count = 0;
+	for (i = 0; i < capacity; i++) {
+		if (forms[i] != NULL)
+			put_node(compiled, forms[i], nodes[i]);
+	}
+	free(forms);
+	free(nodes);
+}
+
+// Makes a node for `expr`, and enters it in the table if `expr` is a cell.
+static struct node *new_node(struct s_expr *expr,
+	struct s_expr *(*run)(struct node *node))
+{
+	struct compiled_forms *compiled = interp->compiled;
+	struct node *node = (struct node *) compiler_alloc(sizeof(struct node));
+
+	if (compiled == NULL) {
+		compiled = (struct compiled_forms *)
+			compiler_alloc(sizeof(struct compiled_forms));
+		compiled->capacity = COMPILED_INITIAL_CAPACITY;
+		compiled->forms = (struct s_expr **) compiler_alloc(
+			compiled->capacity * sizeof(struct s_expr *));
+		compiled->nodes = (struct node **) compiler_alloc(
+			compiled->capacity * sizeof(struct node *));
+		interp->compiled = compiled;
+	}
+	node->run = run;
+	node->expr = expr;
+	node->next = compiled->last;
+	compiled->last = node;
+	if (expr->type == CELL) {
+		// Keep the table at most half full.
+		if (2 * (compiled->count + 1) > compiled->capacity)
+			grow_compiled(compiled);
+		put_node(compiled, expr, node);
+	}
+	return node;
+}
+
+struct s_expr *run_constant(struct node *node)
+{
+	return node->expr;
+}
+
+struct s_expr *run_variable(struct node *node)
+{
+	return eval_lookup(node->expr->value->symbol);
+}
+
+static struct s_expr *run_empty_call(struct node *node)
+{
+	// Like every run function, it gets its node, which it doesn't need.
+	(void) node;
+	set_error_message("syntax error (missing procedure expression)");
+	return NULL;
+}
+
+// Runs a special form, recording it in the profile as call_builtin() would.
+static struct s_expr *run_special(struct node *node,
+	struct builtin_function *builtin)
+{
+	if (!interp->profiling)
+		return node->special(node);
+
+	profile_enter(builtin->name, 1);
+	struct s_expr *ret = node->special(node);
+
+	profile_exit();
+	return ret;
+}
+
+struct s_expr *run_call(struct node *node)
+{
+	struct s_expr *fn = node->operator->run(node->operator);
+	struct fn_arguments *first_arg = NULL;
+	struct fn_arguments *last_arg = NULL;
+	struct s_expr *ret;
+	int i;
+
+	if (fn == NULL)
+		return NULL;
+	if (fn->type == MACRO)
+		return eval_macro_use(node->expr, fn->value->macro);
+	if (!is_function(fn)) {
+		set_error_message("type error (expected function)");
+		return NULL;
+	}
+	if (fn->type == BUILTIN) {
+		if (fn->value->builtin->function == node->builtin)
+			return run_special(node, fn->value->builtin);
+		// Builtins evaluate their own arguments, which they never
+		// modify, so the list is made once.
+		return call_builtin(fn->value->builtin, node->arguments);
+	}
+	for (i = 0; i < node->operand_count; i++) {
+		struct node *operand = node->operands[i];
+		struct s_expr *value = operand->run(operand);
+
+		if (value == NULL) {
+			free_arguments(first_arg);
+			return NULL;
+		}
+		push_argument(&first_arg, &last_arg, value);
+	}
+	ret = eval_apply(fn, first_arg);
+	free_arguments(first_arg);
+	return ret;
+}
+
+struct s_expr *run_quote(struct node *node)
+{
+	return node->operands[0]->expr;
+}
+
+static struct s_expr *run_define(struct node *node)
+{
+	struct node *operand = node->operands[1];
+	struct s_expr *value = operand->run(operand);
+
+	if (value == NULL)
+		return NULL;
+	note_binding(node->operands[0]->expr);
+	set_env(node->operands[0]->expr->value->symbol, value);
+	return node->operands[0]->expr;
+}
+
+struct s_expr *run_and(struct node *node)
+{
+	struct s_expr *val = s_expr_from_boolean(1);
+	int i;
+
+	for (i = 0; i < node->operand_count; i++) {
+		val = node->operands[i]->run(node->operands[i]);
+		if (val == NULL)
+			return NULL;
+		if (is_empty_list(val))
+			return s_expr_from_boolean(0);
+	}
+	return val;
+}
+
+struct s_expr *run_or(struct node *node)
+{
+	int i;
+
+	for (i = 0; i < node->operand_count; i++) {
+		struct s_expr *val = node->operands[i]->run(node->operands[i]);
+
+		if (val == NULL || !is_empty_list(val))
+			return val;
+	}
+	return s_expr_from_boolean(0);
+}
+
+// Reports errors in the same order as cond().
+struct s_expr *run_cond(struct node *node)
+{
+	int i;
+	int j;
+
+	for (i = 0; i < node->clause_count; i++) {
+		struct clause *clause = &node->clauses[i];
+		struct s_expr *ret = NULL;
+
+		if (clause->error != NULL) {
+			set_error_message(clause->error);
+			return NULL;
+		}
+		if (!clause->else_clause) {
+			struct s_expr *test = clause->test->run(clause->test);
+
+			if (test == NULL)
+				return NULL;
+			// Pass as long as `test` is not #f or '().
+			if (is_empty_list(test))
+				continue;
+		} else if (i + 1 < node->clause_count) {
+			set_error_message(
+				"cond - syntax error (else must be the last clause)");
+			return NULL;
+		}
+		for (j = 0; j < clause->body_count; j++) {
+			ret = clause->bodies[j]->run(clause->bodies[j]);
+			if (ret == NULL)
+				return NULL;
+		}
+		return ret;
+	}
+	return empty_list;
+}
+
+static void compile_cond(struct node *node)
+{
+	struct clause *clauses = (struct clause *) compiler_alloc(
+		node->operand_count * sizeof(struct clause));
+	int i;
+	int j;
+
+	for (i = 0; i < node->operand_count; i++) {
+		struct s_expr *form = node->operands[i]->expr;
+		struct s_expr *bodies;
+
+		if (!is_list(form)) {
+			clauses[i].error = "cond - type error (expected list)";
+			continue;
+		}
+		if (list_length(form) < 2) {
+			clauses[i].error =
+				"cond - value error (expected at least two elements in clause)";
+			continue;
+		}
+		struct s_expr *test = form->value->cell->first;
+
+		clauses[i].else_clause = test->type == SYMBOL
+			&& !strcmp(test->value->symbol, "else");
+		if (!clauses[i].else_clause)
+			clauses[i].test = compile_form(test);
+		bodies = form->value->cell->rest;
+		clauses[i].body_count = list_length(bodies);
+		clauses[i].bodies = (struct node **) compiler_alloc(
+			clauses[i].body_count * sizeof(struct node *));
+		for (j = 0; j < clauses[i].body_count; j++) {
+			clauses[i].bodies[j] = compile_form(bodies->value->cell->first);
+			bodies = bodies->value->cell->rest;
+		}
+	}
+	node->clauses = clauses;
+	node->clause_count = node->operand_count;
+	node->builtin = cond;
+	node->special = run_cond;
+}
+
+/*
+ * Gives a call whose operator is the name of a special form the node for it,
+ * when the form is well formed; otherwise the builtin reports the error.
+ */
+static void compile_special(struct node *node)
+{
+	char *name;
+
+	if (node->operator->expr->type != SYMBOL)
+		return;
+	name = node->operator->expr->value->symbol;
+	if (!strcmp(name, "cond")) {
+		compile_cond(node);
+	} else if (!strcmp(name, "and")) {
+		node->builtin = and;
+		node->special = run_and;
+	} else if (!strcmp(name, "or")) {
+		node->builtin = or;
+		node->special = run_or;
+	} else if (!strcmp(name, "quote") && node->operand_count == 1) {
+		node->builtin = quote;
+		node->special = run_quote;
+	} else if (!strcmp(name, "define") && node->operand_count == 2
+	&& node->operands[0]->expr->type == SYMBOL) {
+		node->builtin = define_;
+		node->special = run_define;
+	}
+}
+
+static struct node *compile_call(struct s_expr *expr)
+{
+	struct node *node = new_node(expr, run_call);
+	struct s_expr *operand = expr->value->cell->rest;
+	struct fn_arguments *last_arg = NULL;
+	int i;
+
+	node->operator = compile_form(expr->value->cell->first);
+	node->operand_count = list_length(operand);
+	node->operands = (struct node **) compiler_alloc(
+		node->operand_count * sizeof(struct node *));
+	for (i = 0; i < node->operand_count; i++) {
+		struct fn_arguments *arg = (struct fn_arguments *)
+			compiler_alloc(sizeof(struct fn_arguments));
+
+		arg->value = operand->value->cell->first;
+		if (last_arg == NULL)
+			node->arguments = arg;
+		else
+			last_arg->next = arg;
+		last_arg = arg;
+		node->operands[i] = compile_form(arg->value);
+		operand = operand->value->cell->rest;
+	}
+	compile_special(node);
+	return node;
+}
+
+/*
+ * Analyses `expr` into a node that evaluates it as eval_expression() does.
+ * Nothing is checked until the node runs, so that errors are reported when
+ * the tree walker would report them.
+ */
+struct node *compile_form(struct s_expr *expr)
+{
+	struct node *node;
+
+	if (expr->type == SYMBOL)
+		return new_node(expr, run_variable);
+	if (expr->type == EMPTY_LIST)
+		return new_node(expr, run_empty_call);
+	if (expr->type != CELL)
+		return new_node(expr, run_constant);
+	node = find_node(expr);
+	if (node != NULL)
+		return node;
+	if (!is_list(expr))
+		return new_node(expr, run_constant);
+	return compile_call(expr);
+}
+
+void free_compiled(void)
+{
+	struct compiled_forms *compiled = interp->compiled;
+	struct node *node;
+	int i;
+
+	if (compiled == NULL)
+		return;
+	node = compiled->last;
+	while (node != NULL) {
+		struct node *next = node->next;
+		struct fn_arguments *arg = node->arguments;
+
+		while (arg != NULL) {
+			struct fn_arguments *next_arg = arg->next;
+
+			free(arg);
+			arg = next_arg;
+		}
+		for (i = 0; i < node->clause_count; i++)
+			free(node->clauses[i].bodies);
+		free(node->clauses);
+		free(node->operands);
+		free(node);
+		node = next;
+	}
+	free(compiled->forms);
+	free(compiled->nodes);
+	free(compiled);
+	interp->compiled = NULL;
+}
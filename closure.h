@@ -0,0 +1,110 @@
+/**
+ * closure.h - The closure engine
+ *
+ * With the closure engine (see interpreter.h), each list form is analysed once
+ * into a tree of nodes, and evaluating the form is a call to its node's `run`.
+ * Calls keep their operands both as nodes, which the arguments of lambdas are
+ * evaluated with, and as the argument list builtins get, since builtins
+ * evaluate their own arguments. When they do, eval_expression() finds the
+ * operand's node in the interpreter's table of compiled forms, which is keyed
+ * by the address of the form. Forms are never modified, so a node is valid for
+ * as long as its form.
+ *
+ * Scope is dynamic, so variables are still looked up by name when they are
+ * evaluated. cond, and, or, quote and define get nodes of their own, which are
+ * only used while the operator is bound to that builtin; otherwise the form is
+ * run as an ordinary call, as eval_list() would.
+ */
+#ifndef CLOSURE_H
+#define CLOSURE_H
+#include "parser.h"
+
+struct node;
+
+/**
+ * clause - A clause of a cond node
+ * @error - the message if the clause is malformed, reported when reached
+ * @else_clause - whether the test is `else`
+ * @test
+ * @bodies - the expressions evaluated when the test passes
+ * @body_count
+ */
+struct clause {
+	char *error;
+	int else_clause;
+	struct node *test;
+	struct node **bodies;
+	int body_count;
+};
+
+/**
+ * node - A form, analysed for the closure engine
+ * @run - evaluates the form
+ * @expr - the form
+ * @operator - for a call, the node of the operator
+ * @operands - for a call, the nodes of the operands
+ * @operand_count
+ * @arguments - for a call, the operands as builtins get them
+ * @builtin - for a special form, the builtin it stands for
+ * @special - for a special form, what runs it while the operator is @builtin
+ * @clauses - for cond
+ * @clause_count
+ * @calls - for the body of a lambda, the number of calls until it is hot
+ * @jit_code - for the body of a lambda, its machine code once it is hot
+ * @guard - for a call compiled to machine code, the operator it expects
+ * @next - the node compiled before this one, for freeing
+ */
+struct node {
+	struct s_expr *(*run)(struct node *node);
+	struct s_expr *expr;
+	struct node *operator;
+	struct node **operands;
+	int operand_count;
+	struct fn_arguments *arguments;
+	struct s_expr *(*builtin)(struct fn_arguments *args);
+	struct s_expr *(*special)(struct node *node);
+	struct clause *clauses;
+	int clause_count;
+	int calls;
+	struct s_expr *(*jit_code)(void);
+	struct s_expr *guard;
+	struct node *next;
+};
+
+/**
+ * find_node() - Returns the node `form` was compiled to, or NULL
+ * @form
+ */
+struct node *find_node(struct s_expr *form);
+
+/**
+ * compile_form() - Analyses `expr` into a node that evaluates it as
+ * eval_expression() does
+ * @expr
+ *
+ * Nothing is checked until the node runs, so that errors are reported when
+ * the tree walker would report them.
+ */
+struct node *compile_form(struct s_expr *expr);
+
+/**
+ * free_compiled() - Frees what the closure engine compiled
+ *
+ * The forms it was compiled from are left alone. See interpreter.h for the
+ * engines.
+ */
+void free_compiled(void);
+
+/*
+ * The run functions of nodes, which the JIT (see lower.h) tells nodes apart
+ * by. Each evaluates its node.
+ */
+struct s_expr *run_constant(struct node *node);
+struct s_expr *run_variable(struct node *node);
+struct s_expr *run_call(struct node *node);
+struct s_expr *run_quote(struct node *node);
+struct s_expr *run_and(struct node *node);
+struct s_expr *run_or(struct node *node);
+struct s_expr *run_cond(struct node *node);
+
+#endif
@@ -0,0 +1,212 @@
+/**
+ * coroutine.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "coroutine.h"
+
+/*
+ * Implementation notes:
+ *
+ * On x86-64, a suspended coroutine is just a stack pointer. switch_stack()
+ * pushes the callee-saved registers, stores the stack pointer, loads the other
+ * one and pops that side's registers; everything else is saved by the C
+ * compiler around the call, as for any function call. A new stack is laid
+ * out as if switch_stack() had been called on it from start_trampoline, with
+ * the coroutine in rbx.
+ *
+ * Elsewhere, the same is done with swapcontext().
+ */
+
+#if defined(__x86_64__)
+#define FAST_SWITCH
+#else
+#include <ucontext.h>
+#endif
+
+struct coroutine {
+	void (*fn)(void *data);
+	void *data;
+	// the mapping, guard page included
+	char *stack;
+	size_t mapped_size;
+#ifdef FAST_SWITCH
+	void *sp;
+	void *resumer_sp;
+#else
+	ucontext_t context;
+	ucontext_t resumer_context;
+#endif
+	// the coroutine that resumed this one, if any
+	struct coroutine *resumer;
+	int done;
+};
+
+static __thread struct coroutine *running;
+
+static void coroutine_main(struct coroutine *co);
+
+#ifdef FAST_SWITCH
+void switch_stack(void **save_sp, void *load_sp);
+void start_trampoline(void);
+
+__asm__(
+	".text\n"
+	".globl switch_stack\n"
+	".type switch_stack, @function\n"
+	"switch_stack:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size switch_stack, .-switch_stack\n"
+	".globl start_trampoline\n"
+	".type start_trampoline, @function\n"
+	"start_trampoline:\n"
+	"	movq %rbx, %rdi\n"
+	"	call coroutine_entry\n"
+	"	ud2\n"
+	".size start_trampoline, .-start_trampoline\n"
+);
+
+// Called from start_trampoline, so it can't be static.
+void coroutine_entry(struct coroutine *co);
+
+void coroutine_entry(struct coroutine *co)
+{
+	coroutine_main(co);
+}
+
+static void prepare_stack(struct coroutine *co)
+{
+	// The trampoline is entered by a ret, and must then find the stack
+	// 16-byte aligned, as a call instruction would have left it.
+	void **top = (void **) (co->stack + co->mapped_size - 16);
+
+	*--top = (void *) start_trampoline;
+	*--top = NULL;			// rbp
+	*--top = (void *) co;		// rbx
+	*--top = NULL;			// r12
+	*--top = NULL;			// r13
+	*--top = NULL;			// r14
+	*--top = NULL;			// r15
+	co->sp = top;
+}
+
+static void switch_in(struct coroutine *co)
+{
+	switch_stack(&co->resumer_sp, co->sp);
+}
+
+static void switch_out(struct coroutine *co)
+{
+	switch_stack(&co->sp, co->resumer_sp);
+}
+#else
+static void context_entry(unsigned int high, unsigned int low)
+{
+	uintptr_t address = ((uintptr_t) high << 16 << 16) | low;
+
+	coroutine_main((struct coroutine *) address);
+}
+
+static void prepare_stack(struct coroutine *co)
+{
+	uintptr_t address = (uintptr_t) co;
+	long page = sysconf(_SC_PAGESIZE);
+
+	getcontext(&co->context);
+	co->context.uc_stack.ss_sp = co->stack + page;
+	co->context.uc_stack.ss_size = co->mapped_size - page;
+	co->context.uc_link = NULL;
+	// makecontext() only passes ints.
+	makecontext(&co->context, (void (*)(void)) context_entry, 2,
+		(unsigned int) (address >> 16 >> 16),
+		(unsigned int) address);
+}
+
+static void switch_in(struct coroutine *co)
+{
+	swapcontext(&co->resumer_context, &co->context);
+}
+
+static void switch_out(struct coroutine *co)
+{
+	swapcontext(&co->context, &co->resumer_context);
+}
+#endif
+
+static void coroutine_main(struct coroutine *co)
+{
+	co->fn(co->data);
+	co->done = 1;
+	switch_out(co);
+	// A finished coroutine is never resumed.
+	abort();
+}
+
+struct coroutine *coroutine_create(void (*fn)(void *data), void *data,
+	size_t stack_size)
+{
+	struct coroutine *co = (struct coroutine *)
+		calloc(1, sizeof(struct coroutine));
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (co == NULL) {
+		printf("Out of memory, cannot create a coroutine.\n");
+		exit(1);
+	}
+	co->fn = fn;
+	co->data = data;
+	co->mapped_size = (stack_size + page - 1) / page * page + page;
+	co->stack = (char *) mmap(NULL, co->mapped_size,
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+	if (co->stack == MAP_FAILED) {
+		printf("Out of memory, cannot create a coroutine.\n");
+		exit(1);
+	}
+	// Stacks grow down, so the guard page is the lowest one.
+	mprotect(co->stack, page, PROT_NONE);
+	prepare_stack(co);
+	return co;
+}
+
+int coroutine_resume(struct coroutine *co)
+{
+	co->resumer = running;
+	running = co;
+	switch_in(co);
+	running = co->resumer;
+	return co->done;
+}
+
+void coroutine_yield(void)
+{
+	switch_out(running);
+}
+
+struct coroutine *coroutine_running(void)
+{
+	return running;
+}
+
+void coroutine_free(struct coroutine *co)
+{
+	munmap(co->stack, co->mapped_size);
+	free(co);
+}
@@ -0,0 +1,61 @@
+/**
+ * coroutine.h - Functions that can suspend themselves and be resumed
+ *
+ * A coroutine runs a C function on a control stack of its own, so that it can
+ * stop anywhere, however deep in the evaluator it is, and later continue from
+ * there. Coroutines are cooperative: one runs only while another resumes it,
+ * on the same thread, until it yields or returns.
+ *
+ * Switching saves and restores just the callee-saved registers on x86-64, so
+ * a resume or yield costs a few nanoseconds. Other machines use ucontext,
+ * which also saves the signal mask with a system call.
+ *
+ * Stacks are mapped lazily, so a coroutine only uses as much memory as the
+ * deepest point it has reached. A guard page below the stack turns an
+ * overflow into a crash rather than silent corruption.
+ */
+#ifndef COROUTINE
+#define COROUTINE
+#include <stdlib.h>
+
+struct coroutine;
+
+/**
+ * coroutine_create() - Creates a coroutine that will call fn(data)
+ * @fn - the function, which starts on the first coroutine_resume()
+ * @data
+ * @stack_size - the largest stack the coroutine can use, in bytes
+ */
+struct coroutine *coroutine_create(void (*fn)(void *data), void *data,
+	size_t stack_size);
+
+/**
+ * coroutine_resume() - Runs a coroutine until it yields or returns
+ * @co - a coroutine that is not running and not done
+ * @returns 1 if it has returned, and 0 if it has yielded
+ */
+int coroutine_resume(struct coroutine *co);
+
+/**
+ * coroutine_yield() - Suspends the running coroutine
+ *
+ * Control goes back to the coroutine_resume() that started it, and this
+ * returns when the coroutine is resumed again. It must only be called from
+ * inside a coroutine.
+ */
+void coroutine_yield(void);
+
+/**
+ * coroutine_running() - Returns the coroutine running on this thread, or NULL
+ */
+struct coroutine *coroutine_running(void);
+
+/**
+ * coroutine_free() - Frees a coroutine and its stack
+ * @co - a coroutine that is not running
+ *
+ * Whatever a suspended coroutine was in the middle of is abandoned.
+ */
+void coroutine_free(struct coroutine *co);
+
+#endif
@@ -0,0 +1,710 @@
+/**
+ * data.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "parser.h"
+#include "interpreter.h"
+#include "data.h"
+
+/*
+ * Implementation notes:
+ *
+ * The parser is iterative, so that deeply nested data can't overflow the C
+ * stack. Finished data are pushed on a stack of values; a frame marks where
+ * the items of each open list start. When a list is closed, its cells are
+ * allocated in one piece and its items popped into them.
+ *
+ * Chunks are mapped with MAP_NORESERVE, so the part of a chunk that is never
+ * used costs address space but no memory.
+ */
+
+// The size of the mappings objects are allocated from
+#define CHUNK_SIZE (64 * 1024 * 1024)
+// Integers from 0 to SHARED_INTEGERS - 1 are shared.
+#define SHARED_INTEGERS 1024
+#define INITIAL_SYMBOLS 1024
+#define INITIAL_VALUES 1024
+#define INITIAL_FRAMES 64
+
+struct chunk {
+	char *base;
+	size_t size;
+};
+
+struct data_region {
+	struct chunk *chunks;
+	size_t chunk_count;
+	size_t chunk_capacity;
+	// the list of data or forms read
+	struct s_expr *root;
+	// why reading stopped early, or NULL
+	char *error;
+	// the bytes allocated for objects
+	long long bytes;
+	int unloaded;
+	struct data_region *next;
+};
+
+// An s-expression and its value, allocated together
+struct atom {
+	struct s_expr expr;
+	union s_expr_value value;
+};
+
+struct pair {
+	struct s_expr expr;
+	union s_expr_value value;
+	struct cons_cell cell;
+};
+
+// A string; its characters follow it.
+struct text {
+	struct s_expr expr;
+	union s_expr_value value;
+	struct string string;
+};
+
+struct symbol_slot {
+	uint64_t hash;
+	int length;
+	// NULL if the slot is empty
+	struct s_expr *symbol;
+};
+
+struct frame {
+	// the index in values of the list's first item
+	size_t base;
+};
+
+struct loader {
+	struct data_region *region;
+	// the unread part of the file
+	char *p;
+	char *end;
+	// where the next object goes in the current chunk
+	char *free;
+	char *limit;
+	long long used;
+	struct s_expr **values;
+	size_t value_count;
+	size_t value_capacity;
+	struct frame *frames;
+	size_t depth;
+	size_t frame_capacity;
+	struct symbol_slot *symbols;
+	size_t symbol_count;
+	size_t symbol_capacity;
+	struct s_expr *integers[SHARED_INTEGERS];
+	struct s_expr *booleans[2];
+	// whether a quote at the top level is kept
+	int program;
+	char *error;
+};
+
+static int fail(char *message)
+{
+	free(interp->last_error_message);
+	interp->last_error_message = strdup(message);
+	return 0;
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *grow(void *array, size_t *capacity, size_t size)
+{
+	*capacity *= 2;
+	array = realloc(array, *capacity * size);
+	if (array == NULL) {
+		printf("Out of memory, cannot load data.\n");
+		exit(1);
+	}
+	return array;
+}
+
+static void new_chunk(struct loader *ld, size_t size)
+{
+	struct data_region *region = ld->region;
+	struct chunk *chunk;
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (size < CHUNK_SIZE)
+		size = CHUNK_SIZE;
+	size = (size + page - 1) / page * page;
+	if (region->chunk_count == region->chunk_capacity) {
+		region->chunks = (struct chunk *) grow(region->chunks,
+			&region->chunk_capacity,
+			sizeof(struct chunk));
+	}
+	chunk = &region->chunks[region->chunk_count];
+	chunk->base = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (chunk->base == MAP_FAILED) {
+		printf("Out of memory, cannot load data.\n");
+		exit(1);
+	}
+	chunk->size = size;
+	region->chunk_count++;
+	ld->free = chunk->base;
+	ld->limit = chunk->base + size;
+}
+
+static size_t align(size_t size)
+{
+	return (size + 7) & ~(size_t) 7;
+}
+
+static void *allocate(struct loader *ld, size_t size)
+{
+	void *object;
+
+	size = align(size);
+	if (size > (size_t) (ld->limit - ld->free))
+		new_chunk(ld, size);
+	object = ld->free;
+	ld->free += size;
+	ld->used += size;
+	return object;
+}
+
+// Gives back the end of the last allocation, which was `unused` bytes too big.
+static void shrink_last(struct loader *ld, size_t unused)
+{
+	ld->free -= unused;
+	ld->used -= unused;
+}
+
+static struct s_expr *new_atom(struct loader *ld, enum s_expr_type type)
+{
+	struct atom *atom = (struct atom *) allocate(ld, sizeof(struct atom));
+
+	atom->expr.value = &atom->value;
+	atom->expr.type = type;
+	return &atom->expr;
+}
+
+// Allocates the cells of a list of `count` items in one piece.
+static struct s_expr *new_list(struct loader *ld, struct s_expr **items,
+	size_t count)
+{
+	struct pair *pairs;
+	size_t i;
+
+	if (count == 0)
+		return empty_list;
+	pairs = (struct pair *) allocate(ld, count * sizeof(struct pair));
+	for (i = 0; i < count; i++) {
+		pairs[i].expr.value = &pairs[i].value;
+		pairs[i].expr.type = CELL;
+		pairs[i].value.cell = &pairs[i].cell;
+		pairs[i].cell.first = items[i];
+		pairs[i].cell.rest = i + 1 < count ? &pairs[i + 1].expr
+			: empty_list;
+	}
+	return &pairs[0].expr;
+}
+
+static uint64_t hash_chars(char *chars, int length)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	int i;
+
+	for (i = 0; i < length; i++) {
+		hash ^= (unsigned char) chars[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static struct symbol_slot *find_slot(struct symbol_slot *slots,
+	size_t capacity, uint64_t hash, char *chars, int length)
+{
+	size_t i = hash & (capacity - 1);
+
+	while (slots[i].symbol != NULL && (slots[i].hash != hash
+	|| slots[i].length != length
+	|| memcmp(slots[i].symbol->value->symbol, chars, length))) {
+		i = (i + 1) & (capacity - 1);
+	}
+	return &slots[i];
+}
+
+static void grow_symbols(struct loader *ld)
+{
+	size_t capacity = ld->symbol_capacity * 2;
+	struct symbol_slot *slots = (struct symbol_slot *)
+		calloc(capacity, sizeof(struct symbol_slot));
+	size_t i;
+
+	if (slots == NULL) {
+		printf("Out of memory, cannot load data.\n");
+		exit(1);
+	}
+	for (i = 0; i < ld->symbol_capacity; i++) {
+		struct symbol_slot *old = &ld->symbols[i];
+
+		if (old->symbol != NULL) {
+			*find_slot(slots, capacity, old->hash,
+				old->symbol->value->symbol, old->length) = *old;
+		}
+	}
+	free(ld->symbols);
+	ld->symbols = slots;
+	ld->symbol_capacity = capacity;
+}
+
+static struct s_expr *intern(struct loader *ld, char *chars, int length)
+{
+	uint64_t hash = hash_chars(chars, length);
+	struct symbol_slot *slot = find_slot(ld->symbols, ld->symbol_capacity,
+		hash, chars, length);
+	struct s_expr *symbol;
+
+	if (slot->symbol != NULL)
+		return slot->symbol;
+	symbol = new_atom(ld, SYMBOL);
+	symbol->value->symbol = (char *) allocate(ld, length + 1);
+	memcpy(symbol->value->symbol, chars, length);
+	symbol->value->symbol[length] = '\0';
+	slot->hash = hash;
+	slot->length = length;
+	slot->symbol = symbol;
+	// Keep the table at most half full.
+	if (++ld->symbol_count * 2 > ld->symbol_capacity)
+		grow_symbols(ld);
+	return symbol;
+}
+
+static struct s_expr *integer(struct loader *ld, int value)
+{
+	struct s_expr *expr;
+
+	if (value >= 0 && value < SHARED_INTEGERS
+	&& ld->integers[value] != NULL)
+		return ld->integers[value];
+	expr = new_atom(ld, INTEGER);
+	expr->value->integer = value;
+	if (value >= 0 && value < SHARED_INTEGERS)
+		ld->integers[value] = expr;
+	return expr;
+}
+
+static struct s_expr *boolean(struct loader *ld, int value)
+{
+	if (ld->booleans[value] == NULL) {
+		ld->booleans[value] = new_atom(ld, BOOLEAN);
+		ld->booleans[value]->value->boolean = value;
+	}
+	return ld->booleans[value];
+}
+
+static int is_space(char ch)
+{
+	return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r';
+}
+
+static void skip_space(struct loader *ld)
+{
+	while (ld->p < ld->end && (is_space(*ld->p) || *ld->p == ';')) {
+		if (*ld->p == ';') {
+			while (ld->p < ld->end && *ld->p != '\n')
+				ld->p++;
+		} else {
+			ld->p++;
+		}
+	}
+}
+
+static int hex_digit(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	return -1;
+}
+
+/*
+ * Reads a string literal, with p on its opening quote. The escapes are those
+ * of the lexer. Since a decoded string is never longer than its literal, room
+ * for the literal is allocated and the rest given back.
+ */
+static struct s_expr *string(struct loader *ld)
+{
+	char *close = ++ld->p;
+	struct text *text;
+	size_t room;
+	char *chars;
+	int length = 0;
+
+	while (close < ld->end && *close != '"')
+		close += *close == '\\' ? 2 : 1;
+	if (close >= ld->end) {
+		ld->error = "syntax error (unterminated string)";
+		return NULL;
+	}
+	room = sizeof(struct text) + (close - ld->p) + 1;
+	text = (struct text *) allocate(ld, room);
+	chars = (char *) (text + 1);
+	while (ld->p < close) {
+		char ch = *ld->p++;
+
+		if (ch == '\\') {
+			ch = *ld->p++;
+			if (ch == 'n') {
+				ch = '\n';
+			} else if (ch == 't') {
+				ch = '\t';
+			} else if (ch == 'r') {
+				ch = '\r';
+			} else if (ch == 'x') {
+				int code = 0;
+				int digit;
+
+				while (ld->p < close
+				&& (digit = hex_digit(*ld->p)) >= 0) {
+					code = code * 16 + digit;
+					ld->p++;
+				}
+				if (ld->p == close || *ld->p != ';'
+				|| code > 255) {
+					ld->error = "illegal hex escape in string";
+					return NULL;
+				}
+				ld->p++;
+				ch = code;
+			} else if (ch != '\\' && ch != '"') {
+				ld->error = "illegal escape in string";
+				return NULL;
+			}
+		}
+		chars[length++] = ch;
+	}
+	chars[length] = '\0';
+	ld->p = close + 1;
+	shrink_last(ld, align(room) - align(sizeof(struct text) + length + 1));
+	text->expr.value = &text->value;
+	text->expr.type = STRING;
+	text->value.string = &text->string;
+	text->string.chars = chars;
+	text->string.length = length;
+	return &text->expr;
+}
+
+/*
+ * Reads a symbol or an integer. Like the parser, which uses strtol(), a
+ * token is an integer if it is all digits after an optional sign, and an
+ * integer too large for a long is clamped.
+ */
+static struct s_expr *token(struct loader *ld)
+{
+	char *start = ld->p;
+	char *digits = start;
+	long value = 0;
+	int negative = 0;
+
+	while (ld->p < ld->end && *ld->p != '(' && *ld->p != ')'
+	&& !is_space(*ld->p))
+		ld->p++;
+	if (*digits == '+' || *digits == '-') {
+		negative = *digits == '-';
+		digits++;
+	}
+	if (digits == ld->p)
+		return intern(ld, start, ld->p - start);
+	for (; digits < ld->p; digits++) {
+		int digit = *digits - '0';
+
+		if (digit < 0 || digit > 9)
+			return intern(ld, start, ld->p - start);
+		if (value > (LONG_MAX - digit) / 10)
+			value = LONG_MAX;
+		else
+			value = value * 10 + digit;
+	}
+	if (negative)
+		value = value == LONG_MAX ? LONG_MIN : -value;
+	return integer(ld, (int) value);
+}
+
+static void push_value(struct loader *ld, struct s_expr *value)
+{
+	if (ld->value_count == ld->value_capacity) {
+		ld->values = (struct s_expr **) grow(ld->values,
+			&ld->value_capacity, sizeof(struct s_expr *));
+	}
+	ld->values[ld->value_count++] = value;
+}
+
+static void open_frame(struct loader *ld)
+{
+	if (ld->depth == ld->frame_capacity) {
+		ld->frames = (struct frame *) grow(ld->frames,
+			&ld->frame_capacity, sizeof(struct frame));
+	}
+	ld->frames[ld->depth].base = ld->value_count;
+	ld->depth++;
+}
+
+// Pops the innermost open list off the stack and pushes the list.
+static void close_frame(struct loader *ld)
+{
+	size_t base = ld->frames[--ld->depth].base;
+	struct s_expr *list = new_list(ld, ld->values + base,
+		ld->value_count - base);
+
+	ld->value_count = base;
+	push_value(ld, list);
+}
+
+// Reads the next datum or parenthesis, and returns 0 at the end or on error.
+static int step(struct loader *ld)
+{
+	struct s_expr *datum;
+
+	skip_space(ld);
+	if (ld->p == ld->end)
+		return 0;
+	if (*ld->p == '(') {
+		ld->p++;
+		open_frame(ld);
+		return 1;
+	}
+	if (*ld->p == '\'') {
+		// Like the parser, a quote is read as a symbol of its own.
+		ld->p++;
+		if (ld->depth > 0 || ld->program)
+			push_value(ld, intern(ld, "'", 1));
+		return 1;
+	}
+	if (*ld->p == ')') {
+		ld->p++;
+		// Like the parser, an unmatched one is read as a symbol.
+		if (ld->depth == 0)
+			push_value(ld, intern(ld, ")", 1));
+		else
+			close_frame(ld);
+	} else if (*ld->p == '"') {
+		datum = string(ld);
+		if (datum == NULL)
+			return 0;
+		push_value(ld, datum);
+	} else if (*ld->p == '#') {
+		ld->p++;
+		if (ld->p == ld->end || (*ld->p != 't' && *ld->p != 'f')) {
+			ld->error = "illegal symbol after #";
+			return 0;
+		}
+		push_value(ld, boolean(ld, *ld->p++ == 't'));
+	} else {
+		push_value(ld, token(ld));
+	}
+	return 1;
+}
+
+static void start_loader(struct loader *ld, struct data_region *region)
+{
+	memset(ld, 0, sizeof(*ld));
+	ld->region = region;
+	ld->value_capacity = INITIAL_VALUES;
+	ld->values = (struct s_expr **)
+		malloc(ld->value_capacity * sizeof(struct s_expr *));
+	ld->frame_capacity = INITIAL_FRAMES;
+	ld->frames = (struct frame *)
+		malloc(ld->frame_capacity * sizeof(struct frame));
+	ld->symbol_capacity = INITIAL_SYMBOLS;
+	ld->symbols = (struct symbol_slot *)
+		calloc(ld->symbol_capacity, sizeof(struct symbol_slot));
+	if (ld->values == NULL || ld->frames == NULL || ld->symbols == NULL) {
+		printf("Out of memory, cannot load data.\n");
+		exit(1);
+	}
+}
+
+static void free_loader(struct loader *ld)
+{
+	free(ld->values);
+	free(ld->frames);
+	free(ld->symbols);
+}
+
+static void free_region(struct data_region *region)
+{
+	size_t i;
+
+	for (i = 0; i < region->chunk_count; i++)
+		munmap(region->chunks[i].base, region->chunks[i].size);
+	free(region->chunks);
+	free(region);
+}
+
+struct data_region *data_parse(char *text, size_t length, int program)
+{
+	struct data_region *region = (struct data_region *)
+		calloc(1, sizeof(struct data_region));
+	struct loader ld;
+	size_t complete;
+	size_t i;
+
+	if (region == NULL) {
+		printf("Out of memory, cannot load data.\n");
+		exit(1);
+	}
+	region->chunk_capacity = 4;
+	region->chunks = (struct chunk *)
+		malloc(region->chunk_capacity * sizeof(struct chunk));
+	if (region->chunks == NULL) {
+		printf("Out of memory, cannot load data.\n");
+		exit(1);
+	}
+	start_loader(&ld, region);
+	ld.program = program;
+	ld.p = text;
+	ld.end = text + length;
+	while (step(&ld))
+		;
+	if (ld.error == NULL && ld.depth > 0)
+		ld.error = "syntax error (unexpected end of input in list)";
+	// Keep what was read before the error.
+	complete = ld.depth > 0 ? ld.frames[0].base : ld.value_count;
+	region->root = new_list(&ld, ld.values, complete);
+	region->error = ld.error;
+	region->bytes = ld.used;
+	free_loader(&ld);
+	if (!program && ld.error == NULL) {
+		for (i = 0; i < region->chunk_count; i++) {
+			mprotect(region->chunks[i].base, region->chunks[i].size,
+				PROT_READ);
+		}
+	}
+	return region;
+}
+
+struct s_expr *data_region_list(struct data_region *region)
+{
+	return region->root;
+}
+
+char *data_region_error(struct data_region *region)
+{
+	return region->error;
+}
+
+void data_keep(struct data_region *region)
+{
+	region->next = interp->data_regions;
+	interp->data_regions = region;
+}
+
+struct s_expr *data_load(char *path)
+{
+	long long start = now_ns();
+	struct data_region *region;
+	struct stat st;
+	char *text = NULL;
+	char message[128];
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &st)) {
+		if (fd >= 0)
+			close(fd);
+		fail("load-data - io error (cannot open file)");
+		return NULL;
+	}
+	if (st.st_size > 0) {
+		text = (char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			fd, 0);
+	}
+	close(fd);
+	if (text == MAP_FAILED) {
+		fail("load-data - io error (cannot map file)");
+		return NULL;
+	}
+	if (text != NULL)
+		madvise(text, st.st_size, MADV_SEQUENTIAL);
+	region = data_parse(text, st.st_size, 0);
+	if (text != NULL)
+		munmap(text, st.st_size);
+	if (region->error != NULL) {
+		snprintf(message, sizeof(message), "load-data - %s",
+			region->error);
+		fail(message);
+		free_region(region);
+		return NULL;
+	}
+	data_keep(region);
+	interp->data_files++;
+	interp->data_bytes_read += st.st_size;
+	interp->data_region_bytes += region->bytes;
+	interp->data_load_ns += now_ns() - start;
+	return region->root;
+}
+
+int data_unload(struct s_expr *data)
+{
+	struct data_region *region;
+	size_t i;
+
+	for (region = interp->data_regions; region != NULL;
+	region = region->next) {
+		if (region->root == data && !region->unloaded)
+			break;
+	}
+	if (region == NULL)
+		return fail("unload-data - type error (expected loaded data)");
+	// Replacing the mappings frees their memory but keeps the addresses,
+	// so that nothing else is mapped where stale objects point. The new
+	// pages read as zeros, so every object in them is UNLOADED.
+	for (i = 0; i < region->chunk_count; i++) {
+		mmap(region->chunks[i].base, region->chunks[i].size, PROT_READ,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+			-1, 0);
+	}
+	region->unloaded = 1;
+	return 1;
+}
+
+void data_adopt(struct interpreter *from)
+{
+	struct data_region **link = &from->data_regions;
+
+	while (*link != NULL)
+		link = &(*link)->next;
+	*link = interp->data_regions;
+	interp->data_regions = from->data_regions;
+	from->data_regions = NULL;
+	interp->data_files += from->data_files;
+	interp->data_bytes_read += from->data_bytes_read;
+	interp->data_region_bytes += from->data_region_bytes;
+	interp->data_load_ns += from->data_load_ns;
+}
+
+void free_data(void)
+{
+	struct data_region *region = interp->data_regions;
+
+	while (region != NULL) {
+		struct data_region *next = region->next;
+
+		free(region->chunks);
+		free(region);
+		region = next;
+	}
+	interp->data_regions = NULL;
+}
@@ -0,0 +1,100 @@
+/**
+ * data.h - Loads large files of s-expression data into regions of their own
+ *
+ * load-data reads a file of data, such as a dump of records, much faster than
+ * the reader can. The file is mapped rather than read, and scanned in place
+ * without copying tokens. Objects are allocated by bumping a pointer through
+ * large mappings that belong to the file's region, rather than three at a
+ * time from malloc():
+ *
+ * - an s-expression and its value are allocated together,
+ * - the cells of a list are allocated together, one after the other, so that
+ *   walking down a list reads memory in order,
+ * - each distinct symbol is stored once, and shared by all its occurrences,
+ * - booleans and small integers are shared.
+ *
+ * A region is made read-only once it is loaded; nothing in it can change.
+ * Its memory is released all at once by data_unload(). Until then, like other
+ * objects, its objects are never freed.
+ *
+ * The syntax is that of the reader (see lexer.h), and the file holds any
+ * number of data. Since they are data and not code, a quote in front of a
+ * datum at the top level is ignored.
+ */
+#ifndef DATA
+#define DATA
+#include "parser.h"
+
+struct data_region;
+struct interpreter;
+
+/**
+ * data_load() - Reads the data in a file into a new region
+ * @path
+ * @returns a list of the data in the file, or NULL on error (see
+ * interpreter_error())
+ *
+ * The region is kept by the current interpreter, which also counts the bytes
+ * read and the time it took (see heap_report()).
+ */
+struct s_expr *data_load(char *path);
+
+/**
+ * data_parse() - Reads text into a new region
+ * @text
+ * @length - the number of bytes in `text`
+ * @program - whether the text is a program, in which a quote at the top level
+ * is read like anywhere else; the region of a program is not made read-only
+ *
+ * This can be called on any thread, since it uses no interpreter. The region
+ * belongs to the caller until it is given to data_keep().
+ */
+struct data_region *data_parse(char *text, size_t length, int program);
+
+/**
+ * data_region_list() - Returns the list of what a region has read
+ * @region
+ *
+ * After an error, the list has the data before the one with the error.
+ */
+struct s_expr *data_region_list(struct data_region *region);
+
+/**
+ * data_region_error() - Returns why reading a region stopped early, or NULL
+ * @region
+ * @returns a message such as "syntax error (unterminated string)", which
+ * the caller prefixes with its own name
+ */
+char *data_region_error(struct data_region *region);
+
+/**
+ * data_keep() - Gives a region to the current interpreter
+ * @region - from data_parse()
+ */
+void data_keep(struct data_region *region);
+
+/**
+ * data_unload() - Returns the memory of a region to the system
+ * @data - a list returned by data_load()
+ * @returns 1 on success and 0 on error (see interpreter_error())
+ *
+ * Every object in the region becomes UNLOADED (see parser.h): the addresses
+ * stay reserved and readable, but hold nothing. Evaluating a variable bound
+ * to such an object is an error, and builtins given one report a type error.
+ */
+int data_unload(struct s_expr *data);
+
+/**
+ * data_adopt() - Moves the regions of an interpreter to the current one
+ * @from - an interpreter about to be destroyed
+ */
+void data_adopt(struct interpreter *from);
+
+/**
+ * free_data() - Forgets the regions of the current interpreter
+ *
+ * Their objects stay valid, since the interpreter's values may outlive it.
+ */
+void free_data(void);
+
+#endif
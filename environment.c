@@ -5,6 +5,8 @@
 #include <string.h>
 #include <stdio.h>
 #include "parser.h"
+#include "heap.h"
+#include "interpreter.h"
 #include "environment.h"
 
 /*
@@ -12,7 +14,7 @@
  *
  * The environment state is stored in a pseudo-map - a linked list whose
  * nodes are added at the beginning (hiding previous nodes with the same
- * id).
+ * id). The stack of states belongs to the current interpreter.
  */
 
 static struct definition {
@@ -28,20 +30,60 @@ static struct env_state {
 	struct env_state *prev;
 };
 
-static struct env_state *state_stack;
+static void free_state(struct env_state *state)
+{
+	struct definition *def = state->first_definition;
+
+	// Definitions belong to one state, but their values may be shared.
+	while (def != NULL) {
+		struct definition *next = def->next;
+
+		heap_free(HEAP_DEFINITION, def, sizeof(struct definition));
+		def = next;
+	}
+	heap_free(HEAP_ENV_STATE, state, sizeof(struct env_state));
+}
 
 void start_environment()
 {
 	push_env();
 }
 
+void start_environment_copy(struct env_state *state)
+{
+	struct definition *def;
+
+	push_env();
+	for (def = state->first_definition; def != NULL; def = def->next)
+		set_env(def->id, def->value);
+}
+
+void free_environment(void)
+{
+	if (interp->state_stack == NULL)
+		return;
+	while (pop_env())
+		;
+	free_state(interp->state_stack);
+	interp->state_stack = NULL;
+}
+
+struct env_state *switch_environment(struct env_state *state)
+{
+	struct env_state *prev = interp->state_stack;
+
+	interp->state_stack = state;
+	return prev;
+}
+
 void push_env()
 {
-	struct env_state *prev = state_stack;
-	state_stack = (struct env_state *) malloc(sizeof(struct env_state));
+	struct env_state *prev = interp->state_stack;
+	interp->state_stack = (struct env_state *)
+		heap_alloc(HEAP_ENV_STATE, sizeof(struct env_state));
 
-	state_stack->first_definition = NULL;
-	state_stack->last_definition = NULL;
+	interp->state_stack->first_definition = NULL;
+	interp->state_stack->last_definition = NULL;
 	if (prev != NULL) {
 		// copy parent state's definitions
 		struct definition *tmp = prev->first_definition;
@@ -51,18 +93,18 @@ void push_env()
 			tmp = tmp->next;
 		}
 	}
-	state_stack->prev = prev;
+	interp->state_stack->prev = prev;
 }
 
 int pop_env()
 {
-	if (state_stack->prev == NULL)
+	if (interp->state_stack->prev == NULL)
 		return 0;
 
-	struct env_state *popped = state_stack;
+	struct env_state *popped = interp->state_stack;
 
-	state_stack = state_stack->prev;
-	free(popped);
+	interp->state_stack = popped->prev;
+	free_state(popped);
 	return 1;
 }
 
@@ -71,23 +113,34 @@ void set_env(char *id, struct s_expr *value)
 	// If id already exists, hide the previous value by prepending this
 	// item.
 	struct definition *def = (struct definition *)
-		malloc(sizeof(struct definition));
+		heap_alloc(HEAP_DEFINITION, sizeof(struct definition));
 	def->id = id;
 	def->value = value;
-	def->prev = state_stack->last_definition;
+	def->prev = interp->state_stack->last_definition;
 	def->next = NULL;
-	if (state_stack->last_definition == NULL) {
-		state_stack->first_definition = def;
-		state_stack->last_definition = def;
+	if (interp->state_stack->last_definition == NULL) {
+		interp->state_stack->first_definition = def;
+		interp->state_stack->last_definition = def;
 	} else {
-		state_stack->last_definition->next = def;
-		state_stack->last_definition = def;
+		interp->state_stack->last_definition->next = def;
+		interp->state_stack->last_definition = def;
+	}
+}
+
+void env_for_each(void (*fn)(char *id, struct s_expr *value, void *data),
+	void *data)
+{
+	struct definition *def = interp->state_stack->first_definition;
+
+	while (def != NULL) {
+		fn(def->id, def->value, data);
+		def = def->next;
 	}
 }
 
 struct s_expr *get_env(char *id)
 {
-	struct definition *curr = state_stack->last_definition;
+	struct definition *curr = interp->state_stack->last_definition;
 
 	while (curr != NULL) {
 		if (!strcmp(curr->id, id))
@@ -1,5 +1,7 @@
 /**
  * environment.h - Stores user defined symbols
+ *
+ * The environment belongs to the current interpreter (see interpreter.h).
  */
 
 #ifndef ENV
@@ -7,11 +9,39 @@
 #include <stdlib.h>
 #include "parser.h"
 
+struct env_state;
+
 /**
  * init_env - Starts the environment
  */
 void start_environment();
 
+/**
+ * start_environment_copy - Starts the environment with the bindings of another
+ * interpreter's current environment state
+ * @state - the state, which must not change during the copy
+ */
+void start_environment_copy(struct env_state *state);
+
+/**
+ * free_environment - Frees every environment state
+ *
+ * The values bound in them are not freed.
+ */
+void free_environment(void);
+
+/**
+ * switch_environment - Replaces the stack of environment states
+ * @state - the innermost state of the new stack, or NULL for none
+ * @returns the innermost state of the old stack, to be switched back to later
+ *
+ * This lets code run with a stack of its own, such as a generator (see
+ * coroutine.h) that is suspended in the middle of a call. With
+ * start_environment_copy() and free_environment(), it can also make and free
+ * such stacks.
+ */
+struct env_state *switch_environment(struct env_state *state);
+
 /**
  * set_env - Binds an s-expression to an id
  * @id - the name to bind to
@@ -26,6 +56,17 @@ void set_env(char *id, struct s_expr *value);
  */
 struct s_expr *get_env(char *id);
 
+/**
+ * env_for_each - Calls `fn` on each binding of the current environment state
+ * @fn - the callback, which gets the id, its value and `data`
+ * @data
+ *
+ * Bindings are visited in the order they were made, so a binding that hides
+ * an earlier one with the same id comes after it.
+ */
+void env_for_each(void (*fn)(char *id, struct s_expr *value, void *data),
+	void *data);
+
 /**
  * push_env - Pushes the current environment state onto the environment stack
  */
@@ -2,39 +2,59 @@
  * evaluator.c - Interface for executing an s-expression
  */
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
+#include <pthread.h>
 #include "parser.h"
+#include "heap.h"
 #include "environment.h"
+#include "hash_table.h"
+#include "string_builder.h"
+#include "memo.h"
+#include "profile.h"
+#include "pool.h"
+#include "mailbox.h"
+#include "coroutine.h"
+#include "data.h"
+#include "port.h"
+#include "printer.h"
+#include "macro.h"
+#include "fold.h"
+#include "closure.h"
+#include "lower.h"
+#include "interpreter.h"
 #include "evaluator.h"
 
-static char *last_error_message;
+#define MEMO_DEFAULT_CAPACITY 1024
+// The fewest elements pmap hands to one task
+#define PMAP_GRAIN 8
+// Actors recurse for every message they handle, so give them room.
+#define ACTOR_STACK_SIZE (64 * 1024 * 1024)
+// The most stack a generator can use; only the part it touches is allocated.
+#define GENERATOR_STACK_SIZE (8 * 1024 * 1024)
 
-static void set_error_message(char *message)
+void set_error_message(char *message)
 {
-	if (last_error_message != NULL)
-		free(last_error_message);
-	last_error_message = (char *)
+	if (interp->last_error_message != NULL)
+		free(interp->last_error_message);
+	interp->last_error_message = (char *)
 		malloc((strlen(message)+1) * sizeof(char));
 
-	strcpy(last_error_message, message);
+	strcpy(interp->last_error_message, message);
 }
 
 int get_eval_error(char *buffer, int buffer_size)
 {
-	if (strlen(last_error_message) > buffer_size)
+	if (strlen(interp->last_error_message) > buffer_size)
 		return 0;
 
-	strcpy(buffer, last_error_message);
+	strcpy(buffer, interp->last_error_message);
 	return 1;
 }
 
-static struct fn_arguments {
-	struct s_expr *value;
-	struct fn_arguments *next;
-};
-
-static void register_builtin_function(char *name,
+static struct s_expr *new_builtin_function(char *name,
 struct s_expr *(*function)(struct fn_arguments *))
 {
 	struct builtin_function *function_entry = (struct builtin_function *)
@@ -44,8 +64,182 @@ struct s_expr *(*function)(struct fn_arguments *))
 		(strlen(name)+1) * sizeof(char));
 	strcpy(function_entry->name, name);
 	function_entry->function = *function;
+	return s_expr_from_builtin(function_entry);
+}
+
+static struct s_expr *register_builtin_function(char *name,
+struct s_expr *(*function)(struct fn_arguments *))
+{
+	struct s_expr *builtin = new_builtin_function(name, function);
+
+	set_env(name, builtin);
+	return builtin;
+}
+
+// FUNCTION APPLICATION
+
+void free_arguments(struct fn_arguments *args)
+{
+	while (args != NULL) {
+		struct fn_arguments *next = args->next;
+
+		heap_free(HEAP_ARGUMENTS, args, sizeof(struct fn_arguments));
+		args = next;
+	}
+}
+
+// Adds a node holding `value` to the end of an argument list.
+void push_argument(struct fn_arguments **first,
+	struct fn_arguments **last, struct s_expr *value)
+{
+	struct fn_arguments *new = (struct fn_arguments *)
+		heap_alloc(HEAP_ARGUMENTS, sizeof(struct fn_arguments));
+
+	new->value = value;
+	new->next = NULL;
+	if (*first == NULL)
+		*first = new;
+	else
+		(*last)->next = new;
+	*last = new;
+}
+
+// Returns whether eval_expression() returns `value` unchanged.
+int is_self_evaluating(struct s_expr *value)
+{
+	return value->type != SYMBOL && value->type != CELL
+		&& value->type != EMPTY_LIST;
+}
+
+// Wraps `value` as (quote value), with the quote builtin itself in
+// operator position so that redefining `quote` doesn't affect it.
+struct s_expr *quoted(struct s_expr *value)
+{
+	struct list_builder form;
+
+	list_builder_init(&form);
+	list_builder_push(&form, interp->quote_function);
+	list_builder_push(&form, value);
+	return list_builder_finish(&form, empty_list);
+}
+
+struct s_expr *call_builtin(struct builtin_function *builtin,
+	struct fn_arguments *args)
+{
+	if (!interp->profiling)
+		return builtin->function(args);
+
+	profile_enter(builtin->name, 1);
+	struct s_expr *ret = builtin->function(args);
+
+	profile_exit();
+	return ret;
+}
+
+static struct s_expr *eval_body(struct lambda *lmb);
+
+// Binds the parameters of `lmb` to `values` and evaluates its body.
+static struct s_expr *run_lambda(struct lambda *lmb,
+	struct fn_arguments *values)
+{
+	struct fn_arguments *value = values;
+	int i;
+
+	// Prepare local environment
+	push_env();
+	for (i = 0; i < lmb->arg_count; i++) {
+		set_env(lmb->args[i], value->value);
+		value = value->next;
+	}
+
+	// Evaluate function body
+	struct s_expr *ret = eval_body(lmb);
+
+	pop_env();
+	return ret;
+}
+
+static struct s_expr *apply_lambda(struct lambda *lmb,
+	struct fn_arguments *values)
+{
+	struct fn_arguments *value = values;
+	int i;
+
+	for (i = 0; i < lmb->arg_count; i++) {
+		if (value == NULL) {
+			// Not enough arguments passed to lambda
+			set_error_message("lambda - arity mismatch");
+			return NULL;
+		}
+		value = value->next;
+	}
+	if (value != NULL) {
+		// Too many arguments passed to lambda
+		set_error_message("lambda - arity mismatch");
+		return NULL;
+	}
+
+	unsigned long hash = 0;
+	struct s_expr *ret;
+
+	if (lmb->memo != NULL) {
+		hash = memo_hash(values);
+		ret = memo_cache_get(lmb->memo, values, hash);
+		if (ret != NULL)
+			return ret;
+	}
+
+	if (!interp->profiling) {
+		ret = run_lambda(lmb, values);
+	} else {
+		profile_enter(lmb->name, 0);
+		ret = run_lambda(lmb, values);
+		profile_exit();
+	}
+	if (ret != NULL && lmb->memo != NULL)
+		memo_cache_put(lmb->memo, values, hash, ret);
+	return ret;
+}
+
+/*
+ * apply_function() - Calls a lambda or builtin on already evaluated values
+ * @fn - the function; is_function(fn) must hold
+ * @values - the argument values, which are not evaluated again
+ *
+ * Lambdas have their parameters bound to `values` directly. Builtins evaluate
+ * their own arguments, so any value that doesn't evaluate to itself is quoted
+ * first; when there are none, `values` is passed through without copying.
+ */
+static struct s_expr *apply_function(struct s_expr *fn,
+	struct fn_arguments *values)
+{
+	if (fn->type == LAMBDA)
+		return apply_lambda(fn->value->lambda, values);
+
+	struct fn_arguments *value = values;
+
+	while (value != NULL && is_self_evaluating(value->value))
+		value = value->next;
+	if (value == NULL)
+		return call_builtin(fn->value->builtin, values);
+
+	struct fn_arguments *first_arg = NULL;
+	struct fn_arguments *last_arg = NULL;
 
-	set_env(name, s_expr_from_builtin(function_entry));
+	for (value = values; value != NULL; value = value->next) {
+		push_argument(&first_arg, &last_arg,
+			is_self_evaluating(value->value)
+			? value->value : quoted(value->value));
+	}
+	struct s_expr *ret = call_builtin(fn->value->builtin, first_arg);
+
+	free_arguments(first_arg);
+	return ret;
+}
+
+struct s_expr *eval_apply(struct s_expr *fn, struct fn_arguments *values)
+{
+	return apply_function(fn, values);
 }
 
 // BUILTIN FUNCTIONS
@@ -62,33 +256,22 @@ static struct s_expr *exit_(struct fn_arguments *args)
 
 static struct s_expr *list(struct fn_arguments *args)
 {
-	struct s_expr *first = empty_list;
-	struct s_expr *last = first;
+	struct list_builder result;
 	struct fn_arguments *arg = args;
 
+	list_builder_init(&result);
 	while (arg != NULL) {
-		struct cons_cell *next = (struct cons_cell *)
-			malloc(sizeof(struct cons_cell));
-
-		next->first = eval_expression(arg->value);
-		if (next->first == NULL) return NULL;
-		next->rest = empty_list;
-		struct s_expr *next_s_expr = s_expr_from_cons_cell(next);
+		struct s_expr *value = eval_expression(arg->value);
 
-		if (last != empty_list) {
-			last->value->cell->rest = next_s_expr;
-			last = next_s_expr;
-		} else {
-			first = next_s_expr;
-			last = next_s_expr;
-		}
+		if (value == NULL)
+			return NULL;
+		list_builder_push(&result, value);
 		arg = arg->next;
 	}
-
-	return first;
+	return list_builder_finish(&result, empty_list);
 }
 
-static struct s_expr *is_list_(struct fn_arguments *args)
+struct s_expr *is_list_(struct fn_arguments *args)
 {
 	if (args == NULL || args->next != NULL) {
 		set_error_message("list? - arity mismatch");
@@ -101,7 +284,7 @@ static struct s_expr *is_list_(struct fn_arguments *args)
 		is_list(val));
 }
 
-static struct s_expr *is_empty(struct fn_arguments *args)
+struct s_expr *is_empty(struct fn_arguments *args)
 {
 	if (args == NULL || args->next != NULL) {
 		set_error_message("null? - arity mismatch");
@@ -115,40 +298,185 @@ static struct s_expr *is_empty(struct fn_arguments *args)
 
 static struct s_expr *append(struct fn_arguments *args)
 {
-	struct s_expr *result = empty_list;
+	struct list_builder result;
 	struct fn_arguments *arg = args;
 
-	while (arg != NULL) {
-		struct s_expr *curr = eval_expression(arg->value);
-		if (curr == NULL) return NULL;
+	list_builder_init(&result);
+	if (args == NULL)
+		return empty_list;
 
-		if (is_list(curr)) {
-			struct s_expr *curr_item = curr;
+	// Copy every argument but the last, which becomes the tail of the
+	// result as-is (and so can be any value).
+	while (arg->next != NULL) {
+		struct s_expr *curr = eval_expression(arg->value);
 
-			while (!is_empty_list(curr_item)) {
-				result = list_append(result,
-					curr_item->value->cell->first);
-				curr_item = curr_item->value->cell->rest;
-			}
-		} else {
-			if (arg->next != NULL || arg == args) {
-				// Only the last argument can be a non-list.
-				// Additionally, the first argument must be a
-				// list.
-				set_error_message(
-					"append - type mismatch (expecting list)");
-				return NULL;
-			}
-			// result must be a non-empty list.
-			// Make result an improper list.
-			result->value->cell->rest = curr;
+		if (curr == NULL)
+			return NULL;
+		while (curr->type == CELL) {
+			list_builder_push(&result, curr->value->cell->first);
+			curr = curr->value->cell->rest;
+		}
+		if (!is_empty_list(curr)) {
+			// Only the last argument can be a non-list.
+			set_error_message(
+				"append - type mismatch (expecting list)");
+			return NULL;
 		}
 		arg = arg->next;
 	}
+	struct s_expr *last = eval_expression(arg->value);
+
+	if (last == NULL)
+		return NULL;
+	return list_builder_finish(&result, last);
+}
+
+struct s_expr *length(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("length - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *ls = eval_expression(args->value);
+	int count = 0;
+
+	if (ls == NULL)
+		return NULL;
+	// Count and check for a proper list in the same pass.
+	while (ls->type == CELL) {
+		count++;
+		ls = ls->value->cell->rest;
+	}
+	if (!is_empty_list(ls)) {
+		set_error_message("length - type error (expected list)");
+		return NULL;
+	}
+	return s_expr_from_integer(count);
+}
+
+static struct s_expr *reverse(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("reverse - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *ls = eval_expression(args->value);
+	struct s_expr *result = empty_list;
+
+	if (ls == NULL)
+		return NULL;
+	while (ls->type == CELL) {
+		struct cons_cell *cell = (struct cons_cell *)
+			heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
+
+		cell->first = ls->value->cell->first;
+		cell->rest = result;
+		result = s_expr_from_cons_cell(cell);
+		ls = ls->value->cell->rest;
+	}
+	if (!is_empty_list(ls)) {
+		set_error_message("reverse - type error (expected list)");
+		return NULL;
+	}
 	return result;
 }
 
-static struct s_expr *quote(struct fn_arguments *args)
+/*
+ * Evaluates the arguments of list-tail and list-ref and returns the list after
+ * dropping `k` elements, or NULL.
+ */
+static struct s_expr *drop(struct fn_arguments *args, char *name)
+{
+	char message[64];
+
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	struct s_expr *ls = eval_expression(args->value);
+	struct s_expr *k = eval_expression(args->next->value);
+	int i;
+
+	if (ls == NULL || k == NULL)
+		return NULL;
+	if (k->type != INTEGER || k->value->integer < 0) {
+		sprintf(message,
+			"%s - type error (expected non-negative integer)",
+			name);
+		set_error_message(message);
+		return NULL;
+	}
+	for (i = 0; i < k->value->integer; i++) {
+		if (ls->type != CELL) {
+			sprintf(message, "%s - index error (list too short)",
+				name);
+			set_error_message(message);
+			return NULL;
+		}
+		ls = ls->value->cell->rest;
+	}
+	return ls;
+}
+
+struct s_expr *list_tail(struct fn_arguments *args)
+{
+	return drop(args, "list-tail");
+}
+
+struct s_expr *list_ref(struct fn_arguments *args)
+{
+	struct s_expr *ls = drop(args, "list-ref");
+
+	if (ls == NULL)
+		return NULL;
+	if (ls->type != CELL) {
+		set_error_message("list-ref - index error (list too short)");
+		return NULL;
+	}
+	return ls->value->cell->first;
+}
+
+struct s_expr *last_pair(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("last-pair - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *ls = eval_expression(args->value);
+
+	if (ls == NULL)
+		return NULL;
+	if (ls->type != CELL) {
+		set_error_message("last-pair - type error (expected cons cell)");
+		return NULL;
+	}
+	while (ls->value->cell->rest->type == CELL)
+		ls = ls->value->cell->rest;
+	return ls;
+}
+
+static struct s_expr *list_copy(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("list-copy - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *ls = eval_expression(args->value);
+	struct list_builder result;
+
+	if (ls == NULL)
+		return NULL;
+	list_builder_init(&result);
+	while (ls->type == CELL) {
+		list_builder_push(&result, ls->value->cell->first);
+		ls = ls->value->cell->rest;
+	}
+	// An improper tail is shared rather than copied.
+	return list_builder_finish(&result, ls);
+}
+
+struct s_expr *quote(struct fn_arguments *args)
 {
 	if (args == NULL || args->next != NULL) {
 		set_error_message("quote - arity mismatch");
@@ -170,14 +498,14 @@ static struct s_expr *cons(struct fn_arguments *args)
 	if (first == NULL || second == NULL) return NULL;
 
 	struct cons_cell *cell = (struct cons_cell *)
-		malloc(sizeof(struct cons_cell));
+		heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
 	cell->first = first;
 	cell->rest = second;
 
 	return s_expr_from_cons_cell(cell);
 }
 
-static struct s_expr *car(struct fn_arguments *args)
+struct s_expr *car(struct fn_arguments *args)
 {
 	if (args == NULL || args->next != NULL) {
 		set_error_message("car - arity mismatch");
@@ -194,7 +522,7 @@ static struct s_expr *car(struct fn_arguments *args)
 	return ls->value->cell->first;
 }
 
-static struct s_expr *cdr(struct fn_arguments *args)
+struct s_expr *cdr(struct fn_arguments *args)
 {
 	if (args == NULL || args->next != NULL) {
 		set_error_message("cdr - arity mismatch");
@@ -211,13 +539,16 @@ static struct s_expr *cdr(struct fn_arguments *args)
 	return ls->value->cell->rest;
 }
 
-static struct s_expr *add(struct fn_arguments *args)
+struct s_expr *add(struct fn_arguments *args)
 {
 	int sum = 0;
 	struct fn_arguments *arg = args;
 
 	while (arg != NULL) {
 		struct s_expr *val = eval_expression(arg->value);
+
+		if (val == NULL)
+			return NULL;
 		if (val->type != INTEGER) {
 			set_error_message("+ - type error (expected integer)");
 			return NULL;
@@ -228,7 +559,7 @@ static struct s_expr *add(struct fn_arguments *args)
 	return s_expr_from_integer(sum);
 }
 
-static struct s_expr *subtract(struct fn_arguments *args)
+struct s_expr *subtract(struct fn_arguments *args)
 {
 	if (args == NULL) {
 		set_error_message("- - arity mismatch");
@@ -236,6 +567,8 @@ static struct s_expr *subtract(struct fn_arguments *args)
 	}
 	struct s_expr *first = eval_expression(args->value);
 
+	if (first == NULL)
+		return NULL;
 	if (first->type != INTEGER) {
 		set_error_message("- - type error (expected integer)");
 		return NULL;
@@ -253,6 +586,8 @@ static struct s_expr *subtract(struct fn_arguments *args)
 	while (arg != NULL) {
 		struct s_expr *curr = eval_expression(arg->value);
 
+		if (curr == NULL)
+			return NULL;
 		if (curr->type != INTEGER) {
 			set_error_message("- - type error (expected integer)");
 			return NULL;
@@ -263,13 +598,16 @@ static struct s_expr *subtract(struct fn_arguments *args)
 	return s_expr_from_integer(difference);
 }
 
-static struct s_expr *multiply(struct fn_arguments *args)
+struct s_expr *multiply(struct fn_arguments *args)
 {
 	int product = 1;
 	struct fn_arguments *arg = args;
 
 	while (arg != NULL) {
 		struct s_expr *val = eval_expression(arg->value);
+
+		if (val == NULL)
+			return NULL;
 		if (val->type != INTEGER) {
 			set_error_message("* - type error (expected integer)");
 			return NULL;
@@ -280,7 +618,143 @@ static struct s_expr *multiply(struct fn_arguments *args)
 	return s_expr_from_integer(product);
 }
 
-static struct s_expr *and(struct fn_arguments *args)
+enum comparison { LESS, GREATER, EQUAL, LESS_EQUAL, GREATER_EQUAL };
+
+/*
+ * Shared by the numeric comparisons. Returns #t if each argument compares
+ * with the next one as `comparison` says.
+ */
+static struct s_expr *compare(struct fn_arguments *args, char *name,
+	enum comparison comparison)
+{
+	char message[64];
+	struct fn_arguments *arg;
+	struct s_expr *prev = NULL;
+	int result = 1;
+
+	if (args == NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	// Evaluate every argument, even once the result is known.
+	for (arg = args; arg != NULL; arg = arg->next) {
+		struct s_expr *val = eval_expression(arg->value);
+
+		if (val == NULL)
+			return NULL;
+		if (val->type != INTEGER) {
+			sprintf(message, "%s - type error (expected integer)",
+				name);
+			set_error_message(message);
+			return NULL;
+		}
+		if (prev != NULL) {
+			int a = prev->value->integer;
+			int b = val->value->integer;
+
+			if (comparison == LESS)
+				result = result && a < b;
+			else if (comparison == GREATER)
+				result = result && a > b;
+			else if (comparison == EQUAL)
+				result = result && a == b;
+			else if (comparison == LESS_EQUAL)
+				result = result && a <= b;
+			else
+				result = result && a >= b;
+		}
+		prev = val;
+	}
+	return s_expr_from_boolean(result);
+}
+
+struct s_expr *less(struct fn_arguments *args)
+{
+	return compare(args, "<", LESS);
+}
+
+struct s_expr *greater(struct fn_arguments *args)
+{
+	return compare(args, ">", GREATER);
+}
+
+struct s_expr *numbers_equal(struct fn_arguments *args)
+{
+	return compare(args, "=", EQUAL);
+}
+
+struct s_expr *less_equal(struct fn_arguments *args)
+{
+	return compare(args, "<=", LESS_EQUAL);
+}
+
+struct s_expr *greater_equal(struct fn_arguments *args)
+{
+	return compare(args, ">=", GREATER_EQUAL);
+}
+
+enum division { QUOTIENT, REMAINDER, MODULO };
+
+// Shared by quotient, remainder and modulo.
+static struct s_expr *divide(struct fn_arguments *args, char *name,
+	enum division division)
+{
+	char message[64];
+
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	struct s_expr *a = eval_expression(args->value);
+	struct s_expr *b = eval_expression(args->next->value);
+
+	if (a == NULL || b == NULL)
+		return NULL;
+	if (a->type != INTEGER || b->type != INTEGER) {
+		sprintf(message, "%s - type error (expected integer)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	int n = a->value->integer;
+	int d = b->value->integer;
+
+	if (d == 0) {
+		sprintf(message, "%s - value error (division by zero)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	// INT_MIN / -1 doesn't fit in an int, and traps on most machines.
+	if (n == INT_MIN && d == -1) {
+		sprintf(message, "%s - value error (overflow)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	if (division == QUOTIENT)
+		return s_expr_from_integer(n / d);
+	if (division == REMAINDER || n % d == 0 || (n % d < 0) == (d < 0))
+		return s_expr_from_integer(n % d);
+	// The modulo has the sign of the divisor.
+	return s_expr_from_integer(n % d + d);
+}
+
+struct s_expr *quotient(struct fn_arguments *args)
+{
+	return divide(args, "quotient", QUOTIENT);
+}
+
+struct s_expr *remainder_(struct fn_arguments *args)
+{
+	return divide(args, "remainder", REMAINDER);
+}
+
+struct s_expr *modulo(struct fn_arguments *args)
+{
+	return divide(args, "modulo", MODULO);
+}
+
+struct s_expr *and(struct fn_arguments *args)
 {
 	if (args == NULL) {
 		// no arguments; return #t
@@ -294,6 +768,8 @@ static struct s_expr *and(struct fn_arguments *args)
 	while (arg != NULL) {
 		val = eval_expression(arg->value);
 
+		if (val == NULL)
+			return NULL;
 		if (is_empty_list(val))
 			return s_expr_from_boolean(0);
 		arg = arg->next;
@@ -301,7 +777,7 @@ static struct s_expr *and(struct fn_arguments *args)
 	return val;
 }
 
-static struct s_expr *or(struct fn_arguments *args)
+struct s_expr *or(struct fn_arguments *args)
 {
 	// return the first truthy value
 	struct fn_arguments *arg = args;
@@ -309,6 +785,8 @@ static struct s_expr *or(struct fn_arguments *args)
 	while (arg != NULL) {
 		struct s_expr *val = eval_expression(arg->value);
 
+		if (val == NULL)
+			return NULL;
 		if (!is_empty_list(val))
 			return val;
 		arg = arg->next;
@@ -317,7 +795,7 @@ static struct s_expr *or(struct fn_arguments *args)
 	return s_expr_from_boolean(0);
 }
 
-static struct s_expr *is_symbol(struct fn_arguments *args)
+struct s_expr *is_symbol(struct fn_arguments *args)
 {
 	if (args == NULL || args->next != NULL) {
 		set_error_message("symbol? - arity mismatch");
@@ -329,7 +807,7 @@ static struct s_expr *is_symbol(struct fn_arguments *args)
 	return s_expr_from_boolean(ls->type == SYMBOL);
 }
 
-static struct s_expr *are_equal(struct fn_arguments *args)
+struct s_expr *are_equal(struct fn_arguments *args)
 {
 	if (args == NULL || args->next == NULL || args->next->next != NULL) {
 		set_error_message("equal? - arity mismatch");
@@ -342,6 +820,20 @@ static struct s_expr *are_equal(struct fn_arguments *args)
 	return s_expr_from_boolean(equal(a, b));
 }
 
+struct s_expr *are_eq(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("eq? - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *a = eval_expression(args->value);
+	struct s_expr *b = eval_expression(args->next->value);
+
+	if (a == NULL || b == NULL)
+		return NULL;
+	return s_expr_from_boolean(eq(a, b));
+}
+
 static struct s_expr *assoc(struct fn_arguments *args)
 {
 	if (args == NULL || args->next == NULL || args->next->next != NULL) {
@@ -365,173 +857,2863 @@ static struct s_expr *assoc(struct fn_arguments *args)
 	return result;
 }
 
-static struct s_expr *cond(struct fn_arguments *args)
+static struct s_expr *make_hash_table(struct fn_arguments *args)
 {
-	if (args == NULL) {
-		// TODO return #<void>
-		return empty_list;
-	}
+	enum hash_kind kind = HASH_EQUAL;
 
-	while (args != NULL) {
-		struct s_expr *clause = args->value;
+	if (args != NULL && args->next != NULL) {
+		set_error_message("make-hash-table - arity mismatch");
+		return NULL;
+	}
+	if (args != NULL) {
+		// The optional argument is the equality predicate for keys.
+		struct s_expr *test = eval_expression(args->value);
 
-		if (!is_list(clause)) {
-			set_error_message("cond - type error (expected list)");
+		if (test == NULL)
+			return NULL;
+		if (test->type != BUILTIN
+		|| (test->value->builtin->function != are_eq
+		&& test->value->builtin->function != are_equal)) {
+			set_error_message(
+				"make-hash-table - type error (expected eq? or equal?)");
+			return NULL;
+		}
+		if (test->value->builtin->function == are_eq)
+			kind = HASH_EQ;
+	}
+	return s_expr_from_hash_table(hash_table_create(kind));
+}
+
+// Evaluates an argument that must be a hash table, or returns NULL.
+static struct hash_table *hash_table_argument(struct s_expr *arg,
+	char *type_error)
+{
+	struct s_expr *val = eval_expression(arg);
+
+	if (val == NULL)
+		return NULL;
+	if (val->type != HASH_TABLE) {
+		set_error_message(type_error);
+		return NULL;
+	}
+	return val->value->table;
+}
+
+static struct s_expr *is_hash_table(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("hash-table? - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *val = eval_expression(args->value);
+
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == HASH_TABLE);
+}
+
+static struct s_expr *hash_ref(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL
+	|| (args->next->next != NULL && args->next->next->next != NULL)) {
+		set_error_message("hash-ref - arity mismatch");
+		return NULL;
+	}
+	struct hash_table *table = hash_table_argument(args->value,
+		"hash-ref - type error (expected hash table)");
+	struct s_expr *key;
+	struct s_expr *value;
+
+	if (table == NULL)
+		return NULL;
+	key = eval_expression(args->next->value);
+	if (key == NULL)
+		return NULL;
+	value = hash_table_get(table, key);
+	if (value != NULL)
+		return value;
+	if (args->next->next != NULL) {
+		// Only evaluate the default when it is needed.
+		return eval_expression(args->next->next->value);
+	}
+	set_error_message("hash-ref - key error (no value for key)");
+	return NULL;
+}
+
+static struct s_expr *hash_set(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next == NULL
+	|| args->next->next->next != NULL) {
+		set_error_message("hash-set! - arity mismatch");
+		return NULL;
+	}
+	struct hash_table *table = hash_table_argument(args->value,
+		"hash-set! - type error (expected hash table)");
+
+	if (table == NULL)
+		return NULL;
+	struct s_expr *key = eval_expression(args->next->value);
+	struct s_expr *value = eval_expression(args->next->next->value);
+
+	if (key == NULL || value == NULL)
+		return NULL;
+	hash_table_set(table, key, value);
+	return empty_list;
+}
+
+static struct s_expr *hash_remove(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("hash-remove! - arity mismatch");
+		return NULL;
+	}
+	struct hash_table *table = hash_table_argument(args->value,
+		"hash-remove! - type error (expected hash table)");
+
+	if (table == NULL)
+		return NULL;
+	struct s_expr *key = eval_expression(args->next->value);
+
+	if (key == NULL)
+		return NULL;
+	hash_table_remove(table, key);
+	return empty_list;
+}
+
+static struct s_expr *hash_count(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("hash-count - arity mismatch");
+		return NULL;
+	}
+	struct hash_table *table = hash_table_argument(args->value,
+		"hash-count - type error (expected hash table)");
+
+	if (table == NULL)
+		return NULL;
+	return s_expr_from_integer(hash_table_count(table));
+}
+
+static void collect_key(struct hash_entry *entry, void *data)
+{
+	struct s_expr **result = (struct s_expr **) data;
+
+	*result = cons_onto(entry->key, *result);
+}
+
+static void collect_value(struct hash_entry *entry, void *data)
+{
+	struct s_expr **result = (struct s_expr **) data;
+
+	*result = cons_onto(entry->value, *result);
+}
+
+static void collect_pair(struct hash_entry *entry, void *data)
+{
+	struct s_expr **result = (struct s_expr **) data;
+	// Pairs are two-element lists, so that the result is an association
+	// list that assoc accepts.
+	struct s_expr *pair = cons_onto(entry->key,
+		cons_onto(entry->value, empty_list));
+
+	*result = cons_onto(pair, *result);
+}
+
+static struct s_expr *collect_entries(struct fn_arguments *args, char *name,
+	void (*collect)(struct hash_entry *entry, void *data))
+{
+	char message[64];
+
+	if (args == NULL || args->next != NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	sprintf(message, "%s - type error (expected hash table)", name);
+	struct hash_table *table = hash_table_argument(args->value, message);
+	struct s_expr *result = empty_list;
+
+	if (table == NULL)
+		return NULL;
+	hash_table_for_each(table, collect, &result);
+	return result;
+}
+
+static struct s_expr *hash_keys(struct fn_arguments *args)
+{
+	return collect_entries(args, "hash-keys", collect_key);
+}
+
+static struct s_expr *hash_values(struct fn_arguments *args)
+{
+	return collect_entries(args, "hash-values", collect_value);
+}
+
+static struct s_expr *hash_to_list(struct fn_arguments *args)
+{
+	return collect_entries(args, "hash->list", collect_pair);
+}
+
+/*
+ * Evaluates `count` arguments that must each be a list, storing them in
+ * `lists`. Returns 0 and sets the error message on failure.
+ */
+static int list_arguments(struct fn_arguments *arg, int count,
+	struct s_expr **lists, char *name)
+{
+	char message[64];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		lists[i] = eval_expression(arg->value);
+		if (lists[i] == NULL)
+			return 0;
+		if (lists[i]->type != CELL && !is_empty_list(lists[i])) {
+			sprintf(message, "%s - type error (expected list)", name);
+			set_error_message(message);
+			return 0;
+		}
+		arg = arg->next;
+	}
+	return 1;
+}
+
+/*
+ * Evaluates an argument that must be a function, or returns NULL.
+ */
+static struct s_expr *function_argument(struct s_expr *arg, char *name)
+{
+	char message[64];
+	struct s_expr *fn = eval_expression(arg);
+
+	if (fn == NULL)
+		return NULL;
+	if (!is_function(fn)) {
+		sprintf(message, "%s - type error (expected function)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	return fn;
+}
+
+/*
+ * Moves each list in `lists` one element forward, storing the elements in the
+ * first `count` nodes of `values`. Returns 0 once the shortest list has run
+ * out.
+ */
+static int next_elements(struct s_expr **lists, int count,
+	struct fn_arguments *values)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (lists[i]->type != CELL)
+			return 0;
+	}
+	for (i = 0; i < count; i++) {
+		values->value = lists[i]->value->cell->first;
+		lists[i] = lists[i]->value->cell->rest;
+		values = values->next;
+	}
+	return 1;
+}
+
+/*
+ * Allocates `count` argument nodes linked in order. map, for-each and fold
+ * fill them in again for each call instead of allocating per element.
+ */
+static struct fn_arguments *alloc_argument_nodes(int count)
+{
+	struct fn_arguments *nodes = (struct fn_arguments *) heap_alloc(
+		HEAP_ARGUMENTS, count * sizeof(struct fn_arguments));
+	int i;
+
+	for (i = 0; i < count; i++)
+		nodes[i].next = i + 1 < count ? &nodes[i + 1] : NULL;
+	return nodes;
+}
+
+/*
+ * Shared by map and for-each. Calls the function on the first elements of
+ * each list, then the second elements, and so on until the shortest list runs
+ * out. The results are collected into a list if `collect` is set.
+ */
+static struct s_expr *map_lists(struct fn_arguments *args, char *name,
+	int collect)
+{
+	char message[64];
+
+	if (args == NULL || args->next == NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	struct s_expr *fn = function_argument(args->value, name);
+	int count = 0;
+	struct fn_arguments *arg;
+
+	if (fn == NULL)
+		return NULL;
+	for (arg = args->next; arg != NULL; arg = arg->next)
+		count++;
+
+	struct s_expr **lists = (struct s_expr **)
+		malloc(count * sizeof(struct s_expr *));
+	struct fn_arguments *values = alloc_argument_nodes(count);
+	struct list_builder results;
+	struct s_expr *ret = empty_list;
+
+	list_builder_init(&results);
+	if (!list_arguments(args->next, count, lists, name)) {
+		ret = NULL;
+	} else {
+		while (next_elements(lists, count, values)) {
+			struct s_expr *result = apply_function(fn, values);
+
+			if (result == NULL) {
+				ret = NULL;
+				break;
+			}
+			if (collect)
+				list_builder_push(&results, result);
+		}
+	}
+	free(lists);
+	heap_free(HEAP_ARGUMENTS, values, count * sizeof(struct fn_arguments));
+	if (ret == NULL || !collect) {
+		return ret;
+	}
+	return list_builder_finish(&results, empty_list);
+}
+
+static struct s_expr *map(struct fn_arguments *args)
+{
+	return map_lists(args, "map", 1);
+}
+
+static struct s_expr *for_each(struct fn_arguments *args)
+{
+	return map_lists(args, "for-each", 0);
+}
+
+static struct s_expr *filter(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("filter - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *pred = function_argument(args->value, "filter");
+	struct s_expr *ls;
+	struct fn_arguments value;
+	struct list_builder results;
+
+	if (pred == NULL || !list_arguments(args->next, 1, &ls, "filter"))
+		return NULL;
+	list_builder_init(&results);
+	value.next = NULL;
+	while (next_elements(&ls, 1, &value)) {
+		struct s_expr *keep = apply_function(pred, &value);
+
+		if (keep == NULL)
+			return NULL;
+		if (!is_empty_list(keep))
+			list_builder_push(&results, value.value);
+	}
+	return list_builder_finish(&results, empty_list);
+}
+
+/*
+ * (fold kons knil list1 list2 ...) calls (kons elem1 elem2 ... acc) for each
+ * position, starting with knil as the accumulator, from left to right.
+ */
+static struct s_expr *fold(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next == NULL) {
+		set_error_message("fold - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *kons = function_argument(args->value, "fold");
+	struct s_expr *acc;
+	int count = 0;
+	struct fn_arguments *arg;
+
+	if (kons == NULL)
+		return NULL;
+	acc = eval_expression(args->next->value);
+	if (acc == NULL)
+		return NULL;
+	for (arg = args->next->next; arg != NULL; arg = arg->next)
+		count++;
+
+	struct s_expr **lists = (struct s_expr **)
+		malloc(count * sizeof(struct s_expr *));
+	// One node per list, plus the accumulator at the end.
+	struct fn_arguments *values = alloc_argument_nodes(count + 1);
+
+	if (!list_arguments(args->next->next, count, lists, "fold")) {
+		acc = NULL;
+	} else {
+		while (next_elements(lists, count, values)) {
+			values[count].value = acc;
+			acc = apply_function(kons, values);
+			if (acc == NULL)
+				break;
+		}
+	}
+	free(lists);
+	heap_free(HEAP_ARGUMENTS, values,
+		(count + 1) * sizeof(struct fn_arguments));
+	return acc;
+}
+
+/*
+ * (apply fn arg1 ... list) calls fn with arg1 ... followed by the elements of
+ * list.
+ */
+static struct s_expr *apply(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL) {
+		set_error_message("apply - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *fn = function_argument(args->value, "apply");
+	struct fn_arguments *first_value = NULL;
+	struct fn_arguments *last_value = NULL;
+	struct fn_arguments *arg;
+	struct s_expr *value;
+	struct s_expr *ret = NULL;
+
+	if (fn == NULL)
+		return NULL;
+	for (arg = args->next; arg->next != NULL; arg = arg->next) {
+		value = eval_expression(arg->value);
+		if (value == NULL)
+			goto out;
+		push_argument(&first_value, &last_value, value);
+	}
+	// The last argument is spread out into separate values.
+	value = eval_expression(arg->value);
+	if (value == NULL)
+		goto out;
+	if (!is_list(value)) {
+		set_error_message("apply - type error (expected list)");
+		goto out;
+	}
+	while (value->type == CELL) {
+		push_argument(&first_value, &last_value,
+			value->value->cell->first);
+		value = value->value->cell->rest;
+	}
+	ret = apply_function(fn, first_value);
+out:
+	free_arguments(first_value);
+	return ret;
+}
+
+// Evaluates an argument that must be a string, or returns NULL.
+static struct string *string_argument(struct s_expr *arg, char *type_error)
+{
+	struct s_expr *val = eval_expression(arg);
+
+	if (val == NULL)
+		return NULL;
+	if (val->type != STRING) {
+		set_error_message(type_error);
+		return NULL;
+	}
+	return val->value->string;
+}
+
+struct s_expr *is_string(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("string? - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *val = eval_expression(args->value);
+
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == STRING);
+}
+
+struct s_expr *string_length(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("string-length - arity mismatch");
+		return NULL;
+	}
+	struct string *string = string_argument(args->value,
+		"string-length - type error (expected string)");
+
+	if (string == NULL)
+		return NULL;
+	return s_expr_from_integer(string->length);
+}
+
+static struct s_expr *string_append(struct fn_arguments *args)
+{
+	struct string_builder *builder = string_builder_create();
+	struct fn_arguments *arg;
+	struct s_expr *result = NULL;
+
+	for (arg = args; arg != NULL; arg = arg->next) {
+		struct string *string = string_argument(arg->value,
+			"string-append - type error (expected string)");
+
+		if (string == NULL)
+			goto out;
+		string_builder_append(builder, string->chars, string->length);
+	}
+	result = string_builder_to_string(builder);
+out:
+	string_builder_free(builder);
+	return result;
+}
+
+static struct s_expr *substring(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL
+	|| (args->next->next != NULL && args->next->next->next != NULL)) {
+		set_error_message("substring - arity mismatch");
+		return NULL;
+	}
+	struct string *string = string_argument(args->value,
+		"substring - type error (expected string)");
+
+	if (string == NULL)
+		return NULL;
+	struct s_expr *start = eval_expression(args->next->value);
+	struct s_expr *end = args->next->next == NULL
+		? s_expr_from_integer(string->length)
+		: eval_expression(args->next->next->value);
+
+	if (start == NULL || end == NULL)
+		return NULL;
+	if (start->type != INTEGER || end->type != INTEGER) {
+		set_error_message("substring - type error (expected integer)");
+		return NULL;
+	}
+	if (start->value->integer < 0
+	|| start->value->integer > end->value->integer
+	|| end->value->integer > string->length) {
+		set_error_message("substring - index error (out of range)");
+		return NULL;
+	}
+	return s_expr_from_string(string->chars + start->value->integer,
+		end->value->integer - start->value->integer);
+}
+
+static struct s_expr *string_to_symbol(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("string->symbol - arity mismatch");
+		return NULL;
+	}
+	struct string *string = string_argument(args->value,
+		"string->symbol - type error (expected string)");
+
+	if (string == NULL)
+		return NULL;
+	if (memchr(string->chars, '\0', string->length) != NULL) {
+		set_error_message(
+			"string->symbol - value error (string contains \\x0;)");
+		return NULL;
+	}
+	return s_expr_from_symbol(string->chars);
+}
+
+static struct s_expr *symbol_to_string(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("symbol->string - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *symbol = eval_expression(args->value);
+
+	if (symbol == NULL)
+		return NULL;
+	if (symbol->type != SYMBOL) {
+		set_error_message(
+			"symbol->string - type error (expected symbol)");
+		return NULL;
+	}
+	return s_expr_from_string(symbol->value->symbol,
+		strlen(symbol->value->symbol));
+}
+
+static struct s_expr *number_to_string(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("number->string - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *number = eval_expression(args->value);
+	char digits[16];
+
+	if (number == NULL)
+		return NULL;
+	if (number->type != INTEGER) {
+		set_error_message(
+			"number->string - type error (expected integer)");
+		return NULL;
+	}
+	sprintf(digits, "%d", number->value->integer);
+	return s_expr_from_string(digits, strlen(digits));
+}
+
+static struct s_expr *value_to_string(struct fn_arguments *args, int display,
+	char *name)
+{
+	char message[64];
+
+	if (args == NULL || args->next != NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	struct s_expr *value = eval_expression(args->value);
+	struct printer printer;
+	struct s_expr *result;
+	size_t length;
+	char *chars;
+
+	if (value == NULL)
+		return NULL;
+	printer_to_string(&printer);
+	printer.display = display;
+	printer_write(&printer, value);
+	chars = printer_string(&printer, &length);
+	result = s_expr_from_string(chars, length);
+	printer_free(&printer);
+	return result;
+}
+
+// (write->string value) returns what (write value) would write.
+static struct s_expr *write_to_string(struct fn_arguments *args)
+{
+	return value_to_string(args, 0, "write->string");
+}
+
+// (display->string value) returns what (display value) would write.
+static struct s_expr *display_to_string(struct fn_arguments *args)
+{
+	return value_to_string(args, 1, "display->string");
+}
+
+static struct s_expr *string_to_number(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("string->number - arity mismatch");
+		return NULL;
+	}
+	struct string *string = string_argument(args->value,
+		"string->number - type error (expected string)");
+	char *end;
+
+	if (string == NULL)
+		return NULL;
+	int integer = strtol(string->chars, &end, 10);
+
+	// Like the reader, only accept strings that are entirely an integer.
+	if (string->length == 0 || end != string->chars + string->length)
+		return s_expr_from_boolean(0);
+	return s_expr_from_integer(integer);
+}
+
+static struct s_expr *make_string_builder(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("make-string-builder - arity mismatch");
+		return NULL;
+	}
+	return s_expr_from_string_builder(string_builder_create());
+}
+
+// Evaluates an argument that must be a string builder, or returns NULL.
+static struct string_builder *string_builder_argument(struct s_expr *arg,
+	char *type_error)
+{
+	struct s_expr *val = eval_expression(arg);
+
+	if (val == NULL)
+		return NULL;
+	if (val->type != STRING_BUILDER) {
+		set_error_message(type_error);
+		return NULL;
+	}
+	return val->value->builder;
+}
+
+static struct s_expr *string_builder_append_(struct fn_arguments *args)
+{
+	if (args == NULL) {
+		set_error_message("string-builder-append! - arity mismatch");
+		return NULL;
+	}
+	struct string_builder *builder = string_builder_argument(args->value,
+		"string-builder-append! - type error (expected string builder)");
+	struct fn_arguments *arg;
+
+	if (builder == NULL)
+		return NULL;
+	for (arg = args->next; arg != NULL; arg = arg->next) {
+		struct string *string = string_argument(arg->value,
+			"string-builder-append! - type error (expected string)");
+
+		if (string == NULL)
+			return NULL;
+		string_builder_append(builder, string->chars, string->length);
+	}
+	return empty_list;
+}
+
+static struct s_expr *string_builder_to_string_(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("string-builder->string - arity mismatch");
+		return NULL;
+	}
+	struct string_builder *builder = string_builder_argument(args->value,
+		"string-builder->string - type error (expected string builder)");
+
+	if (builder == NULL)
+		return NULL;
+	return string_builder_to_string(builder);
+}
+
+struct s_expr *cond(struct fn_arguments *args)
+{
+	if (args == NULL) {
+		// TODO return #<void>
+		return empty_list;
+	}
+
+	while (args != NULL) {
+		struct s_expr *clause = args->value;
+
+		if (!is_list(clause)) {
+			set_error_message("cond - type error (expected list)");
+			return NULL;
+		}
+		if (list_length(clause) < 2) {
+			set_error_message(
+				"cond - value error (expected at least two elements in clause)"
+			);
+			return NULL;
+		}
+		struct s_expr *test = clause->value->cell->first;
+		int else_clause = test->type == SYMBOL
+			&& !strcmp(test->value->symbol, "else");
+
+		if (!else_clause) {
+			test = eval_expression(test);
+			if (test == NULL) return NULL;
+		}
+		// Pass as long as `test` is not #f or '().
+		int test_passed = !is_empty_list(test);
+		struct s_expr *then_bodies = clause->value->cell->rest;
+
+		if (test_passed || else_clause) {
+			if (else_clause && args->next != NULL) {
+				set_error_message(
+					"cond - syntax error (else must be the last clause)");
+				return NULL;
+			}
+			// Evaluate then bodies in order and return the result
+			// of the last one.
+			while (!is_empty_list(then_bodies)) {
+				struct s_expr *result = eval_expression(
+					then_bodies->value->cell->first);
+				struct s_expr *rest =
+					then_bodies->value->cell->rest;
+
+				if (result == NULL) return NULL;
+				if (is_empty_list(rest))
+					return result;
+				then_bodies = rest;
+			}
+			// Since there are at least two elements, this comment
+			// will never be reached.
+		}
+		args = args->next;
+	}
+	// TODO return #<void>
+	return empty_list;
+}
+
+// Makes a lambda of `body`, which was folded from `source` unless it is NULL.
+struct s_expr *new_lambda(struct s_expr *arg_names,
+	struct s_expr *body, struct s_expr *source)
+{
+	if (!is_list(arg_names)) {
+		set_error_message("lambda - type error (arguments must be a list)");
+		return NULL;
+	}
+	int arg_count = list_length(arg_names);
+	char **arg_list = (char **) heap_alloc(HEAP_LAMBDA,
+		arg_count * (sizeof(char *)));
+	struct s_expr *tmp = arg_names;
+	int i = 0;
+
+	while (!is_empty_list(tmp)) {
+		struct s_expr *arg = tmp->value->cell->first;
+
+		if (arg->type != SYMBOL) {
+			set_error_message(
+				"lambda - type error (each argument must be a symbol)");
+			return NULL;
+		}
+		arg_list[i] = (char *) heap_alloc(HEAP_LAMBDA,
+			(strlen(arg->value->symbol)+1) * sizeof(char));
+		strcpy(arg_list[i], arg->value->symbol);
+		tmp = tmp->value->cell->rest;
+		i++;
+	}
+	struct lambda *lmb = (struct lambda *)
+		heap_alloc(HEAP_LAMBDA, sizeof(struct lambda));
+
+	lmb->name = (char *) heap_alloc(HEAP_LAMBDA,
+		(strlen("anonymous")+1) * sizeof(char));
+	strcpy(lmb->name, "anonymous");
+	lmb->args = arg_list;
+	lmb->arg_count = arg_count;
+	lmb->body = body;
+	lmb->source = source;
+	lmb->memo = NULL;
+	return s_expr_from_lambda(lmb);
+}
+
+struct s_expr *lambda_(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL
+	|| args->next->next != NULL) {
+		set_error_message("lambda - arity mismatch");
+		return NULL;
+	}
+	// Don't evaluate the body.
+	return new_lambda(args->value, args->next->value, NULL);
+}
+
+// Binds the name in `signature`, (name args ...), to a lambda of `body`, which
+// was folded from `source` unless it is NULL.
+struct s_expr *define_function(struct s_expr *signature,
+	struct s_expr *body, struct s_expr *source)
+{
+	struct s_expr *id = signature->value->cell->first;
+	if (id->type != SYMBOL) {
+		set_error_message("define - type error (expected symbol)");
+		return NULL;
+	}
+	struct s_expr *curr_arg = signature->value->cell->rest;
+	int arg_count = list_length(curr_arg);
+	char **arg_list = (char **) heap_alloc(HEAP_LAMBDA,
+		arg_count * sizeof(char *));
+	int i = 0;
+
+	while (!is_empty_list(curr_arg)) {
+		struct s_expr *tmp = curr_arg->value->cell->first;
+
+		if (tmp->type != SYMBOL) {
+			set_error_message("define - type error (expected symbol)");
+			return NULL;
+		}
+		arg_list[i] = (char *) heap_alloc(HEAP_LAMBDA,
+			(strlen(tmp->value->symbol)+1) * sizeof(char));
+		strcpy(arg_list[i], tmp->value->symbol);
+		curr_arg = curr_arg->value->cell->rest;
+		i++;
+	}
+	struct lambda *lmb = (struct lambda *)
+		heap_alloc(HEAP_LAMBDA, sizeof(struct lambda));
+
+	lmb->name = (char *) heap_alloc(HEAP_LAMBDA,
+		(strlen(id->value->symbol)+1) * sizeof(char));
+	strcpy(lmb->name, id->value->symbol);
+	lmb->args = arg_list;
+	lmb->arg_count = arg_count;
+	lmb->body = body;
+	lmb->source = source;
+	lmb->memo = NULL;
+	note_binding(id);
+	set_env(
+		id->value->symbol,
+		s_expr_from_lambda(lmb));
+	return id;
+}
+
+struct s_expr *define_(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL
+	|| args->next->next != NULL) {
+		set_error_message("define - arity mismatch");
+		return NULL;
+	}
+
+	if (args->value->type == SYMBOL) {
+		struct s_expr *id = args->value;
+		struct s_expr *value = eval_expression(args->next->value);
+
+		if (value == NULL) return NULL;
+		note_binding(id);
+		set_env(id->value->symbol, value);
+		return id;
+	}
+
+	if (is_list(args->value))
+		return define_function(args->value, args->next->value, NULL);
+
+	set_error_message("define - type error (expecting symbol or list)");
+	return NULL;
+}
+
+/*
+ * (define-memoized (name args ...) body) is define for a function whose
+ * results are cached. Recursive calls go through the cache as well, since
+ * they look up `name`.
+ */
+struct s_expr *define_memoized(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL
+	|| args->next->next != NULL) {
+		set_error_message("define-memoized - arity mismatch");
+		return NULL;
+	}
+	if (args->value->type != CELL) {
+		set_error_message(
+			"define-memoized - type error (expected list)");
+		return NULL;
+	}
+	struct s_expr *id = define_(args);
+
+	if (id == NULL)
+		return NULL;
+	get_env(id->value->symbol)->value->lambda->memo =
+		memo_cache_create(MEMO_DEFAULT_CAPACITY);
+	return id;
+}
+
+// Evaluates an argument that must be a memoized lambda, or returns NULL.
+static struct memo_cache *memo_argument(struct s_expr *arg, char *type_error)
+{
+	struct s_expr *val = eval_expression(arg);
+
+	if (val == NULL)
+		return NULL;
+	if (val->type != LAMBDA || val->value->lambda->memo == NULL) {
+		set_error_message(type_error);
+		return NULL;
+	}
+	return val->value->lambda->memo;
+}
+
+/*
+ * (memoize fn [capacity]) returns a memoized copy of the lambda fn, which
+ * keeps at most capacity results.
+ */
+static struct s_expr *memoize(struct fn_arguments *args)
+{
+	int capacity = MEMO_DEFAULT_CAPACITY;
+
+	if (args == NULL
+	|| (args->next != NULL && args->next->next != NULL)) {
+		set_error_message("memoize - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *fn = eval_expression(args->value);
+
+	if (fn == NULL)
+		return NULL;
+	if (fn->type != LAMBDA) {
+		set_error_message("memoize - type error (expected lambda)");
+		return NULL;
+	}
+	if (args->next != NULL) {
+		struct s_expr *size = eval_expression(args->next->value);
+
+		if (size == NULL)
+			return NULL;
+		if (size->type != INTEGER || size->value->integer < 1) {
+			set_error_message(
+				"memoize - type error (expected positive integer)");
+			return NULL;
+		}
+		capacity = size->value->integer;
+	}
+	struct lambda *lmb = (struct lambda *)
+		heap_alloc(HEAP_LAMBDA, sizeof(struct lambda));
+
+	*lmb = *fn->value->lambda;
+	lmb->memo = memo_cache_create(capacity);
+	return s_expr_from_lambda(lmb);
+}
+
+static struct s_expr *stat_pair(char *name, long value)
+{
+	return cons_onto(s_expr_from_symbol(name),
+		cons_onto(s_expr_from_integer(value), empty_list));
+}
+
+// Returns the counters of a memoized lambda as an association list.
+static struct s_expr *memo_stats(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("memo-stats - arity mismatch");
+		return NULL;
+	}
+	struct memo_cache *cache = memo_argument(args->value,
+		"memo-stats - type error (expected memoized lambda)");
+	struct list_builder stats;
+
+	if (cache == NULL)
+		return NULL;
+	list_builder_init(&stats);
+	list_builder_push(&stats, stat_pair("hits", cache->hits));
+	list_builder_push(&stats, stat_pair("misses", cache->misses));
+	list_builder_push(&stats, stat_pair("evictions", cache->evictions));
+	list_builder_push(&stats, stat_pair("size", cache->size));
+	list_builder_push(&stats, stat_pair("capacity", cache->capacity));
+	return list_builder_finish(&stats, empty_list);
+}
+
+static struct s_expr *memo_clear(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("memo-clear! - arity mismatch");
+		return NULL;
+	}
+	struct memo_cache *cache = memo_argument(args->value,
+		"memo-clear! - type error (expected memoized lambda)");
+
+	if (cache == NULL)
+		return NULL;
+	memo_cache_clear(cache);
+	return empty_list;
+}
+
+static struct s_expr *profile_start_(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("profile-start - arity mismatch");
+		return NULL;
+	}
+	profile_start();
+	return empty_list;
+}
+
+static struct s_expr *profile_stop_(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("profile-stop - arity mismatch");
+		return NULL;
+	}
+	profile_stop();
+	return empty_list;
+}
+
+static struct s_expr *profile_report_(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("profile-report - arity mismatch");
+		return NULL;
+	}
+	profile_report(stdout);
+	return empty_list;
+}
+
+// (profile-dump-folded "file") writes folded stacks for flamegraph tools.
+static struct s_expr *profile_dump_folded(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("profile-dump-folded - arity mismatch");
+		return NULL;
+	}
+	struct string *path = string_argument(args->value,
+		"profile-dump-folded - type error (expected string)");
+	FILE *out;
+
+	if (path == NULL)
+		return NULL;
+	out = fopen(path->chars, "w");
+	if (out == NULL) {
+		set_error_message(
+			"profile-dump-folded - io error (cannot open file)");
+		return NULL;
+	}
+	profile_write_folded(out);
+	fclose(out);
+	return empty_list;
+}
+
+/*
+ * Returns the heap counters as an association list from each kind of object
+ * to an association list of its counters, followed by an entry for the total.
+ */
+static struct s_expr *heap_stats(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("heap-stats - arity mismatch");
+		return NULL;
+	}
+	// Take a snapshot first, since building the result allocates.
+	struct heap_census census[HEAP_KINDS];
+	long long peak = interp->heap_peak_live_bytes;
+	struct heap_census total;
+	struct list_builder stats;
+	int kind;
+
+	memcpy(census, interp->heap_census, sizeof(census));
+	memset(&total, 0, sizeof(total));
+	list_builder_init(&stats);
+	for (kind = 0; kind < HEAP_KINDS; kind++) {
+		struct list_builder counters;
+
+		list_builder_init(&counters);
+		list_builder_push(&counters,
+			stat_pair("allocations", census[kind].allocations));
+		list_builder_push(&counters,
+			stat_pair("bytes", census[kind].bytes));
+		list_builder_push(&counters, stat_pair("live",
+			census[kind].allocations - census[kind].frees));
+		list_builder_push(&counters,
+			stat_pair("live-bytes", census[kind].live_bytes));
+		list_builder_push(&stats, cons_onto(
+			s_expr_from_symbol(heap_kind_name(kind)),
+			cons_onto(list_builder_finish(&counters, empty_list),
+			empty_list)));
+		total.allocations += census[kind].allocations;
+		total.frees += census[kind].frees;
+		total.bytes += census[kind].bytes;
+		total.live_bytes += census[kind].live_bytes;
+	}
+
+	struct list_builder counters;
+
+	list_builder_init(&counters);
+	list_builder_push(&counters,
+		stat_pair("allocations", total.allocations));
+	list_builder_push(&counters, stat_pair("bytes", total.bytes));
+	list_builder_push(&counters,
+		stat_pair("live", total.allocations - total.frees));
+	list_builder_push(&counters, stat_pair("live-bytes", total.live_bytes));
+	list_builder_push(&counters, stat_pair("peak-live-bytes", peak));
+	list_builder_push(&stats, cons_onto(s_expr_from_symbol("total"),
+		cons_onto(list_builder_finish(&counters, empty_list),
+		empty_list)));
+	return list_builder_finish(&stats, empty_list);
+}
+
+static struct s_expr *load_data(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("load-data - arity mismatch");
+		return NULL;
+	}
+	struct string *path = string_argument(args->value,
+		"load-data - type error (expected string)");
+
+	if (path == NULL)
+		return NULL;
+	return data_load(path->chars);
+}
+
+static struct s_expr *unload_data(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("unload-data - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *data = eval_expression(args->value);
+
+	if (data == NULL || !data_unload(data))
+		return NULL;
+	return empty_list;
+}
+
+/*
+ * future - A call to a thunk running on the thread pool
+ *
+ * The thunk runs in its own interpreter, forked from the one that created the
+ * future. `value` and `error` are written by the task before it is marked
+ * done; `joined` makes sure only one touch merges the forked interpreter back.
+ */
+struct future {
+	struct task task;
+	struct interpreter *worker;
+	struct s_expr *thunk;
+	struct s_expr *value;
+	char *error;
+	int joined;
+};
+
+static void run_future(void *data)
+{
+	struct future *future = (struct future *) data;
+
+	future->value = interpreter_call(future->worker, future->thunk, NULL);
+	if (future->value == NULL)
+		future->error = strdup(future->worker->last_error_message);
+}
+
+// (future thunk) starts calling thunk with no arguments on the thread pool.
+static struct s_expr *future(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("future - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *thunk = function_argument(args->value, "future");
+	struct future *future;
+
+	if (thunk == NULL)
+		return NULL;
+	future = (struct future *) calloc(1, sizeof(struct future));
+	future->thunk = thunk;
+	future->task.run = run_future;
+	future->task.data = future;
+	if (pool_threads() == 1) {
+		// Nothing could run it in parallel, so run it now.
+		future->value = apply_function(thunk, NULL);
+		if (future->value == NULL)
+			future->error = strdup(interp->last_error_message);
+		future->joined = 1;
+		future->task.done = 1;
+	} else {
+		future->worker = interpreter_fork();
+		pool_submit(&future->task);
+	}
+	return s_expr_from_future(future);
+}
+
+/*
+ * (touch value) waits for a future and returns its value, or the error it
+ * failed with. Any other value is returned as is.
+ */
+static struct s_expr *touch(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("touch - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *value = eval_expression(args->value);
+	struct future *future;
+
+	if (value == NULL || value->type != FUTURE)
+		return value;
+	future = value->value->future;
+	pool_wait(&future->task);
+	if (!__atomic_exchange_n(&future->joined, 1, __ATOMIC_ACQ_REL))
+		interpreter_join(future->worker);
+	if (future->value == NULL)
+		set_error_message(future->error);
+	return future->value;
+}
+
+/*
+ * pmap_chunk - A run of consecutive elements mapped by one task
+ *
+ * The elements in `items` are replaced by their results. On failure,
+ * `error` holds the message and the remaining items are left alone.
+ */
+struct pmap_chunk {
+	struct task task;
+	struct interpreter *worker;
+	struct s_expr *fn;
+	struct s_expr **items;
+	int count;
+	char *error;
+};
+
+static void run_pmap_chunk(void *data)
+{
+	struct pmap_chunk *chunk = (struct pmap_chunk *) data;
+	struct fn_arguments value;
+	int i;
+
+	value.next = NULL;
+	for (i = 0; i < chunk->count; i++) {
+		value.value = chunk->items[i];
+		chunk->items[i] = chunk->worker != NULL
+			? interpreter_call(chunk->worker, chunk->fn, &value)
+			: apply_function(chunk->fn, &value);
+		if (chunk->items[i] == NULL) {
+			chunk->error = strdup(chunk->worker != NULL
+				? chunk->worker->last_error_message
+				: interp->last_error_message);
+			break;
+		}
+	}
+}
+
+/*
+ * (pmap fn list) is (map fn list), with the calls spread over the thread
+ * pool. The calls may share hash tables, string builders, memoized lambdas
+ * and promises, which lock themselves, but their defines stay on their own
+ * thread. Lists shorter than twice PMAP_GRAIN are mapped on this thread, since
+ * starting tasks would cost more than it saves.
+ */
+static struct s_expr *pmap(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("pmap - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *fn = function_argument(args->value, "pmap");
+	struct s_expr *ls;
+	struct s_expr **items;
+	struct pmap_chunk *chunks;
+	struct list_builder results;
+	int count, chunk_size, chunk_count, i;
+	char *error = NULL;
+
+	if (fn == NULL || !list_arguments(args->next, 1, &ls, "pmap"))
+		return NULL;
+	count = list_length(ls);
+	items = (struct s_expr **) malloc(count * sizeof(struct s_expr *));
+	for (i = 0; i < count; i++) {
+		items[i] = ls->value->cell->first;
+		ls = ls->value->cell->rest;
+	}
+
+	// Make a few chunks per thread, so that uneven chunks even out.
+	chunk_size = count / (4 * pool_threads());
+	if (chunk_size < PMAP_GRAIN)
+		chunk_size = PMAP_GRAIN;
+	if (count < 2 * PMAP_GRAIN || pool_threads() == 1)
+		chunk_size = count;
+	chunk_count = count == 0 ? 0 : (count + chunk_size - 1) / chunk_size;
+	chunks = (struct pmap_chunk *)
+		calloc(chunk_count, sizeof(struct pmap_chunk));
+	for (i = 0; i < chunk_count; i++) {
+		chunks[i].task.run = run_pmap_chunk;
+		chunks[i].task.data = &chunks[i];
+		chunks[i].fn = fn;
+		chunks[i].items = items + i * chunk_size;
+		chunks[i].count = i + 1 < chunk_count
+			? chunk_size : count - i * chunk_size;
+	}
+	// This thread takes the first chunk itself, in this interpreter.
+	for (i = 1; i < chunk_count; i++) {
+		chunks[i].worker = interpreter_fork();
+		pool_submit(&chunks[i].task);
+	}
+	if (chunk_count > 0)
+		run_pmap_chunk(&chunks[0]);
+	for (i = 0; i < chunk_count; i++) {
+		if (i > 0) {
+			pool_wait(&chunks[i].task);
+			interpreter_join(chunks[i].worker);
+		}
+		if (error == NULL)
+			error = chunks[i].error;
+		else
+			free(chunks[i].error);
+	}
+
+	list_builder_init(&results);
+	for (i = 0; error == NULL && i < count; i++)
+		list_builder_push(&results, items[i]);
+	free(items);
+	free(chunks);
+	if (error != NULL) {
+		set_error_message(error);
+		free(error);
+		return NULL;
+	}
+	return list_builder_finish(&results, empty_list);
+}
+
+// ACTORS
+
+static struct s_expr *copy_value(struct s_expr *value,
+	struct hash_table **seen);
+
+struct table_copy {
+	struct hash_table *table;
+	struct hash_table **seen;
+	int failed;
+};
+
+static void copy_entry(struct hash_entry *entry, void *data)
+{
+	struct table_copy *copy = (struct table_copy *) data;
+	struct s_expr *key, *value;
+
+	if (copy->failed)
+		return;
+	key = copy_value(entry->key, copy->seen);
+	value = key != NULL ? copy_value(entry->value, copy->seen) : NULL;
+	if (value == NULL)
+		copy->failed = 1;
+	else
+		hash_table_set(copy->table, key, value);
+}
+
+/*
+ * Copies a hash table once, even if it is reachable several times or from
+ * itself. `seen` maps tables already copied to their copies.
+ */
+static struct s_expr *copy_table(struct s_expr *value,
+	struct hash_table **seen)
+{
+	struct table_copy copy;
+	struct s_expr *result;
+
+	if (*seen == NULL)
+		*seen = hash_table_create(HASH_EQ);
+	result = hash_table_get(*seen, value);
+	if (result != NULL)
+		return result;
+	copy.table = hash_table_create(value->value->table->kind);
+	copy.seen = seen;
+	copy.failed = 0;
+	result = s_expr_from_hash_table(copy.table);
+	hash_table_set(*seen, value, result);
+	hash_table_for_each(value->value->table, copy_entry, &copy);
+	return copy.failed ? NULL : result;
+}
+
+static char *copy_chars(char *chars)
+{
+	char *copy = (char *) heap_alloc(HEAP_SYMBOL,
+		(strlen(chars)+1) * sizeof(char));
+
+	strcpy(copy, chars);
+	return copy;
+}
+
+static struct s_expr *copy_lambda(struct lambda *lmb,
+	struct hash_table **seen)
+{
+	struct lambda *copy = (struct lambda *)
+		heap_alloc(HEAP_LAMBDA, sizeof(struct lambda));
+	int i;
+
+	copy->name = copy_chars(lmb->name);
+	copy->args = (char **) heap_alloc(HEAP_LAMBDA,
+		lmb->arg_count * sizeof(char *));
+	for (i = 0; i < lmb->arg_count; i++)
+		copy->args[i] = copy_chars(lmb->args[i]);
+	copy->arg_count = lmb->arg_count;
+	copy->body = copy_value(lmb->body, seen);
+	copy->source = lmb->source != NULL
+		? copy_value(lmb->source, seen) : NULL;
+	// The copy gets its own, empty cache.
+	copy->memo = lmb->memo != NULL
+		? memo_cache_create(lmb->memo->capacity) : NULL;
+	return copy->body != NULL ? s_expr_from_lambda(copy) : NULL;
+}
+
+static struct s_expr *copy_macro(struct macro *macro,
+	struct hash_table **seen)
+{
+	struct macro *copy = (struct macro *)
+		heap_alloc(HEAP_LAMBDA, sizeof(struct macro));
+
+	copy->name = copy_chars(macro->name);
+	copy->literals = copy_value(macro->literals, seen);
+	copy->rules = copy->literals != NULL
+		? copy_value(macro->rules, seen) : NULL;
+	return copy->rules != NULL ? s_expr_from_macro(copy) : NULL;
+}
+
+/*
+ * Deep-copies `value` into objects of the current interpreter, so that the
+ * copy shares nothing mutable with the original. Builtins are shared, since
+ * they never change, and so are actors, whose mailboxes are made to be
+ * shared. Futures cannot be copied: they belong to the interpreter that
+ * touches them. Returns NULL and sets the error message on failure.
+ */
+static struct s_expr *copy_value(struct s_expr *value,
+	struct hash_table **seen)
+{
+	struct list_builder copy;
+
+	switch (value->type) {
+	case BOOLEAN:
+		return s_expr_from_boolean(value->value->boolean);
+	case INTEGER:
+		return s_expr_from_integer(value->value->integer);
+	case SYMBOL:
+		return s_expr_from_symbol(value->value->symbol);
+	case STRING:
+		return s_expr_from_string(value->value->string->chars,
+			value->value->string->length);
+	case LAMBDA:
+		return copy_lambda(value->value->lambda, seen);
+	case MACRO:
+		return copy_macro(value->value->macro, seen);
+	case HASH_TABLE:
+		return copy_table(value, seen);
+	case STRING_BUILDER: {
+		struct string_builder *builder = string_builder_create();
+		struct string *contents = string_builder_to_string(
+			value->value->builder)->value->string;
+
+		string_builder_append(builder, contents->chars,
+			contents->length);
+		return s_expr_from_string_builder(builder);
+	}
+	case FUTURE:
+		set_error_message("send - type error (cannot send a future)");
+		return NULL;
+	case GENERATOR:
+		set_error_message(
+			"send - type error (cannot send a generator)");
+		return NULL;
+	case PROMISE:
+		set_error_message("send - type error (cannot send a promise)");
+		return NULL;
+	case PORT:
+		set_error_message("send - type error (cannot send a port)");
+		return NULL;
+	case ACTOR:
+		return s_expr_from_actor(value->value->mailbox);
+	case CELL:
+		break;
+	default:
+		// builtins and the empty list
+		return value;
+	}
+
+	// Walk down the rest of the list iteratively, like equal.
+	list_builder_init(&copy);
+	while (value->type == CELL) {
+		struct s_expr *first = copy_value(value->value->cell->first,
+			seen);
+
+		if (first == NULL)
+			return NULL;
+		list_builder_push(&copy, first);
+		value = value->value->cell->rest;
+	}
+	value = copy_value(value, seen);
+	return value != NULL ? list_builder_finish(&copy, value) : NULL;
+}
+
+struct s_expr *eval_copy(struct s_expr *value)
+{
+	struct hash_table *seen = NULL;
+	struct s_expr *copy = copy_value(value, &seen);
+
+	if (seen != NULL)
+		hash_table_free(seen);
+	return copy;
+}
+
+static struct mailbox *own_mailbox(void)
+{
+	if (interp->mailbox == NULL)
+		interp->mailbox = mailbox_create();
+	return interp->mailbox;
+}
+
+struct actor_start {
+	struct interpreter *in;
+	struct s_expr *thunk;
+};
+
+static void *run_actor(void *data)
+{
+	struct actor_start *start = (struct actor_start *) data;
+
+	if (interpreter_call(start->in, start->thunk, NULL) == NULL)
+		fprintf(stderr, "actor: %s\n", start->in->last_error_message);
+	interpreter_destroy(start->in);
+	free(start);
+	return NULL;
+}
+
+/*
+ * Gives the new interpreter a copy of a binding of the spawning one. Builtins
+ * bound under their own name are already there.
+ */
+static void copy_binding(char *id, struct s_expr *value, void *data)
+{
+	struct interpreter *child = (struct interpreter *) data;
+	struct s_expr *copy;
+
+	if (value->type == BUILTIN && !strcmp(value->value->builtin->name, id))
+		return;
+	copy = interpreter_copy(child, value);
+	// Bindings that cannot be copied, like futures, are left out.
+	if (copy != NULL)
+		interpreter_define(child, id, copy);
+}
+
+/*
+ * (spawn thunk) starts a new interpreter on its own thread, with a copy of
+ * the current bindings, and calls thunk there. It returns the new actor,
+ * which receives the messages sent to it with (receive).
+ */
+static struct s_expr *spawn(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("spawn - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *thunk = function_argument(args->value, "spawn");
+	struct actor_start *start;
+	pthread_attr_t attributes;
+	pthread_t thread;
+
+	if (thunk == NULL)
+		return NULL;
+	start = (struct actor_start *) malloc(sizeof(struct actor_start));
+	start->in = interpreter_create();
+	start->in->engine = interp->engine;
+	start->in->jit_threshold = interp->jit_threshold;
+	start->in->macros = interp->macros;
+	start->in->unfolded = interp->unfolded;
+	start->in->mailbox = mailbox_create();
+	env_for_each(copy_binding, start->in);
+	start->thunk = interpreter_copy(start->in, thunk);
+	if (start->thunk == NULL) {
+		set_error_message("spawn - type error (cannot copy function)");
+		interpreter_destroy(start->in);
+		free(start);
+		return NULL;
+	}
+
+	struct s_expr *actor = s_expr_from_actor(start->in->mailbox);
+
+	pthread_attr_init(&attributes);
+	pthread_attr_setstacksize(&attributes, ACTOR_STACK_SIZE);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attributes, run_actor, start)) {
+		set_error_message("spawn - cannot start a thread");
+		interpreter_destroy(start->in);
+		free(start);
+		actor = NULL;
+	}
+	pthread_attr_destroy(&attributes);
+	return actor;
+}
+
+// (send actor value) puts a copy of value in the mailbox of actor.
+static struct s_expr *send(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("send - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *actor = eval_expression(args->value);
+	struct s_expr *value, *copy;
+
+	if (actor == NULL)
+		return NULL;
+	if (actor->type != ACTOR) {
+		set_error_message("send - type error (expected actor)");
+		return NULL;
+	}
+	value = eval_expression(args->next->value);
+	if (value == NULL)
+		return NULL;
+	copy = eval_copy(value);
+	if (copy == NULL)
+		return NULL;
+	mailbox_send(actor->value->mailbox, copy);
+	return value;
+}
+
+// (receive) waits for the next message to this interpreter.
+static struct s_expr *receive(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("receive - arity mismatch");
+		return NULL;
+	}
+	return mailbox_receive(own_mailbox());
+}
+
+// (self) returns this interpreter's actor, for replies.
+static struct s_expr *self(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("self - arity mismatch");
+		return NULL;
+	}
+	return s_expr_from_actor(own_mailbox());
+}
+
+static struct s_expr *is_actor(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("actor? - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *val = eval_expression(args->value);
+
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == ACTOR);
+}
+
+// GENERATORS
+
+/*
+ * generator - A producer of values that runs as a coroutine
+ *
+ * `body` runs on the generator's own control stack, with its own stack of
+ * environment states, and hands out values with generator_yield(). A value
+ * that has been produced but not taken yet is kept in `value`. `fn` and
+ * `source` are whatever the body works on: the thunk of make-generator, or
+ * the function and list or generator of the other constructors.
+ */
+struct generator {
+	struct coroutine *coroutine;
+	// the interpreter that made it, which is the only one that may run it
+	struct interpreter *owner;
+	// the generator's environment states while it is suspended, or NULL
+	// until it starts
+	struct env_state *env;
+	void (*body)(struct generator *generator);
+	struct s_expr *fn;
+	struct s_expr *source;
+	struct s_expr *value;
+	int has_value;
+	int running;
+	int done;
+	// the message the body failed with, or NULL
+	char *error;
+};
+
+static void run_generator(void *data)
+{
+	struct generator *generator = (struct generator *) data;
+
+	generator->body(generator);
+}
+
+static struct s_expr *new_generator(void (*body)(struct generator *),
+	struct s_expr *fn, struct s_expr *source)
+{
+	struct generator *generator = (struct generator *)
+		calloc(1, sizeof(struct generator));
+
+	generator->owner = interp;
+	generator->body = body;
+	generator->fn = fn;
+	generator->source = source;
+	generator->coroutine = coroutine_create(run_generator, generator,
+		GENERATOR_STACK_SIZE);
+	return s_expr_from_generator(generator);
+}
+
+// Called by a body to hand out `value` and wait until it is taken.
+static void generator_yield(struct generator *generator, struct s_expr *value)
+{
+	generator->value = value;
+	generator->has_value = 1;
+	coroutine_yield();
+}
+
+static void generator_fail(struct generator *generator)
+{
+	generator->error = strdup(interp->last_error_message);
+}
+
+/*
+ * Runs `generator` until it has a value ready or its body has returned.
+ * Returns 0 and sets the error message if the body failed.
+ */
+static int generator_fill(struct generator *generator)
+{
+	struct generator *prev_generator;
+	struct env_state *prev_env;
+
+	if (generator->has_value)
+		return 1;
+	if (generator->done && generator->error != NULL) {
+		set_error_message(generator->error);
+		return 0;
+	}
+	if (generator->done)
+		return 1;
+	if (generator->owner != interp) {
+		set_error_message(
+			"generator - type error (made by another interpreter)");
+		return 0;
+	}
+	if (generator->running) {
+		set_error_message(
+			"generator - value error (generator is running)");
+		return 0;
+	}
+
+	if (generator->env == NULL) {
+		// The body starts with the bindings of whoever asks for its
+		// first value, as a call would.
+		prev_env = switch_environment(NULL);
+		start_environment_copy(prev_env);
+		generator->env = switch_environment(prev_env);
+	}
+	prev_env = switch_environment(generator->env);
+	prev_generator = interp->generator;
+	interp->generator = generator;
+	generator->running = 1;
+	generator->done = coroutine_resume(generator->coroutine);
+	generator->running = 0;
+	interp->generator = prev_generator;
+	generator->env = switch_environment(prev_env);
+
+	if (generator->done) {
+		coroutine_free(generator->coroutine);
+		generator->coroutine = NULL;
+		prev_env = switch_environment(generator->env);
+		free_environment();
+		switch_environment(prev_env);
+		generator->env = NULL;
+		if (generator->error != NULL) {
+			set_error_message(generator->error);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Takes the value that generator_fill() made ready.
+static struct s_expr *generator_take(struct generator *generator)
+{
+	generator->has_value = 0;
+	return generator->value;
+}
+
+static void run_thunk(struct generator *generator)
+{
+	if (apply_function(generator->fn, NULL) == NULL)
+		generator_fail(generator);
+}
+
+static void run_list(struct generator *generator)
+{
+	struct s_expr *ls;
+
+	for (ls = generator->source; ls->type == CELL;
+	ls = ls->value->cell->rest)
+		generator_yield(generator, ls->value->cell->first);
+}
+
+static void run_map(struct generator *generator)
+{
+	struct generator *source = generator->source->value->generator;
+	struct fn_arguments value;
+
+	value.next = NULL;
+	while (1) {
+		if (!generator_fill(source)) {
+			generator_fail(generator);
+			return;
+		}
+		if (!source->has_value)
+			return;
+		value.value = generator_take(source);
+		value.value = apply_function(generator->fn, &value);
+		if (value.value == NULL) {
+			generator_fail(generator);
+			return;
+		}
+		generator_yield(generator, value.value);
+	}
+}
+
+// Evaluates an argument that must be a generator.
+static struct generator *generator_argument(struct s_expr *arg, char *name)
+{
+	char message[64];
+	struct s_expr *value = eval_expression(arg);
+
+	if (value == NULL)
+		return NULL;
+	if (value->type != GENERATOR) {
+		sprintf(message, "%s - type error (expected generator)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	return value->value->generator;
+}
+
+/*
+ * (make-generator thunk) returns a generator that calls thunk when its first
+ * value is asked for. Each (yield value) in thunk's dynamic extent hands out
+ * a value and suspends thunk until the next one is asked for.
+ */
+static struct s_expr *make_generator(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("make-generator - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *thunk = function_argument(args->value,
+		"make-generator");
+
+	if (thunk == NULL)
+		return NULL;
+	return new_generator(run_thunk, thunk, NULL);
+}
+
+// (yield value) hands value to whoever runs the current generator.
+static struct s_expr *yield(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("yield - arity mismatch");
+		return NULL;
+	}
+	struct generator *generator = interp->generator;
+	struct s_expr *value;
+
+	if (generator == NULL) {
+		set_error_message("yield - value error (not in a generator)");
+		return NULL;
+	}
+	value = eval_expression(args->value);
+	if (value == NULL)
+		return NULL;
+	generator_yield(generator, value);
+	return value;
+}
+
+// (generator-next gen) returns the next value of gen.
+static struct s_expr *generator_next(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("generator-next - arity mismatch");
+		return NULL;
+	}
+	struct generator *generator = generator_argument(args->value,
+		"generator-next");
+
+	if (generator == NULL || !generator_fill(generator))
+		return NULL;
+	if (!generator->has_value) {
+		set_error_message(
+			"generator-next - value error (generator is done)");
+		return NULL;
+	}
+	return generator_take(generator);
+}
+
+/*
+ * (generator-done? gen) returns whether gen has no more values. It runs gen
+ * up to its next value to find out.
+ */
+static struct s_expr *is_generator_done(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("generator-done? - arity mismatch");
+		return NULL;
+	}
+	struct generator *generator = generator_argument(args->value,
+		"generator-done?");
+
+	if (generator == NULL || !generator_fill(generator))
+		return NULL;
+	return s_expr_from_boolean(!generator->has_value);
+}
+
+static struct s_expr *is_generator(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("generator? - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *val = eval_expression(args->value);
+
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == GENERATOR);
+}
+
+// (list->generator list) returns a generator of the elements of list.
+static struct s_expr *list_to_generator(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("list->generator - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *ls;
+
+	if (!list_arguments(args, 1, &ls, "list->generator"))
+		return NULL;
+	return new_generator(run_list, NULL, ls);
+}
+
+/*
+ * (generator-map fn gen) returns a generator of (fn value) for each value of
+ * gen, computed as they are asked for.
+ */
+static struct s_expr *generator_map(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("generator-map - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *fn = function_argument(args->value, "generator-map");
+	struct s_expr *source;
+
+	if (fn == NULL)
+		return NULL;
+	source = eval_expression(args->next->value);
+	if (source == NULL)
+		return NULL;
+	if (source->type != GENERATOR) {
+		set_error_message(
+			"generator-map - type error (expected generator)");
+		return NULL;
+	}
+	return new_generator(run_map, fn, source);
+}
+
+/*
+ * (generator-fold fn init gen) calls (fn value acc) on each value of gen in
+ * turn, with acc starting as init and then being the previous result, and
+ * returns the last result.
+ */
+static struct s_expr *generator_fold(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next == NULL
+	|| args->next->next->next != NULL) {
+		set_error_message("generator-fold - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *fn = function_argument(args->value, "generator-fold");
+	struct s_expr *acc;
+	struct generator *generator;
+	struct fn_arguments value, previous;
+
+	if (fn == NULL)
+		return NULL;
+	acc = eval_expression(args->next->value);
+	if (acc == NULL)
+		return NULL;
+	generator = generator_argument(args->next->next->value,
+		"generator-fold");
+	if (generator == NULL)
+		return NULL;
+	value.next = &previous;
+	previous.next = NULL;
+	while (1) {
+		if (!generator_fill(generator))
+			return NULL;
+		if (!generator->has_value)
+			return acc;
+		value.value = generator_take(generator);
+		previous.value = acc;
+		acc = apply_function(fn, &value);
+		if (acc == NULL)
+			return NULL;
+	}
+}
+
+// PROMISES AND STREAMS
+
+/*
+ * promise_state - What a promise knows about its value
+ *
+ * Until the promise is done, `step` computes the value from `args`: a
+ * delayed expression and its captured bindings, or the rest of a stream
+ * operation. A delay-force step returns another promise instead, whose
+ * state the forced promise then takes over, so that forcing a chain of them
+ * runs in one loop rather than one C call per link (see force_promise()).
+ */
+struct promise_state {
+	int done;
+	int delay_force;
+	struct s_expr *value;
+	struct s_expr *(*step)(struct s_expr **args);
+	struct s_expr *args[2];
+};
+
+// Promises linked by delay-force share one state.
+struct promise {
+	struct promise_state *state;
+};
+
+/*
+ * Held while reading or changing the state of a promise that may be shared,
+ * since futures and pmap calls can force the same one. It is let go while a
+ * step runs, so two threads may run the same step; the first to finish
+ * settles the promise, and the other's value is dropped.
+ */
+static pthread_mutex_t promise_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct s_expr *pair(struct s_expr *first, struct s_expr *rest)
+{
+	struct cons_cell *cell = (struct cons_cell *)
+		heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
+
+	cell->first = first;
+	cell->rest = rest;
+	return s_expr_from_cons_cell(cell);
+}
+
+static struct s_expr *new_promise(struct s_expr *(*step)(struct s_expr **),
+	int delay_force, struct s_expr *first, struct s_expr *second)
+{
+	struct promise *promise = (struct promise *)
+		malloc(sizeof(struct promise));
+
+	promise->state = (struct promise_state *)
+		calloc(1, sizeof(struct promise_state));
+	promise->state->delay_force = delay_force;
+	promise->state->step = step;
+	promise->state->args[0] = first;
+	promise->state->args[1] = second;
+	return s_expr_from_promise(promise);
+}
+
+/*
+ * Adds a (symbol . value) pair to `captured` for each bound symbol in `expr`,
+ * except builtins under their own name, and returns the new list. Scoping is
+ * dynamic, so a delayed expression would otherwise see whatever those
+ * symbols mean when it is forced.
+ */
+static struct s_expr *capture_bindings(struct s_expr *expr,
+	struct s_expr *captured)
+{
+	struct s_expr *value, *binding;
+
+	while (expr->type == CELL) {
+		captured = capture_bindings(expr->value->cell->first, captured);
+		expr = expr->value->cell->rest;
+	}
+	if (expr->type != SYMBOL)
+		return captured;
+	value = get_env(expr->value->symbol);
+	if (value == NULL || (value->type == BUILTIN
+	&& !strcmp(value->value->builtin->name, expr->value->symbol)))
+		return captured;
+	for (binding = captured; binding->type == CELL;
+	binding = binding->value->cell->rest) {
+		struct s_expr *symbol =
+			binding->value->cell->first->value->cell->first;
+
+		if (!strcmp(symbol->value->symbol, expr->value->symbol))
+			return captured;
+	}
+	return pair(pair(expr, value), captured);
+}
+
+// Evaluates a delayed expression with the bindings it captured.
+static struct s_expr *eval_delayed(struct s_expr **args)
+{
+	struct s_expr *binding;
+	struct s_expr *value;
+
+	push_env();
+	for (binding = args[1]; binding->type == CELL;
+	binding = binding->value->cell->rest) {
+		struct s_expr *captured = binding->value->cell->first;
+
+		set_env(captured->value->cell->first->value->symbol,
+			captured->value->cell->rest);
+	}
+	value = eval_expression(args[0]);
+	pop_env();
+	return value;
+}
+
+static struct s_expr *delay_expression(struct s_expr *expr, int delay_force)
+{
+	return new_promise(eval_delayed, delay_force, expr,
+		capture_bindings(expr, empty_list));
+}
+
+static struct s_expr *force_promise(struct promise *promise)
+{
+	struct s_expr *result;
+
+	pthread_mutex_lock(&promise_lock);
+	while (!promise->state->done) {
+		struct promise_state *state = promise->state;
+		struct s_expr *(*step)(struct s_expr **) = state->step;
+		struct s_expr *args[2] = {state->args[0], state->args[1]};
+		struct s_expr *value;
+		struct promise *next;
+
+		pthread_mutex_unlock(&promise_lock);
+		value = step(args);
+		pthread_mutex_lock(&promise_lock);
+		if (value == NULL) {
+			pthread_mutex_unlock(&promise_lock);
 			return NULL;
 		}
-		if (list_length(clause) < 2) {
+		// Forcing it again from inside the step settles it first.
+		if (state->done)
+			break;
+		// Another thread went on to a later link meanwhile.
+		if (state->step != step || state->args[0] != args[0]
+		|| state->args[1] != args[1])
+			continue;
+		if (!state->delay_force) {
+			state->done = 1;
+			state->value = value;
+			state->args[0] = NULL;
+			state->args[1] = NULL;
+			break;
+		}
+		if (value->type != PROMISE) {
+			pthread_mutex_unlock(&promise_lock);
 			set_error_message(
-				"cond - value error (expected at least two elements in clause)"
-			);
+				"force - type error (delay-force needs a promise)");
+			return NULL;
+		}
+		// Go on with the other promise's work, and have it share the
+		// result.
+		next = value->value->promise;
+		if (next->state != state) {
+			*state = *next->state;
+			next->state = state;
+		}
+	}
+	result = promise->state->value;
+	pthread_mutex_unlock(&promise_lock);
+	return result;
+}
+
+// (delay expr) returns a promise to evaluate expr once, when forced.
+struct s_expr *delay(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("delay - arity mismatch");
+		return NULL;
+	}
+	return delay_expression(args->value, 0);
+}
+
+/*
+ * (delay-force expr) is (delay (force expr)) for an expr that returns a
+ * promise, but forcing a chain of them doesn't grow the C stack.
+ */
+struct s_expr *delay_force(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("delay-force - arity mismatch");
+		return NULL;
+	}
+	return delay_expression(args->value, 1);
+}
+
+// (make-promise value) returns a promise that is already done.
+static struct s_expr *make_promise(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("make-promise - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *value = eval_expression(args->value);
+	struct s_expr *promise;
+
+	if (value == NULL || value->type == PROMISE)
+		return value;
+	promise = new_promise(NULL, 0, NULL, NULL);
+	promise->value->promise->state->done = 1;
+	promise->value->promise->state->value = value;
+	return promise;
+}
+
+// (force value) returns the value of a promise. Other values pass through.
+static struct s_expr *force(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("force - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *value = eval_expression(args->value);
+
+	if (value == NULL || value->type != PROMISE)
+		return value;
+	return force_promise(value->value->promise);
+}
+
+static struct s_expr *is_promise(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("promise? - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *val = eval_expression(args->value);
+
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == PROMISE);
+}
+
+// (cons-stream first rest) is (cons first (delay rest)).
+struct s_expr *cons_stream(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("cons-stream - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *first = eval_expression(args->value);
+
+	if (first == NULL)
+		return NULL;
+	return pair(first, delay_expression(args->next->value, 0));
+}
+
+/*
+ * Evaluates an argument that must be a stream: the empty list, or a pair
+ * whose rest is a promise.
+ */
+static struct s_expr *stream_argument(struct s_expr *arg, char *name)
+{
+	char message[64];
+	struct s_expr *stream = eval_expression(arg);
+
+	if (stream == NULL || stream->type == EMPTY_LIST)
+		return stream;
+	if (stream->type != CELL
+	|| stream->value->cell->rest->type != PROMISE) {
+		sprintf(message, "%s - type error (expected stream)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	return stream;
+}
+
+// Forces the rest of a non-empty stream, checking that it is a stream too.
+static struct s_expr *stream_rest(struct s_expr *stream, char *name)
+{
+	char message[64];
+	struct s_expr *rest =
+		force_promise(stream->value->cell->rest->value->promise);
+
+	if (rest == NULL || rest->type == EMPTY_LIST)
+		return rest;
+	if (rest->type != CELL || rest->value->cell->rest->type != PROMISE) {
+		sprintf(message, "%s - type error (expected stream)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	return rest;
+}
+
+static struct s_expr *stream_car(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("stream-car - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *stream = stream_argument(args->value, "stream-car");
+
+	if (stream == NULL)
+		return NULL;
+	if (stream->type == EMPTY_LIST) {
+		set_error_message("stream-car - type error (empty stream)");
+		return NULL;
+	}
+	return stream->value->cell->first;
+}
+
+static struct s_expr *stream_cdr(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("stream-cdr - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *stream = stream_argument(args->value, "stream-cdr");
+
+	if (stream == NULL)
+		return NULL;
+	if (stream->type == EMPTY_LIST) {
+		set_error_message("stream-cdr - type error (empty stream)");
+		return NULL;
+	}
+	return stream_rest(stream, "stream-cdr");
+}
+
+static struct s_expr *map_stream(struct s_expr *fn, struct s_expr *stream);
+
+static struct s_expr *map_step(struct s_expr **args)
+{
+	struct s_expr *rest = stream_rest(args[1], "stream-map");
+
+	return rest != NULL ? map_stream(args[0], rest) : NULL;
+}
+
+static struct s_expr *map_stream(struct s_expr *fn, struct s_expr *stream)
+{
+	struct fn_arguments value;
+	struct s_expr *first;
+
+	if (stream->type == EMPTY_LIST)
+		return stream;
+	value.value = stream->value->cell->first;
+	value.next = NULL;
+	first = apply_function(fn, &value);
+	if (first == NULL)
+		return NULL;
+	return pair(first, new_promise(map_step, 0, fn, stream));
+}
+
+/*
+ * (stream-map fn stream) returns the stream of (fn element) for each element
+ * of stream, each computed when its position is reached.
+ */
+static struct s_expr *stream_map(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("stream-map - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *fn = function_argument(args->value, "stream-map");
+	struct s_expr *stream;
+
+	if (fn == NULL)
+		return NULL;
+	stream = stream_argument(args->next->value, "stream-map");
+	return stream != NULL ? map_stream(fn, stream) : NULL;
+}
+
+static struct s_expr *filter_stream(struct s_expr *pred,
+	struct s_expr *stream);
+
+static struct s_expr *filter_step(struct s_expr **args)
+{
+	struct s_expr *rest = stream_rest(args[1], "stream-filter");
+
+	return rest != NULL ? filter_stream(args[0], rest) : NULL;
+}
+
+// Skips to the first element that satisfies pred, in a loop.
+static struct s_expr *filter_stream(struct s_expr *pred, struct s_expr *stream)
+{
+	struct fn_arguments value;
+
+	value.next = NULL;
+	while (stream->type == CELL) {
+		struct s_expr *keep;
+
+		value.value = stream->value->cell->first;
+		keep = apply_function(pred, &value);
+		if (keep == NULL)
+			return NULL;
+		if (!is_empty_list(keep)) {
+			return pair(value.value,
+				new_promise(filter_step, 0, pred, stream));
+		}
+		stream = stream_rest(stream, "stream-filter");
+		if (stream == NULL)
+			return NULL;
+	}
+	return stream;
+}
+
+// (stream-filter pred stream) returns the stream of elements satisfying pred.
+static struct s_expr *stream_filter(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("stream-filter - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *pred = function_argument(args->value, "stream-filter");
+	struct s_expr *stream;
+
+	if (pred == NULL)
+		return NULL;
+	stream = stream_argument(args->next->value, "stream-filter");
+	return stream != NULL ? filter_stream(pred, stream) : NULL;
+}
+
+static struct s_expr *take_step(struct s_expr **args);
+
+static struct s_expr *take_stream(struct s_expr *stream, int count)
+{
+	if (count <= 0 || stream->type == EMPTY_LIST)
+		return empty_list;
+	return pair(stream->value->cell->first, new_promise(take_step, 0,
+		stream, s_expr_from_integer(count - 1)));
+}
+
+// Stops without forcing more of the source, which may be infinite.
+static struct s_expr *take_step(struct s_expr **args)
+{
+	struct s_expr *rest;
+
+	if (args[1]->value->integer == 0)
+		return empty_list;
+	rest = stream_rest(args[0], "stream-take");
+	return rest != NULL ? take_stream(rest, args[1]->value->integer) : NULL;
+}
+
+/*
+ * Evaluates the stream and count arguments of stream-take and stream->list.
+ * Returns 0 on error.
+ */
+static int stream_count_arguments(struct fn_arguments *args,
+	struct s_expr **stream, int *count, char *name)
+{
+	char message[64];
+	struct s_expr *n;
+
+	*stream = stream_argument(args->value, name);
+	if (*stream == NULL)
+		return 0;
+	n = eval_expression(args->next->value);
+	if (n == NULL)
+		return 0;
+	if (n->type != INTEGER) {
+		sprintf(message, "%s - type error (expected integer)", name);
+		set_error_message(message);
+		return 0;
+	}
+	*count = n->value->integer;
+	return 1;
+}
+
+// (stream-take stream n) returns the stream of the first n elements.
+static struct s_expr *stream_take(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("stream-take - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *stream;
+	int count;
+
+	if (!stream_count_arguments(args, &stream, &count, "stream-take"))
+		return NULL;
+	return take_stream(stream, count);
+}
+
+/*
+ * (stream->list stream [n]) returns a list of the elements of stream, or of
+ * the first n of them.
+ */
+static struct s_expr *stream_to_list(struct fn_arguments *args)
+{
+	if (args == NULL || (args->next != NULL && args->next->next != NULL)) {
+		set_error_message("stream->list - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *stream;
+	struct list_builder result;
+	int count = -1;
+
+	if (args->next == NULL) {
+		stream = stream_argument(args->value, "stream->list");
+		if (stream == NULL)
+			return NULL;
+	} else if (!stream_count_arguments(args, &stream, &count,
+	"stream->list")) {
+		return NULL;
+	}
+	list_builder_init(&result);
+	while (count != 0 && stream->type == CELL) {
+		list_builder_push(&result, stream->value->cell->first);
+		if (--count == 0)
+			break;
+		stream = stream_rest(stream, "stream->list");
+		if (stream == NULL)
+			return NULL;
+	}
+	return list_builder_finish(&result, empty_list);
+}
+
+// PORTS
+
+// The end of the input, which the reader can't produce
+#define EOF_OBJECT "#<eof>"
+
+static struct s_expr *eof_object(void)
+{
+	return s_expr_from_symbol(EOF_OBJECT);
+}
+
+static struct s_expr *char_value(int ch)
+{
+	char c = ch;
+
+	if (ch == EOF)
+		return eof_object();
+	return s_expr_from_string(&c, 1);
+}
+
+/*
+ * Evaluates the port argument of `name`, which is optional when `arg` is NULL,
+ * and checks that it is an open port of the right direction.
+ */
+static struct port *port_argument(struct fn_arguments *arg, int output,
+	char *name)
+{
+	char message[64];
+	struct port *port;
+
+	if (arg == NULL) {
+		port = output ? port_current_output() : port_current_input();
+	} else {
+		struct s_expr *value = eval_expression(arg->value);
+
+		if (value == NULL)
+			return NULL;
+		if (value->type != PORT || value->value->port->output != output) {
+			sprintf(message, "%s - type error (expected %s port)",
+				name, output ? "output" : "input");
+			set_error_message(message);
 			return NULL;
 		}
-		struct s_expr *test = clause->value->cell->first;
-		int else_clause = test->type == SYMBOL
-			&& !strcmp(test->value->symbol, "else");
+		port = value->value->port;
+	}
+	if (port->closed) {
+		sprintf(message, "%s - io error (port is closed)", name);
+		set_error_message(message);
+		return NULL;
+	}
+	return port;
+}
 
-		if (!else_clause) {
-			test = eval_expression(test);
-			if (test == NULL) return NULL;
-		}
-		// Pass as long as `test` is not #f or '().
-		int test_passed = !is_empty_list(test);
-		struct s_expr *then_bodies = clause->value->cell->rest;
+static struct s_expr *open_file(struct fn_arguments *args, int output,
+	char *name)
+{
+	char message[64];
 
-		if (test_passed || else_clause) {
-			if (else_clause && args->next != NULL) {
-				set_error_message(
-					"cond - syntax error (else must be the last clause)");
-				return NULL;
-			}
-			// Evaluate then bodies in order and return the result
-			// of the last one.
-			while (!is_empty_list(then_bodies)) {
-				struct s_expr *result = eval_expression(
-					then_bodies->value->cell->first);
-				struct s_expr *rest =
-					then_bodies->value->cell->rest;
+	if (args == NULL || args->next != NULL) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	sprintf(message, "%s - type error (expected string)", name);
+	struct string *path = string_argument(args->value, message);
+	struct port *port;
 
-				if (result == NULL) return NULL;
-				if (is_empty_list(rest))
-					return result;
-				then_bodies = rest;
-			}
-			// Since there are at least two elements, this comment
-			// will never be reached.
-		}
-		args = args->next;
+	if (path == NULL)
+		return NULL;
+	port = port_open(path->chars, output);
+	if (port == NULL) {
+		sprintf(message, "%s - io error (cannot open file)", name);
+		set_error_message(message);
+		return NULL;
 	}
-	// TODO return #<void>
+	return s_expr_from_port(port);
+}
+
+static struct s_expr *open_input_file(struct fn_arguments *args)
+{
+	return open_file(args, 0, "open-input-file");
+}
+
+static struct s_expr *open_output_file(struct fn_arguments *args)
+{
+	return open_file(args, 1, "open-output-file");
+}
+
+static struct s_expr *close_port(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("close-port - arity mismatch");
+		return NULL;
+	}
+	struct s_expr *value = eval_expression(args->value);
+
+	if (value == NULL)
+		return NULL;
+	if (value->type != PORT) {
+		set_error_message("close-port - type error (expected port)");
+		return NULL;
+	}
+	port_close(value->value->port);
 	return empty_list;
 }
 
-struct s_expr *lambda_(struct fn_arguments *args)
+static struct s_expr *is_port(struct fn_arguments *args)
 {
-	if (args == NULL || args->next == NULL
-	|| args->next->next != NULL) {
-		set_error_message("lambda - arity mismatch");
+	if (args == NULL || args->next != NULL) {
+		set_error_message("port? - arity mismatch");
 		return NULL;
 	}
-	struct s_expr *arg_names = args->value;
-	struct s_expr *body = args->next->value; // don't evaluate
+	struct s_expr *val = eval_expression(args->value);
 
-	if (!is_list(arg_names)) {
-		set_error_message("lambda - type error (arguments must be a list)");
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == PORT);
+}
+
+// (read [port]) reads a datum with the parser, like the shell reads forms.
+static struct s_expr *read_(struct fn_arguments *args)
+{
+	if (args != NULL && args->next != NULL) {
+		set_error_message("read - arity mismatch");
 		return NULL;
 	}
-	int arg_count = list_length(arg_names);
-	char **arg_list = (char **) malloc(
-		arg_count * (sizeof(char *)));
-	struct s_expr *tmp = arg_names;
-	int i = 0;
+	struct port *port = port_argument(args, 0, "read");
+	struct s_expr *datum;
 
-	while (!is_empty_list(tmp)) {
-		struct s_expr *arg = tmp->value->cell->first;
+	if (port == NULL)
+		return NULL;
+	datum = port_read(port);
+	if (datum == NULL && port->lexer.error)
+		return NULL;
+	return datum == NULL ? eof_object() : datum;
+}
 
-		if (arg->type != SYMBOL) {
-			set_error_message(
-				"lambda - type error (each argument must be a symbol)");
-			return NULL;
-		}
-		arg_list[i] = (char *) malloc(
-			(strlen(arg->value->symbol)+1) * sizeof(char));
-		strcpy(arg_list[i], arg->value->symbol);
-		tmp = tmp->value->cell->rest;
-		i++;
+// (read-line [port]) returns the next line as a string, without its newline.
+static struct s_expr *read_line(struct fn_arguments *args)
+{
+	if (args != NULL && args->next != NULL) {
+		set_error_message("read-line - arity mismatch");
+		return NULL;
 	}
-	struct lambda *lmb = (struct lambda *)
-		malloc(sizeof(struct lambda));
+	struct port *port = port_argument(args, 0, "read-line");
+	struct string_builder *line;
+	struct s_expr *result;
+	int ch;
 
-	lmb->name = (char *) malloc(
-		(strlen("anonymous")+1) * sizeof(char));
-	strcpy(lmb->name, "anonymous");
-	lmb->args = arg_list;
-	lmb->arg_count = arg_count;
-	lmb->body = body;
-	return s_expr_from_lambda(lmb);
+	if (port == NULL)
+		return NULL;
+	ch = port_read_char(port);
+	if (ch == EOF)
+		return eof_object();
+	line = string_builder_create();
+	while (ch != EOF && ch != '\n') {
+		char c = ch;
+
+		string_builder_append(line, &c, 1);
+		ch = port_read_char(port);
+	}
+	result = s_expr_from_string(line->chars, line->length);
+	string_builder_free(line);
+	return result;
 }
 
-struct s_expr *define_(struct fn_arguments *args)
+// (read-char [port]) returns the next character as a string of length 1.
+static struct s_expr *read_char(struct fn_arguments *args)
 {
-	if (args == NULL || args->next == NULL
-	|| args->next->next != NULL) {
-		set_error_message("define - arity mismatch");
+	if (args != NULL && args->next != NULL) {
+		set_error_message("read-char - arity mismatch");
 		return NULL;
 	}
+	struct port *port = port_argument(args, 0, "read-char");
 
-	if (args->value->type == SYMBOL) {
-		struct s_expr *id = args->value;
-		struct s_expr *value = eval_expression(args->next->value);
+	if (port == NULL)
+		return NULL;
+	return char_value(port_read_char(port));
+}
 
-		if (value == NULL) return NULL;
-		set_env(id->value->symbol, value);
-		return id;
+static struct s_expr *peek_char(struct fn_arguments *args)
+{
+	if (args != NULL && args->next != NULL) {
+		set_error_message("peek-char - arity mismatch");
+		return NULL;
 	}
+	struct port *port = port_argument(args, 0, "peek-char");
 
-	if (is_list(args->value)) {
-		struct s_expr *id = args->value->value->cell->first;
-		if (id->type != SYMBOL) {
-			set_error_message("define - type error (expected symbol)");
-			return NULL;
-		}
-		struct s_expr *curr_arg = args->value->value->cell->rest;
-		int arg_count = list_length(curr_arg);
-		char **arg_list = (char **) malloc(
-			arg_count * sizeof(char *));
-		int i = 0;
+	if (port == NULL)
+		return NULL;
+	return char_value(port_peek_char(port));
+}
 
-		while (!is_empty_list(curr_arg)) {
-			struct s_expr *tmp = curr_arg->value->cell->first;
+static struct s_expr *eof_object_(struct fn_arguments *args)
+{
+	if (args != NULL) {
+		set_error_message("eof-object - arity mismatch");
+		return NULL;
+	}
+	return eof_object();
+}
 
-			if (tmp->type != SYMBOL) {
-				set_error_message("define - type error (expected symbol)");
-				return NULL;
-			}
-			arg_list[i] = (char *) malloc(
-				(strlen(tmp->value->symbol)+1) * sizeof(char));
-			strcpy(arg_list[i], tmp->value->symbol);
-			curr_arg = curr_arg->value->cell->rest;
-			i++;
-		}
-		struct s_expr *body = args->next->value;
-
-		struct lambda *lmb = (struct lambda *)
-			malloc(sizeof(struct lambda));
-
-		lmb->name = (char *) malloc(
-			(strlen(id->value->symbol)+1) * sizeof(char));
-		strcpy(lmb->name, id->value->symbol);
-		lmb->args = arg_list;
-		lmb->arg_count = arg_count;
-		lmb->body = body;
-		set_env(
-			id->value->symbol,
-			s_expr_from_lambda(lmb));
-		return id;
+static struct s_expr *is_eof_object(struct fn_arguments *args)
+{
+	if (args == NULL || args->next != NULL) {
+		set_error_message("eof-object? - arity mismatch");
+		return NULL;
 	}
+	struct s_expr *val = eval_expression(args->value);
 
-	set_error_message("define - type error (expecting symbol or list)");
-	return NULL;
+	if (val == NULL)
+		return NULL;
+	return s_expr_from_boolean(val->type == SYMBOL
+		&& !strcmp(val->value->symbol, EOF_OBJECT));
+}
+
+static struct s_expr *write_value(struct fn_arguments *args, int display,
+	char *name)
+{
+	char message[64];
+
+	if (args == NULL || (args->next != NULL && args->next->next != NULL)) {
+		sprintf(message, "%s - arity mismatch", name);
+		set_error_message(message);
+		return NULL;
+	}
+	struct s_expr *value = eval_expression(args->value);
+	struct port *port;
+	struct printer printer;
+
+	if (value == NULL)
+		return NULL;
+	port = port_argument(args->next, 1, name);
+	if (port == NULL)
+		return NULL;
+	printer_to_stream(&printer, port->stream);
+	printer.display = display;
+	printer_write(&printer, value);
+	printer_free(&printer);
+	return empty_list;
+}
+
+// (write value [port]) writes value the way it is read in.
+static struct s_expr *write_(struct fn_arguments *args)
+{
+	return write_value(args, 0, "write");
+}
+
+// (display value [port]) writes value with strings as their characters.
+static struct s_expr *display(struct fn_arguments *args)
+{
+	return write_value(args, 1, "display");
+}
+
+static struct s_expr *newline(struct fn_arguments *args)
+{
+	if (args != NULL && args->next != NULL) {
+		set_error_message("newline - arity mismatch");
+		return NULL;
+	}
+	struct port *port = port_argument(args, 1, "newline");
+
+	if (port == NULL)
+		return NULL;
+	putc('\n', port->stream);
+	return empty_list;
+}
+
+/*
+ * (with-output-to-file path thunk) calls thunk with the current output port
+ * writing to path, and returns its value. The file is closed afterwards, even
+ * if thunk fails.
+ */
+static struct s_expr *with_output_to_file(struct fn_arguments *args)
+{
+	if (args == NULL || args->next == NULL || args->next->next != NULL) {
+		set_error_message("with-output-to-file - arity mismatch");
+		return NULL;
+	}
+	struct string *path = string_argument(args->value,
+		"with-output-to-file - type error (expected string)");
+	struct s_expr *thunk;
+	struct port *port;
+	struct port *previous;
+	struct s_expr *result;
+
+	if (path == NULL)
+		return NULL;
+	thunk = function_argument(args->next->value, "with-output-to-file");
+	if (thunk == NULL)
+		return NULL;
+	port = port_open(path->chars, 1);
+	if (port == NULL) {
+		set_error_message(
+			"with-output-to-file - io error (cannot open file)");
+		return NULL;
+	}
+	previous = interp->output_port;
+	interp->output_port = port;
+	result = apply_function(thunk, NULL);
+	interp->output_port = previous;
+	port_close(port);
+	return result;
 }
 
 static struct s_expr *is_function_(struct fn_arguments *args)
@@ -542,11 +3724,12 @@ static struct s_expr *is_function_(struct fn_arguments *args)
 	}
 	struct s_expr *val = eval_expression(args->value);
 
+	if (val == NULL)
+		return NULL;
 	return s_expr_from_boolean(
 		is_function(val));
 }
 
-
 void start_evaluator(void)
 {
 	register_builtin_function("exit", exit_);
@@ -555,23 +3738,123 @@ void start_evaluator(void)
 	register_builtin_function("empty?", is_empty);
 	register_builtin_function("null?", is_empty);
 	register_builtin_function("append", append);
-	register_builtin_function("quote", quote);
+	register_builtin_function("length", length);
+	register_builtin_function("reverse", reverse);
+	register_builtin_function("list-tail", list_tail);
+	register_builtin_function("list-ref", list_ref);
+	register_builtin_function("last-pair", last_pair);
+	register_builtin_function("list-copy", list_copy);
+	interp->quote_function = register_builtin_function("quote", quote);
 	register_builtin_function("cons", cons);
 	register_builtin_function("car", car);
 	register_builtin_function("cdr", cdr);
 	register_builtin_function("+", add);
 	register_builtin_function("-", subtract);
 	register_builtin_function("*", multiply);
+	register_builtin_function("quotient", quotient);
+	register_builtin_function("remainder", remainder_);
+	register_builtin_function("modulo", modulo);
+	register_builtin_function("<", less);
+	register_builtin_function(">", greater);
+	register_builtin_function("=", numbers_equal);
+	register_builtin_function("<=", less_equal);
+	register_builtin_function(">=", greater_equal);
 	register_builtin_function("not", is_empty);
 	register_builtin_function("and", and);
 	register_builtin_function("or", or);
 	register_builtin_function("symbol?", is_symbol);
 	register_builtin_function("equal?", are_equal);
+	register_builtin_function("eq?", are_eq);
 	register_builtin_function("assoc", assoc);
+	register_builtin_function("make-hash-table", make_hash_table);
+	register_builtin_function("hash-table?", is_hash_table);
+	register_builtin_function("hash-ref", hash_ref);
+	register_builtin_function("hash-set!", hash_set);
+	register_builtin_function("hash-remove!", hash_remove);
+	register_builtin_function("hash-count", hash_count);
+	register_builtin_function("hash-keys", hash_keys);
+	register_builtin_function("hash-values", hash_values);
+	register_builtin_function("hash->list", hash_to_list);
 	register_builtin_function("cond", cond);
 	register_builtin_function("lambda", lambda_);
 	register_builtin_function("define", define_);
+	register_builtin_function("define-memoized", define_memoized);
+	register_builtin_function("define-syntax", define_syntax);
+	interp->folded_lambda = new_builtin_function("lambda", folded_lambda);
+	interp->folded_define = new_builtin_function("define", folded_define);
+	register_builtin_function("memoize", memoize);
+	register_builtin_function("memo-stats", memo_stats);
+	register_builtin_function("memo-clear!", memo_clear);
+	register_builtin_function("profile-start", profile_start_);
+	register_builtin_function("profile-stop", profile_stop_);
+	register_builtin_function("profile-report", profile_report_);
+	register_builtin_function("profile-dump-folded", profile_dump_folded);
+	register_builtin_function("heap-stats", heap_stats);
+	register_builtin_function("load-data", load_data);
+	register_builtin_function("unload-data", unload_data);
+	register_builtin_function("open-input-file", open_input_file);
+	register_builtin_function("open-output-file", open_output_file);
+	register_builtin_function("close-port", close_port);
+	register_builtin_function("port?", is_port);
+	register_builtin_function("read", read_);
+	register_builtin_function("read-line", read_line);
+	register_builtin_function("read-char", read_char);
+	register_builtin_function("peek-char", peek_char);
+	register_builtin_function("eof-object", eof_object_);
+	register_builtin_function("eof-object?", is_eof_object);
+	register_builtin_function("write", write_);
+	register_builtin_function("display", display);
+	register_builtin_function("newline", newline);
+	register_builtin_function("with-output-to-file", with_output_to_file);
 	register_builtin_function("function?", is_function_);
+	register_builtin_function("future", future);
+	register_builtin_function("touch", touch);
+	register_builtin_function("pmap", pmap);
+	register_builtin_function("spawn", spawn);
+	register_builtin_function("send", send);
+	register_builtin_function("receive", receive);
+	register_builtin_function("self", self);
+	register_builtin_function("actor?", is_actor);
+	register_builtin_function("make-generator", make_generator);
+	register_builtin_function("yield", yield);
+	register_builtin_function("generator-next", generator_next);
+	register_builtin_function("generator-done?", is_generator_done);
+	register_builtin_function("generator?", is_generator);
+	register_builtin_function("list->generator", list_to_generator);
+	register_builtin_function("generator-map", generator_map);
+	register_builtin_function("generator-fold", generator_fold);
+	register_builtin_function("delay", delay);
+	register_builtin_function("delay-force", delay_force);
+	register_builtin_function("make-promise", make_promise);
+	register_builtin_function("force", force);
+	register_builtin_function("promise?", is_promise);
+	register_builtin_function("cons-stream", cons_stream);
+	register_builtin_function("stream-car", stream_car);
+	register_builtin_function("stream-cdr", stream_cdr);
+	register_builtin_function("stream-map", stream_map);
+	register_builtin_function("stream-filter", stream_filter);
+	register_builtin_function("stream-take", stream_take);
+	register_builtin_function("stream->list", stream_to_list);
+	register_builtin_function("map", map);
+	register_builtin_function("for-each", for_each);
+	register_builtin_function("filter", filter);
+	register_builtin_function("fold", fold);
+	register_builtin_function("apply", apply);
+	register_builtin_function("string?", is_string);
+	register_builtin_function("string-length", string_length);
+	register_builtin_function("string-append", string_append);
+	register_builtin_function("substring", substring);
+	register_builtin_function("string->symbol", string_to_symbol);
+	register_builtin_function("symbol->string", symbol_to_string);
+	register_builtin_function("number->string", number_to_string);
+	register_builtin_function("string->number", string_to_number);
+	register_builtin_function("write->string", write_to_string);
+	register_builtin_function("display->string", display_to_string);
+	register_builtin_function("make-string-builder", make_string_builder);
+	register_builtin_function("string-builder-append!",
+		string_builder_append_);
+	register_builtin_function("string-builder->string",
+		string_builder_to_string_);
 }
 
 static struct fn_arguments *read_arguments(struct s_expr *start)
@@ -582,7 +3865,7 @@ static struct fn_arguments *read_arguments(struct s_expr *start)
 
 	while (!is_empty_list(curr)) {
 		struct fn_arguments *new = (struct fn_arguments *)
-			malloc(sizeof(struct fn_arguments));
+			heap_alloc(HEAP_ARGUMENTS, sizeof(struct fn_arguments));
 
 		new->value = curr->value->cell->first; // car
 		new->next = NULL;
@@ -599,6 +3882,26 @@ static struct fn_arguments *read_arguments(struct s_expr *start)
 	return first_arg;
 }
 
+/*
+ * Evaluates each expression in the list `start`, storing the values in
+ * `values`. Returns 0 if any of them fails to evaluate.
+ */
+static int eval_arguments(struct s_expr *start, struct fn_arguments **values)
+{
+	struct fn_arguments *args = read_arguments(start);
+	struct fn_arguments *arg;
+
+	for (arg = args; arg != NULL; arg = arg->next) {
+		arg->value = eval_expression(arg->value);
+		if (arg->value == NULL) {
+			free_arguments(args);
+			return 0;
+		}
+	}
+	*values = args;
+	return 1;
+}
+
 static struct s_expr *eval_list(struct s_expr *expr)
 {
 	if (is_empty_list(expr)) {
@@ -607,63 +3910,188 @@ static struct s_expr *eval_list(struct s_expr *expr)
 	}
 	struct s_expr *first = eval_expression(expr->value->cell->first); // name or lambda
 	struct s_expr *rest = expr->value->cell->rest; // args
+	struct fn_arguments *args;
+	struct s_expr *ret;
 
 	if (first == NULL) return NULL;
+	if (first->type == MACRO)
+		return eval_macro_use(expr, first->value->macro);
 	if (!is_function(first)) {
 		set_error_message("type error (expected function)");
 		return NULL;
 	}
-	struct fn_arguments *args = read_arguments(rest);
 
 	if (first->type == BUILTIN) {
-		first->value->builtin->function(args);
+		// Builtins evaluate their own arguments.
+		args = read_arguments(rest);
+		ret = call_builtin(first->value->builtin, args);
 	} else {
-		// first is a lambda expression
-		struct lambda *lmb = first->value->lambda;
-
-		// Prepare local environment
-		push_env();
-		int i;
-		struct fn_arguments *arg = args;
-
-		for (i = 0; i < lmb->arg_count; i++) {
-			if (arg == NULL) {
-				// Not enough arguments passed to lambda
-				pop_env();
-				set_error_message("lambda - arity mismatch");
-				return NULL;
-			}
-			set_env(lmb->args[i], eval_expression(arg->value));
-			arg = arg->next;
-		}
-		if (arg != NULL) {
-			// Too many arguments passed to lambda
-			pop_env();
-			set_error_message("lambda - arity mismatch");
+		// first is a lambda expression. Evaluate all arguments before
+		// binding any of them, so that an argument can't see the
+		// parameters of the call it is being passed to.
+		if (!eval_arguments(rest, &args))
 			return NULL;
-		}
+		ret = apply_lambda(first->value->lambda, args);
+	}
+	free_arguments(args);
+	return ret;
+}
+
+static struct s_expr *eval_symbol(struct s_expr *expr)
+{
+	return eval_lookup(expr->value->symbol);
+}
+
+// Evaluates a cell with its node, compiling it the first time.
+static struct s_expr *eval_compiled(struct s_expr *expr)
+{
+	struct node *node = find_node(expr);
 
-		// Evaluate function body
-		struct s_expr *ret = eval_expression(lmb->body);
+	if (node == NULL) {
+		struct s_expr *first = expr->value->cell->first;
 
-		pop_env();
-		return ret;
+		// Forms made while running, such as the ones apply_function()
+		// quotes values with, are not worth keeping.
+		if (first->type != SYMBOL && first->type != CELL)
+			return is_list(expr) ? eval_list(expr) : expr;
+		node = compile_form(expr);
 	}
+	return node->run(node);
 }
 
-static struct s_expr *eval_symbol(struct s_expr *expr)
+// The body `lmb` runs, which is the one it was folded from once folds are
+// undone.
+static struct s_expr *lambda_body(struct lambda *lmb)
+{
+	return interp->unfolded && lmb->source != NULL
+		? lmb->source : lmb->body;
+}
+
+/*
+ * Evaluates the body of a lambda, with machine code once it is hot or if it
+ * was compiled ahead of time.
+ */
+static struct s_expr *eval_body(struct lambda *lmb)
+{
+	struct s_expr *body = lambda_body(lmb);
+	struct node *node;
+
+	if (interp->profiling || body->type != CELL
+	|| (interp->jit_threshold == 0 && interp->compiled == NULL))
+		return eval_expression(body);
+	node = find_node(body);
+	if (node == NULL)
+		node = compile_form(body);
+	if (node->jit_code == NULL && node->calls < interp->jit_threshold
+	&& ++node->calls == interp->jit_threshold)
+		lower_compile(node, lmb->name);
+	if (node->jit_code != NULL)
+		return node->jit_code();
+	if (interp->engine == ENGINE_CLOSURE)
+		return node->run(node);
+	return eval_expression(body);
+}
+
+// NATIVE CODE
+
+struct s_expr *eval_lookup(char *symbol)
 {
-	struct s_expr *value = get_env(expr->value->symbol);
+	struct s_expr *value = get_env(symbol);
 
 	if (value == NULL) {
 		set_error_message("reference error (undefined symbol)");
 		return NULL;
 	}
+	// The data it was bound to has been unloaded (see data.h).
+	if (value->type == UNLOADED) {
+		set_error_message(
+			"unload-data - reference error (data was unloaded)");
+		return NULL;
+	}
 	return value;
 }
 
+struct s_expr *eval_call_builtin(struct s_expr *builtin, struct s_expr *form)
+{
+	struct node *node = find_node(form);
+
+	if (node == NULL)
+		node = compile_form(form);
+	return call_builtin(builtin->value->builtin, node->arguments);
+}
+
+struct s_expr *eval_resume_builtin(struct s_expr *builtin,
+	struct s_expr *form, struct s_expr **values, int count)
+{
+	struct fn_arguments *first_arg = NULL;
+	struct fn_arguments *last_arg = NULL;
+	struct s_expr *operand = form->value->cell->rest;
+	struct s_expr *ret;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		push_argument(&first_arg, &last_arg,
+			is_self_evaluating(values[i])
+			? values[i] : quoted(values[i]));
+		operand = operand->value->cell->rest;
+	}
+	for (; !is_empty_list(operand); operand = operand->value->cell->rest)
+		push_argument(&first_arg, &last_arg, operand->value->cell->first);
+	ret = call_builtin(builtin->value->builtin, first_arg);
+	free_arguments(first_arg);
+	return ret;
+}
+
+struct s_expr *eval_apply_lambda(struct s_expr **values, int count)
+{
+	struct fn_arguments *first_arg = NULL;
+	struct fn_arguments *last_arg = NULL;
+	struct s_expr *ret;
+	int i;
+
+	for (i = 1; i < count; i++)
+		push_argument(&first_arg, &last_arg, values[i]);
+	ret = apply_lambda(values[0]->value->lambda, first_arg);
+	free_arguments(first_arg);
+	return ret;
+}
+
+/*
+ * A call that would run `body` again, from the end of `body`, sees the same
+ * bindings if the frame of the running call is replaced: the new frame binds
+ * the same parameters, and a body without define adds nothing else to it.
+ */
+int eval_tail_call(struct s_expr *body, struct s_expr **values, int count)
+{
+	struct lambda *lmb;
+	int i;
+
+	if (values[0]->type != LAMBDA)
+		return 0;
+	lmb = values[0]->value->lambda;
+	if (lambda_body(lmb) != body || lmb->arg_count != count - 1
+	|| lmb->memo != NULL || interp->profiling)
+		return 0;
+	pop_env();
+	push_env();
+	for (i = 0; i < lmb->arg_count; i++)
+		set_env(lmb->args[i], values[i + 1]);
+	return 1;
+}
+
+void eval_set_native(struct s_expr *body, struct s_expr *(*code)(void))
+{
+	struct node *node = find_node(body);
+
+	if (node == NULL)
+		node = compile_form(body);
+	node->jit_code = code;
+}
+
 struct s_expr *eval_expression(struct s_expr *expr)
 {
+	if (interp->engine == ENGINE_CLOSURE && expr->type == CELL)
+		return eval_compiled(expr);
 	// Only 'call' lists, not booleans
 	if (is_list(expr) && expr->type != BOOLEAN)
 		return eval_list(expr);
@@ -1,5 +1,7 @@
 /**
  * evaluator.h - Interface for executing an s-expression
+ *
+ * These functions work on the current interpreter (see interpreter.h).
  */
 
 #ifndef EVAL
@@ -18,7 +20,8 @@ int get_eval_error(char *buffer, int buffer_size);
 /**
  * start_evaluator() - Initiates the evaluator
  *
- * Run before all other function calls from this module.
+ * Run before all other function calls from this module. It defines the
+ * builtins in the environment.
  */
 void start_evaluator(void);
 
@@ -28,4 +31,191 @@ void start_evaluator(void);
  */
 struct s_expr *eval_expression(struct s_expr *expr);
 
+/**
+ * eval_apply() - Calls a lambda or builtin on already evaluated values
+ * @fn - the function; is_function(fn) must hold
+ * @values - the argument values, which are not evaluated again
+ */
+struct s_expr *eval_apply(struct s_expr *fn, struct fn_arguments *values);
+
+/**
+ * eval_copy() - Deep-copies a value into objects of the current interpreter
+ * @value
+ * @returns the copy, which shares nothing mutable with `value`, or NULL if
+ * `value` holds something that can't be copied, such as a future
+ *
+ * This is how actors send each other messages (see mailbox.h).
+ */
+struct s_expr *eval_copy(struct s_expr *value);
+
+/*
+ * The functions below are shared with the modules the evaluator is split
+ * into: the macro expander (see macro.h), the folder (see fold.h), the closure
+ * engine (see closure.h) and the JIT (see lower.h).
+ */
+
+/**
+ * set_error_message() - Sets the message get_eval_error() returns
+ * @message - copied, so it may be a temporary
+ */
+void set_error_message(char *message);
+
+/**
+ * free_arguments() - Frees an argument list, but not the values in it
+ * @args
+ */
+void free_arguments(struct fn_arguments *args);
+
+/**
+ * push_argument() - Adds a node holding `value` to the end of an argument
+ * list
+ * @first - the first node, or NULL for an empty list
+ * @last - the last node, or NULL for an empty list
+ * @value
+ */
+void push_argument(struct fn_arguments **first,
+	struct fn_arguments **last, struct s_expr *value);
+
+/**
+ * is_self_evaluating() - Whether eval_expression() returns `value` unchanged
+ * @value
+ */
+int is_self_evaluating(struct s_expr *value);
+
+/**
+ * quoted() - Wraps `value` as (quote value), with the quote builtin itself in
+ * operator position
+ * @value
+ */
+struct s_expr *quoted(struct s_expr *value);
+
+/**
+ * call_builtin() - Calls a builtin on its unevaluated operands, recording the
+ * call in the profile
+ * @builtin
+ * @args
+ */
+struct s_expr *call_builtin(struct builtin_function *builtin,
+	struct fn_arguments *args);
+
+/**
+ * new_lambda() - Makes a lambda of `body`
+ * @arg_names - the parameters
+ * @body
+ * @source - what `body` was folded from, or NULL if it wasn't
+ */
+struct s_expr *new_lambda(struct s_expr *arg_names,
+	struct s_expr *body, struct s_expr *source);
+
+/**
+ * define_function() - Binds the name in `signature`, (name args ...), to a
+ * lambda of `body`
+ * @signature
+ * @body
+ * @source - what `body` was folded from, or NULL if it wasn't
+ */
+struct s_expr *define_function(struct s_expr *signature,
+	struct s_expr *body, struct s_expr *source);
+
+/*
+ * Builtins that the other modules recognise by their function, such as the
+ * special forms and the builtins folded or compiled inline. Each takes its
+ * unevaluated operands.
+ */
+struct s_expr *quote(struct fn_arguments *args);
+struct s_expr *cond(struct fn_arguments *args);
+struct s_expr *lambda_(struct fn_arguments *args);
+struct s_expr *define_(struct fn_arguments *args);
+struct s_expr *define_memoized(struct fn_arguments *args);
+struct s_expr *and(struct fn_arguments *args);
+struct s_expr *or(struct fn_arguments *args);
+struct s_expr *delay(struct fn_arguments *args);
+struct s_expr *delay_force(struct fn_arguments *args);
+struct s_expr *cons_stream(struct fn_arguments *args);
+struct s_expr *add(struct fn_arguments *args);
+struct s_expr *subtract(struct fn_arguments *args);
+struct s_expr *multiply(struct fn_arguments *args);
+struct s_expr *quotient(struct fn_arguments *args);
+struct s_expr *remainder_(struct fn_arguments *args);
+struct s_expr *modulo(struct fn_arguments *args);
+struct s_expr *less(struct fn_arguments *args);
+struct s_expr *greater(struct fn_arguments *args);
+struct s_expr *numbers_equal(struct fn_arguments *args);
+struct s_expr *less_equal(struct fn_arguments *args);
+struct s_expr *greater_equal(struct fn_arguments *args);
+struct s_expr *is_empty(struct fn_arguments *args);
+struct s_expr *is_list_(struct fn_arguments *args);
+struct s_expr *is_symbol(struct fn_arguments *args);
+struct s_expr *is_string(struct fn_arguments *args);
+struct s_expr *string_length(struct fn_arguments *args);
+struct s_expr *are_equal(struct fn_arguments *args);
+struct s_expr *are_eq(struct fn_arguments *args);
+struct s_expr *length(struct fn_arguments *args);
+struct s_expr *car(struct fn_arguments *args);
+struct s_expr *cdr(struct fn_arguments *args);
+struct s_expr *list_tail(struct fn_arguments *args);
+struct s_expr *list_ref(struct fn_arguments *args);
+struct s_expr *last_pair(struct fn_arguments *args);
+
+/*
+ * The functions below are what code compiled ahead of time (see aot.h) calls
+ * back into. Those that return an s-expression return NULL on error, with the
+ * message set as the evaluator would set it.
+ */
+
+/**
+ * eval_lookup() - Returns the value bound to `symbol`
+ * @symbol
+ */
+struct s_expr *eval_lookup(char *symbol);
+
+/**
+ * eval_call_builtin() - Calls a builtin on the operands of a form
+ * @builtin - the value the operator of `form` evaluated to
+ * @form - the call, whose operands the builtin evaluates
+ */
+struct s_expr *eval_call_builtin(struct s_expr *builtin, struct s_expr *form);
+
+/**
+ * eval_resume_builtin() - Finishes a call to a builtin whose first operands
+ * have been evaluated
+ * @builtin
+ * @form - the call
+ * @values - the values of the first `count` operands
+ * @count
+ *
+ * The builtin evaluates the rest of the operands, so that any error is its
+ * own.
+ */
+struct s_expr *eval_resume_builtin(struct s_expr *builtin,
+	struct s_expr *form, struct s_expr **values, int count);
+
+/**
+ * eval_apply_lambda() - Calls values[0], a lambda, on the rest of `values`
+ * @values
+ * @count - the number of values, the lambda included
+ */
+struct s_expr *eval_apply_lambda(struct s_expr **values, int count);
+
+/**
+ * eval_tail_call() - Prepares a call from the end of a lambda's body to a
+ * lambda with the same body
+ * @body - the body the call is made from
+ * @values - the lambda, and the values of the arguments
+ * @count - the number of values, the lambda included
+ * @returns 1 if the parameters have been rebound in place of the running
+ * call's, so that the caller can run `body` again, and 0 if the call must be
+ * made with eval_apply_lambda()
+ *
+ * The caller must only call this where `body` has no define.
+ */
+int eval_tail_call(struct s_expr *body, struct s_expr **values, int count);
+
+/**
+ * eval_set_native() - Gives the body of lambdas compiled code
+ * @body - the body of a lambda
+ * @code - a function that evaluates `body`
+ */
+void eval_set_native(struct s_expr *body, struct s_expr *(*code)(void));
+
 #endif
@@ -0,0 +1,602 @@
+/**
+ * fold.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "hash_table.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "evaluator.h"
+#include "macro.h"
+#include "fold.h"
+
+/*
+ * What folded lambda and define forms call: (lambda params body source) and
+ * (define (name params ...) body source), with `source` the body as read. No
+ * name is bound to them, so programs never see the extra operand.
+ */
+struct s_expr *folded_lambda(struct fn_arguments *args)
+{
+	return new_lambda(args->value, args->next->value,
+		args->next->next->value);
+}
+
+struct s_expr *folded_define(struct fn_arguments *args)
+{
+	return define_function(args->value, args->next->value,
+		args->next->next->value);
+}
+
+// The builtins called while folding
+static struct s_expr *(*const pure_builtins[])(struct fn_arguments *) = {
+	add, subtract, multiply, quotient, remainder_, modulo, less, greater,
+	numbers_equal, less_equal, greater_equal, is_empty, is_list_,
+	is_symbol, is_string, string_length, are_equal, are_eq, length,
+	car, cdr, list_tail, list_ref, last_pair
+};
+
+static int is_pure(struct s_expr *(*function)(struct fn_arguments *))
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(pure_builtins) / sizeof(*pure_builtins); i++) {
+		if (pure_builtins[i] == function)
+			return 1;
+	}
+	return 0;
+}
+
+// Whether `function` returns a part of an operand.
+static int is_selector(struct s_expr *(*function)(struct fn_arguments *))
+{
+	return function == car || function == cdr || function == list_tail
+		|| function == list_ref || function == last_pair;
+}
+
+// Whether `function` is a special form, which doesn't evaluate its operands
+// the way calls do.
+static int is_special(struct s_expr *(*function)(struct fn_arguments *))
+{
+	return function == quote || function == cond || function == lambda_
+		|| function == define_ || function == define_memoized
+		|| function == define_syntax || function == and
+		|| function == or || function == delay
+		|| function == delay_force || function == cons_stream
+		|| function == folded_lambda || function == folded_define;
+}
+
+// Records that a form binds `name`, with define-syntax if `syntax` is set.
+static void bind_name(struct s_expr *name, int syntax)
+{
+	struct s_expr *reliance = interp->folded != NULL
+		? hash_table_get(interp->folded, name) : NULL;
+
+	if (interp->bound == NULL)
+		interp->bound = hash_table_create(HASH_EQUAL);
+	if (syntax || hash_table_get(interp->bound, name) == NULL)
+		hash_table_set(interp->bound, name,
+			s_expr_from_boolean(syntax));
+	if (reliance != NULL && (syntax || !is_empty_list(reliance)))
+		interp->unfolded = 1;
+}
+
+// Records the symbols of `list` as bound.
+static void bind_names(struct s_expr *list)
+{
+	for (; list->type == CELL; list = list->value->cell->rest) {
+		if (list->value->cell->first->type == SYMBOL)
+			bind_name(list->value->cell->first, 0);
+	}
+}
+
+// The builtin `expr` evaluates to as an operator, or NULL.
+static struct builtin_function *operator_builtin(struct s_expr *expr)
+{
+	struct s_expr *value = expr->type == SYMBOL
+		? get_env(expr->value->symbol) : expr;
+
+	return value != NULL && value->type == BUILTIN
+		? value->value->builtin : NULL;
+}
+
+static void scan_elements(struct s_expr *list)
+{
+	for (; list->type == CELL; list = list->value->cell->rest)
+		scan_binders(list->value->cell->first);
+}
+
+// Records the names `expr` binds, at any depth.
+void scan_binders(struct s_expr *expr)
+{
+	struct builtin_function *builtin;
+	struct s_expr *(*function)(struct fn_arguments *);
+	struct s_expr *operands;
+
+	if (expr->type == SYMBOL) {
+		builtin = operator_builtin(expr);
+		if (builtin != NULL && is_special(builtin->function))
+			interp->unfolded = 1;
+		return;
+	}
+	if (expr->type != CELL || !is_list(expr))
+		return;
+	builtin = operator_builtin(expr->value->cell->first);
+	function = builtin != NULL ? builtin->function : NULL;
+	operands = expr->value->cell->rest;
+	if (function == quote)
+		return;
+	if ((function == lambda_ || function == define_
+	|| function == define_memoized || function == define_syntax)
+	&& operands->type == CELL) {
+		struct s_expr *signature = operands->value->cell->first;
+
+		if (signature->type == SYMBOL)
+			bind_name(signature, function == define_syntax);
+		else if (function != define_syntax)
+			bind_names(signature);
+		// The rules of a macro are scanned as they are expanded.
+		if (function != define_syntax)
+			scan_elements(operands->value->cell->rest);
+		return;
+	}
+	if (function == cond) {
+		for (; operands->type == CELL;
+		operands = operands->value->cell->rest)
+			scan_elements(operands->value->cell->first);
+		return;
+	}
+	// An operator that is a symbol is called, not used as a value.
+	if (expr->value->cell->first->type != SYMBOL)
+		scan_binders(expr->value->cell->first);
+	scan_elements(operands);
+}
+
+// The builtin the operator `expr` is bound to, if no form binds it, or NULL.
+static struct builtin_function *known_builtin(struct s_expr *expr)
+{
+	if (expr->type == SYMBOL && interp->bound != NULL
+	&& hash_table_get(interp->bound, expr) != NULL)
+		return NULL;
+	return operator_builtin(expr);
+}
+
+// Records that a fold relied on what the operator `expr` is bound to.
+static void rely_on(struct s_expr *expr)
+{
+	if (expr->type != SYMBOL)
+		return;
+	if (interp->folded == NULL)
+		interp->folded = hash_table_create(HASH_EQUAL);
+	hash_table_set(interp->folded, expr, s_expr_from_boolean(1));
+}
+
+// Records that the operands of a call to `expr` were folded.
+static void note_call(struct s_expr *expr)
+{
+	if (interp->folded == NULL)
+		interp->folded = hash_table_create(HASH_EQUAL);
+	if (hash_table_get(interp->folded, expr) == NULL)
+		hash_table_set(interp->folded, expr, s_expr_from_boolean(0));
+}
+
+static struct s_expr *quote_operand(struct s_expr *form)
+{
+	return form->value->cell->rest->value->cell->first;
+}
+
+// Whether `expr` evaluates to a value known before it is evaluated.
+static int is_constant(struct s_expr *expr)
+{
+	struct builtin_function *builtin;
+
+	if (is_self_evaluating(expr))
+		return 1;
+	if (expr->type != CELL || !is_list(expr) || list_length(expr) != 2)
+		return 0;
+	builtin = known_builtin(expr->value->cell->first);
+	if (builtin == NULL || builtin->function != quote)
+		return 0;
+	rely_on(expr->value->cell->first);
+	return 1;
+}
+
+// The value of a constant.
+static struct s_expr *constant_value(struct s_expr *expr)
+{
+	return is_self_evaluating(expr) ? expr : quote_operand(expr);
+}
+
+// Makes a form that evaluates to `value`.
+static struct s_expr *constant_form(struct s_expr *value)
+{
+	struct s_expr *quote_name = s_expr_from_symbol("quote");
+	struct builtin_function *builtin;
+
+	if (is_self_evaluating(value))
+		return value;
+	// The quote special form is quicker to run than quoted().
+	builtin = known_builtin(quote_name);
+	if (builtin == NULL || builtin->function != quote)
+		return quoted(value);
+	rely_on(quote_name);
+	return cons_onto(quote_name, cons_onto(value, empty_list));
+}
+
+static struct s_expr *fold_form(struct s_expr *expr);
+
+// Folds the elements of `list` from the one at `start` on.
+static struct s_expr *fold_elements(struct s_expr *list, int start)
+{
+	struct list_builder folded;
+	struct s_expr *rest;
+	int changed = 0;
+	int i;
+
+	list_builder_init(&folded);
+	for (i = 0, rest = list; rest->type == CELL;
+	i++, rest = rest->value->cell->rest) {
+		struct s_expr *element = rest->value->cell->first;
+		struct s_expr *result = i >= start
+			? fold_form(element) : element;
+
+		// Copy the list from the first element that changes.
+		if (result != element && !changed) {
+			struct s_expr *copy;
+
+			for (copy = list; copy != rest;
+			copy = copy->value->cell->rest)
+				list_builder_push(&folded,
+					copy->value->cell->first);
+			changed = 1;
+		}
+		if (changed)
+			list_builder_push(&folded, result);
+	}
+	return changed ? list_builder_finish(&folded, rest) : list;
+}
+
+/*
+ * Calls `builtin` on the constant operands of `form`, returning the constant
+ * it gives or NULL. Errors are left to be reported when the form runs.
+ */
+static struct s_expr *fold_call(struct s_expr *form,
+	struct builtin_function *builtin)
+{
+	struct fn_arguments *first_arg = NULL;
+	struct fn_arguments *last_arg = NULL;
+	struct s_expr *operand;
+	struct s_expr *value;
+
+	for (operand = form->value->cell->rest; operand->type == CELL;
+	operand = operand->value->cell->rest) {
+		if (!is_constant(operand->value->cell->first)) {
+			free_arguments(first_arg);
+			return NULL;
+		}
+		push_argument(&first_arg, &last_arg,
+			operand->value->cell->first);
+	}
+	value = builtin->function(first_arg);
+	free_arguments(first_arg);
+	if (value == NULL)
+		return NULL;
+	if (!is_selector(builtin->function) && value->type != INTEGER
+	&& value->type != BOOLEAN && value->type != SYMBOL
+	&& value->type != EMPTY_LIST)
+		return NULL;
+	return constant_form(value);
+}
+
+// Folds the clauses of a cond, dropping those that never run.
+static struct s_expr *fold_cond(struct s_expr *expr)
+{
+	struct list_builder folded;
+	struct s_expr *clauses;
+	int changed = 0;
+	int kept = 0;
+
+	list_builder_init(&folded);
+	list_builder_push(&folded, expr->value->cell->first);
+	for (clauses = expr->value->cell->rest; clauses->type == CELL;
+	clauses = clauses->value->cell->rest) {
+		struct s_expr *clause = clauses->value->cell->first;
+		struct s_expr *result;
+		struct s_expr *bodies;
+
+		// Malformed clauses are reported when they are reached.
+		if (!is_list(clause) || list_length(clause) < 2)
+			break;
+		bodies = clause->value->cell->rest;
+		if (is_keyword(clause->value->cell->first, "else")) {
+			if (!kept && clauses->value->cell->rest->type != CELL
+			&& bodies->value->cell->rest->type != CELL) {
+				rely_on(expr->value->cell->first);
+				return fold_form(bodies->value->cell->first);
+			}
+			result = fold_elements(clause, 1);
+			changed |= result != clause;
+			list_builder_push(&folded, result);
+			clauses = clauses->value->cell->rest;
+			break;
+		}
+		result = fold_elements(clause, 0);
+		bodies = result->value->cell->rest;
+		if (is_constant(result->value->cell->first)) {
+			changed = 1;
+			if (is_empty_list(constant_value(
+			result->value->cell->first)))
+				continue;
+			// The clause runs whenever the cond gets to it.
+			if (!kept && bodies->value->cell->rest->type != CELL) {
+				rely_on(expr->value->cell->first);
+				return bodies->value->cell->first;
+			}
+			list_builder_push(&folded, result);
+			kept++;
+			clauses = empty_list;
+			break;
+		}
+		changed |= result != clause;
+		list_builder_push(&folded, result);
+		kept++;
+	}
+	if (!changed)
+		return expr;
+	rely_on(expr->value->cell->first);
+	if (!kept && clauses->type != CELL)
+		return constant_form(empty_list);
+	return list_builder_finish(&folded, clauses);
+}
+
+// Folds the operands of an and, or of an or if `is_or` is set.
+static struct s_expr *fold_connective(struct s_expr *expr, int is_or)
+{
+	struct list_builder folded;
+	struct s_expr *operands;
+	int changed = 0;
+	int kept = 0;
+
+	list_builder_init(&folded);
+	list_builder_push(&folded, expr->value->cell->first);
+	for (operands = expr->value->cell->rest; operands->type == CELL;
+	operands = operands->value->cell->rest) {
+		struct s_expr *operand = operands->value->cell->first;
+		struct s_expr *result = fold_form(operand);
+		int last = operands->value->cell->rest->type != CELL;
+		int decides;
+
+		changed |= result != operand;
+		if (!is_constant(result)) {
+			list_builder_push(&folded, result);
+			kept++;
+			continue;
+		}
+		// A true operand ends an or, and a false one an and.
+		decides = is_empty_list(constant_value(result)) != is_or;
+		if (!decides && !(last && !is_or)) {
+			changed = 1;
+			continue;
+		}
+		changed |= !last;
+		if (!kept) {
+			rely_on(expr->value->cell->first);
+			// and gives #f for any false value.
+			return is_or || !decides
+				? result : s_expr_from_boolean(0);
+		}
+		list_builder_push(&folded, result);
+		kept++;
+		break;
+	}
+	if (!changed)
+		return expr;
+	rely_on(expr->value->cell->first);
+	if (!kept)
+		return s_expr_from_boolean(!is_or);
+	return list_builder_finish(&folded, empty_list);
+}
+
+// Folds the body of a lambda or define form, keeping the body as read.
+static struct s_expr *fold_definition(struct s_expr *expr,
+	struct s_expr *folded_builtin)
+{
+	struct s_expr *operands = expr->value->cell->rest;
+	struct s_expr *body = operands->value->cell->rest->value->cell->first;
+	struct s_expr *result = fold_form(body);
+
+	if (result == body)
+		return expr;
+	rely_on(expr->value->cell->first);
+	return cons_onto(folded_builtin,
+		cons_onto(operands->value->cell->first,
+		cons_onto(result, cons_onto(body, empty_list))));
+}
+
+// Puts `values` in for the symbols `params` in `expr`, except where quoted.
+static struct s_expr *substitute(struct s_expr *expr, struct s_expr *params,
+	struct s_expr *values)
+{
+	struct builtin_function *builtin;
+	struct list_builder result;
+
+	if (expr->type == SYMBOL) {
+		for (; params->type == CELL;
+		params = params->value->cell->rest,
+		values = values->value->cell->rest) {
+			if (is_keyword(params->value->cell->first,
+			expr->value->symbol))
+				return values->value->cell->first;
+		}
+		return expr;
+	}
+	if (expr->type != CELL || !is_list(expr))
+		return expr;
+	builtin = known_builtin(expr->value->cell->first);
+	if (builtin != NULL && builtin->function == quote)
+		return expr;
+	list_builder_init(&result);
+	for (; expr->type == CELL; expr = expr->value->cell->rest)
+		list_builder_push(&result, substitute(expr->value->cell->first,
+			params, values));
+	return list_builder_finish(&result, empty_list);
+}
+
+/*
+ * Folds ((lambda (params ...) body) args ...), whose arguments are folded, to
+ * a constant, or returns NULL. Since the body can only fold to a constant if
+ * it calls nothing but pure builtins, it can't tell that its parameters were
+ * never bound.
+ */
+static struct s_expr *inline_lambda(struct s_expr *expr)
+{
+	struct s_expr *lambda = expr->value->cell->first;
+	struct s_expr *args = expr->value->cell->rest;
+	struct builtin_function *builtin;
+	struct s_expr *params;
+	struct s_expr *param;
+	struct s_expr *arg;
+	struct s_expr *body;
+
+	if (!is_list(lambda) || list_length(lambda) != 3)
+		return NULL;
+	builtin = known_builtin(lambda->value->cell->first);
+	if (builtin == NULL || builtin->function != lambda_)
+		return NULL;
+	params = lambda->value->cell->rest->value->cell->first;
+	if (!is_list(params) || list_length(params) != list_length(args))
+		return NULL;
+	for (param = params, arg = args; param->type == CELL;
+	param = param->value->cell->rest, arg = arg->value->cell->rest) {
+		struct s_expr *name = param->value->cell->first;
+		struct s_expr *other;
+
+		// cond gives else a meaning of its own.
+		if (name->type != SYMBOL || is_keyword(name, "else")
+		|| !is_constant(arg->value->cell->first))
+			return NULL;
+		for (other = param->value->cell->rest; other->type == CELL;
+		other = other->value->cell->rest) {
+			if (is_keyword(other->value->cell->first,
+			name->value->symbol))
+				return NULL;
+		}
+	}
+	body = fold_form(substitute(lambda->value->cell->rest->value->cell->rest
+		->value->cell->first, params, args));
+	if (!is_constant(body))
+		return NULL;
+	rely_on(lambda->value->cell->first);
+	return body;
+}
+
+// Folds a call whose operator is itself a form.
+static struct s_expr *fold_application(struct s_expr *expr)
+{
+	struct s_expr *folded = fold_elements(expr, 1);
+	struct s_expr *operator = folded->value->cell->first;
+	struct s_expr *result = inline_lambda(folded);
+
+	if (result != NULL)
+		return result;
+	result = fold_form(operator);
+	return result != operator
+		? cons_onto(result, folded->value->cell->rest) : folded;
+}
+
+static struct s_expr *fold_form(struct s_expr *expr)
+{
+	struct s_expr *(*function)(struct fn_arguments *);
+	struct builtin_function *builtin;
+	struct s_expr *operator;
+	struct s_expr *folded;
+	struct s_expr *value;
+
+	if (expr->type != CELL || !is_list(expr))
+		return expr;
+	operator = expr->value->cell->first;
+	if (operator->type == CELL)
+		return fold_application(expr);
+	builtin = known_builtin(operator);
+	if (builtin == NULL) {
+		if (operator->type != SYMBOL)
+			return expr;
+		// A name not bound yet may be bound to a macro later, which
+		// undoes this.
+		value = get_env(operator->value->symbol);
+		if (value != NULL && value->type != LAMBDA
+		&& (value->type != BUILTIN
+		|| is_special(value->value->builtin->function)))
+			return expr;
+		folded = fold_elements(expr, 1);
+		if (folded != expr)
+			note_call(operator);
+		return folded;
+	}
+	function = builtin->function;
+	if (function == cond)
+		return fold_cond(expr);
+	if (function == and || function == or)
+		return fold_connective(expr, function == or);
+	if ((function == lambda_ || function == define_)
+	&& list_length(expr) == 3) {
+		struct s_expr *signature =
+			expr->value->cell->rest->value->cell->first;
+
+		if (function == lambda_)
+			return fold_definition(expr, interp->folded_lambda);
+		if (signature->type == CELL)
+			return fold_definition(expr, interp->folded_define);
+		if (signature->type != SYMBOL)
+			return expr;
+		folded = fold_elements(expr, 2);
+		if (folded != expr)
+			note_call(operator);
+		return folded;
+	}
+	if (is_special(function))
+		return expr;
+	folded = fold_elements(expr, 1);
+	if (is_pure(function)) {
+		value = fold_call(folded, builtin);
+		if (value != NULL) {
+			rely_on(operator);
+			return value;
+		}
+	}
+	if (folded != expr)
+		note_call(operator);
+	return folded;
+}
+
+struct s_expr *fold_expression(struct s_expr *expr)
+{
+	// A profile shows the calls the program makes as written.
+	if (!interp->folding || interp->unfolded || interp->profiling)
+		return expr;
+	scan_binders(expr);
+	return interp->unfolded ? expr : fold_form(expr);
+}
+
+void free_folds(void)
+{
+	if (interp->folded != NULL)
+		hash_table_free(interp->folded);
+	if (interp->bound != NULL)
+		hash_table_free(interp->bound);
+	interp->folded = NULL;
+	interp->bound = NULL;
+}
+
+void note_binding(struct s_expr *id)
+{
+	struct s_expr *reliance;
+
+	if (interp->folded == NULL || interp->unfolded)
+		return;
+	reliance = hash_table_get(interp->folded, id);
+	if (reliance != NULL && !is_empty_list(reliance))
+		interp->unfolded = 1;
+}
+
@@ -0,0 +1,83 @@
+/**
+ * fold.h - Replaces the parts of forms whose values are known
+ *
+ * After its macros are expanded and before it is evaluated, a top-level form
+ * is folded: the parts of it whose values are known are replaced by those
+ * values (see fold_expression()). That is,
+ *
+ *   - a call to one of pure_builtins on constant operands, when it succeeds
+ *     and gives a value that can't be told from a new one: an integer, a
+ *     boolean, a symbol or the empty list, or for selectors a part of an
+ *     operand;
+ *   - a cond clause with a constant test, which is dropped if the test is
+ *     false and ends the cond if it is true;
+ *   - a constant operand of and or or, which is dropped or ends the form;
+ *   - ((lambda (params ...) body) args ...) with constant arguments, when the
+ *     body with the arguments put in for the parameters folds to a constant.
+ *
+ * Constants are values that evaluate to themselves and quoted forms. Calls to
+ * other builtins, to lambdas and to names not bound yet have their operands
+ * folded; the operands of special forms that don't evaluate them are left
+ * alone.
+ *
+ * A fold relies on the names involved being bound as they were. Scope is
+ * dynamic, so any define or parameter of that name, anywhere, could change
+ * them. Before a form is folded, every name it binds is recorded in
+ * interp->bound, and folds never rely on such names. A fold records the names
+ * it relied on in interp->folded, and each name whose operands it folded; if
+ * a later form binds one of the first, or a later define-syntax one of the
+ * second, or define binds one of the first as the program runs,
+ * interp->unfolded is set. From then on nothing more is folded, and lambdas
+ * run the bodies they were folded from, which folded lambda and define forms
+ * pass as a third operand; a body that is already running finishes as it
+ * was folded. A form that uses a special form as a value, as in
+ * (apply define ...), could bind anything, so it sets interp->unfolded too.
+ */
+#ifndef FOLD_H
+#define FOLD_H
+#include "parser.h"
+
+/**
+ * fold_expression() - Replaces the parts of a form whose values are known
+ * by those values
+ * @expr - a form whose macros are expanded
+ * @returns the folded form, or `expr` if nothing in it could be folded
+ *
+ * Folding gives the same values and errors as evaluating `expr` would, even
+ * if the builtins it relied on are bound again later. It does nothing while
+ * calls are being profiled, or after interpreter_set_folding() turned it off.
+ */
+struct s_expr *fold_expression(struct s_expr *expr);
+
+/**
+ * free_folds() - Forgets which names folds relied on
+ */
+void free_folds(void);
+
+/**
+ * scan_binders() - Records the names `expr` binds, at any depth, in
+ * interp->bound
+ * @expr
+ */
+void scan_binders(struct s_expr *expr);
+
+/**
+ * note_binding() - Undoes folding if a fold relied on what `id` was bound to
+ * @id - a symbol that define is about to bind again
+ */
+void note_binding(struct s_expr *id);
+
+/**
+ * folded_lambda() - What folded lambda forms call, (lambda params body source)
+ * @args
+ */
+struct s_expr *folded_lambda(struct fn_arguments *args);
+
+/**
+ * folded_define() - What folded define forms call,
+ * (define (name params ...) body source)
+ * @args
+ */
+struct s_expr *folded_define(struct fn_arguments *args);
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * form_cache.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "form_cache.h"
+#include "image.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static char *join_path(char *dir, char *name)
+{
+	char *path = (char *) malloc(strlen(dir) + strlen(name) + 2);
+
+	if (path == NULL) {
+		printf("Out of memory, cannot build a path.\n");
+		exit(1);
+	}
+	sprintf(path, "%s/%s", dir, name);
+	return path;
+}
+
+char *form_cache_default_dir(void)
+{
+	char *dir = getenv("SCHEME_CACHE_DIR");
+
+	if (dir != NULL && dir[0] != '\0')
+		return strdup(dir);
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir != NULL && dir[0] != '\0')
+		return join_path(dir, "scheme-forms");
+	dir = getenv("HOME");
+	if (dir != NULL && dir[0] != '\0')
+		return join_path(dir, ".cache/scheme-forms");
+	return NULL;
+}
+
+char *form_cache_entry(char *dir, char *source, size_t length)
+{
+	uint64_t hash = FNV_OFFSET;
+	char name[64];
+	size_t i;
+
+	// FNV-1a
+	for (i = 0; i < length; i++) {
+		hash ^= (unsigned char) source[i];
+		hash *= FNV_PRIME;
+	}
+	sprintf(name, "%016llx-%llx.forms", (unsigned long long) hash,
+		(unsigned long long) length);
+	return join_path(dir, name);
+}
+
+struct s_expr *form_cache_load(struct interpreter *in, char *entry,
+	char *source, size_t length)
+{
+	struct s_expr *forms;
+	struct string *saved;
+
+	if (access(entry, R_OK))
+		return NULL;
+	forms = image_read_forms(in, entry);
+	if (forms == NULL || forms->type != CELL
+	|| forms->value->cell->first->type != STRING)
+		return NULL;
+	// Another text may have the same hash and length.
+	saved = forms->value->cell->first->value->string;
+	if ((size_t) saved->length != length
+	|| memcmp(saved->chars, source, length))
+		return NULL;
+	return forms->value->cell->rest;
+}
+
+// Creates every missing directory above `path`, like mkdir -p.
+static void make_parents(char *path)
+{
+	char *copy = strdup(path);
+	char *slash;
+
+	if (copy == NULL)
+		return;
+	for (slash = strchr(copy + 1, '/'); slash != NULL;
+	slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		mkdir(copy, 0755);
+		*slash = '/';
+	}
+	free(copy);
+}
+
+void form_cache_store(struct interpreter *in, char *entry, char *source,
+	size_t length, struct s_expr **forms, size_t count)
+{
+	char *temp = (char *) malloc(strlen(entry) + 32);
+	struct interpreter *prev;
+	struct list_builder list;
+	size_t i;
+
+	if (temp == NULL || length > INT_MAX) {
+		free(temp);
+		return;
+	}
+	prev = interpreter_enter(in);
+	list_builder_init(&list);
+	// The source goes first, for form_cache_load() to check.
+	list_builder_push(&list, s_expr_from_string(source, (int) length));
+	for (i = 0; i < count; i++)
+		list_builder_push(&list, forms[i]);
+	interpreter_enter(prev);
+	make_parents(entry);
+	sprintf(temp, "%s.%ld.tmp", entry, (long) getpid());
+	if (image_write_forms(in, temp,
+	list_builder_finish(&list, empty_list)))
+		rename(temp, entry);
+	else
+		unlink(temp);
+	free(temp);
+}
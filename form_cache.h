@@ -0,0 +1,62 @@
+/**
+ * form_cache.h - A cache of parsed scripts on disk
+ *
+ * A script's forms are saved as an image (see image.h) under a name made from
+ * a hash of its source text and the text's length, so that running a script
+ * whose source is unchanged maps the forms in and skips the reader. The entry
+ * also holds the source text, which is compared with the script's, so that a
+ * text with the same hash and length is never given another's forms. The
+ * image header records the build that wrote it; an entry from another build,
+ * or for another text, is treated as a miss and overwritten.
+ *
+ * Entries are written to a temporary file and renamed into place, so that
+ * scripts run at the same time never see half-written entries. The cache is
+ * only an optimization: errors reading or writing it are ignored. The shell
+ * only uses it when asked to (see shell.c).
+ */
+#ifndef FORM_CACHE
+#define FORM_CACHE
+#include <stdlib.h>
+#include "interpreter.h"
+
+/**
+ * form_cache_default_dir() - Returns the directory used when none is given
+ * @returns $SCHEME_CACHE_DIR, else $XDG_CACHE_HOME/scheme-forms, else
+ * $HOME/.cache/scheme-forms, in a string to free(); or NULL if none is set
+ */
+char *form_cache_default_dir(void);
+
+/**
+ * form_cache_entry() - Returns the path of the entry for a source text
+ * @dir - the cache directory
+ * @source
+ * @length - the number of bytes in `source`
+ * @returns the path, in a string to free()
+ */
+char *form_cache_entry(char *dir, char *source, size_t length);
+
+/**
+ * form_cache_load() - Maps the forms saved in an entry
+ * @in
+ * @entry - a path from form_cache_entry()
+ * @source - the text the entry is for
+ * @length - the number of bytes in `source`
+ * @returns the list of forms, or NULL if the entry is missing, unusable or
+ * was saved for another text
+ */
+struct s_expr *form_cache_load(struct interpreter *in, char *entry,
+	char *source, size_t length);
+
+/**
+ * form_cache_store() - Saves forms to an entry
+ * @in
+ * @entry - a path from form_cache_entry(), whose directory is created if needed
+ * @source - the text the forms were read from
+ * @length - the number of bytes in `source`
+ * @forms - the forms, in order
+ * @count - the number of forms
+ */
+void form_cache_store(struct interpreter *in, char *entry, char *source,
+	size_t length, struct s_expr **forms, size_t count);
+
+#endif
@@ -0,0 +1,348 @@
+/**
+ * hash_table.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "hash_table.h"
+
+#define INITIAL_SIZE 8
+// Grow when count > size * LOAD_NUMERATOR / LOAD_DENOMINATOR
+#define LOAD_NUMERATOR 3
+#define LOAD_DENOMINATOR 4
+// Old buckets moved to the new array on each operation during a resize. Must
+// be at least 2 so that a resize always finishes before the next one is due.
+#define MIGRATE_STEP 4
+// How many list elements and nesting levels equal-hashing looks at
+#define MAX_HASH_LENGTH 16
+#define MAX_HASH_DEPTH 4
+
+static unsigned long mix(unsigned long hash, unsigned long value)
+{
+	hash ^= value + 0x9e3779b97f4a7c15UL + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+static unsigned long hash_chars(char *chars, int length)
+{
+	unsigned long hash = 14695981039346656037UL;
+	int i;
+
+	for (i = 0; i < length; i++) {
+		hash ^= (unsigned char) chars[i];
+		hash *= 1099511628211UL;
+	}
+	return hash;
+}
+
+static unsigned long hash_atom(struct s_expr *expr)
+{
+	unsigned long hash = expr->type;
+
+	if (expr->type == BOOLEAN)
+		return mix(hash, expr->value->boolean);
+	if (expr->type == INTEGER)
+		return mix(hash, (unsigned long) expr->value->integer);
+	if (expr->type == SYMBOL)
+		return mix(hash, hash_chars(expr->value->symbol,
+			strlen(expr->value->symbol)));
+	if (expr->type == CELL)
+		return mix(hash, (unsigned long) expr->value->cell);
+	if (expr->type == LAMBDA)
+		return mix(hash, (unsigned long) expr->value->lambda);
+	if (expr->type == BUILTIN)
+		return mix(hash, (unsigned long) expr->value->builtin);
+	if (expr->type == HASH_TABLE)
+		return mix(hash, (unsigned long) expr->value->table);
+	if (expr->type == STRING)
+		return mix(hash, (unsigned long) expr->value->string);
+	if (expr->type == STRING_BUILDER)
+		return mix(hash, (unsigned long) expr->value->builder);
+	if (expr->type == FUTURE)
+		return mix(hash, (unsigned long) expr->value->future);
+	if (expr->type == ACTOR)
+		return mix(hash, (unsigned long) expr->value->mailbox);
+	if (expr->type == GENERATOR)
+		return mix(hash, (unsigned long) expr->value->generator);
+	if (expr->type == PROMISE)
+		return mix(hash, (unsigned long) expr->value->promise);
+	if (expr->type == PORT)
+		return mix(hash, (unsigned long) expr->value->port);
+	if (expr->type == MACRO)
+		return mix(hash, (unsigned long) expr->value->macro);
+	// expr is the empty list
+	return hash;
+}
+
+/*
+ * Only a bounded prefix of each list is hashed. Lists that differ beyond that
+ * prefix share a hash, which is still consistent with equal.
+ */
+static unsigned long hash_equal(struct s_expr *expr, int depth)
+{
+	unsigned long hash = CELL;
+	int length = 0;
+
+	if (expr->type == STRING) {
+		return mix(STRING, hash_chars(expr->value->string->chars,
+			expr->value->string->length));
+	}
+	if (expr->type != CELL)
+		return hash_atom(expr);
+	if (depth == MAX_HASH_DEPTH)
+		return hash;
+
+	while (expr->type == CELL && length < MAX_HASH_LENGTH) {
+		hash = mix(hash, hash_equal(expr->value->cell->first,
+			depth + 1));
+		expr = expr->value->cell->rest;
+		length++;
+	}
+	if (expr->type != CELL)
+		hash = mix(hash, hash_equal(expr, depth + 1));
+	return hash;
+}
+
+unsigned long hash_s_expr(struct s_expr *expr, enum hash_kind kind)
+{
+	if (kind == HASH_EQ)
+		return hash_atom(expr);
+	return hash_equal(expr, 0);
+}
+
+static int keys_match(struct hash_table *table, struct s_expr *a,
+	struct s_expr *b)
+{
+	if (table->kind == HASH_EQ)
+		return eq(a, b);
+	return equal(a, b);
+}
+
+static struct hash_entry **alloc_buckets(unsigned long size)
+{
+	struct hash_entry **buckets = (struct hash_entry **)
+		calloc(size, sizeof(struct hash_entry *));
+
+	if (buckets == NULL) {
+		printf("Out of memory, hash table too large.\n");
+		exit(1);
+	}
+	return buckets;
+}
+
+struct hash_table *hash_table_create(enum hash_kind kind)
+{
+	struct hash_table *table = (struct hash_table *)
+		malloc(sizeof(struct hash_table));
+
+	table->kind = kind;
+	table->size = INITIAL_SIZE;
+	table->buckets = alloc_buckets(table->size);
+	table->old_buckets = NULL;
+	table->old_size = 0;
+	table->migrate_index = 0;
+	table->count = 0;
+	pthread_mutex_init(&table->lock, NULL);
+	return table;
+}
+
+/*
+ * Moves up to `steps` buckets from the old array into the new one. Empty
+ * buckets count as a step too, which keeps the work per call bounded.
+ */
+static void migrate(struct hash_table *table, unsigned long steps)
+{
+	while (table->old_buckets != NULL && steps > 0) {
+		struct hash_entry *entry =
+			table->old_buckets[table->migrate_index];
+
+		while (entry != NULL) {
+			struct hash_entry *next = entry->next;
+			unsigned long index = entry->hash & (table->size - 1);
+
+			entry->next = table->buckets[index];
+			table->buckets[index] = entry;
+			entry = next;
+		}
+		table->old_buckets[table->migrate_index] = NULL;
+		table->migrate_index++;
+		steps--;
+
+		if (table->migrate_index == table->old_size) {
+			free(table->old_buckets);
+			table->old_buckets = NULL;
+			table->old_size = 0;
+			table->migrate_index = 0;
+		}
+	}
+}
+
+static void grow(struct hash_table *table)
+{
+	// Finish any resize still in progress before starting another one.
+	migrate(table, table->old_size);
+
+	table->old_buckets = table->buckets;
+	table->old_size = table->size;
+	table->migrate_index = 0;
+	table->size *= 2;
+	table->buckets = alloc_buckets(table->size);
+}
+
+// Returns the link pointing at the entry for `key` within one bucket chain.
+static struct hash_entry **find_in_chain(struct hash_table *table,
+	struct hash_entry **link, struct s_expr *key, unsigned long hash)
+{
+	while (*link != NULL) {
+		struct hash_entry *entry = *link;
+
+		if (entry->hash == hash && keys_match(table, entry->key, key))
+			return link;
+		link = &entry->next;
+	}
+	return NULL;
+}
+
+/*
+ * Returns the link pointing at the entry for `key` (so that it can be
+ * unlinked), or NULL if there is no such entry.
+ */
+static struct hash_entry **find(struct hash_table *table, struct s_expr *key,
+	unsigned long hash)
+{
+	struct hash_entry **link = find_in_chain(table,
+		&table->buckets[hash & (table->size - 1)], key, hash);
+
+	if (link != NULL || table->old_buckets == NULL)
+		return link;
+	return find_in_chain(table,
+		&table->old_buckets[hash & (table->old_size - 1)], key, hash);
+}
+
+struct s_expr *hash_table_get(struct hash_table *table, struct s_expr *key)
+{
+	unsigned long hash = hash_s_expr(key, table->kind);
+	struct hash_entry **link;
+	struct s_expr *value = NULL;
+
+	pthread_mutex_lock(&table->lock);
+	link = find(table, key, hash);
+	if (link != NULL)
+		value = (*link)->value;
+	pthread_mutex_unlock(&table->lock);
+	return value;
+}
+
+void hash_table_set(struct hash_table *table, struct s_expr *key,
+	struct s_expr *value)
+{
+	unsigned long hash = hash_s_expr(key, table->kind);
+	struct hash_entry **link;
+
+	pthread_mutex_lock(&table->lock);
+	migrate(table, MIGRATE_STEP);
+	link = find(table, key, hash);
+	if (link != NULL) {
+		(*link)->value = value;
+		pthread_mutex_unlock(&table->lock);
+		return;
+	}
+
+	if ((unsigned long) table->count + 1
+	> table->size * LOAD_NUMERATOR / LOAD_DENOMINATOR)
+		grow(table);
+
+	struct hash_entry *entry = (struct hash_entry *)
+		malloc(sizeof(struct hash_entry));
+	unsigned long index = hash & (table->size - 1);
+
+	entry->key = key;
+	entry->value = value;
+	entry->hash = hash;
+	entry->next = table->buckets[index];
+	table->buckets[index] = entry;
+	table->count++;
+	pthread_mutex_unlock(&table->lock);
+}
+
+int hash_table_remove(struct hash_table *table, struct s_expr *key)
+{
+	unsigned long hash = hash_s_expr(key, table->kind);
+	struct hash_entry **link;
+
+	pthread_mutex_lock(&table->lock);
+	migrate(table, MIGRATE_STEP);
+	link = find(table, key, hash);
+	if (link == NULL) {
+		pthread_mutex_unlock(&table->lock);
+		return 0;
+	}
+
+	struct hash_entry *entry = *link;
+
+	*link = entry->next;
+	free(entry);
+	table->count--;
+	pthread_mutex_unlock(&table->lock);
+	return 1;
+}
+
+int hash_table_count(struct hash_table *table)
+{
+	int count;
+
+	pthread_mutex_lock(&table->lock);
+	count = table->count;
+	pthread_mutex_unlock(&table->lock);
+	return count;
+}
+
+static void free_chains(struct hash_entry **buckets, unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		while (buckets[i] != NULL) {
+			struct hash_entry *next = buckets[i]->next;
+
+			free(buckets[i]);
+			buckets[i] = next;
+		}
+	}
+	free(buckets);
+}
+
+void hash_table_free(struct hash_table *table)
+{
+	free_chains(table->buckets, table->size);
+	if (table->old_buckets != NULL)
+		free_chains(table->old_buckets, table->old_size);
+	pthread_mutex_destroy(&table->lock);
+	free(table);
+}
+
+static void for_each_bucket(struct hash_entry **buckets, unsigned long size,
+	void (*fn)(struct hash_entry *entry, void *data), void *data)
+{
+	unsigned long i;
+
+	for (i = 0; i < size; i++) {
+		struct hash_entry *entry = buckets[i];
+
+		while (entry != NULL) {
+			fn(entry, data);
+			entry = entry->next;
+		}
+	}
+}
+
+void hash_table_for_each(struct hash_table *table,
+	void (*fn)(struct hash_entry *entry, void *data), void *data)
+{
+	pthread_mutex_lock(&table->lock);
+	for_each_bucket(table->buckets, table->size, fn, data);
+	if (table->old_buckets != NULL)
+		for_each_bucket(table->old_buckets, table->old_size, fn, data);
+	pthread_mutex_unlock(&table->lock);
+}
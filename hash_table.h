@@ -0,0 +1,104 @@
+/**
+ * hash_table.h - Hash tables keyed by s-expressions
+ *
+ * Tables compare keys either with eq (identity, see parser.h) or with equal
+ * (structural). The hash functions below are consistent with the comparison
+ * of the table, so two keys that compare equal always hash to the same value.
+ */
+#ifndef HASH
+#define HASH
+#include <stdlib.h>
+#include <pthread.h>
+#include "parser.h"
+
+enum hash_kind { HASH_EQ, HASH_EQUAL };
+
+struct hash_entry {
+	struct s_expr *key;
+	struct s_expr *value;
+	unsigned long hash;
+	struct hash_entry *next;
+};
+
+/**
+ * hash_table - A chained hash table that grows incrementally
+ *
+ * When the table needs to grow, a bucket array twice the size is allocated and
+ * the old buckets are moved over a few at a time by each later operation, so
+ * no single insert pays for rehashing the whole table. While a resize is in
+ * progress, `old_buckets` is non-NULL and lookups consult both arrays.
+ *
+ * The functions below hold the table's lock, so that the threads of futures
+ * and pmap can share a table (see evaluator.c).
+ */
+struct hash_table {
+	enum hash_kind kind;
+	struct hash_entry **buckets;
+	unsigned long size;
+	struct hash_entry **old_buckets;
+	unsigned long old_size;
+	unsigned long migrate_index;
+	int count;
+	pthread_mutex_t lock;
+};
+
+/**
+ * hash_s_expr() - Hashes an s-expression
+ * @expr - the s-expression to hash
+ * @kind - HASH_EQ or HASH_EQUAL, matching the comparison that will be used
+ */
+unsigned long hash_s_expr(struct s_expr *expr, enum hash_kind kind);
+
+/**
+ * hash_table_create() - Allocates an empty hash table
+ * @kind - how keys are compared
+ */
+struct hash_table *hash_table_create(enum hash_kind kind);
+
+/**
+ * hash_table_get() - Looks up the value bound to `key`
+ * @table
+ * @key
+ * @returns the value, or NULL if `key` is not in the table
+ */
+struct s_expr *hash_table_get(struct hash_table *table, struct s_expr *key);
+
+/**
+ * hash_table_set() - Binds `value` to `key`, replacing any previous value
+ * @table
+ * @key
+ * @value
+ */
+void hash_table_set(struct hash_table *table, struct s_expr *key,
+	struct s_expr *value);
+
+/**
+ * hash_table_remove() - Removes `key` from the table
+ * @table
+ * @key
+ * @returns 1 if the key was present and 0 otherwise
+ */
+int hash_table_remove(struct hash_table *table, struct s_expr *key);
+
+/**
+ * hash_table_count() - Returns the number of entries in the table
+ * @table
+ */
+int hash_table_count(struct hash_table *table);
+
+/**
+ * hash_table_free() - Frees a table, but not its keys and values
+ * @table
+ */
+void hash_table_free(struct hash_table *table);
+
+/**
+ * hash_table_for_each() - Calls `fn` once for each entry in the table
+ * @table
+ * @fn - the callback; it must not use the table
+ * @data - passed through to `fn`
+ */
+void hash_table_for_each(struct hash_table *table,
+	void (*fn)(struct hash_entry *entry, void *data), void *data);
+
+#endif
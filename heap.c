@@ -0,0 +1,150 @@
+/**
+ * heap.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "heap.h"
+#include "interpreter.h"
+
+// The most freed objects of one kind kept for reuse
+#define HEAP_FREE_LIST_MAX 4096
+
+static char *kind_names[HEAP_KINDS] = {
+	"s-expr",
+	"s-expr-value",
+	"cons-cell",
+	"symbol",
+	"string",
+	"lambda",
+	"fn-arguments",
+	"definition",
+	"env-state",
+};
+
+char *heap_kind_name(enum heap_kind kind)
+{
+	return kind_names[kind];
+}
+
+/*
+ * Freed objects are kept on a free list per kind, as long as they all have
+ * the same size, and handed out again by heap_alloc(). Environment
+ * definitions and argument lists are allocated and freed on every call, and
+ * reusing them is cheaper than going through malloc, especially once there
+ * are several threads and malloc has to lock.
+ */
+static void *take_free(enum heap_kind kind, size_t size)
+{
+	struct heap_free_list *list = &interp->heap_free_lists[kind];
+	void *ptr = list->first;
+
+	if (ptr == NULL || list->size != size)
+		return NULL;
+	list->first = *(void **) ptr;
+	list->length--;
+	return ptr;
+}
+
+static int keep_free(enum heap_kind kind, void *ptr, size_t size)
+{
+	struct heap_free_list *list = &interp->heap_free_lists[kind];
+
+	if (size < sizeof(void *) || list->length == HEAP_FREE_LIST_MAX)
+		return 0;
+	if (list->length > 0 && list->size != size)
+		return 0;
+	list->size = size;
+	*(void **) ptr = list->first;
+	list->first = ptr;
+	list->length++;
+	return 1;
+}
+
+void *heap_alloc(enum heap_kind kind, size_t size)
+{
+	void *ptr = interp != NULL ? take_free(kind, size) : NULL;
+
+	if (ptr == NULL)
+		ptr = malloc(size);
+	if (ptr == NULL) {
+		printf("Out of memory, allocating %s.\n", kind_names[kind]);
+		exit(1);
+	}
+	// Allocations made outside of any interpreter are not counted.
+	if (interp == NULL)
+		return ptr;
+	interp->heap_census[kind].allocations++;
+	interp->heap_census[kind].bytes += size;
+	interp->heap_census[kind].live_bytes += size;
+	interp->heap_live_bytes += size;
+	if (interp->heap_live_bytes > interp->heap_peak_live_bytes)
+		interp->heap_peak_live_bytes = interp->heap_live_bytes;
+	return ptr;
+}
+
+void heap_free(enum heap_kind kind, void *ptr, size_t size)
+{
+	if (interp == NULL) {
+		free(ptr);
+		return;
+	}
+	if (!keep_free(kind, ptr, size))
+		free(ptr);
+	interp->heap_census[kind].frees++;
+	interp->heap_census[kind].live_bytes -= size;
+	interp->heap_live_bytes -= size;
+}
+
+void heap_release(void)
+{
+	int kind;
+
+	for (kind = 0; kind < HEAP_KINDS; kind++) {
+		struct heap_free_list *list = &interp->heap_free_lists[kind];
+
+		while (list->first != NULL) {
+			void *next = *(void **) list->first;
+
+			free(list->first);
+			list->first = next;
+		}
+		list->length = 0;
+	}
+}
+
+void heap_report(FILE *out)
+{
+	struct heap_census total;
+	int kind;
+
+	memset(&total, 0, sizeof(total));
+	fprintf(out, "%-14s %12s %14s %12s %14s\n",
+		"kind", "allocations", "bytes", "live", "live bytes");
+	for (kind = 0; kind < HEAP_KINDS; kind++) {
+		struct heap_census *census = &interp->heap_census[kind];
+
+		fprintf(out, "%-14s %12ld %14lld %12ld %14lld\n",
+			kind_names[kind], census->allocations, census->bytes,
+			census->allocations - census->frees,
+			census->live_bytes);
+		total.allocations += census->allocations;
+		total.frees += census->frees;
+		total.bytes += census->bytes;
+		total.live_bytes += census->live_bytes;
+	}
+	fprintf(out, "%-14s %12ld %14lld %12ld %14lld\n",
+		"total", total.allocations, total.bytes,
+		total.allocations - total.frees, total.live_bytes);
+	fprintf(out, "peak live bytes: %lld\n",
+		interp->heap_peak_live_bytes);
+	if (interp->data_files > 0) {
+		double seconds = interp->data_load_ns / 1e9;
+
+		fprintf(out, "data loaded: %ld files, %lld bytes in %.3f s",
+			interp->data_files, interp->data_bytes_read, seconds);
+		fprintf(out, " (%.1f MB/s), %lld bytes in regions\n",
+			seconds > 0 ? interp->data_bytes_read / 1e6 / seconds
+			: 0.0, interp->data_region_bytes);
+	}
+}
@@ -0,0 +1,81 @@
+/**
+ * heap.h - Counted allocation of interpreter objects
+ *
+ * Interpreter objects are allocated through heap_alloc() so that the number
+ * of allocations and bytes can be reported per kind of object. Objects that
+ * are freed through heap_free() are also subtracted from the live counts;
+ * since most objects are never freed, live counts are an upper bound.
+ *
+ * The counters belong to the current interpreter: struct interpreter has one
+ * struct heap_census per kind of object, and the peak of live bytes over all
+ * kinds (see interpreter.h).
+ */
+#ifndef HEAP
+#define HEAP
+#include <stdlib.h>
+#include <stdio.h>
+
+enum heap_kind {
+	HEAP_S_EXPR,
+	HEAP_VALUE,
+	HEAP_CELL,
+	HEAP_SYMBOL,
+	HEAP_STRING,
+	HEAP_LAMBDA,
+	HEAP_ARGUMENTS,
+	HEAP_DEFINITION,
+	HEAP_ENV_STATE,
+	HEAP_KINDS
+};
+
+struct heap_census {
+	long allocations;
+	long frees;
+	long long bytes;
+	long long live_bytes;
+};
+
+/**
+ * heap_free_list - Freed objects of one kind and size, kept for reuse
+ */
+struct heap_free_list {
+	void *first;
+	size_t size;
+	int length;
+};
+
+/**
+ * heap_kind_name() - Returns the name of a kind of object, like "s-expr"
+ * @kind
+ */
+char *heap_kind_name(enum heap_kind kind);
+
+/**
+ * heap_alloc() - Allocates memory for an object and counts it
+ * @kind - what the memory is for
+ * @size - the number of bytes
+ *
+ * Exits if there is no memory left.
+ */
+void *heap_alloc(enum heap_kind kind, size_t size);
+
+/**
+ * heap_free() - Frees memory allocated by heap_alloc() and counts it
+ * @kind - the kind it was allocated as
+ * @ptr - the memory
+ * @size - the size it was allocated with
+ */
+void heap_free(enum heap_kind kind, void *ptr, size_t size);
+
+/**
+ * heap_release() - Returns the objects kept for reuse to the system
+ */
+void heap_release(void);
+
+/**
+ * heap_report() - Prints the current interpreter's counters as a table
+ * @out - where to print
+ */
+void heap_report(FILE *out);
+
+#endif
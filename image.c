@@ -0,0 +1,906 @@
+/**
+ * image.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "parser.h"
+#include "environment.h"
+#include "hash_table.h"
+#include "string_builder.h"
+#include "memo.h"
+#include "interpreter.h"
+#include "image.h"
+
+/*
+ * Implementation notes:
+ *
+ * The file is the header, the data block (starting on a page boundary), the
+ * relocation table and the fixups. The header holds a checksum of the rest,
+ * and before anything is relocated every offset in the file is checked to be
+ * within the data block, so that a damaged file is an error rather than a
+ * crash. A pointer in the data block holds
+ * BASE_ADDRESS plus the offset of what it points to, and the relocation table
+ * lists the offset of every such pointer. Pointers to what can't be in the
+ * block (the empty list, builtins and rebuilt containers) are written as
+ * NULL and filled in by the fixups.
+ *
+ * Objects are written with an explicit stack of pointers still to be filled
+ * in, so that long lists don't recurse. Every address written is remembered,
+ * so shared and circular structure stays shared.
+ */
+
+#define IMAGE_MAGIC "SCMIMG1"
+// The version of the format, to change with it. Images of another version,
+// or whose structures are laid out differently (see layout()), are rejected.
+#define IMAGE_VERSION 2
+// How many sizes layout() gives
+#define LAYOUT_SIZES 9
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+// Where the data block would like to be mapped: far from where malloc and
+// the kernel usually put things
+#define BASE_ADDRESS ((uintptr_t) 0x3e0000000000)
+#define DATA_ALIGN 16
+#define PAGE_ALIGN 4096
+// Returned by find_placed() for addresses not written yet
+#define NOT_PLACED UINT64_MAX
+
+enum fixup_kind {
+	FIX_EMPTY_LIST, FIX_BUILTIN, FIX_TABLE, FIX_BUILDER, FIX_MEMO
+};
+
+/*
+ * fixup - Something to fill in when loading
+ * @slot - the offset of the pointer to set, or for FIX_MEMO, of the lambda
+ * @data - the offset of the builtin's name, of the table's entries (key and
+ * value pointers in turn) or of the builder's characters
+ * @count - the number of entries or characters, or the memo cache capacity
+ */
+struct fixup {
+	uint32_t kind;
+	uint32_t table_kind;
+	uint64_t slot;
+	uint64_t data;
+	uint64_t count;
+};
+
+struct image_header {
+	char magic[8];
+	uint32_t version;
+	// sizes of the structures in the data block
+	uint32_t layout[LAYOUT_SIZES];
+	// FNV-1a of everything after the header's page
+	uint64_t checksum;
+	uint64_t data_offset;
+	uint64_t data_size;
+	uint64_t reloc_offset;
+	uint64_t reloc_count;
+	uint64_t fixup_offset;
+	uint64_t fixup_count;
+	// the bindings, as pairs of id and value pointers in the data block
+	uint64_t bindings;
+	uint64_t binding_count;
+	// the offset of the pointer to the list of forms, if any
+	uint64_t forms;
+};
+
+enum object_kind {
+	OBJ_S_EXPR, OBJ_CHARS, OBJ_CELL, OBJ_STRING, OBJ_LAMBDA, OBJ_MACRO,
+	OBJ_NAMES
+};
+
+// A pointer at `slot` that is to point to the image's copy of `object`
+struct pending {
+	uint64_t slot;
+	void *object;
+	int kind;
+	int count;
+};
+
+struct placed {
+	void *address;
+	uint64_t offset;
+};
+
+struct writer {
+	char *data;
+	uint64_t size;
+	uint64_t capacity;
+	// an open addressing table of the addresses written so far
+	struct placed *placed;
+	uint64_t placed_count;
+	uint64_t placed_capacity;
+	uint64_t *relocs;
+	uint64_t reloc_count;
+	uint64_t reloc_capacity;
+	struct fixup *fixups;
+	uint64_t fixup_count;
+	uint64_t fixup_capacity;
+	struct pending *stack;
+	uint64_t stack_count;
+	uint64_t stack_capacity;
+	// the first error, if any
+	char *error;
+};
+
+static void layout(uint32_t *sizes)
+{
+	sizes[0] = sizeof(void *);
+	sizes[1] = sizeof(struct s_expr);
+	sizes[2] = sizeof(union s_expr_value);
+	sizes[3] = sizeof(struct cons_cell);
+	sizes[4] = sizeof(struct lambda);
+	sizes[5] = sizeof(struct string);
+	sizes[6] = sizeof(struct macro);
+	sizes[7] = sizeof(struct fixup);
+	// the number of types, which are saved by number
+	sizes[8] = MACRO + 1;
+}
+
+// Adds `size` bytes to `hash`, FNV-1a, so that parts can be summed in turn.
+static uint64_t checksum(uint64_t hash, char *bytes, uint64_t size)
+{
+	uint64_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= (unsigned char) bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static int fail(char *message)
+{
+	free(interp->last_error_message);
+	interp->last_error_message = strdup(message);
+	return 0;
+}
+
+// Makes room for one more item in a growable array.
+static void *grow(void *array, uint64_t count, uint64_t *capacity,
+	size_t item_size)
+{
+	if (count < *capacity)
+		return array;
+	*capacity = *capacity == 0 ? 64 : 2 * *capacity;
+	array = realloc(array, *capacity * item_size);
+	if (array == NULL) {
+		printf("Out of memory, cannot write the image.\n");
+		exit(1);
+	}
+	return array;
+}
+
+// Adds `size` zeroed bytes to the data block and returns their offset.
+static uint64_t reserve(struct writer *w, uint64_t size)
+{
+	uint64_t offset = w->size;
+
+	size = (size + DATA_ALIGN - 1) / DATA_ALIGN * DATA_ALIGN;
+	if (w->size + size > w->capacity) {
+		while (w->size + size > w->capacity)
+			w->capacity = w->capacity == 0 ? 4096 : 2 * w->capacity;
+		w->data = (char *) realloc(w->data, w->capacity);
+		if (w->data == NULL) {
+			printf("Out of memory, cannot write the image.\n");
+			exit(1);
+		}
+	}
+	memset(w->data + offset, 0, size);
+	w->size += size;
+	return offset;
+}
+
+static uint64_t hash_address(void *address, uint64_t capacity)
+{
+	uintptr_t bits = (uintptr_t) address;
+
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdUL;
+	bits ^= bits >> 33;
+	return bits & (capacity - 1);
+}
+
+static uint64_t find_placed(struct writer *w, void *address)
+{
+	uint64_t i;
+
+	if (w->placed_capacity == 0)
+		return NOT_PLACED;
+	i = hash_address(address, w->placed_capacity);
+	while (w->placed[i].address != NULL) {
+		if (w->placed[i].address == address)
+			return w->placed[i].offset;
+		i = (i + 1) & (w->placed_capacity - 1);
+	}
+	return NOT_PLACED;
+}
+
+static void remember(struct writer *w, void *address, uint64_t offset)
+{
+	uint64_t i;
+
+	if (2 * (w->placed_count + 1) > w->placed_capacity) {
+		struct placed *old = w->placed;
+		uint64_t old_capacity = w->placed_capacity;
+
+		w->placed_capacity = old_capacity == 0
+			? 1024 : 2 * old_capacity;
+		w->placed = (struct placed *)
+			calloc(w->placed_capacity, sizeof(struct placed));
+		if (w->placed == NULL) {
+			printf("Out of memory, cannot write the image.\n");
+			exit(1);
+		}
+		w->placed_count = 0;
+		for (i = 0; i < old_capacity; i++) {
+			if (old[i].address != NULL)
+				remember(w, old[i].address, old[i].offset);
+		}
+		free(old);
+	}
+	i = hash_address(address, w->placed_capacity);
+	while (w->placed[i].address != NULL)
+		i = (i + 1) & (w->placed_capacity - 1);
+	w->placed[i].address = address;
+	w->placed[i].offset = offset;
+	w->placed_count++;
+}
+
+// Points the pointer at `slot` to `offset` in the data block.
+static void point_to(struct writer *w, uint64_t slot, uint64_t offset)
+{
+	uintptr_t address = BASE_ADDRESS + offset;
+
+	memcpy(w->data + slot, &address, sizeof(address));
+	w->relocs = (uint64_t *) grow(w->relocs, w->reloc_count,
+		&w->reloc_capacity, sizeof(uint64_t));
+	w->relocs[w->reloc_count++] = slot;
+}
+
+static struct fixup *add_fixup(struct writer *w, int kind, uint64_t slot)
+{
+	struct fixup *fixup;
+
+	w->fixups = (struct fixup *) grow(w->fixups, w->fixup_count,
+		&w->fixup_capacity, sizeof(struct fixup));
+	fixup = &w->fixups[w->fixup_count++];
+	memset(fixup, 0, sizeof(struct fixup));
+	fixup->kind = kind;
+	fixup->slot = slot;
+	return fixup;
+}
+
+// Arranges for the pointer at `slot` to point to the copy of `object`.
+static void defer(struct writer *w, uint64_t slot, void *object, int kind,
+	int count)
+{
+	struct pending *pending;
+
+	if (object == NULL)
+		return;
+	if (kind == OBJ_S_EXPR && object == empty_list) {
+		add_fixup(w, FIX_EMPTY_LIST, slot);
+		return;
+	}
+	w->stack = (struct pending *) grow(w->stack, w->stack_count,
+		&w->stack_capacity, sizeof(struct pending));
+	pending = &w->stack[w->stack_count++];
+	pending->slot = slot;
+	pending->object = object;
+	pending->kind = kind;
+	pending->count = count;
+}
+
+static uint64_t write_chars(struct writer *w, char *chars)
+{
+	uint64_t offset = find_placed(w, chars);
+	size_t length;
+
+	if (offset != NOT_PLACED)
+		return offset;
+	length = strlen(chars) + 1;
+	offset = reserve(w, length);
+	memcpy(w->data + offset, chars, length);
+	remember(w, chars, offset);
+	return offset;
+}
+
+struct table_entries {
+	struct writer *w;
+	uint64_t offset;
+	uint64_t count;
+};
+
+static void defer_entry(struct hash_entry *entry, void *data)
+{
+	struct table_entries *entries = (struct table_entries *) data;
+	uint64_t slot = entries->offset + 2 * entries->count * sizeof(void *);
+
+	defer(entries->w, slot, entry->key, OBJ_S_EXPR, 0);
+	defer(entries->w, slot + sizeof(void *), entry->value, OBJ_S_EXPR, 0);
+	entries->count++;
+}
+
+// Writes the value of an s-expression at `offset`.
+static void write_value(struct writer *w, struct s_expr *expr,
+	uint64_t offset)
+{
+	union s_expr_value *value = expr->value;
+	struct table_entries entries;
+	struct fixup *fixup;
+
+	switch (expr->type) {
+	case BOOLEAN:
+	case INTEGER:
+		memcpy(w->data + offset, value, sizeof(union s_expr_value));
+		break;
+	case SYMBOL:
+		defer(w, offset, value->symbol, OBJ_CHARS, 0);
+		break;
+	case CELL:
+		defer(w, offset, value->cell, OBJ_CELL, 0);
+		break;
+	case LAMBDA:
+		defer(w, offset, value->lambda, OBJ_LAMBDA, 0);
+		break;
+	case MACRO:
+		defer(w, offset, value->macro, OBJ_MACRO, 0);
+		break;
+	case STRING:
+		defer(w, offset, value->string, OBJ_STRING, 0);
+		break;
+	case BUILTIN:
+		fixup = add_fixup(w, FIX_BUILTIN, offset);
+		fixup->data = write_chars(w, value->builtin->name);
+		break;
+	case HASH_TABLE:
+		entries.w = w;
+		entries.offset = reserve(w,
+			2 * (uint64_t) value->table->count * sizeof(void *));
+		entries.count = 0;
+		hash_table_for_each(value->table, defer_entry, &entries);
+		fixup = add_fixup(w, FIX_TABLE, offset);
+		fixup->table_kind = value->table->kind;
+		fixup->data = entries.offset;
+		fixup->count = entries.count;
+		break;
+	case STRING_BUILDER:
+		fixup = add_fixup(w, FIX_BUILDER, offset);
+		fixup->data = reserve(w, value->builder->length);
+		fixup->count = value->builder->length;
+		memcpy(w->data + fixup->data, value->builder->chars,
+			value->builder->length);
+		break;
+	case FUTURE:
+		w->error = "image - type error (cannot save a future)";
+		break;
+	case ACTOR:
+		w->error = "image - type error (cannot save an actor)";
+		break;
+	case GENERATOR:
+		w->error = "image - type error (cannot save a generator)";
+		break;
+	case PROMISE:
+		w->error = "image - type error (cannot save a promise)";
+		break;
+	case PORT:
+		w->error = "image - type error (cannot save a port)";
+		break;
+	case UNLOADED:
+		w->error = "image - type error (cannot save unloaded data)";
+		break;
+	default:
+		break;
+	}
+}
+
+static uint64_t write_object(struct writer *w, void *object, int kind,
+	int count)
+{
+	uint64_t offset;
+	int i;
+
+	switch (kind) {
+	case OBJ_CHARS:
+		return write_chars(w, (char *) object);
+	case OBJ_S_EXPR: {
+		struct s_expr *expr = (struct s_expr *) object;
+		uint64_t value;
+
+		offset = reserve(w, sizeof(struct s_expr));
+		remember(w, object, offset);
+		((struct s_expr *) (w->data + offset))->type = expr->type;
+		if (expr->value == NULL)
+			return offset;
+		value = reserve(w, sizeof(union s_expr_value));
+		point_to(w, offset + offsetof(struct s_expr, value), value);
+		write_value(w, expr, value);
+		return offset;
+	}
+	case OBJ_CELL: {
+		struct cons_cell *cell = (struct cons_cell *) object;
+
+		offset = reserve(w, sizeof(struct cons_cell));
+		remember(w, object, offset);
+		defer(w, offset + offsetof(struct cons_cell, first),
+			cell->first, OBJ_S_EXPR, 0);
+		defer(w, offset + offsetof(struct cons_cell, rest),
+			cell->rest, OBJ_S_EXPR, 0);
+		return offset;
+	}
+	case OBJ_STRING: {
+		struct string *string = (struct string *) object;
+		uint64_t chars;
+
+		offset = reserve(w, sizeof(struct string));
+		remember(w, object, offset);
+		((struct string *) (w->data + offset))->length = string->length;
+		chars = reserve(w, string->length + 1);
+		memcpy(w->data + chars, string->chars, string->length + 1);
+		point_to(w, offset + offsetof(struct string, chars), chars);
+		return offset;
+	}
+	case OBJ_LAMBDA: {
+		struct lambda *lmb = (struct lambda *) object;
+
+		offset = reserve(w, sizeof(struct lambda));
+		remember(w, object, offset);
+		((struct lambda *) (w->data + offset))->arg_count =
+			lmb->arg_count;
+		defer(w, offset + offsetof(struct lambda, name), lmb->name,
+			OBJ_CHARS, 0);
+		defer(w, offset + offsetof(struct lambda, args), lmb->args,
+			OBJ_NAMES, lmb->arg_count);
+		// Save the body as read: folded ones call builtins that no
+		// name is bound to.
+		defer(w, offset + offsetof(struct lambda, body),
+			lmb->source != NULL ? lmb->source : lmb->body,
+			OBJ_S_EXPR, 0);
+		if (lmb->memo != NULL) {
+			add_fixup(w, FIX_MEMO, offset)->count =
+				lmb->memo->capacity;
+		}
+		return offset;
+	}
+	case OBJ_MACRO: {
+		struct macro *macro = (struct macro *) object;
+
+		offset = reserve(w, sizeof(struct macro));
+		remember(w, object, offset);
+		defer(w, offset + offsetof(struct macro, name), macro->name,
+			OBJ_CHARS, 0);
+		defer(w, offset + offsetof(struct macro, literals),
+			macro->literals, OBJ_S_EXPR, 0);
+		defer(w, offset + offsetof(struct macro, rules), macro->rules,
+			OBJ_S_EXPR, 0);
+		return offset;
+	}
+	default: {
+		// OBJ_NAMES
+		char **names = (char **) object;
+
+		offset = reserve(w, count * sizeof(char *));
+		remember(w, object, offset);
+		for (i = 0; i < count; i++) {
+			defer(w, offset + i * sizeof(char *), names[i],
+				OBJ_CHARS, 0);
+		}
+		return offset;
+	}
+	}
+}
+
+// Writes everything reachable from the pending pointers.
+static void write_pending(struct writer *w)
+{
+	while (w->stack_count > 0 && w->error == NULL) {
+		struct pending pending = w->stack[--w->stack_count];
+		uint64_t offset = find_placed(w, pending.object);
+
+		if (offset == NOT_PLACED) {
+			offset = write_object(w, pending.object, pending.kind,
+				pending.count);
+		}
+		point_to(w, pending.slot, offset);
+	}
+}
+
+struct binding_list {
+	char **ids;
+	struct s_expr **values;
+	uint64_t count;
+	uint64_t capacity;
+};
+
+static void add_binding(char *id, struct s_expr *value, void *data)
+{
+	struct binding_list *bindings = (struct binding_list *) data;
+	uint64_t capacity = bindings->capacity;
+
+	// Builtins under their own name are there in any interpreter.
+	if (value->type == BUILTIN && !strcmp(value->value->builtin->name, id))
+		return;
+	bindings->ids = (char **) grow(bindings->ids, bindings->count,
+		&capacity, sizeof(char *));
+	bindings->values = (struct s_expr **) grow(bindings->values,
+		bindings->count, &bindings->capacity, sizeof(struct s_expr *));
+	bindings->ids[bindings->count] = id;
+	bindings->values[bindings->count] = value;
+	bindings->count++;
+}
+
+static int write_file(struct writer *w, struct image_header *header,
+	char *path)
+{
+	FILE *out = fopen(path, "wb");
+	static const char padding[PAGE_ALIGN];
+	uint64_t hash;
+	int ok;
+
+	if (out == NULL)
+		return fail("image - io error (cannot write file)");
+	// The three parts follow each other in the file.
+	hash = checksum(FNV_OFFSET, w->data, w->size);
+	hash = checksum(hash, (char *) w->relocs,
+		w->reloc_count * sizeof(uint64_t));
+	header->checksum = checksum(hash, (char *) w->fixups,
+		w->fixup_count * sizeof(struct fixup));
+	ok = fwrite(header, sizeof(*header), 1, out) == 1
+		&& fwrite(padding, header->data_offset - sizeof(*header), 1,
+			out) == 1
+		&& fwrite(w->data, 1, w->size, out) == w->size
+		&& fwrite(w->relocs, sizeof(uint64_t), w->reloc_count, out)
+			== w->reloc_count
+		&& fwrite(w->fixups, sizeof(struct fixup), w->fixup_count, out)
+			== w->fixup_count;
+	if (fclose(out) != 0 || !ok)
+		return fail("image - io error (cannot write file)");
+	return 1;
+}
+
+/*
+ * Writes an image of the global environment if `with_bindings` is set, and
+ * of `forms` if it isn't NULL.
+ */
+static int write_image(char *path, int with_bindings, struct s_expr *forms)
+{
+	struct writer w;
+	struct binding_list bindings;
+	struct image_header header;
+	uint64_t i;
+	int ok;
+
+	memset(&w, 0, sizeof(w));
+	memset(&bindings, 0, sizeof(bindings));
+	memset(&header, 0, sizeof(header));
+	if (with_bindings)
+		env_for_each(add_binding, &bindings);
+
+	header.bindings = reserve(&w, 2 * bindings.count * sizeof(void *));
+	header.binding_count = bindings.count;
+	for (i = 0; i < bindings.count; i++) {
+		uint64_t slot = header.bindings + 2 * i * sizeof(void *);
+
+		point_to(&w, slot, write_chars(&w, bindings.ids[i]));
+		defer(&w, slot + sizeof(void *), bindings.values[i],
+			OBJ_S_EXPR, 0);
+	}
+	header.forms = reserve(&w, sizeof(void *));
+	if (forms != NULL)
+		defer(&w, header.forms, forms, OBJ_S_EXPR, 0);
+	write_pending(&w);
+
+	if (w.error != NULL) {
+		ok = fail(w.error);
+	} else {
+		strcpy(header.magic, IMAGE_MAGIC);
+		header.version = IMAGE_VERSION;
+		layout(header.layout);
+		header.data_offset = (sizeof(header) + PAGE_ALIGN - 1)
+			/ PAGE_ALIGN * PAGE_ALIGN;
+		header.data_size = w.size;
+		header.reloc_offset = header.data_offset + w.size;
+		header.reloc_count = w.reloc_count;
+		header.fixup_offset = header.reloc_offset
+			+ w.reloc_count * sizeof(uint64_t);
+		header.fixup_count = w.fixup_count;
+		ok = write_file(&w, &header, path);
+	}
+	free(w.data);
+	free(w.placed);
+	free(w.relocs);
+	free(w.fixups);
+	free(w.stack);
+	free(bindings.ids);
+	free(bindings.values);
+	return ok;
+}
+
+int image_dump(struct interpreter *in, char *path)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	int ok = write_image(path, 1, NULL);
+
+	interpreter_enter(prev);
+	return ok;
+}
+
+static int valid_header(struct image_header *header, off_t file_size)
+{
+	uint32_t sizes[LAYOUT_SIZES];
+	uint64_t size = (uint64_t) file_size;
+
+	layout(sizes);
+	// Each part is checked to fit in what is left of the file before its
+	// size is used, so that nothing overflows.
+	return !memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC))
+		&& header->version == IMAGE_VERSION
+		&& !memcmp(header->layout, sizes, sizeof(sizes))
+		&& header->data_offset % PAGE_ALIGN == 0
+		&& header->data_offset >= sizeof(*header)
+		&& header->data_offset <= size
+		&& header->data_size <= size - header->data_offset
+		&& header->reloc_offset == header->data_offset
+			+ header->data_size
+		&& header->reloc_count <= (size - header->reloc_offset)
+			/ sizeof(uint64_t)
+		&& header->fixup_offset == header->reloc_offset
+			+ header->reloc_count * sizeof(uint64_t)
+		&& header->fixup_count <= (size - header->fixup_offset)
+			/ sizeof(struct fixup)
+		&& header->fixup_offset + header->fixup_count
+			* sizeof(struct fixup) == size;
+}
+
+static void set_pointer(char *base, uint64_t slot, void *pointer)
+{
+	memcpy(base + slot, &pointer, sizeof(pointer));
+}
+
+static void *get_pointer(char *base, uint64_t slot)
+{
+	void *pointer;
+
+	memcpy(&pointer, base + slot, sizeof(pointer));
+	return pointer;
+}
+
+// Whether `size` bytes at `offset` are in the data block.
+static int in_block(struct image_header *header, uint64_t offset,
+	uint64_t size)
+{
+	return offset <= header->data_size
+		&& size <= header->data_size - offset;
+}
+
+// Whether the list of `count` pairs of pointers at `offset` is in the block.
+static int pairs_in_block(struct image_header *header, uint64_t offset,
+	uint64_t count)
+{
+	return count <= header->data_size / (2 * sizeof(void *))
+		&& in_block(header, offset, count * 2 * sizeof(void *));
+}
+
+static int valid_fixup(char *base, struct image_header *header,
+	struct fixup *fixup)
+{
+	switch (fixup->kind) {
+	case FIX_EMPTY_LIST:
+		return in_block(header, fixup->slot, sizeof(void *));
+	case FIX_BUILTIN:
+		// The name must end in the block.
+		return in_block(header, fixup->slot, sizeof(void *))
+			&& in_block(header, fixup->data, 1)
+			&& memchr(base + fixup->data, '\0',
+				header->data_size - fixup->data) != NULL;
+	case FIX_TABLE:
+		return in_block(header, fixup->slot, sizeof(void *))
+			&& pairs_in_block(header, fixup->data, fixup->count);
+	case FIX_BUILDER:
+		return in_block(header, fixup->slot, sizeof(void *))
+			&& in_block(header, fixup->data, fixup->count);
+	case FIX_MEMO:
+		return in_block(header, fixup->slot, sizeof(struct lambda));
+	}
+	return 0;
+}
+
+/*
+ * Checks that every offset in the image, and every pointer the relocation
+ * table lists, is in the data block, before any of them is used.
+ */
+static int valid_offsets(char *base, struct image_header *header,
+	uint64_t *relocs, struct fixup *fixups)
+{
+	uint64_t i;
+
+	if (!pairs_in_block(header, header->bindings, header->binding_count)
+	|| !in_block(header, header->forms, sizeof(void *)))
+		return 0;
+	for (i = 0; i < header->reloc_count; i++) {
+		if (!in_block(header, relocs[i], sizeof(void *))
+		|| (uintptr_t) get_pointer(base, relocs[i]) - BASE_ADDRESS
+		>= header->data_size)
+			return 0;
+	}
+	for (i = 0; i < header->fixup_count; i++) {
+		if (!valid_fixup(base, header, &fixups[i]))
+			return 0;
+	}
+	return 1;
+}
+
+// Fills in everything but the entries of hash tables.
+static int apply_fixup(char *base, struct fixup *fixup)
+{
+	struct s_expr *builtin;
+	struct string_builder *builder;
+
+	switch (fixup->kind) {
+	case FIX_EMPTY_LIST:
+		set_pointer(base, fixup->slot, empty_list);
+		break;
+	case FIX_BUILTIN:
+		builtin = get_env(base + fixup->data);
+		if (builtin == NULL || builtin->type != BUILTIN)
+			return fail("image - io error (unknown builtin)");
+		set_pointer(base, fixup->slot, builtin->value->builtin);
+		break;
+	case FIX_TABLE:
+		set_pointer(base, fixup->slot,
+			hash_table_create(fixup->table_kind));
+		break;
+	case FIX_BUILDER:
+		builder = string_builder_create();
+		string_builder_append(builder, base + fixup->data,
+			fixup->count);
+		set_pointer(base, fixup->slot, builder);
+		break;
+	case FIX_MEMO:
+		((struct lambda *) (base + fixup->slot))->memo =
+			memo_cache_create(fixup->count);
+		break;
+	}
+	return 1;
+}
+
+/*
+ * Maps an image, relocates it and applies its fixups. Returns the data block,
+ * or NULL on error.
+ */
+static char *map_image(char *path, struct image_header *header_out)
+{
+	struct image_header header;
+	struct stat st;
+	struct fixup *fixups;
+	uint64_t *relocs;
+	char *map, *base;
+	uintptr_t delta;
+	uint64_t i, j;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		fail("image - io error (cannot open file)");
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0
+	|| pread(fd, &header, sizeof(header), 0) != sizeof(header)
+	|| !valid_header(&header, st.st_size)) {
+		close(fd);
+		fail("image - io error (not an image of this format)");
+		return NULL;
+	}
+	// Asking for the address the pointers were written for usually gets
+	// it, and then nothing needs relocating.
+	map = (char *) mmap((void *) (BASE_ADDRESS - header.data_offset),
+		st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fail("image - io error (cannot map file)");
+		return NULL;
+	}
+	base = map + header.data_offset;
+	relocs = (uint64_t *) (map + header.reloc_offset);
+	fixups = (struct fixup *) (map + header.fixup_offset);
+	if (checksum(FNV_OFFSET, base, st.st_size - header.data_offset)
+	!= header.checksum) {
+		munmap(map, st.st_size);
+		fail("image - io error (checksum mismatch)");
+		return NULL;
+	}
+	if (!valid_offsets(base, &header, relocs, fixups)) {
+		munmap(map, st.st_size);
+		fail("image - io error (offset out of bounds)");
+		return NULL;
+	}
+
+	delta = (uintptr_t) base - BASE_ADDRESS;
+	if (delta != 0) {
+		for (i = 0; i < header.reloc_count; i++) {
+			uintptr_t pointer = (uintptr_t)
+				get_pointer(base, relocs[i]);
+
+			set_pointer(base, relocs[i],
+				(void *) (pointer + delta));
+		}
+	}
+
+	for (i = 0; i < header.fixup_count; i++) {
+		if (!apply_fixup(base, &fixups[i]))
+			return NULL;
+	}
+	// Keys are hashed by now: their builtins, empty lists and tables are
+	// all in place.
+	for (i = 0; i < header.fixup_count; i++) {
+		struct hash_table *table;
+		struct s_expr **entries;
+
+		if (fixups[i].kind != FIX_TABLE)
+			continue;
+		table = (struct hash_table *) get_pointer(base, fixups[i].slot);
+		entries = (struct s_expr **) (base + fixups[i].data);
+		for (j = 0; j < fixups[i].count; j++)
+			hash_table_set(table, entries[2 * j],
+				entries[2 * j + 1]);
+	}
+	*header_out = header;
+	return base;
+}
+
+static int load(char *path)
+{
+	struct image_header header;
+	char *base = map_image(path, &header);
+	uint64_t i;
+
+	if (base == NULL)
+		return 0;
+	for (i = 0; i < header.binding_count; i++) {
+		char **binding = (char **)
+			(base + header.bindings + 2 * i * sizeof(void *));
+
+		set_env(binding[0], (struct s_expr *) binding[1]);
+	}
+	return 1;
+}
+
+int image_load(struct interpreter *in, char *path)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	int ok = load(path);
+
+	interpreter_enter(prev);
+	return ok;
+}
+
+int image_write_forms(struct interpreter *in, char *path, struct s_expr *forms)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	int ok = write_image(path, 0, forms);
+
+	interpreter_enter(prev);
+	return ok;
+}
+
+struct s_expr *image_read_forms(struct interpreter *in, char *path)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	struct image_header header;
+	char *base = map_image(path, &header);
+	struct s_expr *forms = NULL;
+
+	if (base != NULL)
+		forms = (struct s_expr *) get_pointer(base, header.forms);
+	if (base != NULL && forms == NULL)
+		fail("image - io error (no forms in image)");
+	interpreter_enter(prev);
+	return forms;
+}
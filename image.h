@@ -0,0 +1,65 @@
+/**
+ * image.h - Saves the global environment to a file and loads it back
+ *
+ * An image holds every binding of an interpreter's global environment and
+ * every object reachable from them, laid out in one block as if it had been
+ * allocated at a fixed address. Loading maps the file at that address, so
+ * that starting from an image costs one mmap() and a pass over the bindings
+ * rather than parsing and evaluating the source again. When the address is
+ * taken, the pointers in the block are relocated from a table in the file.
+ *
+ * Objects whose memory is resized or freed as the program runs are not kept
+ * in the mapping: hash tables, string builders and memo caches are rebuilt
+ * when the image is loaded, and memo caches start empty. Builtins are looked
+ * up by name. Futures, actors, generators, promises and ports cannot be
+ * saved.
+ *
+ * The same format holds lists of forms, which is how parsed scripts are
+ * cached (see form_cache.h).
+ *
+ * Images are only loaded by builds that read the same version of the format
+ * and lay objects out the same way. A file is checked before it is used, so
+ * that a damaged one is an io error rather than a crash.
+ */
+#ifndef IMAGE
+#define IMAGE
+#include "interpreter.h"
+
+/**
+ * image_dump() - Writes the global environment of `in` to a file
+ * @in
+ * @path
+ * @returns 1 on success and 0 on error (see interpreter_error())
+ */
+int image_dump(struct interpreter *in, char *path);
+
+/**
+ * image_load() - Adds the bindings of an image to the global environment
+ * @in - an interpreter whose builtins have not been redefined
+ * @path
+ * @returns 1 on success and 0 on error (see interpreter_error())
+ *
+ * The objects of the image are never unmapped, like objects on the heap are
+ * never freed.
+ */
+int image_load(struct interpreter *in, char *path);
+
+/**
+ * image_write_forms() - Writes a list of forms, such as a parsed script, to a
+ * file
+ * @in
+ * @path
+ * @forms - a list, which is written without the global environment
+ * @returns 1 on success and 0 on error (see interpreter_error())
+ */
+int image_write_forms(struct interpreter *in, char *path, struct s_expr *forms);
+
+/**
+ * image_read_forms() - Maps the list of forms written by image_write_forms()
+ * @in
+ * @path
+ * @returns the list, or NULL on error (see interpreter_error())
+ */
+struct s_expr *image_read_forms(struct interpreter *in, char *path);
+
+#endif
@@ -0,0 +1,248 @@
+/**
+ * interpreter.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "lexer.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "macro.h"
+#include "fold.h"
+#include "closure.h"
+#include "profile.h"
+#include "data.h"
+#include "jit.h"
+#include "interpreter.h"
+
+// Initial size of the token buffer
+#define TOKEN_SIZE 20
+
+__thread struct interpreter *interp;
+
+struct interpreter *interpreter_enter(struct interpreter *in)
+{
+	struct interpreter *prev = interp;
+
+	interp = in;
+	return prev;
+}
+
+struct interpreter *interpreter_create(void)
+{
+	struct interpreter *in = (struct interpreter *)
+		calloc(1, sizeof(struct interpreter));
+	struct interpreter *prev;
+
+	if (in == NULL) {
+		printf("Out of memory, cannot create an interpreter.\n");
+		exit(1);
+	}
+	in->jit_threshold = JIT_DEFAULT_THRESHOLD;
+	in->folding = 1;
+	prev = interpreter_enter(in);
+	start_environment();
+	start_parser(TOKEN_SIZE);
+	start_evaluator();
+	interpreter_enter(prev);
+	return in;
+}
+
+struct interpreter *interpreter_fork(void)
+{
+	struct interpreter *parent = interp;
+	struct interpreter *child = (struct interpreter *)
+		calloc(1, sizeof(struct interpreter));
+
+	if (child == NULL) {
+		printf("Out of memory, cannot create an interpreter.\n");
+		exit(1);
+	}
+	interpreter_enter(child);
+	start_environment_copy(parent->state_stack);
+	child->quote_function = parent->quote_function;
+	child->engine = parent->engine;
+	child->jit_threshold = parent->jit_threshold;
+	child->macros = parent->macros;
+	child->unfolded = parent->unfolded;
+	interpreter_enter(parent);
+	return child;
+}
+
+void interpreter_join(struct interpreter *child)
+{
+	struct interpreter *parent = interpreter_enter(child);
+	int kind;
+
+	// Free the environment first, so that the counters include it.
+	free_environment();
+	interpreter_enter(parent);
+
+	for (kind = 0; kind < HEAP_KINDS; kind++) {
+		struct heap_census *to = &interp->heap_census[kind];
+		struct heap_census *from = &child->heap_census[kind];
+
+		to->allocations += from->allocations;
+		to->frees += from->frees;
+		to->bytes += from->bytes;
+		to->live_bytes += from->live_bytes;
+	}
+	// The child's peak happened while the parent had at most its current
+	// live bytes.
+	if (interp->heap_live_bytes + child->heap_peak_live_bytes
+	> interp->heap_peak_live_bytes) {
+		interp->heap_peak_live_bytes = interp->heap_live_bytes
+			+ child->heap_peak_live_bytes;
+	}
+	interp->heap_live_bytes += child->heap_live_bytes;
+	data_adopt(child);
+	interpreter_destroy(child);
+}
+
+void interpreter_destroy(struct interpreter *in)
+{
+	struct interpreter *prev = interpreter_enter(in);
+
+	free_parser();
+	free_environment();
+	free_compiled();
+	free_jit();
+	free_expansions();
+	free_folds();
+	free_profile();
+	free_data();
+	heap_release();
+	free(in->last_error_message);
+	interpreter_enter(prev == in ? NULL : prev);
+	free(in);
+}
+
+void interpreter_set_engine(struct interpreter *in, enum eval_engine engine)
+{
+	in->engine = engine;
+}
+
+void interpreter_set_jit(struct interpreter *in, int threshold)
+{
+	in->jit_threshold = threshold;
+}
+
+void interpreter_set_folding(struct interpreter *in, int enabled)
+{
+	in->folding = enabled;
+}
+
+void interpreter_set_input(struct interpreter *in, FILE *stream)
+{
+	struct interpreter *prev = interpreter_enter(in);
+
+	set_token_input(stream);
+	interpreter_enter(prev);
+}
+
+int interpreter_set_buffer(struct interpreter *in, char *buffer,
+	size_t length)
+{
+	FILE *stream = fmemopen(buffer, length, "r");
+
+	if (stream == NULL)
+		return 0;
+	interpreter_set_input(in, stream);
+	in->lexer.owns_input = 1;
+	return 1;
+}
+
+struct s_expr *interpreter_read(struct interpreter *in)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	struct s_expr *expr = get_expression();
+
+	interpreter_enter(prev);
+	return expr;
+}
+
+int interpreter_read_failed(struct interpreter *in)
+{
+	return in->lexer.error;
+}
+
+struct s_expr *interpreter_eval(struct interpreter *in, struct s_expr *expr)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	struct s_expr *value = expand_expression(expr);
+
+	if (value != NULL)
+		value = eval_expression(fold_expression(value));
+	interpreter_enter(prev);
+	return value;
+}
+
+struct s_expr *interpreter_call(struct interpreter *in, struct s_expr *fn,
+	struct fn_arguments *values)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	struct s_expr *value = eval_apply(fn, values);
+
+	interpreter_enter(prev);
+	return value;
+}
+
+struct s_expr *interpreter_copy(struct interpreter *in, struct s_expr *value)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	struct s_expr *copy = eval_copy(value);
+
+	interpreter_enter(prev);
+	return copy;
+}
+
+void interpreter_define(struct interpreter *in, char *id,
+	struct s_expr *value)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	char *copy = (char *) heap_alloc(HEAP_SYMBOL, strlen(id) + 1);
+
+	strcpy(copy, id);
+	set_env(copy, value);
+	interpreter_enter(prev);
+}
+
+void interpreter_set_profiling(struct interpreter *in, int enabled)
+{
+	struct interpreter *prev = interpreter_enter(in);
+
+	if (enabled)
+		profile_start();
+	else
+		profile_stop();
+	interpreter_enter(prev);
+}
+
+void interpreter_profile_report(struct interpreter *in, FILE *out,
+	FILE *folded)
+{
+	struct interpreter *prev = interpreter_enter(in);
+
+	profile_report(out);
+	if (folded != NULL)
+		profile_write_folded(folded);
+	interpreter_enter(prev);
+}
+
+void interpreter_heap_report(struct interpreter *in, FILE *out)
+{
+	struct interpreter *prev = interpreter_enter(in);
+
+	heap_report(out);
+	interpreter_enter(prev);
+}
+
+int interpreter_error(struct interpreter *in, char *buffer, int buffer_size)
+{
+	struct interpreter *prev = interpreter_enter(in);
+	int copied = get_eval_error(buffer, buffer_size);
+
+	interpreter_enter(prev);
+	return copied;
+}
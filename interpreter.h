@@ -0,0 +1,309 @@
+/**
+ * interpreter.h - Independent interpreter instances
+ *
+ * All of the state of an interpreter (its environment, its input and lexer,
+ * the last error, the profile and the allocation counters) lives in a struct
+ * interpreter. Any number of interpreters can exist in one process, and
+ * interpreters on different threads can run at the same time: they share no
+ * mutable state.
+ *
+ * The functions below take the interpreter explicitly. The modules underneath
+ * (lexer, parser, environment, evaluator, profiler and heap) work on the
+ * interpreter that is current on the calling thread, which these functions
+ * set for the duration of the call. An interpreter must only be used by one
+ * thread at a time.
+ *
+ * Objects are never freed (see heap.h), so s-expressions returned by one
+ * interpreter stay valid after it is destroyed. Interpreters on different
+ * threads may share values as long as none of them modifies those values;
+ * futures and pmap (see pool.h) hand values between threads this way.
+ * Actors (see mailbox.h) instead send each other deep copies, which then
+ * belong to the receiving interpreter alone.
+ */
+#ifndef INTERPRETER
+#define INTERPRETER
+#include <stdlib.h>
+#include <stdio.h>
+#include "heap.h"
+#include "parser.h"
+
+struct env_state;
+struct profiler;
+struct data_region;
+struct port;
+struct compiled_forms;
+struct jit_code;
+
+struct lexer {
+	// the current token
+	char *lexeme;
+	// the allocated size of lexeme, and the length of the current token
+	int lexeme_size;
+	int lexeme_length;
+	// the stream tokens are read from
+	FILE *input;
+	// whether input was opened by the interpreter and must be closed
+	int owns_input;
+	// the current character in the input stream, or EOF
+	int c;
+	// if the previous call to get_token() required looking ahead
+	int lookahead;
+	// whether the input stopped at a syntax error (see syntax_error())
+	int error;
+};
+
+/**
+ * eval_engine - How an interpreter evaluates expressions
+ * @ENGINE_TREE - by walking the s-expression each time it is evaluated
+ * @ENGINE_CLOSURE - by analysing each list form once into a tree of nodes that
+ * hold a function to run and their operands, decoded (see closure.h)
+ *
+ * Both give the same values and errors.
+ */
+enum eval_engine {
+	ENGINE_TREE,
+	ENGINE_CLOSURE
+};
+
+struct interpreter {
+	struct lexer lexer;
+	// the token the parser is looking at
+	char *current_token;
+	// the innermost environment state
+	struct env_state *state_stack;
+	char *last_error_message;
+	enum eval_engine engine;
+	// the forms the closure engine has compiled, or NULL
+	struct compiled_forms *compiled;
+	// the calls after which a lambda is compiled to machine code, or 0 for
+	// never, and the code made so far (see jit.h)
+	int jit_threshold;
+	struct jit_code *jit_code;
+	// whether define-syntax has run, so that forms may need expanding; the
+	// expansion of each macro use expanded so far, by form, or NULL; and
+	// the number of symbols renamed by expansions (see macro.h)
+	int macros;
+	struct hash_table *expansions;
+	int renames;
+	// whether forms are folded before they are evaluated; the names whose
+	// bindings folds relied on, and the names forms bind, or NULL; whether
+	// a name folds relied on has been bound since, which undoes them; and
+	// what folded lambda and define forms call (see fold.h)
+	int folding;
+	struct hash_table *folded;
+	struct hash_table *bound;
+	int unfolded;
+	struct s_expr *folded_lambda;
+	struct s_expr *folded_define;
+	// the quote builtin, used to pass already evaluated values to builtins
+	struct s_expr *quote_function;
+	// whether calls are being recorded, see profile.h
+	int profiling;
+	struct profiler *profiler;
+	// where messages to this interpreter arrive, or NULL until needed
+	struct mailbox *mailbox;
+	// the generator whose body is running, or NULL (see coroutine.h)
+	struct generator *generator;
+	// the current ports, or NULL until needed (see port.h)
+	struct port *input_port;
+	struct port *output_port;
+	// the regions made by load-data, and what loading them took (see
+	// data.h)
+	struct data_region *data_regions;
+	long data_files;
+	long long data_bytes_read;
+	long long data_region_bytes;
+	long long data_load_ns;
+	struct heap_census heap_census[HEAP_KINDS];
+	struct heap_free_list heap_free_lists[HEAP_KINDS];
+	long long heap_live_bytes;
+	long long heap_peak_live_bytes;
+};
+
+/**
+ * interp - The interpreter current on this thread, or NULL
+ */
+extern __thread struct interpreter *interp;
+
+/**
+ * interpreter_create() - Creates an interpreter with the builtins defined
+ *
+ * It reads from stdin until interpreter_set_input() is called.
+ */
+struct interpreter *interpreter_create(void);
+
+/**
+ * interpreter_destroy() - Frees an interpreter
+ * @in
+ *
+ * This frees the environment, lexer and profile, and closes any input opened
+ * by interpreter_set_buffer(). Values it created are left alone.
+ */
+void interpreter_destroy(struct interpreter *in);
+
+/**
+ * interpreter_fork() - Creates an interpreter for running a task in parallel
+ * with the current one
+ *
+ * The new interpreter starts with a copy of the current interpreter's
+ * bindings, and has no input. It is meant to be run on another thread and
+ * then passed to interpreter_join() on the thread of the current one.
+ */
+struct interpreter *interpreter_fork(void);
+
+/**
+ * interpreter_join() - Destroys an interpreter from interpreter_fork()
+ * @child
+ *
+ * Its allocation counters are added to those of the current interpreter.
+ * Values it created stay valid.
+ */
+void interpreter_join(struct interpreter *child);
+
+/**
+ * interpreter_enter() - Makes `in` the current interpreter on this thread
+ * @in - the interpreter, or NULL
+ * @returns the previously current interpreter, to be restored by passing it
+ * back to interpreter_enter()
+ *
+ * This is only needed to call the functions of the other modules directly.
+ */
+struct interpreter *interpreter_enter(struct interpreter *in);
+
+/**
+ * interpreter_set_engine() - Chooses how `in` evaluates expressions
+ * @in
+ * @engine - ENGINE_TREE, the default, or ENGINE_CLOSURE
+ *
+ * Interpreters started by `in` for futures, pmap and actors use the same
+ * engine.
+ */
+void interpreter_set_engine(struct interpreter *in, enum eval_engine engine);
+
+/**
+ * interpreter_set_jit() - Chooses when `in` compiles lambdas to machine code
+ * @in
+ * @threshold - the number of calls after which the body of a lambda is
+ * compiled, or 0 to never compile
+ *
+ * Interpreters start with JIT_DEFAULT_THRESHOLD (see jit.h). Like the engine,
+ * this is passed on to the interpreters `in` starts.
+ */
+void interpreter_set_jit(struct interpreter *in, int threshold);
+
+/**
+ * interpreter_set_folding() - Chooses whether `in` folds forms before
+ * evaluating them
+ * @in
+ * @enabled - 1, the default, to fold constant subexpressions (see
+ * fold_expression() in evaluator.h), or 0 to evaluate forms as they are read
+ */
+void interpreter_set_folding(struct interpreter *in, int enabled);
+
+/**
+ * interpreter_set_input() - Reads expressions from `stream`
+ * @in
+ * @stream - the stream, which remains owned by the caller
+ */
+void interpreter_set_input(struct interpreter *in, FILE *stream);
+
+/**
+ * interpreter_set_buffer() - Reads expressions from memory
+ * @in
+ * @buffer - the source text, which must outlive its use
+ * @length - the number of bytes in `buffer`
+ * @returns 1 on success and 0 if the buffer could not be opened as a stream
+ */
+int interpreter_set_buffer(struct interpreter *in, char *buffer,
+	size_t length);
+
+/**
+ * interpreter_read() - Parses the next expression from the input
+ * @in
+ * @returns the expression, or NULL at the end of the input or on a syntax
+ * error (see interpreter_read_failed())
+ */
+struct s_expr *interpreter_read(struct interpreter *in);
+
+/**
+ * interpreter_read_failed() - Returns whether interpreter_read() stopped at a
+ * syntax error rather than at the end of the input
+ * @in
+ *
+ * The error's message is then given by interpreter_error(), and the rest of
+ * the input is skipped until interpreter_set_input() is called again.
+ */
+int interpreter_read_failed(struct interpreter *in);
+
+/**
+ * interpreter_eval() - Expands the macros in an expression, folds it and
+ * evaluates it
+ * @in
+ * @expr
+ * @returns the value, or NULL on error (see interpreter_error())
+ */
+struct s_expr *interpreter_eval(struct interpreter *in, struct s_expr *expr);
+
+/**
+ * interpreter_call() - Calls a function value in `in`
+ * @in
+ * @fn - a lambda or builtin
+ * @values - the argument values, which are not evaluated again
+ * @returns the value, or NULL on error (see interpreter_error())
+ */
+struct s_expr *interpreter_call(struct interpreter *in, struct s_expr *fn,
+	struct fn_arguments *values);
+
+/**
+ * interpreter_copy() - Deep-copies a value into objects of `in`
+ * @in
+ * @value - a value, possibly of another interpreter
+ * @returns the copy, or NULL if `value` can't be copied (see eval_copy() in
+ * evaluator.h)
+ */
+struct s_expr *interpreter_copy(struct interpreter *in, struct s_expr *value);
+
+/**
+ * interpreter_define() - Binds a name in the innermost environment of `in`
+ * @in
+ * @id - the name, which is copied
+ * @value - a value of `in`
+ */
+void interpreter_define(struct interpreter *in, char *id,
+	struct s_expr *value);
+
+/**
+ * interpreter_set_profiling() - Starts or stops profiling the calls `in`
+ * makes (see profile.h)
+ * @in
+ * @enabled
+ */
+void interpreter_set_profiling(struct interpreter *in, int enabled);
+
+/**
+ * interpreter_profile_report() - Writes the profile of `in`
+ * @in
+ * @out - where the report goes
+ * @folded - where the folded stacks go, or NULL
+ */
+void interpreter_profile_report(struct interpreter *in, FILE *out,
+	FILE *folded);
+
+/**
+ * interpreter_heap_report() - Writes the allocation counters of `in` (see
+ * heap_report())
+ * @in
+ * @out
+ */
+void interpreter_heap_report(struct interpreter *in, FILE *out);
+
+/**
+ * interpreter_error() - Retrieves the message of the last error
+ * @in
+ * @buffer - the destination buffer
+ * @buffer_size - the size of the destination buffer
+ * @returns 1 if the message was copied successfully and 0 otherwise
+ */
+int interpreter_error(struct interpreter *in, char *buffer, int buffer_size);
+
+#endif
@@ -0,0 +1,491 @@
+/**
+ * jit.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "parser.h"
+#include "interpreter.h"
+#include "jit.h"
+
+/*
+ * Implementation notes:
+ *
+ * The accumulator is rax. A function keeps rbp as a frame pointer, with its
+ * slots in an array just below it, so JIT_CALL_SLOTS can pass their address.
+ * rcx, rdx, rdi, rsi and r11 are scratch registers, which calls may clobber.
+ * The frame is a multiple of 16 bytes, so the stack stays aligned for calls.
+ *
+ * Jumps are always encoded with 32-bit offsets, and patched once every label
+ * has been placed.
+ */
+
+#define INITIAL_INSNS 64
+#define INITIAL_CODE 1024
+
+/**
+ * jit_code - A mapping holding the code of one function
+ */
+struct jit_code {
+	void *start;
+	size_t size;
+	struct jit_code *next;
+};
+
+static int perf_map_enabled;
+static FILE *perf_map;
+static pthread_mutex_t perf_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void jit_ir_init(struct jit_ir *ir)
+{
+	memset(ir, 0, sizeof(*ir));
+}
+
+int jit_new_label(struct jit_ir *ir)
+{
+	return ir->labels++;
+}
+
+void jit_emit(struct jit_ir *ir, enum jit_op op, int a, int b, void *imm,
+	void *fn)
+{
+	struct jit_insn *insn;
+
+	if (ir->count == ir->capacity) {
+		ir->capacity = ir->capacity > 0 ? 2 * ir->capacity
+			: INITIAL_INSNS;
+		ir->insns = (struct jit_insn *) realloc(ir->insns,
+			ir->capacity * sizeof(struct jit_insn));
+		if (ir->insns == NULL) {
+			printf("Out of memory, cannot compile.\n");
+			exit(1);
+		}
+	}
+	insn = &ir->insns[ir->count++];
+	insn->op = op;
+	insn->a = a;
+	insn->b = b;
+	insn->imm = imm;
+	insn->fn = fn;
+	if (op == JIT_STORE && a + 1 > ir->slots)
+		ir->slots = a + 1;
+	if (op == JIT_CALL_SLOTS && a + b > ir->slots)
+		ir->slots = a + b;
+}
+
+void jit_ir_free(struct jit_ir *ir)
+{
+	free(ir->insns);
+	ir->insns = NULL;
+}
+
+void jit_set_perf_map(int enabled)
+{
+	perf_map_enabled = enabled;
+}
+
+// Records where a function's code is, for perf.
+static void write_perf_map(void *start, size_t size, char *name)
+{
+	char path[64];
+
+	pthread_mutex_lock(&perf_map_lock);
+	if (perf_map == NULL) {
+		sprintf(path, "/tmp/perf-%d.map", (int) getpid());
+		perf_map = fopen(path, "a");
+	}
+	if (perf_map != NULL) {
+		fprintf(perf_map, "%lx %lx scheme:%s\n",
+			(unsigned long) (uintptr_t) start, (unsigned long) size,
+			name);
+		fflush(perf_map);
+	}
+	pthread_mutex_unlock(&perf_map_lock);
+}
+
+// Copies finished code to a mapping of its own, and makes it executable.
+static void *install(unsigned char *code, size_t length, char *name)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	size_t size = (length + page - 1) / page * page;
+	struct jit_code *mapping;
+	void *start;
+
+	start = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (start == MAP_FAILED)
+		return NULL;
+	memcpy(start, code, length);
+	if (mprotect(start, size, PROT_READ | PROT_EXEC)) {
+		munmap(start, size);
+		return NULL;
+	}
+	mapping = (struct jit_code *) malloc(sizeof(struct jit_code));
+	if (mapping == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	mapping->start = start;
+	mapping->size = size;
+	mapping->next = interp->jit_code;
+	interp->jit_code = mapping;
+	if (perf_map_enabled)
+		write_perf_map(start, length, name);
+	return start;
+}
+
+void free_jit(void)
+{
+	struct jit_code *mapping = interp->jit_code;
+
+	while (mapping != NULL) {
+		struct jit_code *next = mapping->next;
+
+		munmap(mapping->start, mapping->size);
+		free(mapping);
+		mapping = next;
+	}
+	interp->jit_code = NULL;
+}
+
+#if defined(__x86_64__)
+
+/**
+ * assembler - Machine code being written
+ * @code
+ * @length
+ * @capacity
+ * @labels - the offset of each label, or -1 until it is placed
+ * @fixups - the offsets of jumps, each followed by its label
+ * @fixup_count - the number of jumps
+ * @frame - the size of the slot array
+ */
+struct assembler {
+	unsigned char *code;
+	size_t length;
+	size_t capacity;
+	long *labels;
+	int *fixups;
+	int fixup_count;
+	int fixup_capacity;
+	int frame;
+};
+
+static void bytes(struct assembler *as, const void *data, size_t length)
+{
+	if (as->length + length > as->capacity) {
+		while (as->length + length > as->capacity)
+			as->capacity *= 2;
+		as->code = (unsigned char *) realloc(as->code, as->capacity);
+		if (as->code == NULL) {
+			printf("Out of memory, cannot compile.\n");
+			exit(1);
+		}
+	}
+	memcpy(as->code + as->length, data, length);
+	as->length += length;
+}
+
+static void byte(struct assembler *as, unsigned char b)
+{
+	bytes(as, &b, 1);
+}
+
+static void imm32(struct assembler *as, int32_t value)
+{
+	bytes(as, &value, 4);
+}
+
+static void imm64(struct assembler *as, void *value)
+{
+	uint64_t bits = (uint64_t) (uintptr_t) value;
+
+	bytes(as, &bits, 8);
+}
+
+// Writes a 32-bit offset to `label`, to be filled in by patch().
+static void label_offset(struct assembler *as, int label)
+{
+	if (as->fixup_count == as->fixup_capacity) {
+		as->fixup_capacity = as->fixup_capacity > 0
+			? 2 * as->fixup_capacity : 64;
+		as->fixups = (int *) realloc(as->fixups,
+			2 * as->fixup_capacity * sizeof(int));
+		if (as->fixups == NULL) {
+			printf("Out of memory, cannot compile.\n");
+			exit(1);
+		}
+	}
+	as->fixups[2 * as->fixup_count] = (int) as->length;
+	as->fixups[2 * as->fixup_count + 1] = label;
+	as->fixup_count++;
+	imm32(as, 0);
+}
+
+static void patch(struct assembler *as)
+{
+	int i;
+
+	for (i = 0; i < as->fixup_count; i++) {
+		int at = as->fixups[2 * i];
+		int32_t offset = (int32_t) (as->labels[as->fixups[2 * i + 1]]
+			- (at + 4));
+
+		memcpy(as->code + at, &offset, 4);
+	}
+}
+
+// The offset from rbp of slot i
+static int32_t slot(struct assembler *as, int i)
+{
+	return -as->frame + 8 * i;
+}
+
+// mov r11, fn; call r11
+static void call(struct assembler *as, void *fn)
+{
+	static const unsigned char mov_r11[] = { 0x49, 0xbb };
+	static const unsigned char call_r11[] = { 0x41, 0xff, 0xd3 };
+
+	bytes(as, mov_r11, sizeof(mov_r11));
+	imm64(as, fn);
+	bytes(as, call_r11, sizeof(call_r11));
+}
+
+// cmp dword [rax + type], value
+static void compare_type(struct assembler *as, int type)
+{
+	byte(as, 0x81);
+	byte(as, 0x78);
+	byte(as, (unsigned char) offsetof(struct s_expr, type));
+	imm32(as, type);
+}
+
+// Jumps to `label` on condition `cc`, as in 0f 8x.
+static void jump_if(struct assembler *as, unsigned char cc, int label)
+{
+	byte(as, 0x0f);
+	byte(as, 0x80 | cc);
+	label_offset(as, label);
+}
+
+#define CC_EQUAL 0x4
+#define CC_NOT_EQUAL 0x5
+
+// Both branches on truth test the same way as is_empty_list().
+static void branch_if_false(struct assembler *as, int label)
+{
+	// mov rcx, [rax]; cmp dword [rcx], 0
+	static const unsigned char load_boolean[] = {
+		0x48, 0x8b, 0x08, 0x83, 0x39, 0x00
+	};
+
+	compare_type(as, EMPTY_LIST);
+	jump_if(as, CC_EQUAL, label);
+	compare_type(as, BOOLEAN);
+	// jne over the test of the boolean
+	byte(as, 0x75);
+	byte(as, sizeof(load_boolean) + 6);
+	bytes(as, load_boolean, sizeof(load_boolean));
+	jump_if(as, CC_EQUAL, label);
+}
+
+static void branch_if_true(struct assembler *as, int label)
+{
+	static const unsigned char load_boolean[] = {
+		0x48, 0x8b, 0x08, 0x83, 0x39, 0x00
+	};
+
+	compare_type(as, EMPTY_LIST);
+	// je past the rest
+	byte(as, 0x74);
+	byte(as, 7 + 6 + sizeof(load_boolean) + 6);
+	compare_type(as, BOOLEAN);
+	jump_if(as, CC_NOT_EQUAL, label);
+	bytes(as, load_boolean, sizeof(load_boolean));
+	jump_if(as, CC_NOT_EQUAL, label);
+}
+
+static void arith(struct assembler *as, struct jit_insn *insn)
+{
+	// mov rcx, [rcx]; mov ecx, [rcx]; mov rdx, [rax]; mov edx, [rdx]
+	static const unsigned char load_integers[] = {
+		0x48, 0x8b, 0x09, 0x8b, 0x09, 0x48, 0x8b, 0x10, 0x8b, 0x12
+	};
+	// The setcc condition code of each comparison
+	static const unsigned char conditions[] = {
+		[JIT_LESS] = 0xc, [JIT_GREATER] = 0xf, [JIT_EQUAL] = 0x4,
+		[JIT_LESS_EQUAL] = 0xe, [JIT_GREATER_EQUAL] = 0xd
+	};
+
+	// mov rcx, [rbp + slot]
+	byte(as, 0x48);
+	byte(as, 0x8b);
+	byte(as, 0x8d);
+	imm32(as, slot(as, insn->a));
+	bytes(as, load_integers, sizeof(load_integers));
+	if (insn->b == JIT_ADD) {
+		// add ecx, edx
+		byte(as, 0x01);
+		byte(as, 0xd1);
+	} else if (insn->b == JIT_SUB) {
+		// sub ecx, edx
+		byte(as, 0x29);
+		byte(as, 0xd1);
+	} else if (insn->b == JIT_MUL) {
+		// imul ecx, edx
+		byte(as, 0x0f);
+		byte(as, 0xaf);
+		byte(as, 0xca);
+	}
+	if (insn->b == JIT_ADD || insn->b == JIT_SUB || insn->b == JIT_MUL) {
+		// mov edi, ecx
+		byte(as, 0x89);
+		byte(as, 0xcf);
+	} else {
+		// cmp ecx, edx; setcc al; movzx edi, al
+		byte(as, 0x39);
+		byte(as, 0xd1);
+		byte(as, 0x0f);
+		byte(as, 0x90 | conditions[insn->b]);
+		byte(as, 0xc0);
+		byte(as, 0x0f);
+		byte(as, 0xb6);
+		byte(as, 0xf8);
+	}
+	call(as, insn->fn);
+}
+
+static void assemble_insn(struct assembler *as, struct jit_insn *insn,
+	int epilogue)
+{
+	if (insn->op == JIT_CONST) {
+		// mov rax, imm
+		byte(as, 0x48);
+		byte(as, 0xb8);
+		imm64(as, insn->imm);
+	} else if (insn->op == JIT_CALL) {
+		// mov rdi, imm
+		byte(as, 0x48);
+		byte(as, 0xbf);
+		imm64(as, insn->imm);
+		call(as, insn->fn);
+	} else if (insn->op == JIT_CALL_ACC) {
+		// mov rdi, rax
+		byte(as, 0x48);
+		byte(as, 0x89);
+		byte(as, 0xc7);
+		call(as, insn->fn);
+	} else if (insn->op == JIT_CALL_SLOTS) {
+		// mov rdi, imm; lea rsi, [rbp + slot]; mov edx, b
+		byte(as, 0x48);
+		byte(as, 0xbf);
+		imm64(as, insn->imm);
+		byte(as, 0x48);
+		byte(as, 0x8d);
+		byte(as, 0xb5);
+		imm32(as, slot(as, insn->a));
+		byte(as, 0xba);
+		imm32(as, insn->b);
+		call(as, insn->fn);
+	} else if (insn->op == JIT_STORE) {
+		// mov [rbp + slot], rax
+		byte(as, 0x48);
+		byte(as, 0x89);
+		byte(as, 0x85);
+		imm32(as, slot(as, insn->a));
+	} else if (insn->op == JIT_LOAD_FIELD) {
+		// mov rax, [rax + a]
+		byte(as, 0x48);
+		byte(as, 0x8b);
+		byte(as, 0x80);
+		imm32(as, insn->a);
+	} else if (insn->op == JIT_RETURN_IF_NULL) {
+		// test rax, rax; jz epilogue
+		byte(as, 0x48);
+		byte(as, 0x85);
+		byte(as, 0xc0);
+		jump_if(as, CC_EQUAL, epilogue);
+	} else if (insn->op == JIT_BRANCH_IF_NOT) {
+		// mov rcx, imm; cmp rax, rcx; jne label
+		byte(as, 0x48);
+		byte(as, 0xb9);
+		imm64(as, insn->imm);
+		byte(as, 0x48);
+		byte(as, 0x39);
+		byte(as, 0xc8);
+		jump_if(as, CC_NOT_EQUAL, insn->a);
+	} else if (insn->op == JIT_BRANCH_IF_NOT_TYPE) {
+		compare_type(as, insn->b);
+		jump_if(as, CC_NOT_EQUAL, insn->a);
+	} else if (insn->op == JIT_BRANCH_IF_FALSE) {
+		branch_if_false(as, insn->a);
+	} else if (insn->op == JIT_BRANCH_IF_TRUE) {
+		branch_if_true(as, insn->a);
+	} else if (insn->op == JIT_JUMP) {
+		byte(as, 0xe9);
+		label_offset(as, insn->a);
+	} else if (insn->op == JIT_LABEL) {
+		as->labels[insn->a] = (long) as->length;
+	} else if (insn->op == JIT_ARITH) {
+		arith(as, insn);
+	} else {
+		// JIT_RETURN
+		byte(as, 0xe9);
+		label_offset(as, epilogue);
+	}
+}
+
+void *jit_assemble(struct jit_ir *ir, char *name)
+{
+	// push rbp; mov rbp, rsp; sub rsp, frame
+	static const unsigned char prologue[] = { 0x55, 0x48, 0x89, 0xe5 };
+	// leave; ret
+	static const unsigned char epilogue[] = { 0xc9, 0xc3 };
+	struct assembler as;
+	// The epilogue gets a label after the function's own.
+	int epilogue_label = ir->labels;
+	void *start;
+	int i;
+
+	memset(&as, 0, sizeof(as));
+	as.capacity = INITIAL_CODE;
+	as.code = (unsigned char *) malloc(as.capacity);
+	as.labels = (long *) malloc((ir->labels + 1) * sizeof(long));
+	if (as.code == NULL || as.labels == NULL) {
+		printf("Out of memory, cannot compile.\n");
+		exit(1);
+	}
+	as.frame = (8 * ir->slots + 15) / 16 * 16;
+
+	bytes(&as, prologue, sizeof(prologue));
+	byte(&as, 0x48);
+	byte(&as, 0x81);
+	byte(&as, 0xec);
+	imm32(&as, as.frame);
+	for (i = 0; i < ir->count; i++)
+		assemble_insn(&as, &ir->insns[i], epilogue_label);
+	as.labels[epilogue_label] = (long) as.length;
+	bytes(&as, epilogue, sizeof(epilogue));
+	patch(&as);
+
+	start = install(as.code, as.length, name);
+	free(as.code);
+	free(as.labels);
+	free(as.fixups);
+	return start;
+}
+
+#else
+
+void *jit_assemble(struct jit_ir *ir, char *name)
+{
+	return NULL;
+}
+
+#endif
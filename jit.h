@@ -0,0 +1,154 @@
+/**
+ * jit.h - Turns a small IR into x86-64 machine code
+ *
+ * The evaluator describes the body of a hot lambda in the IR below (see
+ * lower.h), and jit_assemble() turns it into a function that takes no
+ * arguments and returns an s-expression, or NULL on error, like
+ * eval_expression(). The IR is for an accumulator machine: every instruction
+ * reads or sets one value, kept in a register, plus a few numbered stack slots
+ * for values that must survive a call. Anything the IR can't say is done by
+ * calling back into C.
+ *
+ * Code is written to a mapping of its own and then made executable, so no
+ * memory is ever writable and executable at once. The mappings belong to the
+ * current interpreter, and are unmapped with it by free_jit().
+ *
+ * On machines other than x86-64, jit_assemble() always fails, and lambdas
+ * keep running in the interpreter.
+ */
+#ifndef JIT_H
+#define JIT_H
+#include <stdlib.h>
+
+// How many calls a lambda gets before its body is compiled, by default
+#define JIT_DEFAULT_THRESHOLD 100
+
+/**
+ * jit_op - An IR instruction, acting on the accumulator `acc`
+ * @JIT_CONST - acc = imm
+ * @JIT_CALL - acc = fn(imm)
+ * @JIT_CALL_ACC - acc = fn(acc)
+ * @JIT_CALL_SLOTS - acc = fn(imm, &slot[a], b), with slots a to a+b-1 set
+ * @JIT_STORE - slot[a] = acc
+ * @JIT_LOAD_FIELD - acc = the pointer at byte a of *acc
+ * @JIT_RETURN_IF_NULL - returns NULL if acc is NULL
+ * @JIT_BRANCH_IF_NOT - goes to label a unless acc == imm
+ * @JIT_BRANCH_IF_NOT_TYPE - goes to label a unless acc's type is b
+ * @JIT_BRANCH_IF_FALSE - goes to label a if acc is #f or the empty list
+ * @JIT_BRANCH_IF_TRUE - goes to label a unless acc is #f or the empty list
+ * @JIT_JUMP - goes to label a
+ * @JIT_LABEL - places label a
+ * @JIT_ARITH - acc = fn(slot[a] op acc), where both are integers, op is the
+ * jit_arith b, and fn makes an integer or a boolean of the result
+ * @JIT_RETURN - returns acc
+ */
+enum jit_op {
+	JIT_CONST,
+	JIT_CALL,
+	JIT_CALL_ACC,
+	JIT_CALL_SLOTS,
+	JIT_STORE,
+	JIT_LOAD_FIELD,
+	JIT_RETURN_IF_NULL,
+	JIT_BRANCH_IF_NOT,
+	JIT_BRANCH_IF_NOT_TYPE,
+	JIT_BRANCH_IF_FALSE,
+	JIT_BRANCH_IF_TRUE,
+	JIT_JUMP,
+	JIT_LABEL,
+	JIT_ARITH,
+	JIT_RETURN
+};
+
+// The operations of JIT_ARITH, which wrap around like C's int
+enum jit_arith {
+	JIT_ADD,
+	JIT_SUB,
+	JIT_MUL,
+	JIT_LESS,
+	JIT_GREATER,
+	JIT_EQUAL,
+	JIT_LESS_EQUAL,
+	JIT_GREATER_EQUAL
+};
+
+struct jit_insn {
+	enum jit_op op;
+	int a;
+	int b;
+	void *imm;
+	void *fn;
+};
+
+/**
+ * jit_ir - A function being described
+ * @insns
+ * @count
+ * @capacity
+ * @labels - the number of labels made so far
+ * @slots - the number of stack slots used so far
+ */
+struct jit_ir {
+	struct jit_insn *insns;
+	int count;
+	int capacity;
+	int labels;
+	int slots;
+};
+
+/**
+ * jit_ir_init() - Starts an empty function
+ * @ir
+ */
+void jit_ir_init(struct jit_ir *ir);
+
+/**
+ * jit_new_label() - Returns a label, to be placed once with JIT_LABEL
+ * @ir
+ */
+int jit_new_label(struct jit_ir *ir);
+
+/**
+ * jit_emit() - Adds an instruction (see jit_op)
+ * @ir
+ * @op
+ * @a
+ * @b
+ * @imm
+ * @fn
+ *
+ * Operands an instruction doesn't use are ignored.
+ */
+void jit_emit(struct jit_ir *ir, enum jit_op op, int a, int b, void *imm,
+	void *fn);
+
+/**
+ * jit_assemble() - Makes machine code for a function
+ * @ir - a function that ends in JIT_RETURN
+ * @name - the name it is given in the perf map
+ * @returns the address of the code, or NULL if it can't be made
+ */
+void *jit_assemble(struct jit_ir *ir, char *name);
+
+/**
+ * jit_ir_free() - Frees the instructions of a function
+ * @ir
+ */
+void jit_ir_free(struct jit_ir *ir);
+
+/**
+ * jit_set_perf_map() - Turns the perf map on or off for the whole process
+ * @enabled
+ *
+ * While it is on, jit_assemble() adds a line for each function to
+ * /tmp/perf-PID.map, where `perf report` looks for the names of code that
+ * has no symbols.
+ */
+void jit_set_perf_map(int enabled);
+
+/**
+ * free_jit() - Unmaps the code made for the current interpreter
+ */
+void free_jit(void);
+
+#endif
@@ -5,14 +5,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include "interpreter.h"
 #include "lexer.h"
 
-// the current token
-static char *lexeme;
-// the current character in the input stream from the keyboard
-static char c;
-// if the previous call to get_token() required looking ahead
-static int lookahead;
+/*
+ * Implementation notes:
+ *
+ * The lexer state is kept in the current interpreter (see struct lexer in
+ * interpreter.h). Every function works on it through a local pointer `lx`.
+ */
 
 /**
  * new_token() - Reinitializes lexeme to a string of max_length.
@@ -24,86 +25,280 @@ static int lookahead;
  */
 static void new_token(int max_length)
 {
-	if (lexeme != NULL)
-		free(lexeme);
+	struct lexer *lx = &interp->lexer;
+
+	if (lx->lexeme != NULL)
+		free(lx->lexeme);
 
-	lexeme = (char *) calloc(max_length, sizeof(char));
-	if (lexeme == NULL) {
+	lx->lexeme_size = max_length;
+	lx->lexeme = (char *) calloc(max_length, sizeof(char));
+	if (lx->lexeme == NULL) {
 		printf("Out of memory, too many tokens.\n");
 		exit(0);
 	}
 }
 
+/**
+ * add_char() - Appends a character to lexeme, growing it as needed.
+ * @i - the index to write at, which is advanced
+ * @ch - the character
+ *
+ * There is always room left for a terminating '\0' afterwards.
+ */
+static void add_char(int *i, char ch)
+{
+	struct lexer *lx = &interp->lexer;
+
+	if (*i + 2 > lx->lexeme_size) {
+		lx->lexeme_size *= 2;
+		lx->lexeme = (char *) realloc(lx->lexeme,
+			lx->lexeme_size * sizeof(char));
+		if (lx->lexeme == NULL) {
+			printf("Out of memory, token too long.\n");
+			exit(0);
+		}
+	}
+	lx->lexeme[(*i)++] = ch;
+}
+
+/**
+ * syntax_error()
+ */
+void syntax_error(char *message)
+{
+	struct lexer *lx = &interp->lexer;
+
+	free(interp->last_error_message);
+	interp->last_error_message = strdup(message);
+	// Skip the rest of the input.
+	lx->c = EOF;
+	lx->lookahead = 1;
+	lx->error = 1;
+}
+
+static int hex_digit(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	return -1;
+}
+
+/**
+ * scan_string() - Scans a string literal into lexeme.
+ *
+ * Called with c on the opening double quote. The token is the opening quote
+ * followed by the contents with escapes decoded. The supported escapes are
+ * \n, \t, \r, \\, \" and \x<hex digits>; (as in R7RS). Returns the length
+ * of the token, or -1 after a syntax error.
+ */
+static int scan_string(void)
+{
+	struct lexer *lx = &interp->lexer;
+	int i = 0;
+
+	add_char(&i, '"');
+	lx->c = getc(lx->input);
+	while (lx->c != '"') {
+		if (lx->c == EOF) {
+			syntax_error("syntax error (unterminated string)");
+			return -1;
+		}
+		if (lx->c == '\\') {
+			lx->c = getc(lx->input);
+			if (lx->c == 'n') {
+				lx->c = '\n';
+			} else if (lx->c == 't') {
+				lx->c = '\t';
+			} else if (lx->c == 'r') {
+				lx->c = '\r';
+			} else if (lx->c == 'x') {
+				int code = 0;
+				int digit;
+
+				lx->c = getc(lx->input);
+				while ((digit = hex_digit(lx->c)) >= 0) {
+					code = code * 16 + digit;
+					lx->c = getc(lx->input);
+				}
+				if (lx->c != ';' || code > 255) {
+					syntax_error("syntax error (illegal hex"
+						" escape in string)");
+					return -1;
+				}
+				lx->c = code;
+			} else if ((lx->c != '\\') && (lx->c != '"')) {
+				syntax_error("syntax error (illegal escape in"
+					" string)");
+				return -1;
+			}
+		}
+		add_char(&i, lx->c);
+		lx->c = getc(lx->input);
+	}
+	lx->lexeme[i] = '\0';
+	return i;
+}
+
+/**
+ * set_token_input()
+ */
+void set_token_input(FILE *stream)
+{
+	struct lexer *lx = &interp->lexer;
+
+	if (lx->owns_input)
+		fclose(lx->input);
+	lx->input = stream;
+	lx->owns_input = 0;
+	lx->lookahead = 0;
+	lx->error = 0;
+}
+
+static int is_space(int ch)
+{
+	return (ch == ' ') || (ch == '\n') || (ch == '\t') || (ch == '\r');
+}
+
+/**
+ * skip_space() - Advances c past white space and comments.
+ *
+ * A comment runs from a semicolon to the end of the line.
+ */
+static void skip_space(void)
+{
+	struct lexer *lx = &interp->lexer;
+
+	while (is_space(lx->c) || (lx->c == ';')) {
+		if (lx->c == ';') {
+			while ((lx->c != '\n') && (lx->c != EOF))
+				lx->c = getc(lx->input);
+		} else {
+			lx->c = getc(lx->input);
+		}
+	}
+}
+
 /**
  * start_tokens()
  */
 void start_tokens(int max_length)
 {
-	lookahead = 0;
-	lexeme = NULL;
+	struct lexer *lx = &interp->lexer;
+
+	lx->input = stdin;
+	lx->owns_input = 0;
+	lx->lookahead = 0;
+	lx->error = 0;
+	lx->lexeme = NULL;
 	new_token(max_length);
 }
 
+/**
+ * free_tokens()
+ */
+void free_tokens(void)
+{
+	struct lexer *lx = &interp->lexer;
+
+	if (lx->owns_input)
+		fclose(lx->input);
+	lx->owns_input = 0;
+	free(lx->lexeme);
+	lx->lexeme = NULL;
+}
+
 /**
  * get_token()
  *
  * Implementation notes: The function works by getting the first character, in
- * case the previous call required lookahead, then skipping over whitespace. The
- * main part is the "if" statement that handles 4 cases:
+ * case the previous call required lookahead, then skipping over whitespace and
+ * comments. At the end of the input it returns NULL. Otherwise, the main part
+ * is the "if" statement that handles 5 cases:
  *   (1) Current character is ")" or "'" (single quote). Then return the
  *       character as a string.
  *   (2) Current character is "(". Then scan for ")". If found, return "()".
  *       Otherwise, return "(".
  *   (3) Current character is "#". Only accepted following characters are t
  *       and f, in which case "#t" or "#f" are returned.
- *   (4) Default case: Scan for a string of characters, and return as a string
+ *   (4) Current character is a double quote. Scan a string literal (see
+ *       scan_string()).
+ *   (5) Default case: Scan for a string of characters, and return as a string
  *       (a string cannot contain any whitespace character, or "(" or ")").
  */
 char *get_token()
 {
+	struct lexer *lx = &interp->lexer;
 	int i; //local index for lexeme
 
-	if (!lookahead) //get first char
-		c = getchar();
-
-	while ((c == ' ') || (c == '\n')) //skip white space
-		c = getchar();
-
-	if ((c == ')') || (c == '\'')) { //Case (1): right paren or quote
-		lexeme[0] = c;
-		lexeme[1] = '\0';
-		lookahead = 0;
-	} else if (c == '(') { //Case (2): left paren or ()
-		lookahead = 1;
-		c = getchar();
-		while ((c == ' ') || (c == '\n'))
-			c = getchar();
-		if (c == ')') {
-			strcpy(lexeme, "()"); //empty list token
-			lookahead = 0;
+	if (!lx->lookahead) //get first char
+		lx->c = getc(lx->input);
+
+	skip_space();
+	if (lx->c == EOF) { //end of input; keep returning NULL
+		lx->lookahead = 1;
+		return NULL;
+	}
+
+	if ((lx->c == ')') || (lx->c == '\'')) { //Case (1): right paren or quote
+		lx->lexeme[0] = lx->c;
+		lx->lexeme[1] = '\0';
+		lx->lookahead = 0;
+	} else if (lx->c == '(') { //Case (2): left paren or ()
+		lx->lookahead = 1;
+		lx->c = getc(lx->input);
+		skip_space();
+		if (lx->c == ')') {
+			strcpy(lx->lexeme, "()"); //empty list token
+			lx->lookahead = 0;
 		} else {
-			strcpy(lexeme, "(");
+			strcpy(lx->lexeme, "(");
 		}
-	} else if (c == '#') { //Case (3): #t or #f
-		lookahead = 0;
-		c = getchar();
-		if ((c != 't') && (c != 'f')) {
-			printf("Illegal symbol after #.\n");
-			exit(1);
+	} else if (lx->c == '#') { //Case (3): #t or #f
+		lx->lookahead = 0;
+		lx->c = getc(lx->input);
+		if ((lx->c != 't') && (lx->c != 'f')) {
+			syntax_error("syntax error (illegal symbol after #)");
+			return NULL;
 		}
-		if (c == 't')
-			strcpy(lexeme, "#t");
+		if (lx->c == 't')
+			strcpy(lx->lexeme, "#t");
 		else
-			strcpy(lexeme, "#f");
-	} else { //Case (4): scan for symbol
+			strcpy(lx->lexeme, "#f");
+	} else if (lx->c == '"') { //Case (4): string literal
+		lx->lookahead = 0;
+		lx->lexeme_length = scan_string();
+		return lx->lexeme_length >= 0 ? lx->lexeme : NULL;
+	} else { //Case (5): scan for symbol
 		i = 0;
-		lookahead = 1;
-		while ((c != '(') && (c != ')') && (c != ' ') && (c != '\n')) {
-			lexeme[i++] = c;
-			c = getchar();
+		lx->lookahead = 1;
+		while ((lx->c != '(') && (lx->c != ')') && !is_space(lx->c)
+		&& (lx->c != EOF)) {
+			add_char(&i, lx->c);
+			lx->c = getc(lx->input);
 		}
-		lexeme[i] = '\0';
+		lx->lexeme[i] = '\0';
 	}
 
-	return lexeme;
+	lx->lexeme_length = strlen(lx->lexeme);
+	return lx->lexeme;
+}
+
+/**
+ * get_token_length()
+ */
+int get_token_length(void)
+{
+	return interp->lexer.lexeme_length;
+}
+
+/**
+ * get_token_error()
+ */
+int get_token_error(void)
+{
+	return interp->lexer.error;
 }
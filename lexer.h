@@ -3,11 +3,12 @@
  *
  * This is the interface for a lexical analyzer for part of Scheme.  It has an
  * operation for initializing the stream of tokens and for getting the next
- * token.
+ * token. The stream belongs to the current interpreter (see interpreter.h).
  */
 #ifndef LEXER
 #define LEXER
 #include <stdlib.h>
+#include <stdio.h>
 
 /**
  * start_tokens() - Initialize a token stream of tokens.
@@ -17,21 +18,41 @@
  *
  *    start_tokens(20);
  *
- * The argument signifies the fact that tokens will have the given maximum
- * length. Thus in the above statement tokens in the stream can be at most 20
- * characters long.
+ * The argument is the initial size of the token buffer. Longer tokens are
+ * still scanned; the buffer grows to fit them.
  */
 void start_tokens(int max_length);
 
+/**
+ * free_tokens() - Frees the token buffer and closes any input the
+ * interpreter opened (see interpreter_set_buffer()).
+ */
+void free_tokens(void);
+
+/**
+ * set_token_input() - Read tokens from `stream` instead of stdin.
+ * @stream - the stream to read from
+ *
+ * Call this after start_tokens(). Any lookahead from the previous stream is
+ * discarded.
+ */
+void set_token_input(FILE *stream);
+
 /**
  * get_token() - Return the next token in the token stream.
  *
- * It ignores all white space, including newlines. It returns the tokens "(",
- * ")", "#t", "#f", "'" (the single quote), and "()" (the empty list, which is
- * returned as the string "()"). All other strings of symbols with no white
- * space are regarded as symbols or literals, and are returned as strings. (For
- * ease in scanning, there is one exception: the "#" sign is excluded except at
- * the beginning of #t or #f.)
+ * It ignores all white space, including newlines, and comments, which run from
+ * ";" to the end of the line. It returns NULL at the end of the input, and on
+ * a syntax error (see syntax_error()).
+ * Otherwise, it returns the tokens "(", ")", "#t", "#f", "'" (the single
+ * quote), and "()" (the empty list, which is returned as the string "()").
+ * All other strings of symbols with no white space are regarded as symbols or
+ * literals, and are returned as strings. (For ease in scanning, there is one
+ * exception: the "#" sign is excluded except at the beginning of #t or #f.)
+ *
+ * String literals are returned as a double quote followed by the contents of
+ * the string with escapes decoded, and without the closing quote. Since the
+ * contents may include '\0', use get_token_length() for their length.
  *
  * To invoke this, one may, for example, declare a string variable
  * named token:
@@ -44,25 +65,33 @@ void start_tokens(int max_length);
  *
  * This technique is fine as long as you are quite sure you will only want to
  * store the value in token until the next call to get_token(), and no longer.
+ * Tokens have no maximum length, so to keep one longer, copy it into a buffer
+ * of get_token_length() + 1 bytes.
  *
- * IT IS SAFER to allocate token statically, as in,
- *
- *     char token[20];
- *
- * (assuming, for example, that tokens are <= 20 characters) and do a string
- * copy of the return value from get_token():
- *
- *     strcpy(token, get_token());
- *
- * rather than the above assignment. In this syntax the string copy acts much
- * more like a true assignment, and using get_token() you can store the next
- * token in another variable in the same way without losing the information in
- * token.
- *
- * WARNING: Tokens may be at most max_length characters long (see
- * start_tokens()). This function is not guaranteed to work for longer tokens,
- * although it may work in most cases.
+ * WARNING: The returned buffer may be reallocated by the next call, so don't
+ * hold on to the pointer past that.
  */
 char *get_token();
 
+/**
+ * get_token_length() - Return the length of the last token from get_token().
+ */
+int get_token_length(void);
+
+/**
+ * syntax_error() - Stops the token stream at a syntax error.
+ * @message - the error message
+ *
+ * The message becomes the interpreter's last error, and the rest of the input
+ * is skipped: get_token() returns NULL from then on, until set_token_input()
+ * is called. The parser calls this too, for errors the lexer can't see.
+ */
+void syntax_error(char *message);
+
+/**
+ * get_token_error() - Return whether get_token() returned NULL because of a
+ * syntax error rather than at the end of the input.
+ */
+int get_token_error(void);
+
 #endif
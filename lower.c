@@ -0,0 +1,324 @@
+/**
+ * lower.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stddef.h>
+#include "parser.h"
+#include "environment.h"
+#include "evaluator.h"
+#include "closure.h"
+#include "jit.h"
+#include "lower.h"
+
+static struct s_expr *jit_error(char *message)
+{
+	set_error_message(message);
+	return NULL;
+}
+
+static struct s_expr *jit_is_empty(struct s_expr *value)
+{
+	return s_expr_from_boolean(is_empty_list(value));
+}
+
+static struct s_expr *jit_apply_lambda(struct node *node,
+	struct s_expr **values, int count)
+{
+	// JIT_CALL_SLOTS passes the node first, though the lambda is in values.
+	(void) node;
+	return eval_apply_lambda(values, count);
+}
+
+static struct s_expr *jit_resume(struct node *node, struct s_expr **values,
+	int count)
+{
+	return eval_resume_builtin(node->guard, node->expr, values, count);
+}
+
+static void lower(struct jit_ir *ir, struct node *node, int depth);
+
+// Goes to `slow` unless the operator of `node` is still node->guard.
+static void lower_guard(struct jit_ir *ir, struct node *node, int slow)
+{
+	jit_emit(ir, JIT_CALL, 0, 0, node->operator->expr->value->symbol,
+		get_env);
+	jit_emit(ir, JIT_BRANCH_IF_NOT, slow, 0, node->guard, NULL);
+}
+
+// Ends a call: the slow path runs the node, and either way acc is checked.
+static void lower_slow_path(struct jit_ir *ir, struct node *node, int slow,
+	int end)
+{
+	jit_emit(ir, JIT_LABEL, slow, 0, NULL, NULL);
+	jit_emit(ir, JIT_CALL, 0, 0, node, node->run);
+	jit_emit(ir, JIT_LABEL, end, 0, NULL, NULL);
+	jit_emit(ir, JIT_RETURN_IF_NULL, 0, 0, NULL, NULL);
+}
+
+static void lower_lambda_call(struct jit_ir *ir, struct node *node,
+	int depth)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+	int i;
+
+	jit_emit(ir, JIT_CALL, 0, 0, node->operator->expr->value->symbol,
+		eval_lookup);
+	jit_emit(ir, JIT_RETURN_IF_NULL, 0, 0, NULL, NULL);
+	jit_emit(ir, JIT_BRANCH_IF_NOT_TYPE, slow, LAMBDA, NULL, NULL);
+	jit_emit(ir, JIT_STORE, depth, 0, NULL, NULL);
+	for (i = 0; i < node->operand_count; i++) {
+		lower(ir, node->operands[i], depth + 1 + i);
+		jit_emit(ir, JIT_STORE, depth + 1 + i, 0, NULL, NULL);
+	}
+	jit_emit(ir, JIT_CALL_SLOTS, depth, node->operand_count + 1, node,
+		jit_apply_lambda);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+// Returns the jit_arith of an inline builtin, or -1.
+static int arith_of(struct s_expr *(*function)(struct fn_arguments *))
+{
+	if (function == add)
+		return JIT_ADD;
+	if (function == subtract)
+		return JIT_SUB;
+	if (function == multiply)
+		return JIT_MUL;
+	if (function == less)
+		return JIT_LESS;
+	if (function == greater)
+		return JIT_GREATER;
+	if (function == numbers_equal)
+		return JIT_EQUAL;
+	if (function == less_equal)
+		return JIT_LESS_EQUAL;
+	if (function == greater_equal)
+		return JIT_GREATER_EQUAL;
+	return -1;
+}
+
+static void lower_arith(struct jit_ir *ir, struct node *node, int depth,
+	int op)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+	int resume_first = jit_new_label(ir);
+	int resume_both = jit_new_label(ir);
+
+	lower_guard(ir, node, slow);
+	lower(ir, node->operands[0], depth);
+	jit_emit(ir, JIT_STORE, depth, 0, NULL, NULL);
+	jit_emit(ir, JIT_BRANCH_IF_NOT_TYPE, resume_first, INTEGER, NULL, NULL);
+	lower(ir, node->operands[1], depth + 1);
+	jit_emit(ir, JIT_STORE, depth + 1, 0, NULL, NULL);
+	jit_emit(ir, JIT_BRANCH_IF_NOT_TYPE, resume_both, INTEGER, NULL, NULL);
+	jit_emit(ir, JIT_ARITH, depth, op, NULL,
+		op == JIT_ADD || op == JIT_SUB || op == JIT_MUL
+		? (void *) s_expr_from_integer : (void *) s_expr_from_boolean);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	jit_emit(ir, JIT_LABEL, resume_first, 0, NULL, NULL);
+	jit_emit(ir, JIT_CALL_SLOTS, depth, 1, node, jit_resume);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	jit_emit(ir, JIT_LABEL, resume_both, 0, NULL, NULL);
+	jit_emit(ir, JIT_CALL_SLOTS, depth, 2, node, jit_resume);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+// car and cdr
+static void lower_field(struct jit_ir *ir, struct node *node, int depth,
+	size_t field)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+	int resume = jit_new_label(ir);
+
+	lower_guard(ir, node, slow);
+	lower(ir, node->operands[0], depth);
+	jit_emit(ir, JIT_STORE, depth, 0, NULL, NULL);
+	jit_emit(ir, JIT_BRANCH_IF_NOT_TYPE, resume, CELL, NULL, NULL);
+	jit_emit(ir, JIT_LOAD_FIELD, offsetof(struct s_expr, value), 0, NULL,
+		NULL);
+	jit_emit(ir, JIT_LOAD_FIELD, offsetof(union s_expr_value, cell), 0,
+		NULL, NULL);
+	jit_emit(ir, JIT_LOAD_FIELD, field, 0, NULL, NULL);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	jit_emit(ir, JIT_LABEL, resume, 0, NULL, NULL);
+	jit_emit(ir, JIT_CALL_SLOTS, depth, 1, node, jit_resume);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+static void lower_is_empty(struct jit_ir *ir, struct node *node, int depth)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+
+	lower_guard(ir, node, slow);
+	lower(ir, node->operands[0], depth);
+	jit_emit(ir, JIT_CALL_ACC, 0, 0, NULL, jit_is_empty);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+static void lower_cond(struct jit_ir *ir, struct node *node, int depth)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+	int i;
+	int j;
+
+	lower_guard(ir, node, slow);
+	for (i = 0; i < node->clause_count; i++) {
+		struct clause *clause = &node->clauses[i];
+		int next = jit_new_label(ir);
+
+		if (clause->error != NULL) {
+			jit_emit(ir, JIT_CALL, 0, 0, clause->error, jit_error);
+			jit_emit(ir, JIT_RETURN_IF_NULL, 0, 0, NULL, NULL);
+		} else if (clause->else_clause && i + 1 < node->clause_count) {
+			jit_emit(ir, JIT_CALL, 0, 0,
+				"cond - syntax error (else must be the last clause)",
+				jit_error);
+			jit_emit(ir, JIT_RETURN_IF_NULL, 0, 0, NULL, NULL);
+		} else {
+			if (!clause->else_clause) {
+				lower(ir, clause->test, depth);
+				jit_emit(ir, JIT_BRANCH_IF_FALSE, next, 0, NULL,
+					NULL);
+			}
+			for (j = 0; j < clause->body_count; j++)
+				lower(ir, clause->bodies[j], depth);
+			jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+		}
+		jit_emit(ir, JIT_LABEL, next, 0, NULL, NULL);
+	}
+	jit_emit(ir, JIT_CONST, 0, 0, empty_list, NULL);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+// and and or, which stop at the first false or true operand
+static void lower_and_or(struct jit_ir *ir, struct node *node, int depth,
+	int is_and)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+	int stop = jit_new_label(ir);
+	int i;
+
+	lower_guard(ir, node, slow);
+	for (i = 0; i < node->operand_count; i++) {
+		lower(ir, node->operands[i], depth);
+		jit_emit(ir, is_and ? JIT_BRANCH_IF_FALSE : JIT_BRANCH_IF_TRUE,
+			is_and ? stop : end, 0, NULL, NULL);
+	}
+	if (is_and && node->operand_count > 0) {
+		jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+		jit_emit(ir, JIT_LABEL, stop, 0, NULL, NULL);
+	}
+	// (and) is #t, and and stops with #f, as or does when it runs out.
+	jit_emit(ir, JIT_CALL, 0, 0,
+		(void *) (long) (is_and && node->operand_count == 0),
+		s_expr_from_boolean);
+	if (is_and && node->operand_count == 0)
+		jit_emit(ir, JIT_LABEL, stop, 0, NULL, NULL);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+static void lower_quote(struct jit_ir *ir, struct node *node)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+
+	lower_guard(ir, node, slow);
+	jit_emit(ir, JIT_CONST, 0, 0, node->operands[0]->expr, NULL);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+static void lower_builtin_call(struct jit_ir *ir, struct node *node)
+{
+	int slow = jit_new_label(ir);
+	int end = jit_new_label(ir);
+
+	lower_guard(ir, node, slow);
+	jit_emit(ir, JIT_CALL, 0, 0, node->arguments,
+		node->guard->value->builtin->function);
+	jit_emit(ir, JIT_JUMP, end, 0, NULL, NULL);
+	lower_slow_path(ir, node, slow, end);
+}
+
+static void lower_call(struct jit_ir *ir, struct node *node, int depth)
+{
+	struct s_expr *(*function)(struct fn_arguments *);
+	int end;
+
+	if (node->operator->run == run_variable && node->guard == NULL)
+		node->guard = get_env(node->operator->expr->value->symbol);
+	if (node->operator->run != run_variable || node->guard == NULL
+	|| (node->guard->type != LAMBDA && node->guard->type != BUILTIN)) {
+		end = jit_new_label(ir);
+		lower_slow_path(ir, node, end, end);
+		return;
+	}
+	if (node->guard->type == LAMBDA) {
+		lower_lambda_call(ir, node, depth);
+		return;
+	}
+	function = node->guard->value->builtin->function;
+	if (node->special == run_cond && function == node->builtin)
+		lower_cond(ir, node, depth);
+	else if (node->special == run_and && function == node->builtin)
+		lower_and_or(ir, node, depth, 1);
+	else if (node->special == run_or && function == node->builtin)
+		lower_and_or(ir, node, depth, 0);
+	else if (node->special == run_quote && function == node->builtin)
+		lower_quote(ir, node);
+	else if (arith_of(function) >= 0 && node->operand_count == 2)
+		lower_arith(ir, node, depth, arith_of(function));
+	else if (function == car && node->operand_count == 1)
+		lower_field(ir, node, depth, offsetof(struct cons_cell, first));
+	else if (function == cdr && node->operand_count == 1)
+		lower_field(ir, node, depth, offsetof(struct cons_cell, rest));
+	else if (function == is_empty && node->operand_count == 1)
+		lower_is_empty(ir, node, depth);
+	else
+		lower_builtin_call(ir, node);
+}
+
+/*
+ * Emits code that leaves the value of `node` in acc, or returns NULL, using
+ * slots from `depth` up.
+ */
+static void lower(struct jit_ir *ir, struct node *node, int depth)
+{
+	int end;
+
+	if (node->run == run_constant) {
+		jit_emit(ir, JIT_CONST, 0, 0, node->expr, NULL);
+	} else if (node->run == run_variable) {
+		jit_emit(ir, JIT_CALL, 0, 0, node->expr->value->symbol,
+			eval_lookup);
+		jit_emit(ir, JIT_RETURN_IF_NULL, 0, 0, NULL, NULL);
+	} else if (node->run == run_call) {
+		lower_call(ir, node, depth);
+	} else {
+		end = jit_new_label(ir);
+		lower_slow_path(ir, node, end, end);
+	}
+}
+
+void lower_compile(struct node *node, char *name)
+{
+	struct jit_ir ir;
+
+	jit_ir_init(&ir);
+	lower(&ir, node, 0);
+	jit_emit(&ir, JIT_RETURN, 0, 0, NULL, NULL);
+	node->jit_code = (struct s_expr *(*)(void)) jit_assemble(&ir, name);
+	jit_ir_free(&ir);
+}
@@ -0,0 +1,32 @@
+/**
+ * lower.h - Compiles the nodes of hot lambdas to machine code
+ *
+ * Once the body of a lambda has run interp->jit_threshold times, its node is
+ * lowered to the IR of jit.h and compiled to machine code, which later calls
+ * run instead of the node. The code follows the nodes: calls look their
+ * operator up, and only take a fast path while it is bound to what it was
+ * bound to when the code was made. That path evaluates the arguments of
+ * lambdas in machine code, does integer arithmetic, comparisons, car, cdr and
+ * null? inline, runs cond, and, or and quote as branches, and calls any other
+ * builtin directly. Anything else, including a call whose operator has
+ * changed, runs its node. When an inline operation finds an argument of the
+ * wrong type, the builtin is called with the arguments evaluated so far, so
+ * that the error is the builtin's own.
+ *
+ * Code made while profiling would hide calls from the profile, so it isn't
+ * used then.
+ */
+#ifndef LOWER_H
+#define LOWER_H
+#include "closure.h"
+
+/**
+ * lower_compile() - Sets node->jit_code to the machine code of `node`
+ * @node - the body of a lambda
+ * @name - the name of the lambda, for the symbols of the code
+ *
+ * node->jit_code is left NULL if the code can't be made.
+ */
+void lower_compile(struct node *node, char *name);
+
+#endif
@@ -0,0 +1,645 @@
+/**
+ * macro.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "hash_table.h"
+#include "environment.h"
+#include "interpreter.h"
+#include "evaluator.h"
+#include "fold.h"
+#include "macro.h"
+
+struct match {
+	char *name;
+	// how many ellipses the variable is under
+	int depth;
+	struct s_expr *value;
+};
+
+struct matches {
+	struct match *items;
+	int count;
+	int capacity;
+};
+
+static int is_ellipsis(struct s_expr *expr)
+{
+	return is_keyword(expr, "...");
+}
+
+// Whether the first element of `list` is followed by "...".
+static int is_repeated(struct s_expr *list)
+{
+	struct s_expr *rest = list->value->cell->rest;
+
+	return rest->type == CELL && is_ellipsis(rest->value->cell->first);
+}
+
+static void add_match(struct matches *matches, char *name, int depth,
+	struct s_expr *value)
+{
+	if (matches->count == matches->capacity) {
+		matches->capacity = matches->capacity == 0
+			? 8 : matches->capacity * 2;
+		matches->items = (struct match *) realloc(matches->items,
+			matches->capacity * sizeof(struct match));
+		if (matches->items == NULL) {
+			printf("Out of memory, cannot expand a macro.\n");
+			exit(1);
+		}
+	}
+	matches->items[matches->count].name = name;
+	matches->items[matches->count].depth = depth;
+	matches->items[matches->count].value = value;
+	matches->count++;
+}
+
+static struct match *find_match(struct matches *matches, char *name)
+{
+	int i;
+
+	for (i = matches->count - 1; i >= 0; i--) {
+		if (!strcmp(matches->items[i].name, name))
+			return &matches->items[i];
+	}
+	return NULL;
+}
+
+static int is_literal(struct macro *macro, char *name)
+{
+	struct s_expr *literals;
+
+	for (literals = macro->literals; literals->type == CELL;
+	literals = literals->value->cell->rest) {
+		if (!strcmp(literals->value->cell->first->value->symbol, name))
+			return 1;
+	}
+	return 0;
+}
+
+// Checks that each ellipsis in `pattern` follows an element, once per list.
+static int valid_pattern(struct s_expr *pattern)
+{
+	int ellipses = 0;
+
+	if (pattern->type != CELL)
+		return !is_ellipsis(pattern);
+	if (is_ellipsis(pattern->value->cell->first))
+		return 0;
+	for (; pattern->type == CELL; pattern = pattern->value->cell->rest) {
+		struct s_expr *element = pattern->value->cell->first;
+
+		if (is_ellipsis(element) && ++ellipses > 1)
+			return 0;
+		if (!is_ellipsis(element) && !valid_pattern(element))
+			return 0;
+	}
+	return !is_ellipsis(pattern);
+}
+
+/*
+ * (define-syntax name (syntax-rules (literal ...) (pattern template) ...))
+ * binds name to a macro. Each pattern is a list whose first element, standing
+ * for the keyword, is ignored.
+ */
+struct s_expr *define_syntax(struct fn_arguments *args)
+{
+	struct s_expr *spec;
+	struct s_expr *rest;
+	struct macro *macro;
+
+	if (args == NULL || args->next == NULL
+	|| args->next->next != NULL) {
+		set_error_message("define-syntax - arity mismatch");
+		return NULL;
+	}
+	if (args->value->type != SYMBOL) {
+		set_error_message("define-syntax - type error (expected symbol)");
+		return NULL;
+	}
+	spec = args->next->value;
+	if (!is_list(spec) || list_length(spec) < 2
+	|| !is_keyword(spec->value->cell->first, "syntax-rules")
+	|| !is_list(spec->value->cell->rest->value->cell->first)) {
+		set_error_message(
+			"define-syntax - syntax error (expected syntax-rules)");
+		return NULL;
+	}
+	for (rest = spec->value->cell->rest->value->cell->first;
+	rest->type == CELL; rest = rest->value->cell->rest) {
+		if (rest->value->cell->first->type != SYMBOL) {
+			set_error_message(
+				"define-syntax - type error (expected symbol)");
+			return NULL;
+		}
+	}
+	for (rest = spec->value->cell->rest->value->cell->rest;
+	rest->type == CELL; rest = rest->value->cell->rest) {
+		struct s_expr *rule = rest->value->cell->first;
+
+		if (!is_list(rule) || list_length(rule) != 2
+		|| rule->value->cell->first->type != CELL
+		|| !valid_pattern(rule->value->cell->first)) {
+			set_error_message(
+				"define-syntax - syntax error (malformed rule)");
+			return NULL;
+		}
+	}
+	macro = (struct macro *) heap_alloc(HEAP_LAMBDA, sizeof(struct macro));
+	macro->name = args->value->value->symbol;
+	macro->literals = spec->value->cell->rest->value->cell->first;
+	macro->rules = spec->value->cell->rest->value->cell->rest;
+	// The name may have been bound to a macro that uses were expanded by.
+	free_expansions();
+	set_env(args->value->value->symbol, s_expr_from_macro(macro));
+	interp->macros = 1;
+	return args->value;
+}
+
+/*
+ * Adds the variables of `pattern` to `vars`, with their depths in it. With a
+ * NULL macro, adds every symbol of a template instead.
+ */
+static void pattern_variables(struct macro *macro, struct s_expr *pattern,
+	int depth, struct matches *vars)
+{
+	if (pattern->type == SYMBOL) {
+		if (!is_keyword(pattern, "_") && !is_ellipsis(pattern)
+		&& (macro == NULL
+		|| !is_literal(macro, pattern->value->symbol)))
+			add_match(vars, pattern->value->symbol, depth, NULL);
+		return;
+	}
+	for (; pattern->type == CELL; pattern = pattern->value->cell->rest)
+		pattern_variables(macro, pattern->value->cell->first,
+			depth + is_repeated(pattern), vars);
+	if (pattern->type == SYMBOL)
+		pattern_variables(macro, pattern, depth, vars);
+}
+
+static int match_pattern(struct macro *macro, struct s_expr *pattern,
+	struct s_expr *form, struct matches *matches);
+
+/*
+ * Matches the elements of `*form` against `pattern` followed by an ellipsis,
+ * leaving as many elements as `tail`, the rest of the pattern, needs.
+ */
+static int match_repeated(struct macro *macro, struct s_expr *pattern,
+	struct s_expr *tail, struct s_expr **form, struct matches *matches)
+{
+	struct matches vars = {NULL, 0, 0};
+	struct list_builder *lists;
+	struct s_expr *rest;
+	int count = 0;
+	int i;
+	int j;
+
+	for (rest = *form; rest->type == CELL; rest = rest->value->cell->rest)
+		count++;
+	for (rest = tail; rest->type == CELL; rest = rest->value->cell->rest)
+		count--;
+	if (count < 0)
+		return 0;
+	pattern_variables(macro, pattern, 0, &vars);
+	lists = (struct list_builder *) malloc(
+		(vars.count + 1) * sizeof(struct list_builder));
+	if (lists == NULL) {
+		printf("Out of memory, cannot expand a macro.\n");
+		exit(1);
+	}
+	for (j = 0; j < vars.count; j++)
+		list_builder_init(&lists[j]);
+	for (i = 0; i < count; i++) {
+		struct matches inner = {NULL, 0, 0};
+
+		if (!match_pattern(macro, pattern, (*form)->value->cell->first,
+		&inner)) {
+			free(inner.items);
+			free(vars.items);
+			free(lists);
+			return 0;
+		}
+		for (j = 0; j < vars.count; j++)
+			list_builder_push(&lists[j],
+				find_match(&inner, vars.items[j].name)->value);
+		free(inner.items);
+		*form = (*form)->value->cell->rest;
+	}
+	for (j = 0; j < vars.count; j++)
+		add_match(matches, vars.items[j].name, vars.items[j].depth + 1,
+			list_builder_finish(&lists[j], empty_list));
+	free(vars.items);
+	free(lists);
+	return 1;
+}
+
+static int match_pattern(struct macro *macro, struct s_expr *pattern,
+	struct s_expr *form, struct matches *matches)
+{
+	if (pattern->type == SYMBOL) {
+		if (is_keyword(pattern, "_"))
+			return 1;
+		if (is_literal(macro, pattern->value->symbol))
+			return form->type == SYMBOL && !strcmp(
+				form->value->symbol, pattern->value->symbol);
+		add_match(matches, pattern->value->symbol, 0, form);
+		return 1;
+	}
+	while (pattern->type == CELL) {
+		struct s_expr *element = pattern->value->cell->first;
+
+		if (is_repeated(pattern)) {
+			pattern = pattern->value->cell->rest->value->cell->rest;
+			if (!match_repeated(macro, element, pattern, &form,
+			matches))
+				return 0;
+			continue;
+		}
+		if (form->type != CELL || !match_pattern(macro, element,
+		form->value->cell->first, matches))
+			return 0;
+		pattern = pattern->value->cell->rest;
+		form = form->value->cell->rest;
+	}
+	if (pattern->type == SYMBOL)
+		return match_pattern(macro, pattern, form, matches);
+	return equal(pattern, form);
+}
+
+/*
+ * Whether the template introduced `symbol`. Each symbol of a template is
+ * expanded to a copy made for the expansion, kept in `introduced` under its
+ * name, so that it can be told from a symbol of the same name the use passed
+ * in, even if they were read as the same object.
+ */
+static int introduces(struct matches *introduced, struct s_expr *symbol)
+{
+	struct match *match = find_match(introduced, symbol->value->symbol);
+
+	return match != NULL && match->value == symbol;
+}
+
+// Adds a fresh name for `binder`, if the template introduced it.
+static void add_rename(struct s_expr *binder, struct matches *introduced,
+	struct matches *renames)
+{
+	char *name;
+	size_t length;
+
+	if (binder->type != SYMBOL || !introduces(introduced, binder)
+	|| find_match(renames, binder->value->symbol))
+		return;
+	// Symbols are read up to a space, so no program has this one.
+	length = strlen(binder->value->symbol) + 16;
+	name = (char *) malloc(length);
+	if (name == NULL) {
+		printf("Out of memory, cannot expand a macro.\n");
+		exit(1);
+	}
+	snprintf(name, length, "%s %d", binder->value->symbol,
+		++interp->renames);
+	add_match(renames, binder->value->symbol, 0, s_expr_from_symbol(name));
+	free(name);
+}
+
+// Finds the symbols of the template that `expansion` binds, at any depth.
+static void find_binders(struct s_expr *expansion,
+	struct matches *introduced, struct matches *renames)
+{
+	struct s_expr *keyword;
+	struct s_expr *params = NULL;
+
+	if (expansion->type != CELL || !is_list(expansion))
+		return;
+	keyword = expansion->value->cell->first;
+	if (is_keyword(keyword, "quote"))
+		return;
+	if (list_length(expansion) >= 2 && (is_keyword(keyword, "lambda")
+	|| is_keyword(keyword, "define")
+	|| is_keyword(keyword, "define-memoized")))
+		params = expansion->value->cell->rest->value->cell->first;
+	if (params != NULL && params->type == SYMBOL)
+		add_rename(params, introduced, renames);
+	for (; params != NULL && params->type == CELL;
+	params = params->value->cell->rest)
+		add_rename(params->value->cell->first, introduced, renames);
+	for (; expansion->type == CELL;
+	expansion = expansion->value->cell->rest)
+		find_binders(expansion->value->cell->first, introduced,
+			renames);
+}
+
+// Renames the symbols of the template in `expansion` that are in `renames`.
+static struct s_expr *rename_binders(struct s_expr *expansion,
+	struct matches *introduced, struct matches *renames)
+{
+	struct list_builder renamed;
+	struct match *match;
+	struct s_expr *rest;
+
+	if (expansion->type == SYMBOL) {
+		match = find_match(renames, expansion->value->symbol);
+		return match != NULL && introduces(introduced, expansion)
+			? match->value : expansion;
+	}
+	if (expansion->type != CELL
+	|| is_keyword(expansion->value->cell->first, "quote"))
+		return expansion;
+	list_builder_init(&renamed);
+	for (rest = expansion; rest->type == CELL;
+	rest = rest->value->cell->rest)
+		list_builder_push(&renamed, rename_binders(
+			rest->value->cell->first, introduced, renames));
+	return list_builder_finish(&renamed,
+		rename_binders(rest, introduced, renames));
+}
+
+static struct s_expr *expand_template(struct s_expr *template,
+	struct matches *matches, struct matches *introduced);
+
+// Expands `template`, which is followed by an ellipsis, once per match.
+static int expand_repeated(struct s_expr *template, struct matches *matches,
+	struct matches *introduced, struct list_builder *expansion)
+{
+	struct matches inner = {NULL, 0, 0};
+	struct matches vars = {NULL, 0, 0};
+	struct s_expr **lists;
+	int count = -1;
+	int i;
+	int j;
+
+	// What repeats is the pattern variables under an ellipsis used here.
+	pattern_variables(NULL, template, 0, &vars);
+	lists = (struct s_expr **) malloc(
+		(vars.count + 1) * sizeof(struct s_expr *));
+	if (lists == NULL) {
+		printf("Out of memory, cannot expand a macro.\n");
+		exit(1);
+	}
+	for (i = 0; i < matches->count; i++)
+		add_match(&inner, matches->items[i].name,
+			matches->items[i].depth, matches->items[i].value);
+	for (j = 0; j < vars.count; j++) {
+		struct match *match = find_match(matches, vars.items[j].name);
+
+		lists[j] = match != NULL && match->depth > 0
+			? match->value : NULL;
+		if (lists[j] != NULL && count >= 0
+		&& list_length(lists[j]) != count) {
+			set_error_message(
+				"syntax-rules - syntax error (ellipsis lengths differ)");
+			count = -2;
+			break;
+		}
+		if (lists[j] != NULL)
+			count = list_length(lists[j]);
+	}
+	if (count == -1)
+		set_error_message(
+			"syntax-rules - syntax error (nothing to repeat)");
+	for (i = 0; i < count; i++) {
+		struct s_expr *value;
+
+		for (j = 0; j < vars.count; j++) {
+			if (lists[j] == NULL)
+				continue;
+			add_match(&inner, vars.items[j].name,
+				find_match(matches, vars.items[j].name)->depth
+				- 1, lists[j]->value->cell->first);
+			lists[j] = lists[j]->value->cell->rest;
+		}
+		value = expand_template(template, &inner, introduced);
+		if (value == NULL) {
+			count = -1;
+			break;
+		}
+		list_builder_push(expansion, value);
+		inner.count = matches->count;
+	}
+	free(inner.items);
+	free(vars.items);
+	free(lists);
+	return count >= 0;
+}
+
+static struct s_expr *expand_template(struct s_expr *template,
+	struct matches *matches, struct matches *introduced)
+{
+	struct list_builder expansion;
+	struct match *match;
+	struct s_expr *tail;
+
+	if (template->type == SYMBOL) {
+		match = find_match(matches, template->value->symbol);
+		if (match != NULL && match->depth > 0) {
+			set_error_message(
+				"syntax-rules - syntax error (missing ellipsis)");
+			return NULL;
+		}
+		if (match != NULL)
+			return match->value;
+		match = find_match(introduced, template->value->symbol);
+		if (match != NULL)
+			return match->value;
+		add_match(introduced, template->value->symbol, 0,
+			s_expr_from_symbol(template->value->symbol));
+		return introduced->items[introduced->count - 1].value;
+	}
+	if (template->type != CELL)
+		return template;
+	list_builder_init(&expansion);
+	while (template->type == CELL) {
+		struct s_expr *element = template->value->cell->first;
+		struct s_expr *value;
+
+		if (is_repeated(template)) {
+			if (!expand_repeated(element, matches, introduced,
+			&expansion))
+				return NULL;
+			template = template->value->cell->rest
+				->value->cell->rest;
+			continue;
+		}
+		value = expand_template(element, matches, introduced);
+		if (value == NULL)
+			return NULL;
+		list_builder_push(&expansion, value);
+		template = template->value->cell->rest;
+	}
+	tail = expand_template(template, matches, introduced);
+	return tail != NULL ? list_builder_finish(&expansion, tail) : NULL;
+}
+
+static struct s_expr *expand(struct s_expr *expr);
+
+// Expands a use of `macro` by the first rule that matches it.
+static struct s_expr *expand_use(struct s_expr *form, struct macro *macro)
+{
+	struct s_expr *rules;
+	struct s_expr *expansion;
+
+	if (interp->expansions == NULL)
+		interp->expansions = hash_table_create(HASH_EQ);
+	expansion = hash_table_get(interp->expansions, form);
+	if (expansion != NULL)
+		return expansion;
+	for (rules = macro->rules; rules->type == CELL;
+	rules = rules->value->cell->rest) {
+		struct s_expr *rule = rules->value->cell->first;
+		struct s_expr *template = rule->value->cell->rest
+			->value->cell->first;
+		struct matches matches = {NULL, 0, 0};
+		struct matches introduced = {NULL, 0, 0};
+		struct matches renames = {NULL, 0, 0};
+
+		// The keyword itself is not matched.
+		if (!match_pattern(macro,
+		rule->value->cell->first->value->cell->rest,
+		form->value->cell->rest, &matches)) {
+			free(matches.items);
+			continue;
+		}
+		expansion = expand_template(template, &matches, &introduced);
+		free(matches.items);
+		// The expansion may use macros too, which may bind symbols of
+		// the template, so binders are only looked for once they are
+		// expanded.
+		if (expansion != NULL)
+			expansion = expand(expansion);
+		if (expansion != NULL) {
+			find_binders(expansion, &introduced, &renames);
+			if (renames.count > 0)
+				expansion = rename_binders(expansion,
+					&introduced, &renames);
+		}
+		free(introduced.items);
+		free(renames.items);
+		if (expansion != NULL)
+			hash_table_set(interp->expansions, form, expansion);
+		// A use expanded as it runs has not been scanned.
+		if (expansion != NULL && interp->folding && !interp->unfolded)
+			scan_binders(expansion);
+		return expansion;
+	}
+	set_error_message("syntax-rules - syntax error (no rule matches)");
+	return NULL;
+}
+
+// Evaluates a use of a macro that was bound after the use was read.
+struct s_expr *eval_macro_use(struct s_expr *form, struct macro *macro)
+{
+	struct s_expr *expansion = expand_use(form, macro);
+
+	return expansion != NULL ? eval_expression(expansion) : NULL;
+}
+
+static struct s_expr *expand_clause(struct s_expr *clause);
+
+static struct s_expr *expand(struct s_expr *expr)
+{
+	struct list_builder expansion;
+	struct s_expr *operator;
+	struct s_expr *value;
+	struct s_expr *rest;
+	int signature = 0;
+	int clauses = 0;
+	int changed = 0;
+	int i;
+
+	if (expr->type != CELL || !is_list(expr))
+		return expr;
+	operator = expr->value->cell->first;
+	value = operator->type == SYMBOL
+		? get_env(operator->value->symbol) : NULL;
+	if (value != NULL && value->type == MACRO)
+		return expand_use(expr, value->value->macro);
+	if (value != NULL && value->type == BUILTIN) {
+		struct s_expr *(*function)(struct fn_arguments *) =
+			value->value->builtin->function;
+
+		if (function == quote || function == define_syntax)
+			return expr;
+		// Parameter lists and cond clauses are not calls.
+		signature = function == lambda_ || function == define_
+			|| function == define_memoized;
+		clauses = function == cond;
+	}
+	list_builder_init(&expansion);
+	for (i = 0, rest = expr; rest->type == CELL;
+	i++, rest = rest->value->cell->rest) {
+		struct s_expr *element = rest->value->cell->first;
+		struct s_expr *expanded = element;
+
+		if (i > 0 && clauses)
+			expanded = expand_clause(element);
+		else if (i > 0 && !(i == 1 && signature))
+			expanded = expand(element);
+		if (expanded == NULL)
+			return NULL;
+		// Copy the list from the first element that changes.
+		if (expanded != element && !changed) {
+			struct s_expr *copy;
+
+			for (copy = expr; copy != rest;
+			copy = copy->value->cell->rest)
+				list_builder_push(&expansion,
+					copy->value->cell->first);
+			changed = 1;
+		}
+		if (changed)
+			list_builder_push(&expansion, expanded);
+	}
+	return changed ? list_builder_finish(&expansion, empty_list) : expr;
+}
+
+// Expands the test and bodies of a cond clause.
+static struct s_expr *expand_clause(struct s_expr *clause)
+{
+	struct list_builder expansion;
+	struct s_expr *rest;
+	int changed = 0;
+
+	if (clause->type != CELL || !is_list(clause))
+		return clause;
+	list_builder_init(&expansion);
+	for (rest = clause; rest->type == CELL;
+	rest = rest->value->cell->rest) {
+		struct s_expr *element = rest->value->cell->first;
+		struct s_expr *expanded = expand(element);
+
+		if (expanded == NULL)
+			return NULL;
+		if (expanded != element && !changed) {
+			struct s_expr *copy;
+
+			for (copy = clause; copy != rest;
+			copy = copy->value->cell->rest)
+				list_builder_push(&expansion,
+					copy->value->cell->first);
+			changed = 1;
+		}
+		if (changed)
+			list_builder_push(&expansion, expanded);
+	}
+	return changed ? list_builder_finish(&expansion, empty_list) : clause;
+}
+
+struct s_expr *expand_expression(struct s_expr *expr)
+{
+	// The uses stay in the form, so that one whose macro is bound again
+	// is expanded again. A use that is missed here is expanded when it is
+	// evaluated.
+	if (interp->macros && expand(expr) == NULL)
+		return NULL;
+	return expr;
+}
+
+void free_expansions(void)
+{
+	if (interp->expansions != NULL)
+		hash_table_free(interp->expansions);
+	interp->expansions = NULL;
+}
@@ -0,0 +1,59 @@
+/**
+ * macro.h - Macros defined by define-syntax
+ *
+ * Macros are values, bound by define-syntax like any other, so they have the
+ * same dynamic scope. Before a top-level form is evaluated, every use of a
+ * macro in it is expanded (see expand_expression()). A use whose macro is only
+ * bound later, such as one in the body of a lambda defined before the macro,
+ * is expanded when it is first evaluated. Either way the expansion is kept in
+ * interp->expansions under the use, which stays in the form, and evaluating
+ * the use evaluates its expansion. define-syntax forgets every expansion,
+ * since it may have redefined the macro of any use, so that each use is
+ * expanded again the next time it is evaluated.
+ *
+ * Matching binds each pattern variable to the form it matched or, under n
+ * ellipses, to n levels of lists of such forms. Once the uses of macros in an
+ * expansion are expanded in turn, the symbols of the template that it binds
+ * with lambda, define or define-memoized, wherever the binding form came
+ * from, are renamed to symbols that no program can contain, so that they
+ * can't capture symbols passed in by the use. Other symbols in the template
+ * mean what they mean where the expansion is evaluated, as symbols always do
+ * here.
+ */
+#ifndef MACRO_H
+#define MACRO_H
+#include "parser.h"
+
+/**
+ * define_syntax() - The builtin define-syntax
+ * @args - the operands of the form, (name (syntax-rules (literals ...)
+ * (pattern template) ...))
+ */
+struct s_expr *define_syntax(struct fn_arguments *args);
+
+/**
+ * eval_macro_use() - Expands and evaluates a use of `macro`
+ * @form - the use, whose operator evaluated to `macro`
+ * @macro
+ */
+struct s_expr *eval_macro_use(struct s_expr *form, struct macro *macro);
+
+/**
+ * expand_expression() - Expands the uses of macros in a form
+ * @expr
+ * @returns `expr`, or NULL on error
+ *
+ * Each use of a macro that is bound at this point is expanded once, and the
+ * expansion is what evaluating the use evaluates, until define-syntax binds a
+ * macro again.
+ */
+struct s_expr *expand_expression(struct s_expr *expr);
+
+/**
+ * free_expansions() - Forgets the expansions made so far
+ *
+ * The forms they were made of are left alone.
+ */
+void free_expansions(void);
+
+#endif
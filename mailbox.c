@@ -0,0 +1,136 @@
+/**
+ * mailbox.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+#include <pthread.h>
+#include "parser.h"
+#include "mailbox.h"
+
+/*
+ * Implementation notes:
+ *
+ * Senders swap themselves in as the new head and then link the previous head
+ * to themselves. Between those two steps the queue is briefly broken: the
+ * receiver can see that the tail has no successor although the head has
+ * moved on. It then yields and tries again rather than sleeping.
+ *
+ * Sleeping uses the usual pairing: the receiver sets `sleeping` and then
+ * checks the queue again, while a sender links its message and then checks
+ * `sleeping`. With sequentially consistent operations on both sides, at
+ * least one of them sees the other, so no wakeup is lost.
+ */
+
+// How many times the receiver polls an empty mailbox before sleeping
+#define SPIN_COUNT 64
+
+struct mailbox *mailbox_create(void)
+{
+	struct mailbox *mailbox = (struct mailbox *)
+		calloc(1, sizeof(struct mailbox));
+
+	if (mailbox == NULL) {
+		printf("Out of memory, cannot create a mailbox.\n");
+		exit(1);
+	}
+	mailbox->head = &mailbox->stub;
+	mailbox->tail = &mailbox->stub;
+	pthread_mutex_init(&mailbox->lock, NULL);
+	pthread_cond_init(&mailbox->arrived, NULL);
+	return mailbox;
+}
+
+static void link_in(struct mailbox *mailbox, struct message *message)
+{
+	struct message *prev;
+
+	__atomic_store_n(&message->next, NULL, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(&mailbox->head, message, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&prev->next, message, __ATOMIC_RELEASE);
+}
+
+void mailbox_send(struct mailbox *mailbox, struct s_expr *value)
+{
+	struct message *message = (struct message *)
+		malloc(sizeof(struct message));
+
+	if (message == NULL) {
+		printf("Out of memory, cannot send a message.\n");
+		exit(1);
+	}
+	message->value = value;
+	link_in(mailbox, message);
+	__atomic_add_fetch(&mailbox->sent, 1, __ATOMIC_RELAXED);
+	if (__atomic_load_n(&mailbox->sleeping, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&mailbox->lock);
+		pthread_cond_signal(&mailbox->arrived);
+		pthread_mutex_unlock(&mailbox->lock);
+	}
+}
+
+/*
+ * Returns the oldest message's value, or NULL if there is none yet. Sets
+ * `*busy` if a message is on its way in but not linked yet.
+ */
+static struct s_expr *take(struct mailbox *mailbox, int *busy)
+{
+	struct message *tail = mailbox->tail;
+	struct message *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	struct s_expr *value;
+
+	*busy = 0;
+	if (tail == &mailbox->stub) {
+		// Step past the stub to the first real message.
+		if (next == NULL) {
+			*busy = __atomic_load_n(&mailbox->head, __ATOMIC_SEQ_CST)
+				!= tail;
+			return NULL;
+		}
+		mailbox->tail = next;
+		tail = next;
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	}
+	if (next == NULL) {
+		// The tail is the last message, which can only be taken once
+		// something follows it. Put the stub back behind it.
+		if (__atomic_load_n(&mailbox->head, __ATOMIC_SEQ_CST) != tail) {
+			*busy = 1;
+			return NULL;
+		}
+		link_in(mailbox, &mailbox->stub);
+		next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+		if (next == NULL) {
+			*busy = 1;
+			return NULL;
+		}
+	}
+	mailbox->tail = next;
+	value = tail->value;
+	free(tail);
+	return value;
+}
+
+struct s_expr *mailbox_receive(struct mailbox *mailbox)
+{
+	struct s_expr *value;
+	int busy;
+	int spins = 0;
+
+	while ((value = take(mailbox, &busy)) == NULL) {
+		if (busy || spins++ < SPIN_COUNT) {
+			sched_yield();
+			continue;
+		}
+		pthread_mutex_lock(&mailbox->lock);
+		__atomic_store_n(&mailbox->sleeping, 1, __ATOMIC_SEQ_CST);
+		while ((value = take(mailbox, &busy)) == NULL && !busy)
+			pthread_cond_wait(&mailbox->arrived, &mailbox->lock);
+		__atomic_store_n(&mailbox->sleeping, 0, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&mailbox->lock);
+		if (value != NULL)
+			break;
+	}
+	mailbox->received++;
+	return value;
+}
@@ -0,0 +1,60 @@
+/**
+ * mailbox.h - Message queues between threads
+ *
+ * A mailbox has any number of senders and a single receiver, the actor that
+ * owns it. Sending never blocks or takes a lock: a message is linked in with
+ * one atomic exchange (Vyukov's intrusive MPSC queue). The receiver only
+ * sleeps on a condition variable when the mailbox is empty, and senders only
+ * touch that condition variable when the receiver is asleep.
+ *
+ * Mailboxes are never freed, since any number of threads may still hold a
+ * reference to one.
+ */
+#ifndef MAILBOX
+#define MAILBOX
+#include <pthread.h>
+#include "parser.h"
+
+struct message {
+	struct message *next;
+	struct s_expr *value;
+};
+
+struct mailbox {
+	// where senders link in new messages
+	struct message *head;
+	// the receiver's end; the oldest message follows it
+	struct message *tail;
+	// the placeholder node that keeps the queue from ever being empty
+	struct message stub;
+	// set while the receiver waits on `arrived`
+	int sleeping;
+	pthread_mutex_t lock;
+	pthread_cond_t arrived;
+	long sent;
+	long received;
+};
+
+/**
+ * mailbox_create() - Allocates an empty mailbox
+ */
+struct mailbox *mailbox_create(void);
+
+/**
+ * mailbox_send() - Adds a message to the end of a mailbox
+ * @mailbox
+ * @value - the message, which must not be used by the sender afterwards
+ *
+ * Any thread may call this.
+ */
+void mailbox_send(struct mailbox *mailbox, struct s_expr *value);
+
+/**
+ * mailbox_receive() - Removes the oldest message, waiting for one if needed
+ * @mailbox
+ *
+ * Only the owner of the mailbox may call this.
+ */
+struct s_expr *mailbox_receive(struct mailbox *mailbox);
+
+#endif
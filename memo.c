@@ -0,0 +1,169 @@
+/**
+ * memo.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "hash_table.h"
+#include "memo.h"
+
+struct memo_cache *memo_cache_create(int capacity)
+{
+	struct memo_cache *cache = (struct memo_cache *)
+		malloc(sizeof(struct memo_cache));
+
+	// The cache never holds more than `capacity` entries, so the bucket
+	// array is sized once up front.
+	cache->bucket_count = 1;
+	while (cache->bucket_count < (unsigned long) capacity)
+		cache->bucket_count *= 2;
+	cache->buckets = (struct memo_entry **) calloc(cache->bucket_count,
+		sizeof(struct memo_entry *));
+	if (cache->buckets == NULL) {
+		printf("Out of memory, memo cache too large.\n");
+		exit(1);
+	}
+	cache->newest = NULL;
+	cache->oldest = NULL;
+	cache->size = 0;
+	cache->capacity = capacity;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+	pthread_mutex_init(&cache->lock, NULL);
+	return cache;
+}
+
+unsigned long memo_hash(struct fn_arguments *values)
+{
+	unsigned long hash = 0;
+
+	while (values != NULL) {
+		hash = hash * 31 + hash_s_expr(values->value, HASH_EQUAL);
+		values = values->next;
+	}
+	return hash;
+}
+
+// Compares the stored key list with the argument values element by element.
+static int key_matches(struct s_expr *key, struct fn_arguments *values)
+{
+	while (key->type == CELL && values != NULL) {
+		if (!equal(key->value->cell->first, values->value))
+			return 0;
+		key = key->value->cell->rest;
+		values = values->next;
+	}
+	return key->type != CELL && values == NULL;
+}
+
+static void unlink_recent(struct memo_cache *cache, struct memo_entry *entry)
+{
+	if (entry->newer != NULL)
+		entry->newer->older = entry->older;
+	else
+		cache->newest = entry->older;
+	if (entry->older != NULL)
+		entry->older->newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
+}
+
+static void push_recent(struct memo_cache *cache, struct memo_entry *entry)
+{
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if (cache->newest != NULL)
+		cache->newest->newer = entry;
+	else
+		cache->oldest = entry;
+	cache->newest = entry;
+}
+
+struct s_expr *memo_cache_get(struct memo_cache *cache,
+	struct fn_arguments *values, unsigned long hash)
+{
+	struct memo_entry *entry;
+	struct s_expr *value = NULL;
+
+	pthread_mutex_lock(&cache->lock);
+	entry = cache->buckets[hash & (cache->bucket_count - 1)];
+	while (entry != NULL) {
+		if (entry->hash == hash && key_matches(entry->key, values)) {
+			unlink_recent(cache, entry);
+			push_recent(cache, entry);
+			value = entry->value;
+			break;
+		}
+		entry = entry->next;
+	}
+	if (value != NULL)
+		cache->hits++;
+	else
+		cache->misses++;
+	pthread_mutex_unlock(&cache->lock);
+	return value;
+}
+
+static void evict_oldest(struct memo_cache *cache)
+{
+	struct memo_entry *entry = cache->oldest;
+	struct memo_entry **link =
+		&cache->buckets[entry->hash & (cache->bucket_count - 1)];
+
+	while (*link != entry)
+		link = &(*link)->next;
+	*link = entry->next;
+	unlink_recent(cache, entry);
+	free(entry);
+	cache->size--;
+	cache->evictions++;
+}
+
+void memo_cache_put(struct memo_cache *cache, struct fn_arguments *values,
+	unsigned long hash, struct s_expr *value)
+{
+	struct memo_entry *entry;
+	struct list_builder key;
+	unsigned long index = hash & (cache->bucket_count - 1);
+
+	pthread_mutex_lock(&cache->lock);
+	// A recursive call, or another thread, may already have stored this
+	// result.
+	for (entry = cache->buckets[index]; entry != NULL;
+	entry = entry->next) {
+		if (entry->hash == hash && key_matches(entry->key, values)) {
+			pthread_mutex_unlock(&cache->lock);
+			return;
+		}
+	}
+	if (cache->size == cache->capacity)
+		evict_oldest(cache);
+
+	list_builder_init(&key);
+	while (values != NULL) {
+		list_builder_push(&key, values->value);
+		values = values->next;
+	}
+	entry = (struct memo_entry *) malloc(sizeof(struct memo_entry));
+	entry->key = list_builder_finish(&key, empty_list);
+	entry->value = value;
+	entry->hash = hash;
+	entry->next = cache->buckets[index];
+	cache->buckets[index] = entry;
+	push_recent(cache, entry);
+	cache->size++;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void memo_cache_clear(struct memo_cache *cache)
+{
+	pthread_mutex_lock(&cache->lock);
+	while (cache->oldest != NULL)
+		evict_oldest(cache);
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+	pthread_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,82 @@
+/**
+ * memo.h - Bounded caches of lambda results
+ *
+ * A memoized lambda keeps a cache from argument tuples to results. Arguments
+ * are compared with equal, and the least recently used entry is evicted once
+ * the cache is full.
+ */
+#ifndef MEMO
+#define MEMO
+#include <stdlib.h>
+#include <pthread.h>
+#include "parser.h"
+
+struct memo_entry {
+	// the arguments, as a list
+	struct s_expr *key;
+	struct s_expr *value;
+	unsigned long hash;
+	// the next entry in the same bucket
+	struct memo_entry *next;
+	// neighbours in the recently used list, most recent first
+	struct memo_entry *newer;
+	struct memo_entry *older;
+};
+
+struct memo_cache {
+	struct memo_entry **buckets;
+	unsigned long bucket_count;
+	struct memo_entry *newest;
+	struct memo_entry *oldest;
+	int size;
+	int capacity;
+	long hits;
+	long misses;
+	long evictions;
+	// held by each operation, since a lambda may run on several threads
+	pthread_mutex_t lock;
+};
+
+/**
+ * memo_cache_create() - Allocates an empty cache
+ * @capacity - the maximum number of entries, at least 1
+ */
+struct memo_cache *memo_cache_create(int capacity);
+
+/**
+ * memo_hash() - Hashes a tuple of argument values
+ * @values - the arguments
+ */
+unsigned long memo_hash(struct fn_arguments *values);
+
+/**
+ * memo_cache_get() - Looks up the result for a tuple of arguments
+ * @cache
+ * @values - the arguments
+ * @hash - memo_hash(values)
+ * @returns the cached result, or NULL on a miss
+ *
+ * Counts a hit or a miss, and marks the entry as most recently used.
+ */
+struct s_expr *memo_cache_get(struct memo_cache *cache,
+	struct fn_arguments *values, unsigned long hash);
+
+/**
+ * memo_cache_put() - Stores the result for a tuple of arguments
+ * @cache
+ * @values - the arguments, which are copied into a list
+ * @hash - memo_hash(values)
+ * @value - the result
+ *
+ * Evicts the least recently used entry if the cache is full.
+ */
+void memo_cache_put(struct memo_cache *cache, struct fn_arguments *values,
+	unsigned long hash, struct s_expr *value);
+
+/**
+ * memo_cache_clear() - Removes all entries and resets the counters
+ * @cache
+ */
+void memo_cache_clear(struct memo_cache *cache);
+
+#endif
@@ -0,0 +1,305 @@
+/**
+ * parallel_reader.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "parser.h"
+#include "data.h"
+#include "pool.h"
+#include "interpreter.h"
+#include "parallel_reader.h"
+
+// Text shorter than this is scanned and read on one thread.
+#define MIN_PIECE (256 * 1024)
+// Pieces scanned per thread, so that chunks can be balanced between threads
+#define PIECES_PER_THREAD 4
+#define NO_SPLIT SIZE_MAX
+
+// The state of the lexer (see get_token() in lexer.c)
+enum scan_state {
+	IN_SPACE,	// between tokens
+	IN_TOKEN,	// in a symbol or number
+	IN_HASH,	// after #, before the t or f
+	IN_STRING,
+	IN_ESCAPE,	// after a backslash in a string
+	IN_COMMENT
+};
+
+/**
+ * piece - A range of the text, and what scanning it found
+ * @depth - how much deeper in parentheses the piece ends than it starts
+ * @min_depth - the lowest depth in the piece, relative to its start
+ * @split - the first "(" at min_depth, or NO_SPLIT; it starts a top-level form
+ * if the piece starts min_depth deep
+ */
+struct piece {
+	char *text;
+	size_t start;
+	size_t end;
+	enum scan_state start_state;
+	enum scan_state end_state;
+	long depth;
+	long min_depth;
+	size_t split;
+	struct task task;
+};
+
+struct chunk {
+	char *text;
+	size_t length;
+	struct data_region *region;
+	struct task task;
+};
+
+struct parallel_reader {
+	// the interpreter the regions are given to
+	struct interpreter *in;
+	struct chunk *chunks;
+	int chunk_count;
+	// the chunk forms are taken from, and what is left of its forms
+	int current;
+	struct s_expr *forms;
+	char *error;
+};
+
+static void keep_chunk(struct parallel_reader *reader, struct chunk *chunk)
+{
+	struct interpreter *prev = interpreter_enter(reader->in);
+
+	data_keep(chunk->region);
+	interpreter_enter(prev);
+}
+
+static int is_space(char ch)
+{
+	return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r';
+}
+
+static void scan_piece(void *data)
+{
+	struct piece *piece = (struct piece *) data;
+	enum scan_state state = piece->start_state;
+	long depth = 0;
+	long min_depth = 0;
+	size_t split = NO_SPLIT;
+	size_t i;
+
+	for (i = piece->start; i < piece->end; i++) {
+		char ch = piece->text[i];
+
+		if (state == IN_STRING) {
+			if (ch == '\\')
+				state = IN_ESCAPE;
+			else if (ch == '"')
+				state = IN_SPACE;
+			continue;
+		} else if (state == IN_ESCAPE) {
+			state = IN_STRING;
+			continue;
+		} else if (state == IN_COMMENT) {
+			if (ch == '\n')
+				state = IN_SPACE;
+			continue;
+		} else if (state == IN_HASH) {
+			state = IN_SPACE;
+			continue;
+		} else if (state == IN_TOKEN) {
+			// Only these end a token; ; and " are part of it.
+			if (ch != '(' && ch != ')' && !is_space(ch))
+				continue;
+			state = IN_SPACE;
+		}
+
+		if (is_space(ch))
+			continue;
+		if (ch == '(') {
+			if (depth == min_depth && split == NO_SPLIT)
+				split = i;
+			depth++;
+		} else if (ch == ')') {
+			depth--;
+			if (depth < min_depth) {
+				min_depth = depth;
+				split = NO_SPLIT;
+			}
+		} else if (ch == ';') {
+			state = IN_COMMENT;
+			continue;
+		} else if (ch == '"') {
+			state = IN_STRING;
+		} else if (ch == '#') {
+			state = IN_HASH;
+		} else if (ch != '\'') {
+			state = IN_TOKEN;
+		}
+	}
+	piece->end_state = state;
+	piece->depth = depth;
+	piece->min_depth = min_depth;
+	piece->split = split;
+}
+
+static void read_chunk(void *data)
+{
+	struct chunk *chunk = (struct chunk *) data;
+
+	chunk->region = data_parse(chunk->text, chunk->length, 1);
+}
+
+// Returns the next piece boundary at or after `at`: the start of a line.
+static size_t line_start(char *text, size_t length, size_t at)
+{
+	char *newline;
+
+	if (at == 0 || at >= length)
+		return at < length ? at : length;
+	newline = (char *) memchr(text + at - 1, '\n', length - at + 1);
+	if (newline == NULL)
+		return length;
+	// memchr() searched from text + at - 1, so the offset is not negative.
+	return (size_t) (newline - text) + 1;
+}
+
+/*
+ * Finds where top-level forms start, far enough apart to cut the text into
+ * about `count` chunks, and returns how many starts it put in `splits`
+ * (which has room for `count`). The start of the text is always one.
+ */
+static int find_splits(char *text, size_t length, int count, size_t *splits)
+{
+	struct piece *pieces = (struct piece *)
+		calloc(count, sizeof(struct piece));
+	enum scan_state state = IN_SPACE;
+	long depth = 0;
+	int unmatched = 0;
+	int split_count = 0;
+	int i;
+
+	if (pieces == NULL) {
+		printf("Out of memory, cannot read in parallel.\n");
+		exit(1);
+	}
+	for (i = 0; i < count; i++) {
+		pieces[i].text = text;
+		pieces[i].start = line_start(text, length, length / count * i);
+		pieces[i].end = i + 1 < count
+			? line_start(text, length, length / count * (i + 1))
+			: length;
+		pieces[i].start_state = IN_SPACE;
+		pieces[i].task.run = scan_piece;
+		pieces[i].task.data = &pieces[i];
+		pool_submit(&pieces[i].task);
+	}
+	splits[split_count++] = 0;
+	for (i = 0; i < count; i++) {
+		struct piece *piece = &pieces[i];
+
+		pool_wait(&piece->task);
+		if (piece->start_state != state) {
+			piece->start_state = state;
+			scan_piece(piece);
+		}
+		// An unmatched ) is read as a symbol, which the depths don't
+		// allow for, so no form after one is split off.
+		if (depth + piece->min_depth < 0)
+			unmatched = 1;
+		if (!unmatched && piece->split != NO_SPLIT && piece->split > 0
+		&& depth + piece->min_depth == 0)
+			splits[split_count++] = piece->split;
+		state = piece->end_state;
+		depth += piece->depth;
+	}
+	free(pieces);
+	return split_count;
+}
+
+struct parallel_reader *parallel_reader_open(struct interpreter *in,
+	char *text, size_t length)
+{
+	struct parallel_reader *reader = (struct parallel_reader *)
+		calloc(1, sizeof(struct parallel_reader));
+	int count = pool_threads() * PIECES_PER_THREAD;
+	size_t *splits;
+	int i;
+
+	if (length / count < MIN_PIECE)
+		count = length / MIN_PIECE > 0 ? length / MIN_PIECE : 1;
+	splits = (size_t *) malloc(count * sizeof(size_t));
+	if (reader == NULL || splits == NULL) {
+		printf("Out of memory, cannot read in parallel.\n");
+		exit(1);
+	}
+	if (count > 1) {
+		reader->chunk_count = find_splits(text, length, count, splits);
+	} else {
+		splits[0] = 0;
+		reader->chunk_count = 1;
+	}
+	reader->chunks = (struct chunk *)
+		calloc(reader->chunk_count, sizeof(struct chunk));
+	if (reader->chunks == NULL) {
+		printf("Out of memory, cannot read in parallel.\n");
+		exit(1);
+	}
+	for (i = 0; i < reader->chunk_count; i++) {
+		struct chunk *chunk = &reader->chunks[i];
+		size_t end = i + 1 < reader->chunk_count ? splits[i + 1]
+			: length;
+
+		chunk->text = text + splits[i];
+		chunk->length = end - splits[i];
+		chunk->task.run = read_chunk;
+		chunk->task.data = chunk;
+		pool_submit(&chunk->task);
+	}
+	free(splits);
+	reader->in = in;
+	reader->current = -1;
+	reader->forms = empty_list;
+	return reader;
+}
+
+struct s_expr *parallel_reader_next(struct parallel_reader *reader)
+{
+	struct s_expr *form;
+
+	while (is_empty_list(reader->forms)) {
+		struct chunk *chunk;
+
+		// An error ends the chunk, so it ends the program.
+		if (reader->current >= 0) {
+			chunk = &reader->chunks[reader->current];
+			reader->error = data_region_error(chunk->region);
+			if (reader->error != NULL)
+				return NULL;
+		}
+		if (reader->current + 1 == reader->chunk_count)
+			return NULL;
+		chunk = &reader->chunks[++reader->current];
+		pool_wait(&chunk->task);
+		keep_chunk(reader, chunk);
+		reader->forms = data_region_list(chunk->region);
+	}
+	form = reader->forms->value->cell->first;
+	reader->forms = reader->forms->value->cell->rest;
+	return form;
+}
+
+char *parallel_reader_error(struct parallel_reader *reader)
+{
+	return reader->error;
+}
+
+void parallel_reader_close(struct parallel_reader *reader)
+{
+	int i;
+
+	for (i = reader->current + 1; i < reader->chunk_count; i++) {
+		pool_wait(&reader->chunks[i].task);
+		keep_chunk(reader, &reader->chunks[i]);
+	}
+	free(reader->chunks);
+	free(reader);
+}
@@ -0,0 +1,60 @@
+/**
+ * parallel_reader.h - Reads a large program on several threads
+ *
+ * The text is cut into chunks at the start of top-level forms, and each chunk
+ * is read by data_parse() (see data.h) on a thread of the pool, into a region
+ * of its own. Forms are still returned one at a time and in order, so that
+ * evaluating them while later chunks are being read behaves exactly like
+ * reading and evaluating them one after the other.
+ *
+ * Finding where forms start takes a pass over the text that tracks the depth
+ * of parentheses, which is also split between threads. A piece of text can
+ * only be scanned without knowing what came before it if it starts where the
+ * lexer's state is known: pieces start after a newline, where the lexer is
+ * between tokens unless a string spans the newline. Pieces are scanned as if
+ * they start between tokens, and the rare piece that starts in a string is
+ * scanned again once that is known.
+ */
+#ifndef PARALLEL_READER
+#define PARALLEL_READER
+#include <stdlib.h>
+#include "parser.h"
+
+struct parallel_reader;
+struct interpreter;
+
+/**
+ * parallel_reader_open() - Starts reading a program
+ * @in - the interpreter the forms are for
+ * @text - the source, which must outlive the reader
+ * @length - the number of bytes in `text`
+ *
+ * The chunks are queued right away, and read while the forms are used.
+ */
+struct parallel_reader *parallel_reader_open(struct interpreter *in,
+	char *text, size_t length);
+
+/**
+ * parallel_reader_next() - Returns the next form
+ * @reader
+ * @returns the form, or NULL at the end or at an error (see
+ * parallel_reader_error())
+ *
+ * The regions that forms come from are given to the reader's interpreter (see
+ * data_keep()).
+ */
+struct s_expr *parallel_reader_next(struct parallel_reader *reader);
+
+/**
+ * parallel_reader_error() - Returns why reading stopped early, or NULL
+ * @reader
+ */
+char *parallel_reader_error(struct parallel_reader *reader);
+
+/**
+ * parallel_reader_close() - Waits for the chunks being read and frees a reader
+ * @reader
+ */
+void parallel_reader_close(struct parallel_reader *reader);
+
+#endif
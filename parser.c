@@ -5,18 +5,21 @@
 #include <string.h>
 #include <stdio.h>
 #include "lexer.h"
+#include "heap.h"
 #include "parser.h"
+#include "interpreter.h"
 
-static int token_length;
-static char *current_token;
-struct s_expr *empty_list;
+// The empty list is never modified, so all interpreters share it.
+static struct s_expr the_empty_list = { NULL, EMPTY_LIST };
+struct s_expr *empty_list = &the_empty_list;
 
 struct s_expr *s_expr_from_boolean(int boolean)
 {
-	struct s_expr *expr = (struct s_expr *) malloc(sizeof(struct s_expr));
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
 
-	expr->value = (union s_expr_value *) malloc(
-		sizeof(union s_expr_value));
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
 	expr->value->boolean = boolean;
 	expr->type = BOOLEAN;
 	return expr;
@@ -24,10 +27,11 @@ struct s_expr *s_expr_from_boolean(int boolean)
 
 struct s_expr *s_expr_from_integer(int integer)
 {
-	struct s_expr *expr = (struct s_expr *) malloc(sizeof(struct s_expr));
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
 
-	expr->value = (union s_expr_value *) malloc(
-		sizeof(union s_expr_value));
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
 	expr->value->integer = integer;
 	expr->type = INTEGER;
 	return expr;
@@ -35,12 +39,13 @@ struct s_expr *s_expr_from_integer(int integer)
 
 struct s_expr *s_expr_from_symbol(char *symbol)
 {
-	struct s_expr *expr = (struct s_expr *) malloc(sizeof(struct s_expr));
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
 
-	expr->value = (union s_expr_value *) malloc(
-		sizeof(union s_expr_value));
-	expr->value->symbol = (char *)
-		malloc((token_length+1)*sizeof(char));
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->symbol = (char *) heap_alloc(HEAP_SYMBOL,
+		(strlen(symbol)+1)*sizeof(char));
 	strcpy(expr->value->symbol, symbol);
 	expr->type = SYMBOL;
 	return expr;
@@ -48,10 +53,11 @@ struct s_expr *s_expr_from_symbol(char *symbol)
 
 struct s_expr *s_expr_from_cons_cell(struct cons_cell *cell)
 {
-	struct s_expr *expr = (struct s_expr *) malloc(sizeof(struct s_expr));
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
 
-	expr->value = (union s_expr_value *) malloc(
-		sizeof(union s_expr_value));
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
 	expr->value->cell = cell;
 	expr->type = CELL;
 	return expr;
@@ -60,11 +66,11 @@ struct s_expr *s_expr_from_cons_cell(struct cons_cell *cell)
 struct s_expr *s_expr_from_lambda(struct lambda *lmb)
 {
 	struct s_expr *expr = (struct s_expr *)
-		malloc(sizeof(struct s_expr));
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
 
 	expr->type = LAMBDA;
-	expr->value = (union s_expr_value *) malloc(
-		sizeof(union s_expr_value));
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
 	expr->value->lambda = lmb;
 	return expr;
 }
@@ -72,21 +78,128 @@ struct s_expr *s_expr_from_lambda(struct lambda *lmb)
 struct s_expr *s_expr_from_builtin(struct builtin_function *builtin)
 {
 	struct s_expr *expr = (struct s_expr *)
-		malloc(sizeof(struct s_expr));
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
 
 	expr->type = BUILTIN;
-	expr->value = (union s_expr_value *) malloc(
-		sizeof(union s_expr_value));
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
 	expr->value->builtin = builtin;
 	return expr;
 }
 
+struct s_expr *s_expr_from_hash_table(struct hash_table *table)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = HASH_TABLE;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->table = table;
+	return expr;
+}
+
+struct s_expr *s_expr_from_string(char *chars, int length)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+	struct string *string = (struct string *)
+		heap_alloc(HEAP_STRING, sizeof(struct string));
+
+	string->chars = (char *) heap_alloc(HEAP_STRING,
+		(length+1) * sizeof(char));
+	memcpy(string->chars, chars, length);
+	string->chars[length] = '\0';
+	string->length = length;
+	expr->type = STRING;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->string = string;
+	return expr;
+}
+
+struct s_expr *s_expr_from_string_builder(struct string_builder *builder)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = STRING_BUILDER;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->builder = builder;
+	return expr;
+}
+
 // Hidden; use the empty_list 'constant' instead.
-static struct s_expr *s_expr_as_empty_list()
+struct s_expr *s_expr_from_future(struct future *future)
 {
 	struct s_expr *expr = (struct s_expr *)
-		malloc(sizeof(struct s_expr));
-	expr->type = EMPTY_LIST;
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = FUTURE;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->future = future;
+	return expr;
+}
+
+struct s_expr *s_expr_from_actor(struct mailbox *mailbox)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = ACTOR;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->mailbox = mailbox;
+	return expr;
+}
+
+struct s_expr *s_expr_from_generator(struct generator *generator)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = GENERATOR;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->generator = generator;
+	return expr;
+}
+
+struct s_expr *s_expr_from_promise(struct promise *promise)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = PROMISE;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->promise = promise;
+	return expr;
+}
+
+struct s_expr *s_expr_from_port(struct port *port)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = PORT;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->port = port;
+	return expr;
+}
+
+struct s_expr *s_expr_from_macro(struct macro *macro)
+{
+	struct s_expr *expr = (struct s_expr *)
+		heap_alloc(HEAP_S_EXPR, sizeof(struct s_expr));
+
+	expr->type = MACRO;
+	expr->value = (union s_expr_value *) heap_alloc(
+		HEAP_VALUE, sizeof(union s_expr_value));
+	expr->value->macro = macro;
 	return expr;
 }
 
@@ -119,7 +232,7 @@ int list_length(struct s_expr *ls)
 struct s_expr *list_append(struct s_expr *ls, struct s_expr *value)
 {
 	struct cons_cell *new_cell = (struct cons_cell *)
-		malloc(sizeof(struct cons_cell));
+		heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
 	new_cell->first = value;
 	new_cell->rest = empty_list;
 	struct s_expr *new_cell_expr = s_expr_from_cons_cell(new_cell);
@@ -139,13 +252,60 @@ struct s_expr *list_append(struct s_expr *ls, struct s_expr *value)
 	return ls;
 }
 
+struct s_expr *cons_onto(struct s_expr *first, struct s_expr *rest)
+{
+	struct cons_cell *cell = (struct cons_cell *)
+		heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
+
+	cell->first = first;
+	cell->rest = rest;
+	return s_expr_from_cons_cell(cell);
+}
+
+void list_builder_init(struct list_builder *builder)
+{
+	builder->head = empty_list;
+	builder->tail = NULL;
+}
+
+void list_builder_push(struct list_builder *builder, struct s_expr *value)
+{
+	struct cons_cell *new_cell = (struct cons_cell *)
+		heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
+	new_cell->first = value;
+	new_cell->rest = empty_list;
+	struct s_expr *new_cell_expr = s_expr_from_cons_cell(new_cell);
+
+	if (builder->tail == NULL)
+		builder->head = new_cell_expr;
+	else
+		builder->tail->value->cell->rest = new_cell_expr;
+	builder->tail = new_cell_expr;
+}
+
+struct s_expr *list_builder_finish(struct list_builder *builder,
+	struct s_expr *rest)
+{
+	if (builder->tail == NULL)
+		return rest;
+	builder->tail->value->cell->rest = rest;
+	return builder->head;
+}
+
+int is_keyword(struct s_expr *expr, char *name)
+{
+	return expr->type == SYMBOL && !strcmp(expr->value->symbol, name);
+}
+
 int is_function(struct s_expr *expr)
 {
 	return expr->type == BUILTIN || expr->type == LAMBDA;
 }
 
-int equal(struct s_expr *a, struct s_expr *b)
+int eq(struct s_expr *a, struct s_expr *b)
 {
+	if (a == b)
+		return 1;
 	if (a->type != b->type)
 		return 0;
 	enum s_expr_type type = a->type;
@@ -154,11 +314,54 @@ int equal(struct s_expr *a, struct s_expr *b)
 		return 1;
 	if (type == BOOLEAN)
 		return a->value->boolean == b->value->boolean;
+	if (type == INTEGER)
+		return a->value->integer == b->value->integer;
 	if (type == SYMBOL)
 		return !strcmp(a->value->symbol, b->value->symbol);
-	// They're cons cells
-	return equal(a->value->cell->first, b->value->cell->first)
-		&& equal(a->value->cell->rest, b->value->cell->rest);
+	if (type == CELL)
+		return a->value->cell == b->value->cell;
+	if (type == LAMBDA)
+		return a->value->lambda == b->value->lambda;
+	if (type == BUILTIN)
+		return a->value->builtin == b->value->builtin;
+	if (type == HASH_TABLE)
+		return a->value->table == b->value->table;
+	if (type == STRING)
+		return a->value->string == b->value->string;
+	if (type == FUTURE)
+		return a->value->future == b->value->future;
+	if (type == ACTOR)
+		return a->value->mailbox == b->value->mailbox;
+	if (type == GENERATOR)
+		return a->value->generator == b->value->generator;
+	if (type == PROMISE)
+		return a->value->promise == b->value->promise;
+	if (type == PORT)
+		return a->value->port == b->value->port;
+	if (type == MACRO)
+		return a->value->macro == b->value->macro;
+	if (type == UNLOADED)
+		return 0;
+	// They're string builders
+	return a->value->builder == b->value->builder;
+}
+
+int equal(struct s_expr *a, struct s_expr *b)
+{
+	// Walk down the rest of each list iteratively so that long lists
+	// don't exhaust the stack.
+	while (a->type == CELL && b->type == CELL) {
+		if (!equal(a->value->cell->first, b->value->cell->first))
+			return 0;
+		a = a->value->cell->rest;
+		b = b->value->cell->rest;
+	}
+	if (a->type == STRING && b->type == STRING) {
+		return a->value->string->length == b->value->string->length
+			&& !memcmp(a->value->string->chars,
+			b->value->string->chars, a->value->string->length);
+	}
+	return eq(a, b);
 }
 
 int is_assoc_list(struct s_expr *expr)
@@ -195,46 +398,60 @@ void start_parser(int max_token_length)
 {
 	// Initialize lexer
 	start_tokens(max_token_length);
-	current_token = (char *) malloc((max_token_length+1) * sizeof(char));
-	token_length = max_token_length;
-
-	empty_list = s_expr_as_empty_list();
 }
 
 void free_parser(void)
 {
-	free(current_token);
+	free_tokens();
 }
 
 static struct s_expr *symbol(void)
 {
-	return s_expr_from_symbol(current_token);
+	return s_expr_from_symbol(interp->current_token);
 }
 
-static struct s_expr *s_expression(void)
+static struct s_expr *string(void)
 {
-	char *tmp = (char *) malloc(
-		(strlen(current_token)+1) * sizeof(char));
+	// Skip the opening quote, which marks the token as a string.
+	return s_expr_from_string(interp->current_token + 1,
+		get_token_length() - 1);
+}
 
-	strcpy(tmp, current_token);
-	int integer = strtol(tmp, &tmp, 10);
+/*
+ * current_token points into the lexer's buffer, so it is only valid until the
+ * next call to get_token(). Returns NULL on a syntax error.
+ */
+static struct s_expr *s_expression(void)
+{
+	char *end;
+	int integer = strtol(interp->current_token, &end, 10);
 
-	if (!strcmp(current_token, "(")) {
+	if (interp->current_token[0] == '"')
+		return string();
+	if (!strcmp(interp->current_token, "(")) {
 		// Since it starts with (, it's a list of one or more
 		// s_expressions
 
 		struct cons_cell *first = (struct cons_cell *)
-			malloc(sizeof(struct cons_cell));
+			heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
 		struct cons_cell *curr = first;
 		struct cons_cell *prev_curr = NULL;
 
 		while (1) {
-			strcpy(current_token, get_token());
-			if (!strcmp(current_token, ")"))
+			interp->current_token = get_token();
+			if (interp->current_token == NULL) {
+				if (!get_token_error())
+					syntax_error("syntax error (unexpected"
+						" end of input in list)");
+				return NULL;
+			}
+			if (!strcmp(interp->current_token, ")"))
 				break;
 			curr->first = s_expression();
+			if (curr->first == NULL)
+				return NULL;
 			struct cons_cell *next = (struct cons_cell *)
-				malloc(sizeof(struct cons_cell));
+				heap_alloc(HEAP_CELL, sizeof(struct cons_cell));
 
 			curr->rest = s_expr_from_cons_cell(next);
 			prev_curr = curr;
@@ -242,16 +459,16 @@ static struct s_expr *s_expression(void)
 		}
 		// Terminate list with empty list
 		prev_curr->rest = empty_list;
-		free(curr);
+		heap_free(HEAP_CELL, curr, sizeof(struct cons_cell));
 		return s_expr_from_cons_cell(first);
-	} else if (!strcmp(current_token, "()")) {
+	} else if (!strcmp(interp->current_token, "()")) {
 		// It's a list of zero s_expressions (because the lexical
 		// analyzer treats '()' as a single token)
 		return empty_list;
-	} else if (!strcmp(current_token, "#f")
-	|| !strcmp(current_token, "#t")) {
-		return s_expr_from_boolean(!strcmp(current_token, "#t"));
-	} else if (*tmp == '\0') {
+	} else if (!strcmp(interp->current_token, "#f")
+	|| !strcmp(interp->current_token, "#t")) {
+		return s_expr_from_boolean(!strcmp(interp->current_token, "#t"));
+	} else if (*end == '\0') {
 		// It's an integer (see top of function)
 		return s_expr_from_integer(integer);
 	} else {
@@ -261,49 +478,8 @@ static struct s_expr *s_expression(void)
 
 struct s_expr *get_expression(void)
 {
-	strcpy(current_token, get_token());
+	interp->current_token = get_token();
+	if (interp->current_token == NULL)
+		return NULL;
 	return s_expression();
 }
-
-static void _print_expression(struct s_expr *expr)
-{
-	if (expr->type == SYMBOL) {
-		printf(expr->value->symbol);
-	} else if (expr->type == CELL) {
-		if (is_list(expr)) {
-			printf("(");
-			struct s_expr *curr = expr;
-
-			while (!is_empty_list(curr)) {
-				_print_expression(curr->value->cell->first);
-				curr = curr->value->cell->rest;
-				if (!is_empty_list(curr))
-					printf(" ");
-			}
-			printf(")");
-		} else {
-			printf("(");
-			_print_expression(expr->value->cell->first);
-			printf(" . ");
-			_print_expression(expr->value->cell->rest);
-			printf(")");
-		}
-	} else if (expr->type == BOOLEAN) {
-		printf(expr->value->boolean ? "#t" : "#f");
-	} else if (expr->type == INTEGER) {
-		printf("%d", expr->value->integer);
-	} else if (expr->type == LAMBDA) {
-		printf("<lambda %s>", expr->value->lambda->name);
-	} else if (expr->type == BUILTIN) {
-		printf("<built-in function %s>", expr->value->builtin->name);
-	} else {
-		// expr is the empty list
-		printf("()");
-	}
-}
-
-void print_expression(struct s_expr *expr)
-{
-	_print_expression(expr);
-	printf("\n");
-}
@@ -5,6 +5,15 @@
 #define PARSER
 #include <stdlib.h>
 
+struct hash_table;
+struct string_builder;
+struct memo_cache;
+struct future;
+struct mailbox;
+struct generator;
+struct promise;
+struct port;
+
 const struct cons_cell {
 	struct s_expr *first;
 	struct s_expr *rest;
@@ -15,6 +24,41 @@ const struct lambda {
 	char **args;
 	int arg_count;
 	struct s_expr *body;
+	// the body as it was read, if folding changed it, or NULL (see
+	// fold.h)
+	struct s_expr *source;
+	// the cache of results, or NULL if the lambda isn't memoized
+	struct memo_cache *memo;
+};
+
+/**
+ * macro - A macro made by define-syntax (see macro.h)
+ * @name
+ * @literals - the list of symbols its patterns match as they are
+ * @rules - the list of its (pattern template) rules, tried in order
+ */
+struct macro {
+	char *name;
+	struct s_expr *literals;
+	struct s_expr *rules;
+};
+
+/**
+ * string - An immutable string
+ * @chars - the characters, followed by a '\0' that isn't part of the string
+ * @length - the number of characters, which may include '\0'
+ */
+struct string {
+	char *chars;
+	int length;
+};
+
+/**
+ * fn_arguments - The arguments of a function call, as a linked list
+ */
+struct fn_arguments {
+	struct s_expr *value;
+	struct fn_arguments *next;
 };
 
 struct builtin_function {
@@ -31,9 +75,26 @@ union s_expr_value {
 	struct cons_cell *cell;
 	struct lambda *lambda;
 	struct builtin_function *builtin;
+	struct hash_table *table;
+	struct string *string;
+	struct string_builder *builder;
+	struct future *future;
+	struct mailbox *mailbox;
+	struct generator *generator;
+	struct promise *promise;
+	struct port *port;
+	struct macro *macro;
 };
 
-enum s_expr_type { BOOLEAN, INTEGER, SYMBOL, CELL, EMPTY_LIST, LAMBDA, BUILTIN };
+/*
+ * UNLOADED is what the objects of a region read as once unload-data has
+ * released its memory (see data.h). It is 0, so that zeroed memory has it.
+ */
+enum s_expr_type {
+	UNLOADED, BOOLEAN, INTEGER, SYMBOL, CELL, EMPTY_LIST, LAMBDA, BUILTIN,
+	HASH_TABLE, STRING, STRING_BUILDER, FUTURE, ACTOR,
+	GENERATOR, PROMISE, PORT, MACRO
+};
 
 /**
  * s_expr - A parse tree
@@ -46,7 +107,7 @@ struct s_expr {
 /**
  * empty_list - Constant representing '()
  */
-struct s_expr *empty_list;
+extern struct s_expr *empty_list;
 
 /**
  * s_expr_from_boolean - Util method for creating a boolean s-expression
@@ -98,6 +159,82 @@ struct s_expr *s_expr_from_lambda(struct lambda *lmb);
  */
 struct s_expr *s_expr_from_builtin(struct builtin_function *builtin);
 
+/**
+ * s_expr_from_hash_table - Util method for creating a hash table s-expression
+ * @table - the hash table
+ *
+ * Creates an s_expr of type HASH_TABLE.
+ */
+struct s_expr *s_expr_from_hash_table(struct hash_table *table);
+
+/**
+ * s_expr_from_string - Util method for creating a string s-expression
+ * @chars - the characters of the string, which are copied
+ * @length - the number of characters
+ *
+ * Creates an s_expr of type STRING.
+ */
+struct s_expr *s_expr_from_string(char *chars, int length);
+
+/**
+ * s_expr_from_string_builder - Util method for creating an s-expression for a
+ * string builder
+ * @builder - the string builder
+ *
+ * Creates an s_expr of type STRING_BUILDER.
+ */
+struct s_expr *s_expr_from_string_builder(struct string_builder *builder);
+
+/**
+ * s_expr_from_future - Util method for creating an s-expression for a future
+ * @future - the future
+ *
+ * Creates an s_expr of type FUTURE.
+ */
+struct s_expr *s_expr_from_future(struct future *future);
+
+/**
+ * s_expr_from_actor - Util method for creating an s-expression for an actor
+ * @mailbox - the mailbox of the actor
+ *
+ * Creates an s_expr of type ACTOR.
+ */
+struct s_expr *s_expr_from_actor(struct mailbox *mailbox);
+
+/**
+ * s_expr_from_generator - Util method for creating an s-expression for a
+ * generator
+ * @generator - the generator
+ *
+ * Creates an s_expr of type GENERATOR.
+ */
+struct s_expr *s_expr_from_generator(struct generator *generator);
+
+/**
+ * s_expr_from_promise - Util method for creating an s-expression for a
+ * promise
+ * @promise - the promise
+ *
+ * Creates an s_expr of type PROMISE.
+ */
+struct s_expr *s_expr_from_promise(struct promise *promise);
+
+/**
+ * s_expr_from_port - Util method for creating an s-expression for a port
+ * @port - the port
+ *
+ * Creates an s_expr of type PORT.
+ */
+struct s_expr *s_expr_from_port(struct port *port);
+
+/**
+ * s_expr_from_macro - Util method for creating an s-expression for a macro
+ * @macro - the macro
+ *
+ * Creates an s_expr of type MACRO.
+ */
+struct s_expr *s_expr_from_macro(struct macro *macro);
+
 /**
  * is_empty_list - Determines if the s-expression is the empty list
  * @expr - the expression to test
@@ -123,16 +260,79 @@ int list_length(struct s_expr *expr);
  */
 struct s_expr *list_append(struct s_expr *ls, struct s_expr *value);
 
+/**
+ * cons_onto - Makes a cell of `first` and `rest`
+ * @first
+ * @rest - shared, not copied
+ */
+struct s_expr *cons_onto(struct s_expr *first, struct s_expr *rest);
+
+/**
+ * list_builder - Builds a list front to back in linear time
+ * @head - the first cons cell, or the empty list if nothing was pushed
+ * @tail - the last cons cell, or NULL if nothing was pushed
+ *
+ * Unlike repeated calls to list_append(), which walk to the end of the list
+ * each time, the builder keeps a pointer to the last cell.
+ */
+struct list_builder {
+	struct s_expr *head;
+	struct s_expr *tail;
+};
+
+/**
+ * list_builder_init - Starts building an empty list
+ * @builder
+ */
+void list_builder_init(struct list_builder *builder);
+
+/**
+ * list_builder_push - Adds an s-expression to the end of the list
+ * @builder
+ * @value - the item to append
+ */
+void list_builder_push(struct list_builder *builder, struct s_expr *value);
+
+/**
+ * list_builder_finish - Terminates the list and returns it
+ * @builder
+ * @rest - what the last cell points to, usually empty_list; it is shared, not
+ * copied
+ */
+struct s_expr *list_builder_finish(struct list_builder *builder,
+	struct s_expr *rest);
+
+/**
+ * is_keyword - Determines if the s-expression is the symbol `name`
+ * @expr
+ * @name
+ */
+int is_keyword(struct s_expr *expr, char *name);
+
 /**
  * is_function - Determines if the s-expression is a builtin function or lambda
  * @expr - the expression to test
  */
 int is_function(struct s_expr *expr);
 
+/**
+ * eq - Returns whether the two s-expressions are the same object
+ * @a
+ * @b
+ *
+ * Booleans, integers, symbols and the empty list are compared by value, since
+ * they are not shared between occurrences. Everything else is compared by
+ * identity.
+ */
+int eq(struct s_expr *a, struct s_expr *b);
+
 /**
  * equal - Returns whether the two s-expressions have equal value
  * @a
  * @b
+ *
+ * Lists are compared element by element and strings character by character;
+ * all other types are compared with eq.
  */
 int equal(struct s_expr *a, struct s_expr *b);
 
@@ -159,17 +359,19 @@ struct s_expr *assoc_list_get(struct s_expr *expr, struct s_expr *key);
  */
 void start_parser(int token_length);
 
-struct s_expr *empty_list;
-
 /**
  * get_expression() - Reads an s_expression from stdin and prints its parse
  * tree.
  *
  * An s_expression takes the following form:
- *    <s_expression> = ( { <s_expression> } ) | #t | #f | <symbol> | ()
+ *    <s_expression> = ( { <s_expression> } ) | #t | #f | <symbol> | <string>
+ *                   | ()
  *
  * Since it prints to stdout and reads from stdin, you can simply call:
  *    get_expression();
+ *
+ * Returns NULL at the end of the input, and on a syntax error, which sets the
+ * interpreter's last error (see get_token_error() in lexer.h).
  */
 struct s_expr *get_expression(void);
 
@@ -178,10 +380,4 @@ struct s_expr *get_expression(void);
  */
 void free_parser(void);
 
-/**
- * print_expression() - Displays the parse tree of an s-expression.
- * @expr
- */
-void print_expression(struct s_expr *expr);
-
 #endif
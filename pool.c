@@ -0,0 +1,234 @@
+/**
+ * pool.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+
+/*
+ * Implementation notes:
+ *
+ * Each deque is a growable ring buffer guarded by its own mutex. Contention
+ * on it is rare: only thieves touch a deque other than their own, and only
+ * when they have run out of work.
+ *
+ * Idle threads sleep on `changed`, which is broadcast whenever a task is
+ * queued or finishes. `pending` counts queued tasks, and is only increased
+ * while holding `lock`, so a thread that sees it at 0 under the lock cannot
+ * miss the wakeup for the next task. A task can be taken just before it is
+ * counted, so `pending` may briefly drop below 0.
+ */
+
+#define INITIAL_DEQUE_SIZE 64
+
+struct deque {
+	struct task **tasks;
+	int capacity;
+	// tasks are in [top, bottom), modulo capacity
+	long top;
+	long bottom;
+	pthread_mutex_t lock;
+};
+
+static int threads;
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+// one deque per worker, followed by the shared one for outside threads
+static struct deque *deques;
+static int deque_count;
+static int pending;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+
+// the deque of the worker running on this thread, or NULL
+static __thread struct deque *own;
+
+static void deque_init(struct deque *deque)
+{
+	deque->capacity = INITIAL_DEQUE_SIZE;
+	deque->tasks = (struct task **)
+		malloc(deque->capacity * sizeof(struct task *));
+	if (deque->tasks == NULL) {
+		printf("Out of memory, cannot start the thread pool.\n");
+		exit(1);
+	}
+	deque->top = 0;
+	deque->bottom = 0;
+	pthread_mutex_init(&deque->lock, NULL);
+}
+
+static void push_bottom(struct deque *deque, struct task *task)
+{
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom - deque->top == deque->capacity) {
+		struct task **tasks = (struct task **)
+			malloc(2 * deque->capacity * sizeof(struct task *));
+		long i;
+
+		if (tasks == NULL) {
+			printf("Out of memory, too many tasks.\n");
+			exit(1);
+		}
+		for (i = deque->top; i < deque->bottom; i++) {
+			tasks[i % (2 * deque->capacity)] =
+				deque->tasks[i % deque->capacity];
+		}
+		free(deque->tasks);
+		deque->tasks = tasks;
+		deque->capacity *= 2;
+	}
+	deque->tasks[deque->bottom % deque->capacity] = task;
+	deque->bottom++;
+	pthread_mutex_unlock(&deque->lock);
+}
+
+static struct task *pop_bottom(struct deque *deque)
+{
+	struct task *task = NULL;
+
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom > deque->top) {
+		deque->bottom--;
+		task = deque->tasks[deque->bottom % deque->capacity];
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return task;
+}
+
+static struct task *steal_top(struct deque *deque)
+{
+	struct task *task = NULL;
+
+	pthread_mutex_lock(&deque->lock);
+	if (deque->bottom > deque->top) {
+		task = deque->tasks[deque->top % deque->capacity];
+		deque->top++;
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return task;
+}
+
+/*
+ * Takes the newest task of this thread's own deque, or else steals the oldest
+ * task of another deque, starting from a different one each time to spread
+ * the thieves out.
+ */
+static struct task *find_task(void)
+{
+	static __thread unsigned int next_victim;
+	struct task *task;
+	int i;
+
+	if (own != NULL && (task = pop_bottom(own)) != NULL)
+		goto found;
+	for (i = 0; i < deque_count; i++) {
+		struct deque *victim = &deques[next_victim++ % deque_count];
+
+		if (victim != own && (task = steal_top(victim)) != NULL)
+			goto found;
+	}
+	return NULL;
+
+found:
+	__atomic_sub_fetch(&pending, 1, __ATOMIC_SEQ_CST);
+	return task;
+}
+
+static void run_task(struct task *task)
+{
+	task->run(task->data);
+	pthread_mutex_lock(&lock);
+	__atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&changed);
+	pthread_mutex_unlock(&lock);
+}
+
+static void *worker(void *data)
+{
+	own = (struct deque *) data;
+	while (1) {
+		struct task *task = find_task();
+
+		if (task != NULL) {
+			run_task(task);
+			continue;
+		}
+		pthread_mutex_lock(&lock);
+		while (__atomic_load_n(&pending, __ATOMIC_SEQ_CST) <= 0)
+			pthread_cond_wait(&changed, &lock);
+		pthread_mutex_unlock(&lock);
+	}
+	return NULL;
+}
+
+static void start_pool(void)
+{
+	char *setting = getenv("SCHEME_THREADS");
+	int i;
+
+	if (threads < 1 && setting != NULL)
+		threads = atoi(setting);
+	if (threads < 1)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+		threads = 1;
+
+	deque_count = threads;
+	deques = (struct deque *) malloc(deque_count * sizeof(struct deque));
+	if (deques == NULL) {
+		printf("Out of memory, cannot start the thread pool.\n");
+		exit(1);
+	}
+	for (i = 0; i < deque_count; i++)
+		deque_init(&deques[i]);
+	// The last deque is the shared one, which has no worker.
+	for (i = 0; i < threads - 1; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, worker, &deques[i])) {
+			printf("Cannot start a worker thread.\n");
+			exit(1);
+		}
+		pthread_detach(thread);
+	}
+}
+
+void pool_set_threads(int count)
+{
+	threads = count;
+}
+
+int pool_threads(void)
+{
+	pthread_once(&started, start_pool);
+	return threads;
+}
+
+void pool_submit(struct task *task)
+{
+	pthread_once(&started, start_pool);
+	task->done = 0;
+	push_bottom(own != NULL ? own : &deques[deque_count - 1], task);
+	pthread_mutex_lock(&lock);
+	__atomic_add_fetch(&pending, 1, __ATOMIC_SEQ_CST);
+	pthread_cond_broadcast(&changed);
+	pthread_mutex_unlock(&lock);
+}
+
+void pool_wait(struct task *task)
+{
+	while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+		struct task *other = find_task();
+
+		if (other != NULL) {
+			run_task(other);
+			continue;
+		}
+		pthread_mutex_lock(&lock);
+		while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)
+		&& __atomic_load_n(&pending, __ATOMIC_SEQ_CST) <= 0)
+			pthread_cond_wait(&changed, &lock);
+		pthread_mutex_unlock(&lock);
+	}
+}
@@ -0,0 +1,62 @@
+/**
+ * pool.h - A work-stealing thread pool
+ *
+ * The pool is shared by every interpreter in the process and is started on
+ * first use. It has one worker thread fewer than pool_threads(), since a
+ * thread that waits for a task with pool_wait() runs queued tasks itself in
+ * the meantime. That also keeps tasks that wait for other tasks (nested
+ * pmap, or touching a future inside a future) from deadlocking.
+ *
+ * Each worker has its own deque of tasks. Workers push and pop tasks at the
+ * bottom of their own deque, and steal from the top of the others' when
+ * theirs is empty. Tasks submitted from threads outside the pool go to a
+ * shared deque that every worker steals from.
+ */
+#ifndef POOL
+#define POOL
+
+/**
+ * task - A unit of work
+ * @run - the function to call
+ * @data - passed to `run`
+ * @done - set once `run` has returned; read it with pool_wait()
+ *
+ * Tasks are allocated by the caller and must stay alive until pool_wait()
+ * returns for them.
+ */
+struct task {
+	void (*run)(void *data);
+	void *data;
+	int done;
+};
+
+/**
+ * pool_set_threads() - Sets the number of threads used for parallel work
+ * @threads - at least 1; 1 runs every task on the thread that waits for it
+ *
+ * This only has an effect before the pool is first used. Otherwise the size
+ * comes from the SCHEME_THREADS environment variable, or else the number of
+ * online processors.
+ */
+void pool_set_threads(int threads);
+
+/**
+ * pool_threads() - Returns the number of threads used for parallel work
+ */
+int pool_threads(void);
+
+/**
+ * pool_submit() - Queues a task to run on some thread of the pool
+ * @task - with `run` and `data` set
+ */
+void pool_submit(struct task *task);
+
+/**
+ * pool_wait() - Waits for a submitted task to finish
+ * @task
+ *
+ * The calling thread runs other queued tasks while it waits.
+ */
+void pool_wait(struct task *task);
+
+#endif
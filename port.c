@@ -0,0 +1,109 @@
+/**
+ * port.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "lexer.h"
+#include "interpreter.h"
+#include "port.h"
+
+// Initial size of the token buffer of an input port
+#define TOKEN_SIZE 20
+
+static struct port *new_port(FILE *stream, int output, int owns_stream)
+{
+	struct port *port = (struct port *) calloc(1, sizeof(struct port));
+
+	if (port == NULL) {
+		printf("Out of memory, cannot open a port.\n");
+		exit(1);
+	}
+	port->stream = stream;
+	port->output = output;
+	port->owns_stream = owns_stream;
+	if (!output) {
+		// Set up the port's lexer with the lexer's own functions.
+		struct lexer saved = interp->lexer;
+
+		start_tokens(TOKEN_SIZE);
+		set_token_input(stream);
+		port->lexer = interp->lexer;
+		interp->lexer = saved;
+	}
+	return port;
+}
+
+struct port *port_open(char *path, int output)
+{
+	FILE *stream = fopen(path, output ? "w" : "r");
+
+	if (stream == NULL)
+		return NULL;
+	setvbuf(stream, NULL, _IOFBF, PORT_BUFFER_SIZE);
+	return new_port(stream, output, 1);
+}
+
+struct port *port_current_input(void)
+{
+	if (interp->input_port == NULL)
+		interp->input_port = new_port(stdin, 0, 0);
+	return interp->input_port;
+}
+
+struct port *port_current_output(void)
+{
+	if (interp->output_port == NULL)
+		interp->output_port = new_port(stdout, 1, 0);
+	return interp->output_port;
+}
+
+struct s_expr *port_read(struct port *port)
+{
+	struct lexer saved = interp->lexer;
+	char *saved_token = interp->current_token;
+	struct s_expr *datum;
+
+	interp->lexer = port->lexer;
+	datum = get_expression();
+	port->lexer = interp->lexer;
+	interp->lexer = saved;
+	interp->current_token = saved_token;
+	return datum;
+}
+
+int port_read_char(struct port *port)
+{
+	struct lexer *lx = &port->lexer;
+
+	if (lx->lookahead) {
+		lx->lookahead = 0;
+		return lx->c;
+	}
+	return getc(port->stream);
+}
+
+int port_peek_char(struct port *port)
+{
+	struct lexer *lx = &port->lexer;
+
+	if (!lx->lookahead) {
+		lx->c = getc(port->stream);
+		lx->lookahead = 1;
+	}
+	return lx->c;
+}
+
+void port_close(struct port *port)
+{
+	if (port->closed)
+		return;
+	port->closed = 1;
+	if (port->owns_stream)
+		fclose(port->stream);
+	else
+		fflush(port->stream);
+	free(port->lexer.lexeme);
+	port->lexer.lexeme = NULL;
+}
@@ -0,0 +1,82 @@
+/**
+ * port.h - Files that programs read from and write to
+ *
+ * A port is a stream with a large buffer of its own, so that reading or
+ * writing a character at a time costs a copy rather than a system call. Input
+ * ports keep the state of a lexer (see lexer.h), so that any of them can be
+ * read with the parser, one datum at a time. Reading characters and reading
+ * data can be mixed on the same port: both go through the lexer's lookahead.
+ *
+ * Each interpreter has a current input and output port, which are ports on
+ * stdin and stdout unless with-output-to-file changes the output port. The
+ * ports on stdin and stdout are made when first needed, and keep the buffering
+ * their streams already had, so that output stays in order with the shell's.
+ */
+#ifndef PORT_H
+#define PORT_H
+#include <stdio.h>
+#include "interpreter.h"
+
+// The size of the buffer of each port opened on a file
+#define PORT_BUFFER_SIZE (256 * 1024)
+
+struct port {
+	FILE *stream;
+	int output;
+	int closed;
+	// whether closing the port closes the stream
+	int owns_stream;
+	// the state of the lexer reading an input port
+	struct lexer lexer;
+};
+
+/**
+ * port_open() - Opens a file
+ * @path
+ * @output - whether to open it for writing, truncating it, or else reading
+ * @returns the port, or NULL if the file can't be opened
+ */
+struct port *port_open(char *path, int output);
+
+/**
+ * port_current_input() - Returns the current interpreter's input port
+ */
+struct port *port_current_input(void);
+
+/**
+ * port_current_output() - Returns the current interpreter's output port
+ */
+struct port *port_current_output(void);
+
+/**
+ * port_read() - Reads a datum with the parser
+ * @port - an open input port
+ * @returns the datum, or NULL at the end of the input or on a syntax error
+ *
+ * After a syntax error, port->lexer.error is set, the message is the
+ * interpreter's last error, and the rest of the input is skipped.
+ */
+struct s_expr *port_read(struct port *port);
+
+/**
+ * port_read_char() - Reads a character, like getc()
+ * @port - an open input port
+ */
+int port_read_char(struct port *port);
+
+/**
+ * port_peek_char() - Returns the next character without reading it
+ * @port - an open input port
+ */
+int port_peek_char(struct port *port);
+
+/**
+ * port_close() - Closes a port, flushing it if it is an output port
+ * @port
+ *
+ * Closing a closed port does nothing. Ports are not freed, since values may
+ * still refer to them.
+ */
+void port_close(struct port *port);
+
+#endif
@@ -0,0 +1,282 @@
+/**
+ * printer.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "parser.h"
+#include "printer.h"
+
+// The size a printer's buffer starts at; it grows as needed
+#define INITIAL_CAPACITY 256
+#define INITIAL_FRAMES 16
+
+/**
+ * print_frame - A list being written
+ * @rest - what is left of the list to write
+ * @count - the number of items written so far
+ */
+struct print_frame {
+	struct s_expr *rest;
+	int count;
+};
+
+static void start(struct printer *printer, enum printer_sink sink)
+{
+	memset(printer, 0, sizeof(*printer));
+	printer->sink = sink;
+}
+
+void printer_to_stream(struct printer *printer, FILE *stream)
+{
+	start(printer, PRINTER_STREAM);
+	printer->stream = stream;
+}
+
+void printer_to_fd(struct printer *printer, int fd)
+{
+	start(printer, PRINTER_FD);
+	printer->fd = fd;
+}
+
+void printer_to_string(struct printer *printer)
+{
+	start(printer, PRINTER_STRING);
+}
+
+// Hands the buffer to the sink, without flushing a stream.
+static void drain(struct printer *printer)
+{
+	size_t written = 0;
+
+	if (printer->sink == PRINTER_STREAM) {
+		fwrite(printer->buffer, 1, printer->length, printer->stream);
+	} else if (printer->sink == PRINTER_FD) {
+		while (written < printer->length) {
+			ssize_t n = write(printer->fd, printer->buffer + written,
+				printer->length - written);
+
+			// Output that can't be written is dropped, as stdio
+			// does.
+			if (n <= 0)
+				break;
+			written += n;
+		}
+	} else {
+		return;
+	}
+	printer->length = 0;
+}
+
+// Makes room for `length` more characters and the final '\0'.
+static void reserve(struct printer *printer, size_t length)
+{
+	size_t capacity = printer->capacity;
+
+	if (printer->length + length < printer->capacity)
+		return;
+	if (printer->sink != PRINTER_STRING && printer->length > 0
+	&& printer->length + length >= PRINTER_BUFFER_SIZE) {
+		drain(printer);
+		if (length < printer->capacity)
+			return;
+	}
+	if (capacity == 0)
+		capacity = INITIAL_CAPACITY;
+	while (printer->length + length >= capacity)
+		capacity *= 2;
+	printer->buffer = (char *) realloc(printer->buffer, capacity);
+	if (printer->buffer == NULL) {
+		printf("Out of memory, cannot print.\n");
+		exit(1);
+	}
+	printer->capacity = capacity;
+}
+
+void printer_append(struct printer *printer, char *chars, size_t length)
+{
+	reserve(printer, length);
+	memcpy(printer->buffer + printer->length, chars, length);
+	printer->length += length;
+}
+
+static void append_char(struct printer *printer, char ch)
+{
+	reserve(printer, 1);
+	printer->buffer[printer->length++] = ch;
+}
+
+static void append_text(struct printer *printer, char *text)
+{
+	printer_append(printer, text, strlen(text));
+}
+
+// Writes a string in the form it is read in, with quotes and escapes.
+static void append_string(struct printer *printer, struct string *string)
+{
+	char escape[8];
+	int i;
+
+	append_char(printer, '"');
+	for (i = 0; i < string->length; i++) {
+		unsigned char ch = string->chars[i];
+
+		if (ch == '"' || ch == '\\') {
+			append_char(printer, '\\');
+			append_char(printer, ch);
+		} else if (ch == '\n') {
+			append_text(printer, "\\n");
+		} else if (ch == '\t') {
+			append_text(printer, "\\t");
+		} else if (ch == '\r') {
+			append_text(printer, "\\r");
+		} else if (ch < ' ' || ch > '~') {
+			sprintf(escape, "\\x%x;", ch);
+			append_text(printer, escape);
+		} else {
+			append_char(printer, ch);
+		}
+	}
+	append_char(printer, '"');
+}
+
+// Writes anything but a cons cell.
+static void append_atom(struct printer *printer, struct s_expr *expr)
+{
+	char number[16];
+
+	if (expr->type == SYMBOL) {
+		append_text(printer, expr->value->symbol);
+	} else if (expr->type == BOOLEAN) {
+		append_text(printer, expr->value->boolean ? "#t" : "#f");
+	} else if (expr->type == INTEGER) {
+		sprintf(number, "%d", expr->value->integer);
+		append_text(printer, number);
+	} else if (expr->type == LAMBDA) {
+		append_text(printer, "<lambda ");
+		append_text(printer, expr->value->lambda->name);
+		append_char(printer, '>');
+	} else if (expr->type == BUILTIN) {
+		append_text(printer, "<built-in function ");
+		append_text(printer, expr->value->builtin->name);
+		append_char(printer, '>');
+	} else if (expr->type == HASH_TABLE) {
+		append_text(printer, "<hash-table>");
+	} else if (expr->type == STRING && printer->display) {
+		printer_append(printer, expr->value->string->chars,
+			expr->value->string->length);
+	} else if (expr->type == STRING) {
+		append_string(printer, expr->value->string);
+	} else if (expr->type == STRING_BUILDER) {
+		append_text(printer, "<string-builder>");
+	} else if (expr->type == FUTURE) {
+		append_text(printer, "<future>");
+	} else if (expr->type == ACTOR) {
+		append_text(printer, "<actor>");
+	} else if (expr->type == GENERATOR) {
+		append_text(printer, "<generator>");
+	} else if (expr->type == PROMISE) {
+		append_text(printer, "<promise>");
+	} else if (expr->type == PORT) {
+		append_text(printer, "<port>");
+	} else if (expr->type == MACRO) {
+		append_text(printer, "<macro ");
+		append_text(printer, expr->value->macro->name);
+		append_char(printer, '>');
+	} else if (expr->type == UNLOADED) {
+		append_text(printer, "<unloaded>");
+	} else {
+		// expr is the empty list
+		append_text(printer, "()");
+	}
+}
+
+/*
+ * Starts writing a value: atoms are written whole, and lists are opened and
+ * pushed on the stack. Returns the new depth.
+ */
+static size_t open_value(struct printer *printer, struct s_expr *expr,
+	size_t depth)
+{
+	if (expr->type != CELL) {
+		append_atom(printer, expr);
+		return depth;
+	}
+	if (printer->max_depth > 0 && depth >= (size_t) printer->max_depth) {
+		append_text(printer, "...");
+		return depth;
+	}
+	if (depth == printer->frame_capacity) {
+		printer->frame_capacity = printer->frame_capacity > 0
+			? printer->frame_capacity * 2 : INITIAL_FRAMES;
+		printer->frames = (struct print_frame *) realloc(
+			printer->frames,
+			printer->frame_capacity * sizeof(struct print_frame));
+		if (printer->frames == NULL) {
+			printf("Out of memory, cannot print.\n");
+			exit(1);
+		}
+	}
+	append_char(printer, '(');
+	printer->frames[depth].rest = expr;
+	printer->frames[depth].count = 0;
+	return depth + 1;
+}
+
+void printer_write(struct printer *printer, struct s_expr *expr)
+{
+	size_t depth = open_value(printer, expr, 0);
+
+	while (depth > 0) {
+		struct print_frame *frame = &printer->frames[depth - 1];
+		struct s_expr *rest = frame->rest;
+
+		// #f ends a list, like the empty list.
+		if (is_empty_list(rest)) {
+			append_char(printer, ')');
+			depth--;
+			continue;
+		}
+		if (rest->type != CELL) {
+			append_text(printer, " . ");
+			append_atom(printer, rest);
+			append_char(printer, ')');
+			depth--;
+			continue;
+		}
+		if (frame->count > 0)
+			append_char(printer, ' ');
+		if (printer->max_length > 0
+		&& frame->count == printer->max_length) {
+			append_text(printer, "...)");
+			depth--;
+			continue;
+		}
+		frame->rest = rest->value->cell->rest;
+		frame->count++;
+		depth = open_value(printer, rest->value->cell->first, depth);
+	}
+}
+
+void printer_flush(struct printer *printer)
+{
+	drain(printer);
+}
+
+char *printer_string(struct printer *printer, size_t *length)
+{
+	reserve(printer, 0);
+	printer->buffer[printer->length] = '\0';
+	*length = printer->length;
+	return printer->buffer;
+}
+
+void printer_free(struct printer *printer)
+{
+	drain(printer);
+	free(printer->buffer);
+	free(printer->frames);
+	printer->buffer = NULL;
+	printer->frames = NULL;
+}
@@ -0,0 +1,115 @@
+/**
+ * printer.h - Writes s-expressions to a stream, a file descriptor or a string
+ *
+ * A printer collects its output in a buffer, and hands it to its sink in large
+ * pieces: a stream gets one fwrite() and a file descriptor one write() per
+ * PRINTER_BUFFER_SIZE bytes or flush. A string sink keeps everything in the
+ * buffer. The walk over an s-expression is iterative, with a stack of the
+ * lists being written, so nesting can't overflow the C stack, and each list
+ * is walked once.
+ *
+ * Values are written the way the reader reads them in ("write"), or with
+ * strings as their characters ("display"). Lists can be cut off after a
+ * number of items, and nested lists after a depth, with "...".
+ */
+#ifndef PRINTER
+#define PRINTER
+#include <stdio.h>
+#include "parser.h"
+
+// How much output a printer holds before handing it to a stream or descriptor
+#define PRINTER_BUFFER_SIZE (64 * 1024)
+
+enum printer_sink {
+	PRINTER_STREAM,
+	PRINTER_FD,
+	PRINTER_STRING
+};
+
+struct print_frame;
+
+/**
+ * printer - Where output goes, and how values are written
+ * @display - whether strings are written as their characters
+ * @max_length - the most items written of a list, or 0 for no limit
+ * @max_depth - the most lists written inside one another, or 0 for no limit
+ *
+ * The other fields are set by the printer_to_*() functions, after which
+ * @display, @max_length and @max_depth can be changed at any time.
+ */
+struct printer {
+	enum printer_sink sink;
+	FILE *stream;
+	int fd;
+	char *buffer;
+	size_t length;
+	size_t capacity;
+	int display;
+	int max_length;
+	int max_depth;
+	// the lists being written
+	struct print_frame *frames;
+	size_t frame_capacity;
+};
+
+/**
+ * printer_to_stream() - Starts a printer that writes to a stream
+ * @printer
+ * @stream
+ */
+void printer_to_stream(struct printer *printer, FILE *stream);
+
+/**
+ * printer_to_fd() - Starts a printer that writes to a file descriptor
+ * @printer
+ * @fd
+ */
+void printer_to_fd(struct printer *printer, int fd);
+
+/**
+ * printer_to_string() - Starts a printer that builds a string
+ * @printer
+ */
+void printer_to_string(struct printer *printer);
+
+/**
+ * printer_write() - Writes an s-expression
+ * @printer
+ * @expr
+ */
+void printer_write(struct printer *printer, struct s_expr *expr);
+
+/**
+ * printer_append() - Writes characters as they are
+ * @printer
+ * @chars
+ * @length - the number of characters
+ */
+void printer_append(struct printer *printer, char *chars, size_t length);
+
+/**
+ * printer_flush() - Hands what is buffered to the stream or descriptor
+ * @printer
+ *
+ * A stream keeps its own buffer, so output written with stdio functions
+ * afterwards comes after it; fflush() it for the output to be written now.
+ * This does nothing for a string sink.
+ */
+void printer_flush(struct printer *printer);
+
+/**
+ * printer_string() - Returns what a string sink has been given
+ * @printer - a printer started by printer_to_string()
+ * @length - set to the number of characters
+ *
+ * The characters are followed by a '\0', and belong to the printer.
+ */
+char *printer_string(struct printer *printer, size_t *length);
+
+/**
+ * printer_free() - Flushes a printer and frees its buffers
+ * @printer
+ */
+void printer_free(struct printer *printer);
+
+#endif
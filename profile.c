@@ -0,0 +1,283 @@
+/**
+ * profile.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "interpreter.h"
+#include "profile.h"
+
+/*
+ * Implementation notes:
+ *
+ * Each call is a node in a calling-context tree: the children of a node are
+ * the distinct functions called from that context. Self time is kept on the
+ * nodes (for folded stacks) and summed per function (for the report).
+ * Inclusive time only counts the outermost active call of a function, so
+ * recursion isn't counted twice.
+ *
+ * Each interpreter has its own profiler, allocated on first use.
+ */
+
+struct function_record {
+	char *name;
+	int builtin;
+	long calls;
+	long long self_ns;
+	long long inclusive_ns;
+	// the number of calls to this function currently in progress
+	int active;
+	struct function_record *next;
+};
+
+struct context_node {
+	struct function_record *function;
+	long long self_ns;
+	struct context_node *parent;
+	struct context_node *first_child;
+	struct context_node *next_sibling;
+};
+
+struct frame {
+	struct context_node *node;
+	long long start_ns;
+	long long children_ns;
+};
+
+struct profiler {
+	struct function_record *functions;
+	// the root of the tree, which stands for no function
+	struct context_node root;
+	struct frame *stack;
+	int stack_depth;
+	int stack_size;
+};
+
+static struct profiler *current_profiler(void)
+{
+	if (interp->profiler == NULL) {
+		interp->profiler = (struct profiler *)
+			calloc(1, sizeof(struct profiler));
+	}
+	return interp->profiler;
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void free_context(struct context_node *node)
+{
+	struct context_node *child = node->first_child;
+
+	while (child != NULL) {
+		struct context_node *next = child->next_sibling;
+
+		free_context(child);
+		free(child);
+		child = next;
+	}
+}
+
+static void free_functions(struct profiler *p)
+{
+	while (p->functions != NULL) {
+		struct function_record *next = p->functions->next;
+
+		free(p->functions->name);
+		free(p->functions);
+		p->functions = next;
+	}
+}
+
+void profile_start(void)
+{
+	struct profiler *p = current_profiler();
+
+	free_functions(p);
+	free_context(&p->root);
+	p->root.first_child = NULL;
+	p->stack_depth = 0;
+	interp->profiling = 1;
+}
+
+void profile_stop(void)
+{
+	struct profiler *p = current_profiler();
+
+	while (p->stack_depth > 0)
+		profile_exit();
+	interp->profiling = 0;
+}
+
+static struct function_record *find_function(struct profiler *p, char *name,
+	int builtin)
+{
+	struct function_record *function;
+
+	for (function = p->functions; function != NULL;
+	function = function->next) {
+		if (function->builtin == builtin
+		&& !strcmp(function->name, name))
+			return function;
+	}
+	function = (struct function_record *)
+		calloc(1, sizeof(struct function_record));
+	function->name = (char *) malloc((strlen(name)+1) * sizeof(char));
+	strcpy(function->name, name);
+	function->builtin = builtin;
+	function->next = p->functions;
+	p->functions = function;
+	return function;
+}
+
+static struct context_node *find_child(struct profiler *p,
+	struct context_node *parent, char *name, int builtin)
+{
+	struct context_node *child;
+
+	for (child = parent->first_child; child != NULL;
+	child = child->next_sibling) {
+		if (child->function->builtin == builtin
+		&& !strcmp(child->function->name, name))
+			return child;
+	}
+	child = (struct context_node *) calloc(1, sizeof(struct context_node));
+	child->function = find_function(p, name, builtin);
+	child->parent = parent;
+	child->next_sibling = parent->first_child;
+	parent->first_child = child;
+	return child;
+}
+
+void profile_enter(char *name, int builtin)
+{
+	struct profiler *p = current_profiler();
+	struct context_node *parent = p->stack_depth > 0
+		? p->stack[p->stack_depth - 1].node : &p->root;
+	struct context_node *node = find_child(p, parent, name, builtin);
+
+	if (p->stack_depth == p->stack_size) {
+		p->stack_size = p->stack_size == 0 ? 64 : 2 * p->stack_size;
+		p->stack = (struct frame *) realloc(p->stack,
+			p->stack_size * sizeof(struct frame));
+	}
+	node->function->calls++;
+	node->function->active++;
+	p->stack[p->stack_depth].node = node;
+	p->stack[p->stack_depth].children_ns = 0;
+	p->stack_depth++;
+	// Read the clock last, so that bookkeeping isn't charged to the call.
+	p->stack[p->stack_depth - 1].start_ns = now_ns();
+}
+
+void profile_exit(void)
+{
+	long long end = now_ns();
+	struct profiler *p = current_profiler();
+
+	if (p->stack_depth == 0)
+		return;
+
+	struct frame *frame = &p->stack[--p->stack_depth];
+	struct function_record *function = frame->node->function;
+	long long elapsed = end - frame->start_ns;
+	long long self = elapsed - frame->children_ns;
+
+	frame->node->self_ns += self;
+	function->self_ns += self;
+	if (--function->active == 0)
+		function->inclusive_ns += elapsed;
+	if (p->stack_depth > 0)
+		p->stack[p->stack_depth - 1].children_ns += elapsed;
+}
+
+static int by_self_time(const void *a, const void *b)
+{
+	struct function_record *fa = *(struct function_record **) a;
+	struct function_record *fb = *(struct function_record **) b;
+
+	if (fa->self_ns != fb->self_ns)
+		return fa->self_ns < fb->self_ns ? 1 : -1;
+	return strcmp(fa->name, fb->name);
+}
+
+void profile_report(FILE *out)
+{
+	struct profiler *p = current_profiler();
+	struct function_record *function;
+	struct function_record **sorted;
+	int count = 0;
+	int i;
+
+	for (function = p->functions; function != NULL;
+	function = function->next)
+		count++;
+	sorted = (struct function_record **)
+		malloc(count * sizeof(struct function_record *));
+	count = 0;
+	for (function = p->functions; function != NULL;
+	function = function->next)
+		sorted[count++] = function;
+	qsort(sorted, count, sizeof(struct function_record *), by_self_time);
+
+	fprintf(out, "%10s %12s %12s  %s\n",
+		"calls", "self ms", "total ms", "function");
+	for (i = 0; i < count; i++) {
+		fprintf(out, "%10ld %12.3f %12.3f  %s%s\n",
+			sorted[i]->calls,
+			sorted[i]->self_ns / 1e6,
+			sorted[i]->inclusive_ns / 1e6,
+			sorted[i]->name,
+			sorted[i]->builtin ? " (builtin)" : "");
+	}
+	free(sorted);
+}
+
+// Prints the names from the outermost call down to `node`, separated by ';'.
+static void write_stack(FILE *out, struct context_node *node)
+{
+	if (node->parent->parent != NULL) {
+		write_stack(out, node->parent);
+		fputc(';', out);
+	}
+	fputs(node->function->name, out);
+}
+
+static void write_folded(FILE *out, struct context_node *node)
+{
+	struct context_node *child;
+
+	// The root has no parent and no time of its own.
+	if (node->parent != NULL && node->self_ns / 1000 > 0) {
+		write_stack(out, node);
+		fprintf(out, " %lld\n", node->self_ns / 1000);
+	}
+	for (child = node->first_child; child != NULL;
+	child = child->next_sibling)
+		write_folded(out, child);
+}
+
+void profile_write_folded(FILE *out)
+{
+	write_folded(out, &current_profiler()->root);
+}
+
+void free_profile(void)
+{
+	struct profiler *p = interp->profiler;
+
+	if (p == NULL)
+		return;
+	free_functions(p);
+	free_context(&p->root);
+	free(p->stack);
+	free(p);
+	interp->profiler = NULL;
+	interp->profiling = 0;
+}
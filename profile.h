@@ -0,0 +1,66 @@
+/**
+ * profile.h - Per-function call profiler
+ *
+ * The evaluator reports each call to a lambda or builtin with profile_enter()
+ * and profile_exit() while the `profiling` flag of the current interpreter is
+ * set (see interpreter.h). The profiler attributes call counts, self time and
+ * inclusive time to each function, and keeps a tree of calling contexts from
+ * which folded stacks (the input format of flamegraph tools) are written.
+ *
+ * Callers check `profiling` before calling profile_enter(), so that a disabled
+ * profiler costs a single branch per call. Each interpreter has its own
+ * profile.
+ *
+ * Functions are identified by name, so all anonymous lambdas share one entry.
+ */
+#ifndef PROFILE
+#define PROFILE
+#include <stdio.h>
+
+/**
+ * profile_start() - Discards any previous profile and starts recording
+ */
+void profile_start(void);
+
+/**
+ * profile_stop() - Stops recording
+ *
+ * Calls still in progress are closed as of now; their later profile_exit()
+ * calls are ignored.
+ */
+void profile_stop(void);
+
+/**
+ * profile_enter() - Records the start of a call
+ * @name - the name of the function
+ * @builtin - 1 for builtins and 0 for lambdas
+ */
+void profile_enter(char *name, int builtin);
+
+/**
+ * profile_exit() - Records the end of the most recent call
+ */
+void profile_exit(void);
+
+/**
+ * profile_report() - Prints calls, self and inclusive time per function
+ * @out - where to print
+ *
+ * Functions are sorted by self time, highest first.
+ */
+void profile_report(FILE *out);
+
+/**
+ * free_profile() - Stops recording and frees the current profile
+ */
+void free_profile(void);
+
+/**
+ * profile_write_folded() - Writes one line per call stack with its self time
+ * @out - where to write
+ *
+ * Each line has the form "outer;inner;innermost <microseconds>".
+ */
+void profile_write_folded(FILE *out);
+
+#endif
@@ -1,37 +1,371 @@
-#define TOKEN_SIZE 20
-
 /**
  * shell.c - The interactive shell
+ *
+ * Usage: scheme [options] [FILE]
+ *
+ * With FILE, the expressions in FILE are evaluated in order without printing
+ * their values, and the first error ends the program with status 1. Without
+ * FILE, expressions are read from stdin with a prompt and their values are
+ * printed. Either way, the program exits at the end of the input.
+ *
+ * Options:
+ *   --profile              profile every call and print a report on exit
+ *   --profile-folded FILE  also write folded stacks to FILE on exit
+ *   --stats                print allocation counts and peak memory on exit
+ *   --threads N            use N threads for pmap and future
+ *   --engine NAME          evaluate with the "tree" walker (the default) or by
+ *                          compiling forms to "closure" trees first
+ *   --no-jit               never compile lambdas to machine code
+ *   --jit-threshold N      compile a lambda to machine code after N calls
+ *   --perf-map             list compiled code in /tmp/perf-PID.map for perf
+ *   --image FILE           start with the bindings saved in FILE
+ *   --dump-image FILE      save the bindings to FILE at the end of the input
+ *   --cache                cache the parsed forms of FILE in the default
+ *                          directory
+ *   --cache-dir DIR        cache the parsed forms of FILE in DIR
+ *   --no-cache             always parse FILE, even if $SCHEME_CACHE_DIR is set
+ *   --parallel-read        parse FILE on several threads while it runs
+ *   --print-length N       print at most N items of each list, then "..."
+ *   --print-depth N        print lists nested at most N deep, then "..."
+ *   --compile FILE -o OUT  write FILE compiled to C to OUT (see aot.h)
+ *
+ * With --cache or --cache-dir, or with $SCHEME_CACHE_DIR set, a script whose
+ * source has not changed since it last ran to the end is not parsed again
+ * (see form_cache.h). Without --cache-dir, the directory is taken from the
+ * environment.
  */
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include "environment.h"
+#include <sys/resource.h>
 #include "parser.h"
-#include "evaluator.h"
+#include "interpreter.h"
+#include "pool.h"
+#include "image.h"
+#include "form_cache.h"
+#include "parallel_reader.h"
+#include "printer.h"
+#include "jit.h"
+#include "aot.h"
+
+static char *folded_path;
+// The interpreter the reports at exit are about
+static struct interpreter *main_interpreter;
+// The forms read so far, saved to the form cache at the end
+static struct s_expr **parsed;
+static size_t parsed_count;
+static size_t parsed_capacity;
+
+static void report_profile(void)
+{
+	FILE *out = NULL;
+
+	interpreter_set_profiling(main_interpreter, 0);
+	if (folded_path != NULL) {
+		out = fopen(folded_path, "w");
+		if (out == NULL)
+			fprintf(stderr, "Cannot write %s\n", folded_path);
+	}
+	interpreter_profile_report(main_interpreter, stderr, out);
+	if (out != NULL)
+		fclose(out);
+}
+
+static void report_stats(void)
+{
+	struct rusage usage;
+
+	interpreter_heap_report(main_interpreter, stderr);
+	getrusage(RUSAGE_SELF, &usage);
+	fprintf(stderr, "peak rss kb: %ld\n", usage.ru_maxrss);
+}
+
+static void keep_form(struct s_expr *form)
+{
+	if (parsed_count == parsed_capacity) {
+		parsed_capacity = parsed_capacity > 0 ? 2 * parsed_capacity : 64;
+		parsed = (struct s_expr **) realloc(parsed,
+			parsed_capacity * sizeof(struct s_expr *));
+		if (parsed == NULL) {
+			printf("Out of memory, cannot cache the forms.\n");
+			exit(1);
+		}
+	}
+	parsed[parsed_count++] = form;
+}
+
+static void fail_image(struct interpreter *in, char *path)
+{
+	char error[128];
+
+	interpreter_error(in, error, 128);
+	fprintf(stderr, "%s: %s\n", path, error);
+	exit(1);
+}
+
+static char *read_script(char *path, size_t *length)
+{
+	FILE *script = fopen(path, "r");
+	size_t capacity = 4096;
+	char *source = (char *) malloc(capacity);
+	size_t n;
+
+	if (script == NULL) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		exit(1);
+	}
+	*length = 0;
+	while (source != NULL
+	&& (n = fread(source + *length, 1, capacity - *length, script)) > 0) {
+		*length += n;
+		if (*length == capacity) {
+			capacity *= 2;
+			source = (char *) realloc(source, capacity);
+		}
+	}
+	if (source == NULL) {
+		printf("Out of memory, cannot read %s.\n", path);
+		exit(1);
+	}
+	fclose(script);
+	return source;
+}
 
-main(void)
+static int compile(char *path, char *output_path)
 {
-	printf("A parser for a subset of Scheme. Type any Scheme");
-	printf(" expression and its\n");
-	printf("\"parse tree\" will be printed out. Type Ctrl-C to quit.\n");
+	size_t length;
+	char *source = read_script(path, &length);
+	FILE *out = fopen(output_path, "w");
+	struct interpreter *in = interpreter_create();
+	char error[128];
 
-	start_environment();
-	start_parser(TOKEN_SIZE);
-	start_evaluator();
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", output_path);
+		return 1;
+	}
+	if (!aot_compile(in, path, source, length, out)
+	&& interpreter_read_failed(in)) {
+		interpreter_error(in, error, 128);
+		fprintf(stderr, "%s: %s\n", path, error);
+		return 1;
+	}
+	if (ferror(out) || fclose(out) != 0) {
+		fprintf(stderr, "Cannot write %s\n", output_path);
+		return 1;
+	}
+	free(source);
+	return 0;
+}
+
+static void usage(char *program)
+{
+	fprintf(stderr, "Usage: %s [--profile] [--profile-folded FILE]",
+		program);
+	fprintf(stderr, " [--stats] [--threads N] [--engine tree|closure]");
+	fprintf(stderr, " [--no-jit] [--jit-threshold N] [--perf-map]");
+	fprintf(stderr, " [--no-fold]");
+	fprintf(stderr, " [--image FILE]");
+	fprintf(stderr, " [--dump-image FILE] [--cache] [--cache-dir DIR]");
+	fprintf(stderr, " [--no-cache]");
+	fprintf(stderr, " [--parallel-read] [--print-length N]");
+	fprintf(stderr, " [--print-depth N] [FILE]\n");
+	fprintf(stderr, "       %s --compile FILE -o OUT\n", program);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int profile = 0;
+	int stats = 0;
+	char *script_path = NULL;
+	char *image_path = NULL;
+	char *dump_path = NULL;
+	char *cache_dir = NULL;
+	char *compile_path = NULL;
+	char *output_path = NULL;
+	int use_cache = getenv("SCHEME_CACHE_DIR") != NULL;
+	int no_cache = 0;
+	int parallel = 0;
+	enum eval_engine engine = ENGINE_TREE;
+	int jit_threshold = JIT_DEFAULT_THRESHOLD;
+	int folding = 1;
+	char *script = NULL;
+	size_t script_length = 0;
+	char *cache_entry = NULL;
+	struct s_expr *cached = NULL;
+	struct parallel_reader *reader = NULL;
+	struct printer printer;
+	struct interpreter *in;
+	int i;
+
+	printer_to_stream(&printer, stdout);
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--profile")) {
+			profile = 1;
+		} else if (!strcmp(argv[i], "--profile-folded")
+		&& i + 1 < argc) {
+			profile = 1;
+			folded_path = argv[++i];
+		} else if (!strcmp(argv[i], "--stats")) {
+			stats = 1;
+		} else if (!strcmp(argv[i], "--threads") && i + 1 < argc
+		&& atoi(argv[i + 1]) > 0) {
+			pool_set_threads(atoi(argv[++i]));
+		} else if (!strcmp(argv[i], "--engine") && i + 1 < argc
+		&& !strcmp(argv[i + 1], "tree")) {
+			engine = ENGINE_TREE;
+			i++;
+		} else if (!strcmp(argv[i], "--engine") && i + 1 < argc
+		&& !strcmp(argv[i + 1], "closure")) {
+			engine = ENGINE_CLOSURE;
+			i++;
+		} else if (!strcmp(argv[i], "--no-jit")) {
+			jit_threshold = 0;
+		} else if (!strcmp(argv[i], "--jit-threshold") && i + 1 < argc
+		&& atoi(argv[i + 1]) > 0) {
+			jit_threshold = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--no-fold")) {
+			folding = 0;
+		} else if (!strcmp(argv[i], "--perf-map")) {
+			jit_set_perf_map(1);
+		} else if (!strcmp(argv[i], "--image") && i + 1 < argc) {
+			image_path = argv[++i];
+		} else if (!strcmp(argv[i], "--dump-image") && i + 1 < argc) {
+			dump_path = argv[++i];
+		} else if (!strcmp(argv[i], "--cache")) {
+			use_cache = 1;
+		} else if (!strcmp(argv[i], "--cache-dir") && i + 1 < argc) {
+			cache_dir = argv[++i];
+		} else if (!strcmp(argv[i], "--no-cache")) {
+			no_cache = 1;
+		} else if (!strcmp(argv[i], "--parallel-read")) {
+			parallel = 1;
+		} else if (!strcmp(argv[i], "--print-length") && i + 1 < argc
+		&& atoi(argv[i + 1]) > 0) {
+			printer.max_length = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--print-depth") && i + 1 < argc
+		&& atoi(argv[i + 1]) > 0) {
+			printer.max_depth = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--compile") && i + 1 < argc) {
+			compile_path = argv[++i];
+		} else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+			output_path = argv[++i];
+		} else if (argv[i][0] != '-' && script_path == NULL) {
+			script_path = argv[i];
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if ((compile_path == NULL) != (output_path == NULL)
+	|| (compile_path != NULL && script_path != NULL))
+		usage(argv[0]);
+	if (compile_path != NULL)
+		return compile(compile_path, output_path);
+	if (script_path != NULL) {
+		script = read_script(script_path, &script_length);
+		if (use_cache && cache_dir == NULL)
+			cache_dir = form_cache_default_dir();
+		if (!no_cache && cache_dir != NULL)
+			cache_entry = form_cache_entry(cache_dir, script,
+				script_length);
+	}
+
+	in = interpreter_create();
+	interpreter_set_engine(in, engine);
+	interpreter_set_jit(in, jit_threshold);
+	interpreter_set_folding(in, folding);
+	main_interpreter = in;
+	if (image_path != NULL && !image_load(in, image_path))
+		fail_image(in, image_path);
+	if (script == NULL) {
+		printf("A parser for a subset of Scheme. Type any Scheme");
+		printf(" expression and its\n");
+		printf("\"parse tree\" will be printed out.");
+		printf(" Type Ctrl-D to quit.\n");
+	}
+	if (cache_entry != NULL)
+		cached = form_cache_load(in, cache_entry, script,
+			script_length);
+	if (script != NULL && cached == NULL && parallel) {
+		reader = parallel_reader_open(in, script, script_length);
+	} else if (script != NULL && cached == NULL
+	&& !interpreter_set_buffer(in, script, script_length)) {
+		fprintf(stderr, "Cannot read %s\n", script_path);
+		return 1;
+	}
+	if (stats)
+		atexit(report_stats);
+	if (profile) {
+		atexit(report_profile);
+		interpreter_set_profiling(in, 1);
+	}
 
 	while (1) {
-		printf("scheme> ");
-		struct s_expr *input = get_expression();
-		struct s_expr *result = eval_expression(input);
-		if (result == NULL) {
-			char error[128];
-			get_eval_error(error, 128);
-			fprintf(stderr, error);
-			fprintf(stderr, "\n");
+		if (script == NULL)
+			printf("scheme> ");
+		struct s_expr *input;
+		char error[128];
+
+		if (cached != NULL) {
+			if (is_empty_list(cached))
+				break;
+			input = cached->value->cell->first;
+			cached = cached->value->cell->rest;
+		} else if (reader != NULL) {
+			input = parallel_reader_next(reader);
+			if (input == NULL && parallel_reader_error(reader)) {
+				fprintf(stderr, "%s: %s\n", script_path,
+					parallel_reader_error(reader));
+				exit(1);
+			}
+			if (input == NULL)
+				break;
+			if (cache_entry != NULL)
+				keep_form(input);
 		} else {
-			print_expression(result);
+			input = interpreter_read(in);
+			if (input == NULL && interpreter_read_failed(in)) {
+				interpreter_error(in, error, 128);
+				if (script != NULL) {
+					fprintf(stderr, "%s: %s\n",
+						script_path, error);
+					exit(1);
+				}
+				fprintf(stderr, "%s\n", error);
+				// Go on reading from the next line.
+				interpreter_set_input(in, stdin);
+				continue;
+			}
+			if (input == NULL)
+				break;
+			if (cache_entry != NULL)
+				keep_form(input);
+		}
+		struct s_expr *result = interpreter_eval(in, input);
+		if (result == NULL) {
+			interpreter_error(in, error, 128);
+			if (script != NULL) {
+				fprintf(stderr, "%s: %s\n", script_path, error);
+				exit(1);
+			}
+			fprintf(stderr, "%s\n", error);
+		} else if (script == NULL) {
+			printer_write(&printer, result);
+			printer_append(&printer, "\n", 1);
+			// Keep the value ahead of the next prompt.
+			printer_flush(&printer);
 		}
 	}
-	free_parser();
+	if (script == NULL)
+		printf("\n");
+	printer_free(&printer);
+	if (reader != NULL)
+		parallel_reader_close(reader);
+	// After a hit, cached is the empty list rather than NULL.
+	if (cache_entry != NULL && cached == NULL)
+		form_cache_store(in, cache_entry, script, script_length,
+			parsed, parsed_count);
+	if (dump_path != NULL && !image_dump(in, dump_path))
+		fail_image(in, dump_path);
+	return 0;
 }
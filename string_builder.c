@@ -0,0 +1,58 @@
+/**
+ * string_builder.c - See header file for more information.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "parser.h"
+#include "string_builder.h"
+
+#define INITIAL_CAPACITY 32
+
+struct string_builder *string_builder_create(void)
+{
+	struct string_builder *builder = (struct string_builder *)
+		malloc(sizeof(struct string_builder));
+
+	builder->chars = (char *) malloc(INITIAL_CAPACITY * sizeof(char));
+	builder->length = 0;
+	builder->capacity = INITIAL_CAPACITY;
+	pthread_mutex_init(&builder->lock, NULL);
+	return builder;
+}
+
+void string_builder_append(struct string_builder *builder, char *chars,
+	int length)
+{
+	pthread_mutex_lock(&builder->lock);
+	if (builder->length + length > builder->capacity) {
+		while (builder->length + length > builder->capacity)
+			builder->capacity *= 2;
+		builder->chars = (char *) realloc(builder->chars,
+			builder->capacity * sizeof(char));
+		if (builder->chars == NULL) {
+			printf("Out of memory, string too long.\n");
+			exit(1);
+		}
+	}
+	memcpy(builder->chars + builder->length, chars, length);
+	builder->length += length;
+	pthread_mutex_unlock(&builder->lock);
+}
+
+void string_builder_free(struct string_builder *builder)
+{
+	free(builder->chars);
+	pthread_mutex_destroy(&builder->lock);
+	free(builder);
+}
+
+struct s_expr *string_builder_to_string(struct string_builder *builder)
+{
+	struct s_expr *string;
+
+	pthread_mutex_lock(&builder->lock);
+	string = s_expr_from_string(builder->chars, builder->length);
+	pthread_mutex_unlock(&builder->lock);
+	return string;
+}
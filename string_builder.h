@@ -0,0 +1,56 @@
+/**
+ * string_builder.h - Mutable buffers for building strings
+ *
+ * Appending to a string builder copies only the appended characters, so
+ * building a string out of many pieces takes time linear in its final length,
+ * unlike repeated calls to string-append.
+ *
+ * Each operation holds the builder's lock, so futures and pmap calls that share
+ * a builder can append to it at the same time.
+ */
+#ifndef STR_BUILDER
+#define STR_BUILDER
+#include <stdlib.h>
+#include <pthread.h>
+#include "parser.h"
+
+struct string_builder {
+	char *chars;
+	int length;
+	int capacity;
+	pthread_mutex_t lock;
+};
+
+/**
+ * string_builder_create() - Allocates an empty string builder
+ */
+struct string_builder *string_builder_create(void);
+
+/**
+ * string_builder_append() - Adds characters to the end of the builder
+ * @builder
+ * @chars - the characters to add, which are copied
+ * @length - the number of characters
+ *
+ * The buffer doubles in size when it fills up, so appends take amortized
+ * constant time per character.
+ */
+void string_builder_append(struct string_builder *builder, char *chars,
+	int length);
+
+/**
+ * string_builder_free() - Frees a string builder and its buffer
+ * @builder
+ */
+void string_builder_free(struct string_builder *builder);
+
+/**
+ * string_builder_to_string() - Creates a string s-expression from the
+ * contents of the builder
+ * @builder
+ *
+ * The contents are copied, so later appends don't change the string.
+ */
+struct s_expr *string_builder_to_string(struct string_builder *builder);
+
+#endif
@@ -0,0 +1,60 @@
+; Actors: interpreters on their own threads that share nothing and talk by
+; sending copies of values.
+
+; Replies to each message (sender . value) with what handle returns.
+(define (serve handle)
+  (cond (else (reply handle (receive))
+              (serve handle))))
+(define (reply handle message)
+  (send (car message) (handle (cdr message))))
+(define (ask actor value)
+  (cond (else (send actor (cons (self) value))
+              (receive))))
+
+(define doubler (spawn (lambda () (serve (lambda (n) (* 2 n))))))
+(display (actor? doubler))
+(display (actor? (self)))
+(display (actor? 2))
+(newline)
+(display (ask doubler 21))
+(newline)
+
+; Messages from one sender arrive in the order they were sent.
+(define (send-all actor ls)
+  (for-each (lambda (n) (send actor (cons (self) n))) ls))
+(define (receive-all n)
+  (cond ((= n 0) (quote ()))
+        (else (cons (receive) (receive-all (- n 1))))))
+(send-all doubler (list 1 2 3 4 5))
+(display (receive-all 5))
+(newline)
+
+; The actor changes its copy of a table, not the one that was sent.
+(define filler
+  (spawn (lambda ()
+           (serve (lambda (table)
+                    (car (list table (hash-set! table (quote added) 1))))))))
+(define table (make-hash-table))
+(hash-set! table (quote sent) 0)
+(define copy (ask filler table))
+(display (hash-count table))
+(display (hash-count copy))
+(newline)
+
+; Values that refer to themselves are copied with the same shape.
+(define nested (make-hash-table))
+(hash-set! nested (quote self) nested)
+(define echo (spawn (lambda () (serve (lambda (value) value)))))
+(define returned (ask echo nested))
+(display (eq? (hash-ref returned (quote self)) returned))
+(display (eq? returned nested))
+(newline)
+
+; The actor has a copy of the bindings from when it was spawned.
+(define greeting "hello")
+(define greeter (spawn (lambda () (serve (lambda (name) (string-append greeting ", " name))))))
+(define greeting "bye")
+(display (ask greeter "ann"))
+(newline)
+
+(send echo (delay 1))
@@ -0,0 +1,20 @@
+; quotient, remainder and modulo on each combination of signs, and on the
+; one quotient that does not fit in an integer.
+
+(define (divide-all n d)
+  (list (quotient n d) (remainder n d) (modulo n d)))
+(display (divide-all 7 2))
+(newline)
+(display (divide-all -7 2))
+(newline)
+(display (divide-all 7 -2))
+(newline)
+(display (divide-all -7 -2))
+(newline)
+(display (divide-all -2147483648 2))
+(newline)
+(display (divide-all 2147483647 -1))
+(newline)
+
+; -2147483648 divided by -1 is 2147483648, one more than the largest integer.
+(display (quotient -2147483648 -1))
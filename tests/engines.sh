@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# engines.sh - Checks that the engines, and the JIT, give the same values
+#
+# Usage: tests/engines.sh [BENCHMARK.scm ...]
+#
+# Without arguments, the benchmarks are bench/*.scm and the error cases in
+# tests/engines/*.scm. Each is fed to the shell on stdin, so that the value of
+# every form is printed, once with each line of ENGINES. What each run writes
+# to stdout and stderr must be what the first line's run writes. Prints a diff
+# for each benchmark that differs, and exits with status 1 if any did.
+
+SCHEME=${SCHEME:-./scheme}
+ENGINES="--engine tree
+--engine closure
+--engine closure --no-jit
+--engine closure --jit-threshold 1"
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/../bench/*.scm \
+	"$(dirname "$0")"/engines/*.scm
+
+expected=$(mktemp)
+out=$(mktemp)
+err=$(mktemp)
+trap 'rm -f "$expected" "$out" "$err"' EXIT
+
+# run FILE FLAGS... - writes what the shell prints for FILE to $out
+run() {
+	file=$1
+	shift
+	"$SCHEME" --no-cache "$@" < "$file" > "$out" 2> "$err"
+	cat "$err" >> "$out"
+}
+
+failed=0
+for file in "$@"; do
+	first=
+	echo "$ENGINES" | {
+		while IFS= read -r flags; do
+			run "$file" $flags
+			if [ -z "$first" ]; then
+				first=$flags
+				cp "$out" "$expected"
+				continue
+			fi
+			if ! diff -u "$expected" "$out"; then
+				echo "FAIL: $file: $flags differs from $first" >&2
+				exit 1
+			fi
+		done
+	} || failed=1
+done
+[ $failed -eq 0 ] && echo "The engines agree."
+exit $failed
@@ -0,0 +1,35 @@
+; Errors inside arithmetic and the other builtins the engines and the JIT
+; compile calls to. Each lambda is called often enough to be compiled before
+; it is called with a value it can't use.
+
+(define (sum-cdr x) (+ 1 (cdr x)))
+(define (difference-cdr x) (- 1 (cdr x)))
+(define (negate-cdr x) (- (cdr x)))
+(define (product-cdr x) (* 2 (cdr x)))
+(define (below-cdr x) (< 1 (cdr x)))
+(define (both-cdr x) (and 1 (cdr x)))
+(define (either-cdr x) (or (cdr x) 1))
+(define (function-cdr x) (function? (cdr x)))
+
+(define (repeat f n)
+  (cond ((= n 0) (f (cons 1 2)))
+        (else (f (cons 1 2)) (repeat f (- n 1)))))
+(repeat sum-cdr 200)
+(repeat difference-cdr 200)
+(repeat negate-cdr 200)
+(repeat product-cdr 200)
+(repeat below-cdr 200)
+(repeat both-cdr 200)
+(repeat either-cdr 200)
+(repeat function-cdr 200)
+
+(sum-cdr 5)
+(difference-cdr 5)
+(negate-cdr 5)
+(product-cdr 5)
+(below-cdr 5)
+(both-cdr 5)
+(either-cdr 5)
+(function-cdr 5)
+(+ 1 (cdr 5))
+(sum-cdr (cons 1 2))
@@ -0,0 +1,34 @@
+; Folding constant subexpressions must not change what a script does, even
+; when the names a fold relied on are bound again later.
+
+(define (seconds-per-day) (* 24 (* 60 60)))
+(define (sum) (+ 1 (+ 2 3)))
+(define (both) (list (sum) (- 10 (* 2 3))))
+(display (seconds-per-day))
+(newline)
+(display (both))
+(newline)
+
+; A parameter named like a builtin hides it in the body.
+(define (with-op + a) (+ a (+ 2 3)))
+(display (with-op * 4))
+(newline)
+
+; Redefining a name undoes the folds that relied on it.
+(define * +)
+(display (seconds-per-day))
+(newline)
+(display (both))
+(newline)
+
+; So does (define + -), after which forms use the new binding.
+(define + -)
+(display (sum))
+(newline)
+(display (+ 10 (+ 2 1)))
+(newline)
+(define (later) (+ 100 (+ 20 3)))
+(display (later))
+(newline)
+(display (both))
+(newline)
@@ -0,0 +1,56 @@
+; Generators, which suspend at each yield until their next value is asked
+; for.
+
+(define (count-up i n)
+  (cond ((> i n) (quote done))
+        (else (yield i) (count-up (+ i 1) n))))
+(define gen (make-generator (lambda () (count-up 1 3))))
+(display (generator? gen))
+(display (generator? (list 1)))
+(newline)
+(display (generator-next gen))
+(display (generator-next gen))
+(newline)
+(display (generator-done? gen))
+(display (generator-next gen))
+(display (generator-done? gen))
+(newline)
+
+; The thunk runs only when a value is first asked for, and only up to the
+; next yield.
+(define trace (make-string-builder))
+(define (noisy)
+  (cond (else (string-builder-append! trace "a")
+              (yield 1)
+              (string-builder-append! trace "b")
+              (yield 2)
+              (string-builder-append! trace "c"))))
+(define lazy (make-generator noisy))
+(display (string-builder->string trace))
+(display (generator-next lazy))
+(display (string-builder->string trace))
+(newline)
+
+; Pipelines, with no lists between the stages.
+(display (generator-fold + 0 (generator-map (lambda (x) (* x x)) (list->generator (list 1 2 3)))))
+(newline)
+(display (generator-fold cons (quote ()) (list->generator (list 1 2 3))))
+(newline)
+(display (generator-done? (list->generator (quote ()))))
+(newline)
+
+; Generators nest: each yield goes to the innermost one being run.
+(define (outer)
+  (cond (else (yield (generator-fold + 0 (make-generator (lambda () (count-up 1 4)))))
+              (yield (quote last)))))
+(define nesting (make-generator outer))
+(display (generator-next nesting))
+(display (generator-next nesting))
+(newline)
+
+; Deep recursion inside a generator.
+(define deep (make-generator (lambda () (count-up 1 500))))
+(display (generator-fold + 0 deep))
+(newline)
+
+(generator-next gen)
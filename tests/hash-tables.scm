@@ -0,0 +1,61 @@
+; Hash tables, keyed by equal? or by eq?.
+
+; equal? tables match keys by structure.
+(define ages (make-hash-table))
+(hash-set! ages "ann" 31)
+(hash-set! ages (list 1 2) (quote pair))
+(hash-set! ages (quote bob) 27)
+(display (hash-ref ages "ann"))
+(newline)
+(display (hash-ref ages (list 1 2)))
+(newline)
+(display (hash-count ages))
+(newline)
+
+; Setting a key again replaces its value, and removing it twice is harmless.
+(hash-set! ages (quote bob) 28)
+(display (hash-ref ages (quote bob)))
+(newline)
+(hash-remove! ages "ann")
+(hash-remove! ages "ann")
+(display (hash-count ages))
+(newline)
+(display (assoc (quote bob) (hash->list ages)))
+(newline)
+
+; The default is only evaluated when the key is missing.
+(display (hash-ref ages (quote bob) (car (quote ()))))
+(newline)
+(display (hash-ref ages (quote carol) (quote none)))
+(newline)
+
+; eq? tables match lists only when they are the same list.
+(define key (list 1 2))
+(define seen (make-hash-table eq?))
+(hash-set! seen key (quote same))
+(display (hash-ref seen key))
+(newline)
+(display (hash-ref seen (list 1 2) (quote different)))
+(newline)
+(display (hash-table? seen))
+(newline)
+(display (hash-table? key))
+(newline)
+
+; Enough keys to make the table grow while it is being used.
+(define fill
+  (lambda (table from to)
+    (cond ((> from to) table)
+          (else (fill (car (list table (hash-set! table from (* 2 from))))
+                      (+ from 1) to)))))
+(define numbers (fill (make-hash-table) 1 2000))
+(display (hash-count numbers))
+(newline)
+(display (hash-ref numbers 1999))
+(newline)
+(display (fold + 0 (hash-values numbers)))
+(newline)
+(display (fold + 0 (hash-keys numbers)))
+(newline)
+
+(hash-ref ages (quote carol))
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# heap.sh - Checks that loops give back the environment they allocate
+#
+# Usage: tests/heap.sh [WORKLOAD.scm ...]
+#
+# Each workload in tests/heap/ loops `n` times, and is run with `scheme --stats`
+# after a line defining n: first with n = 0 for the baseline, then with each of
+# ITERATIONS. The live counts and live bytes of definitions, fn-arguments and
+# env-state in the heap report must be the baseline's every time, under each
+# line of FLAGS. Prints what differs, and exits with status 1 if anything did.
+
+SCHEME=${SCHEME:-./scheme}
+ITERATIONS="1 300"
+FLAGS="
+--no-fold
+--engine closure
+--engine closure --no-jit
+--engine closure --jit-threshold 1"
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/heap/*.scm
+
+script=$(mktemp)
+trap 'rm -f "$script"' EXIT
+
+# census N FILE FLAGS... - runs FILE with n = N and prints the live counts
+census() {
+	n=$1
+	file=$2
+	shift 2
+	{ echo "(define n $n)"; cat "$file"; } > "$script"
+	"$SCHEME" --no-cache --stats "$@" "$script" 2>&1 > /dev/null |
+		awk '$1 == "definition" || $1 == "fn-arguments" \
+			|| $1 == "env-state" { print $1, $4, $5 }'
+}
+
+failed=0
+for file in "$@"; do
+	echo "$FLAGS" | while IFS= read -r flags; do
+		baseline=$(census 0 "$file" $flags)
+		if [ -z "$baseline" ]; then
+			echo "FAIL: $file ${flags:-(no flags)}: no heap report" >&2
+			exit 1
+		fi
+		for n in $ITERATIONS; do
+			live=$(census "$n" "$file" $flags)
+			[ "$live" = "$baseline" ] && continue
+			echo "FAIL: $file ${flags:-(no flags)}, n = $n" >&2
+			echo "baseline:" >&2
+			echo "$baseline" >&2
+			echo "after the loop:" >&2
+			echo "$live" >&2
+			exit 1
+		done
+	done || failed=1
+done
+[ $failed -eq 0 ] && echo "The heap census returned to its baseline."
+exit $failed
@@ -0,0 +1,14 @@
+; Lambdas called by builtins, and builtins called through apply.
+(define items (list 1 2 3 4 5 6 7 8))
+
+(define (step)
+  (fold (lambda (x acc) (+ x acc)) 0
+        (map (lambda (x) (* x x))
+             (filter (lambda (x) (< x 5)) items)))
+  (apply + items))
+
+(define (repeat i)
+  (cond ((= i 0) 0)
+        (else (step) (repeat (- i 1)))))
+
+(repeat n)
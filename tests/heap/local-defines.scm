@@ -0,0 +1,11 @@
+; Bodies with defines of their own, which die with the call.
+(define (area w h)
+  (define width w)
+  (define height h)
+  (* width height))
+
+(define (repeat i)
+  (cond ((= i 0) 0)
+        (else (area i 2) (repeat (- i 1)))))
+
+(repeat n)
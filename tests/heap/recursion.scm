@@ -0,0 +1,10 @@
+; Calls that return through every frame.
+(define (fib k)
+  (cond ((< k 2) k)
+        (else (+ (fib (- k 1)) (fib (- k 2))))))
+
+(define (repeat i)
+  (cond ((= i 0) 0)
+        (else (fib 8) (repeat (- i 1)))))
+
+(repeat n)
@@ -0,0 +1,10 @@
+; A loop of tail calls, which rebind their parameters in place.
+(define (count-down i acc)
+  (cond ((= i 0) acc)
+        (else (count-down (- i 1) (+ acc 1)))))
+
+(define (repeat i)
+  (cond ((= i 0) 0)
+        (else (count-down 50 0) (repeat (- i 1)))))
+
+(repeat n)
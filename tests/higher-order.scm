@@ -0,0 +1,39 @@
+; map, for-each, filter, fold and apply, with builtins and lambdas.
+
+(display (map car (list (list 1 2) (list 3 4))))
+(newline)
+(display (map (lambda (x) (* x x)) (list 1 2 3)))
+(newline)
+
+; With several lists, they stop at the end of the shortest one.
+(display (map + (list 1 2 3) (list 10 20) (list 100 200 300)))
+(newline)
+(display (map + (quote ())))
+(newline)
+
+; for-each calls in order, for the side effects.
+(for-each (lambda (x y) (display (list x y))) (list 1 2) (list (quote a) (quote b)))
+(newline)
+
+(display (filter (lambda (x) (> x 2)) (list 1 5 2 4 3)))
+(newline)
+(display (filter (lambda (x) (> x 9)) (list 1 5 2)))
+(newline)
+
+; fold passes the accumulator last and goes from left to right.
+(display (fold cons (quote ()) (list 1 2 3)))
+(newline)
+(display (fold (lambda (x y acc) (+ acc (* x y))) 0 (list 1 2 3) (list 4 5 6)))
+(newline)
+(display (fold + 0 (quote ())))
+(newline)
+
+(display (apply + (list 1 2 3)))
+(newline)
+(display (apply list 1 2 (list 3 4)))
+(newline)
+(display (apply (lambda (a b) (- a b)) (list 10 3)))
+(newline)
+
+; Every argument after the function must be a list.
+(map car (list 1) 2)
@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# image.sh - Checks that an image gives back the bindings it was made from
+#
+# Usage: tests/image.sh
+#
+# Saves the bindings of image/save.scm with `scheme --dump-image`, then runs
+# image/use.scm with that image loaded, which must write image/use.out. An
+# image with a changed byte, a cut-off image and a file that is not an image
+# must each be refused with an io error, and saving image/promise.scm must be
+# a type error. Runs once with each line of FLAGS. Prints what differs, and
+# exits with status 1 if anything did.
+
+SCHEME=${SCHEME:-./scheme}
+FLAGS="
+--no-fold
+--engine closure
+--engine closure --no-jit
+--engine closure --jit-threshold 1
+--parallel-read"
+dir=$(dirname "$0")/image
+
+image=$(mktemp)
+damaged=$(mktemp)
+out=$(mktemp)
+trap 'rm -f "$image" "$damaged" "$out"' EXIT
+
+# fails MESSAGE COMMAND... - checks that COMMAND fails, writing only MESSAGE
+fails() {
+	message=$1
+	shift
+	if "$@" > "$out" 2>&1 || [ "$(cat "$out")" != "$message" ]; then
+		echo "FAIL: $*" >&2
+		echo "expected: $message" >&2
+		echo "got:" >&2
+		cat "$out" >&2
+		return 1
+	fi
+}
+
+echo "$FLAGS" | while IFS= read -r flags; do
+	if ! "$SCHEME" --no-cache $flags --dump-image "$image" "$dir/save.scm" \
+	|| ! "$SCHEME" --no-cache $flags --image "$image" "$dir/use.scm" \
+	> "$out" 2>&1 || ! diff -u "$dir/use.out" "$out"; then
+		echo "FAIL: $dir/use.scm ${flags:-(no flags)}" >&2
+		exit 1
+	fi
+
+	cp "$image" "$damaged"
+	size=$(wc -c < "$image")
+	printf '\377' | dd of="$damaged" bs=1 seek=$((size - 100)) \
+		conv=notrunc 2> /dev/null
+	fails "$damaged: image - io error (checksum mismatch)" \
+		"$SCHEME" --no-cache $flags --image "$damaged" "$dir/use.scm" \
+		|| exit 1
+	head -c 40 "$image" > "$damaged"
+	fails "$damaged: image - io error (not an image of this format)" \
+		"$SCHEME" --no-cache $flags --image "$damaged" "$dir/use.scm" \
+		|| exit 1
+	fails "$dir/use.scm: image - io error (not an image of this format)" \
+		"$SCHEME" --no-cache $flags --image "$dir/use.scm" \
+		"$dir/use.scm" || exit 1
+	fails "$damaged: image - type error (cannot save a promise)" \
+		"$SCHEME" --no-cache $flags --dump-image "$damaged" \
+		"$dir/promise.scm" || exit 1
+done || exit 1
+echo "The images load back."
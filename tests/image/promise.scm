@@ -0,0 +1,3 @@
+; A promise cannot be saved, so image.sh dumping this fails.
+
+(define later (delay 1))
@@ -0,0 +1,28 @@
+; The bindings that image.sh saves to an image, for use.scm to use.
+
+(define greeting "hello")
+(define numbers (list 1 2 3))
+(define (square x) (* x x))
+(define (count-down n)
+  (cond ((= n 0) (quote ()))
+        (else (cons n (count-down (- n 1))))))
+
+; Tables and builders are rebuilt when the image is loaded.
+(define table (make-hash-table))
+(hash-set! table (quote a) 1)
+(hash-set! table "b" (list 2 3))
+(hash-set! table (quote self) table)
+(define builder (make-string-builder))
+(string-builder-append! builder "saved")
+
+; Memo caches start empty.
+(define-memoized (fib n)
+  (cond ((< n 2) n)
+        (else (+ (fib (- n 1)) (fib (- n 2))))))
+(fib 20)
+
+(define-syntax swap
+  (syntax-rules ()
+    ((_ a b) (list b a))))
+
+(define plus +)
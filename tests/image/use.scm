@@ -0,0 +1,28 @@
+; Run by image.sh with the image of save.scm loaded.
+
+(display greeting)
+(newline)
+(display (map square numbers))
+(newline)
+(display (count-down 3))
+(newline)
+(display (hash-ref table (quote a)))
+(display (hash-ref table "b"))
+(display (eq? (hash-ref table (quote self)) table))
+(newline)
+
+; The rebuilt table and builder can still change.
+(hash-set! table (quote c) 4)
+(display (hash-count table))
+(string-builder-append! builder ", and loaded")
+(display (string-builder->string builder))
+(newline)
+
+(display (memo-stats fib))
+(newline)
+(display (fib 20))
+(newline)
+(display (swap 1 2))
+(newline)
+(display (plus 1 2))
+(newline)
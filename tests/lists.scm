@@ -0,0 +1,58 @@
+; The list library: append, length, reverse, list-tail, list-ref, last-pair
+; and list-copy.
+
+(define ls (list 1 2 3 4))
+(display (append))
+(newline)
+(display (append ls (list 5) (quote ()) (list 6 7)))
+(newline)
+
+; The last argument to append is its tail as it is, and need not be a list.
+(define tail (list 8 9))
+(display (eq? (list-tail (append ls tail) 4) tail))
+(newline)
+(display (append ls 5))
+(newline)
+
+(display (length ls))
+(newline)
+(display (length (quote ())))
+(newline)
+(display (reverse ls))
+(newline)
+(display (reverse (quote ())))
+(newline)
+(display (list-tail ls 0))
+(newline)
+(display (list-tail ls 4))
+(newline)
+(display (list-ref ls 2))
+(newline)
+(display (last-pair ls))
+(newline)
+(display (last-pair (append ls 5)))
+(newline)
+
+; list-copy makes new cells for the same elements.
+(define copy (list-copy ls))
+(display copy)
+(newline)
+(display (eq? copy ls))
+(newline)
+(display (equal? copy ls))
+(newline)
+
+; A longer list.
+(define build
+  (lambda (n acc)
+    (cond ((= n 0) acc)
+          (else (build (- n 1) (cons n acc))))))
+(define long (build 1000 (quote ())))
+(display (length (append long long)))
+(newline)
+(display (list-ref (reverse long) 0))
+(newline)
+(display (last-pair long))
+(newline)
+
+(list-ref ls 4)
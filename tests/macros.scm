@@ -0,0 +1,81 @@
+; Macros defined with define-syntax and syntax-rules.
+
+; Literals match only themselves, so the first rule needs the =>.
+(define-syntax arrow
+  (syntax-rules (=>)
+    ((_ a => b) (list (quote a) (quote to) (quote b)))
+    ((_ a b) (list (quote a) (quote and) (quote b)))))
+(display (arrow x => y))
+(newline)
+(display (arrow x y))
+(newline)
+
+; Pattern variables under two ellipses.
+(define-syntax table
+  (syntax-rules ()
+    ((_ (key value ...) ...) (list (list (quote key) (+ value ...)) ...))))
+(display (table (a 1 2) (b) (c 3 4 5)))
+(newline)
+
+; Macros whose expansions and arguments use other macros, and themselves.
+(define-syntax swap-args
+  (syntax-rules ()
+    ((_ f a b) (f b a))))
+(define-syntax twice
+  (syntax-rules ()
+    ((_ e) (list e e))))
+(define-syntax sum-of
+  (syntax-rules ()
+    ((_ e) e)
+    ((_ e rest ...) (+ e (sum-of rest ...)))))
+(display (twice (swap-args - 1 10)))
+(newline)
+(display (sum-of 1 2 3 (sum-of 4 5)))
+(newline)
+
+; The t the template binds is renamed, so it doesn't capture the user's t.
+(define t 5)
+(define-syntax first-true
+  (syntax-rules ()
+    ((_ a b) ((lambda (t) (cond (t t) (else b))) a))))
+(display (first-true #f t))
+(newline)
+(display (first-true 1 t))
+(newline)
+
+; A use in a lambda defined before its macro is expanded when it first runs,
+; and again once the macro is redefined.
+(define (use) (later 4))
+(define-syntax later
+  (syntax-rules ()
+    ((_ x) (+ x 1))))
+(display (use))
+(newline)
+(define-syntax later
+  (syntax-rules ()
+    ((_ x) (* x 10))))
+(display (use))
+(newline)
+
+; The tmp the template binds through another macro is renamed too, so the
+; user's tmp passed in as y still means the global one.
+(define-syntax my-let
+  (syntax-rules ()
+    ((_ ((name val)) body) ((lambda (name) body) val))))
+(define-syntax swap-sum
+  (syntax-rules ()
+    ((_ x y) (my-let ((tmp x)) (+ tmp y)))))
+(define tmp 10)
+(display (swap-sum 1 tmp))
+(newline)
+
+; A use expanded before the lambda it is in was defined is expanded again
+; once its macro is redefined.
+(define (squared) (my-let ((x 5)) (* x x)))
+(display (squared))
+(newline)
+(define-syntax my-let
+  (syntax-rules ()
+    ((_ ((name val)) body) (list (quote name) val))))
+(display (squared))
+(newline)
@@ -0,0 +1,45 @@
+; Memoized lambdas, from define-memoized and memoize.
+
+; Recursive calls go through the cache, so this takes linear time.
+(define-memoized (fib n)
+  (cond ((< n 2) n)
+        (else (+ (fib (- n 1)) (fib (- n 2))))))
+(display (fib 40))
+(newline)
+(display (memo-stats fib))
+(newline)
+(display (fib 40))
+(newline)
+(display (assoc (quote hits) (memo-stats fib)))
+(newline)
+
+; Arguments are compared with equal?.
+(define sum (memoize (lambda (ls) (fold + 0 ls)) 2))
+(display (sum (list 1 2 3)))
+(display (sum (list 1 2 3)))
+(newline)
+(display (memo-stats sum))
+(newline)
+
+; The least recently used result goes first once the cache is full.
+(sum (list 4))
+(sum (list 1 2 3))
+(sum (list 5))
+(display (memo-stats sum))
+(newline)
+(sum (list 1 2 3))
+(display (assoc (quote hits) (memo-stats sum)))
+(newline)
+
+; memo-clear! drops the results and resets the counters.
+(memo-clear! sum)
+(sum (list 1 2 3))
+(display (memo-stats sum))
+(newline)
+
+; memoize copies the lambda, leaving the original uncached.
+(define square (lambda (x) (* x x)))
+(define fast-square (memoize square))
+(display (fast-square 9))
+(newline)
+(memo-stats square)
@@ -0,0 +1,73 @@
+; pmap and future, with calls that share a hash table, a string builder and
+; promises.
+
+(define range
+  (lambda (from to)
+    (cond ((> from to) (quote ()))
+          (else (cons from (range (+ from 1) to))))))
+(define last
+  (lambda (values) (car (last-pair values))))
+(define numbers (range 1 400))
+
+; Each call adds to the table and the builder, and forces the same promise.
+(define squares (make-hash-table))
+(define marks (make-string-builder))
+(define answer (delay (* 6 7)))
+(define results
+  (pmap (lambda (n)
+          (last (list (hash-set! squares n (* n n))
+                      (string-builder-append! marks "x")
+                      (+ n (force answer)))))
+        numbers))
+(display (length results))
+(newline)
+(display (list-ref results 0))
+(newline)
+(display (list-ref results 399))
+(newline)
+(display (hash-count squares))
+(newline)
+(display (fold + 0 (hash-values squares)))
+(newline)
+(display (string-length (string-builder->string marks)))
+(newline)
+
+; Each call also forces the same stream, which no call has forced yet.
+(define count-from
+  (lambda (n) (cons-stream n (count-from (+ n 1)))))
+(define naturals (count-from 0))
+(display (fold + 0 (pmap (lambda (n) (fold + 0 (stream->list (stream-take naturals 10))))
+                         numbers)))
+(newline)
+
+; Some calls remove what others added.
+(define evens (make-hash-table))
+(define added
+  (pmap (lambda (n) (hash-set! evens n n)) numbers))
+(define removed
+  (pmap (lambda (n)
+          (cond ((= (remainder n 2) 1) (hash-remove! evens n))
+                (else n)))
+        numbers))
+(display (hash-count evens))
+(newline)
+
+; Futures share them too.
+(define add-marks
+  (lambda (n)
+    (future (lambda ()
+              (last (list (string-builder-append! marks "y")
+                          (hash-set! squares (+ n 1000) n)
+                          (force answer)))))))
+(define futures (map add-marks numbers))
+(display (fold + 0 (map (lambda (f) (touch f)) futures)))
+(newline)
+(display (hash-count squares))
+(newline)
+(display (string-length (string-builder->string marks)))
+(newline)
+
+; Defines in a call stay in that call.
+(define defines
+  (pmap (lambda (n) (define local n)) numbers))
+(display local)
@@ -0,0 +1,47 @@
+; Ports: writing a file, then reading it back by datum, line and character.
+
+(define path "/tmp/scheme-tests-ports.txt")
+
+(define out (open-output-file path))
+(display (port? out))
+(display (port? path))
+(newline)
+(write (list 1 "two" (quote three)) out)
+(newline out)
+(display "a line of text" out)
+(newline out)
+(display "xy" out)
+(close-port out)
+(close-port out)
+
+(define in (open-input-file path))
+(define datum (read in))
+(display (car (cdr datum)))
+(display (string? (car (cdr datum))))
+(newline)
+; read leaves the rest of the line, so read-line returns it empty.
+(display (string-length (read-line in)))
+(newline)
+(display (read-line in))
+(newline)
+(display (peek-char in))
+(display (read-char in))
+(display (read-char in))
+(newline)
+(display (eof-object? (read-char in)))
+(display (eof-object? (read-line in)))
+(display (eof-object? (read in)))
+(display (eof-object? (eof-object)))
+(newline)
+(close-port in)
+
+; with-output-to-file sends display and write without a port to the file.
+(display (with-output-to-file path (lambda () (car (list 42 (display "inside"))))))
+(newline)
+(define again (open-input-file path))
+(display (read-line again))
+(newline)
+(close-port again)
+
+; A closed port can't be used again.
+(read-line in)
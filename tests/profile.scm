@@ -0,0 +1,26 @@
+; The profiler. Its report and folded stacks hold times, which differ from
+; run to run, so this only checks that it runs and how it fails.
+
+(define f
+  (lambda (n)
+    (cond ((= n 0) 0)
+          (else (+ 1 (f (- n 1)))))))
+
+; Stopping a profiler that never started does nothing.
+(profile-stop)
+(profile-start)
+(display (f 10))
+(newline)
+(profile-stop)
+(display (profile-dump-folded "/dev/null"))
+(newline)
+
+; Starting again clears what the last run counted.
+(profile-start)
+(display (f 5))
+(newline)
+(profile-stop)
+(display (profile-dump-folded "/dev/null"))
+(newline)
+
+(profile-dump-folded "tests/no-such-directory/profile.folded")
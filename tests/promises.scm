@@ -0,0 +1,49 @@
+; Promises and the streams built on them.
+
+; A delayed expression runs once, when first forced.
+(define runs (make-string-builder))
+(define p (delay (car (list 42 (string-builder-append! runs "x")))))
+(display (promise? p))
+(display (promise? 42))
+(display (string-builder->string runs))
+(newline)
+(display (force p))
+(display (force p))
+(display (string-builder->string runs))
+(newline)
+
+; force passes other values through, and make-promise wraps them.
+(display (force 7))
+(display (force (make-promise 8)))
+(display (eq? (make-promise p) p))
+(newline)
+
+; A delayed expression sees the bindings from when it was delayed.
+(define x 1)
+(define later (delay (+ x 1)))
+(define x 10)
+(display (force later))
+(newline)
+
+; Forcing a long chain of delay-force takes constant stack.
+(define (loop n)
+  (cond ((= n 0) (make-promise (quote done)))
+        (else (delay-force (loop (- n 1))))))
+(display (force (loop 100000)))
+(newline)
+
+; Infinite streams, computed as far as they are used.
+(define (count-from n) (cons-stream n (count-from (+ n 1))))
+(define naturals (count-from 0))
+(display (stream-car (stream-cdr naturals)))
+(newline)
+(define (even? n) (= (remainder n 2) 0))
+(display (stream->list (stream-map (lambda (n) (* n n)) (stream-filter even? naturals)) 5))
+(newline)
+(display (stream->list (stream-take naturals 3)))
+(newline)
+(display (stream->list (stream-take (stream-filter even? (stream-take naturals 5)) 10)))
+(newline)
+
+; delay-force of something that is not a promise fails when forced.
+(force (delay-force 5))
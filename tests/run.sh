@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# run.sh - Runs the script tests and compares their output with what is
+# expected
+#
+# Usage: tests/run.sh [TEST.scm ...]
+#
+# Each test is a script, TEST.scm, run with `scheme TEST.scm` from the top of
+# the tree, so that paths in it are relative to there. What it writes to
+# stdout, followed by what it writes to stderr, must be TEST.out exactly. A
+# script ends at its first error, so a test of an error has it last.
+#
+# Each test is run once with each line of FLAGS below, and must give the same
+# output every time. Prints the tests that fail with a diff, and exits with
+# status 1 if any did.
+#
+# The thread pool gets four threads unless SCHEME_THREADS says otherwise, so
+# that pmap and future run in parallel even on one core.
+
+SCHEME=${SCHEME:-./scheme}
+export SCHEME_THREADS=${SCHEME_THREADS:-4}
+FLAGS="
+--no-fold
+--engine closure
+--engine closure --no-jit
+--engine closure --jit-threshold 1
+--parallel-read"
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/*.scm
+
+out=$(mktemp)
+err=$(mktemp)
+trap 'rm -f "$out" "$err"' EXIT
+
+failed=0
+for file in "$@"; do
+	expected=${file%.scm}.out
+	echo "$FLAGS" | while IFS= read -r flags; do
+		"$SCHEME" --no-cache $flags "$file" > "$out" 2> "$err"
+		cat "$err" >> "$out"
+		if ! diff -u "$expected" "$out"; then
+			echo "FAIL: $file ${flags:-(no flags)}" >&2
+			exit 1
+		fi
+	done || failed=1
+done
+[ $failed -eq 0 ] && echo "All tests passed."
+exit $failed
@@ -0,0 +1,5 @@
+; A ) with no ( before it is read as a symbol, which is not defined.
+(display "before")
+(newline)
+)
+(display "after")
@@ -0,0 +1,31 @@
+; String builders, which take any number of strings per append.
+
+(define out (make-string-builder))
+(display (string-builder->string out))
+(display (string-length (string-builder->string out)))
+(newline)
+(string-builder-append! out "Hello")
+(string-builder-append! out ", " "world" "")
+(display (string-builder->string out))
+(newline)
+
+; The string is a copy, so later appends don't change it.
+(define before (string-builder->string out))
+(string-builder-append! out "!")
+(display before)
+(newline)
+(display (string-builder->string out))
+(newline)
+
+; Past the first few doublings of the buffer.
+(define fill
+  (lambda (n)
+    (cond ((= n 0) out)
+          (else (fill (car (list (- n 1) (string-builder-append! out "0123456789"))))))))
+(fill 100)
+(display (string-length (string-builder->string out)))
+(newline)
+(display (substring (string-builder->string out) 0 16))
+(newline)
+
+(string-builder-append! out "a" (quote b))
@@ -0,0 +1,4 @@
+; A syntax error ends the script with a message, after the forms before it.
+(display "before")
+(newline)
+(display "unterminated)
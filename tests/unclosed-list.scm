@@ -0,0 +1,4 @@
+; A list left open ends the script with a message, after the forms before it.
+(display "before")
+(newline)
+(display (list 1 2)
@@ -0,0 +1,15 @@
+; Data must not be usable once it has been unloaded.
+(define d (load-data "tests/unload-data.dat"))
+(define first-record (car d))
+(display (length d))
+(newline)
+(display first-record)
+(newline)
+(define outside (list 0 (car (cdr d))))
+(unload-data d)
+; Objects reached from outside the region read as unloaded.
+(display (cdr outside))
+(newline)
+(display (list? (car (cdr outside))))
+(newline)
+(length d)